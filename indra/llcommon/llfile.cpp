@@ -29,6 +29,10 @@
 
 #if LL_WINDOWS
 #include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
 #endif
 
 #include "linden_common.h"
@@ -183,6 +187,166 @@ const char *LLFile::tmpdir()
 }
 
 
+/***************** Memory mapped file *******************/
+
+LLMappedFile::LLMappedFile()
+:	mData(NULL),
+	mSize(0),
+	mReadOnly(true),
+#if LL_WINDOWS
+	mFile(INVALID_HANDLE_VALUE),
+	mMapping(NULL)
+#else
+	mFile(-1)
+#endif
+{
+}
+
+LLMappedFile::~LLMappedFile()
+{
+	close();
+}
+
+bool LLMappedFile::open(const std::string& filename, size_t size, bool readonly)
+{
+	close();
+	mReadOnly = readonly;
+
+#if LL_WINDOWS
+	llutf16string utf16filename = utf8str_to_utf16str(filename);
+	DWORD access = readonly ? GENERIC_READ : (GENERIC_READ | GENERIC_WRITE);
+	DWORD creation = readonly ? OPEN_EXISTING : OPEN_ALWAYS;
+	mFile = CreateFileW(utf16filename.c_str(), access, FILE_SHARE_READ | FILE_SHARE_WRITE,
+						NULL, creation, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (mFile == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+	LARGE_INTEGER file_size;
+	if (!GetFileSizeEx((HANDLE)mFile, &file_size))
+	{
+		close();
+		return false;
+	}
+	if (size == 0 || (readonly && (size_t)file_size.QuadPart < size))
+	{
+		size = (size_t)file_size.QuadPart;
+	}
+	if (size == 0)
+	{
+		close();
+		return false;
+	}
+	// CreateFileMapping() grows the file to the mapping size if needed.
+	U64 map_size = llmax((U64)size, (U64)file_size.QuadPart);
+	mMapping = CreateFileMappingW((HANDLE)mFile, NULL, readonly ? PAGE_READONLY : PAGE_READWRITE,
+								  (DWORD)(map_size >> 32), (DWORD)(map_size & 0xffffffff), NULL);
+	if (!mMapping)
+	{
+		close();
+		return false;
+	}
+	mData = (U8*)MapViewOfFile((HANDLE)mMapping, readonly ? FILE_MAP_READ : FILE_MAP_WRITE, 0, 0, 0);
+	if (!mData)
+	{
+		close();
+		return false;
+	}
+	mSize = (size_t)map_size;
+#else
+	mFile = ::open(filename.c_str(), readonly ? O_RDONLY : (O_RDWR | O_CREAT), 0600);
+	if (mFile < 0)
+	{
+		return false;
+	}
+	struct stat st;
+	if (fstat(mFile, &st) != 0)
+	{
+		close();
+		return false;
+	}
+	if (size == 0 || (readonly && (size_t)st.st_size < size))
+	{
+		size = (size_t)st.st_size;
+	}
+	if (size == 0)
+	{
+		close();
+		return false;
+	}
+	if ((size_t)st.st_size < size)
+	{
+		if (ftruncate(mFile, (off_t)size) != 0)
+		{
+			close();
+			return false;
+		}
+	}
+	else
+	{
+		size = (size_t)st.st_size;
+	}
+	void* data = mmap(NULL, size, readonly ? PROT_READ : (PROT_READ | PROT_WRITE), MAP_SHARED, mFile, 0);
+	if (data == MAP_FAILED)
+	{
+		close();
+		return false;
+	}
+	mData = (U8*)data;
+	mSize = size;
+#endif
+	return true;
+}
+
+void LLMappedFile::close()
+{
+#if LL_WINDOWS
+	if (mData)
+	{
+		UnmapViewOfFile(mData);
+	}
+	if (mMapping)
+	{
+		CloseHandle((HANDLE)mMapping);
+		mMapping = NULL;
+	}
+	if (mFile != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle((HANDLE)mFile);
+		mFile = INVALID_HANDLE_VALUE;
+	}
+#else
+	if (mData)
+	{
+		munmap(mData, mSize);
+	}
+	if (mFile >= 0)
+	{
+		::close(mFile);
+		mFile = -1;
+	}
+#endif
+	mData = NULL;
+	mSize = 0;
+}
+
+bool LLMappedFile::flush(bool async)
+{
+	if (!mData || mReadOnly)
+	{
+		return false;
+	}
+#if LL_WINDOWS
+	if (!FlushViewOfFile(mData, 0))
+	{
+		return false;
+	}
+	return async || FlushFileBuffers((HANDLE)mFile);
+#else
+	return msync(mData, mSize, async ? MS_ASYNC : MS_SYNC) == 0;
+#endif
+}
+
 /***************** Modified file stream created to overcome the incorrect behaviour of posix fopen in windows *******************/
 
 #if USE_LLFILESTREAMS
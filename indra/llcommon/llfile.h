@@ -88,6 +88,43 @@ public:
 	static  const char * tmpdir();
 };
 
+/**
+ * Shared read/write memory mapping of a whole file.
+ * Stores into the mapping reach the file whenever the OS decides to write
+ * the dirty pages back; call flush() to push them out explicitly
+ * (msync() / FlushViewOfFile()).
+ */
+class LL_COMMON_API LLMappedFile
+{
+public:
+	LLMappedFile();
+	~LLMappedFile();
+
+	// Maps filename, creating the file and growing it to at least size bytes
+	// unless readonly. A size of 0 maps the file at its current size.
+	bool open(const std::string& filename, size_t size, bool readonly = false);
+	void close();
+
+	// Schedules (async) or waits for (sync) the write-back of dirty pages.
+	bool flush(bool async = true);
+
+	bool isOpen() const { return mData != NULL; }
+	bool isReadOnly() const { return mReadOnly; }
+	U8* getData() const { return mData; }
+	size_t getSize() const { return mSize; }
+
+private:
+	U8*		mData;
+	size_t	mSize;
+	bool	mReadOnly;
+#if LL_WINDOWS
+	void*	mFile;		// HANDLE
+	void*	mMapping;	// HANDLE
+#else
+	int		mFile;
+#endif
+};
+
 
 #if USE_LLFILESTREAMS
 
@@ -192,7 +192,7 @@ void LLQueuedThread::printQueueStats()
 	lockData();
 	if (!mRequestQueue.empty())
 	{
-		QueuedRequest *req = *mRequestQueue.begin();
+		QueuedRequest *req = mRequestQueue.top();
 		llinfos << llformat("Pending Requests:%d Current status:%d", mRequestQueue.size(), req->getStatus()) << llendl;
 	}
 	else
@@ -340,10 +340,9 @@ void LLQueuedThread::setPriority(handle_t handle, U32 priority)
 		}
 		else if(req->getStatus() == STATUS_QUEUED)
 		{
-			// remove from list then re-insert
-			llverify(mRequestQueue.erase(req) == 1);
+			// moved in the queue by the next processNextRequest()
 			req->setPriority(priority);
-			mRequestQueue.insert(req);
+			mRequestQueue.reprioritize(req);
 		}
 	}
 	unlockData();
@@ -400,13 +399,11 @@ S32 LLQueuedThread::processNextRequest()
 	lockData();
 	while(1)
 	{
-		req = NULL;
-		if (mRequestQueue.empty())
+		req = mRequestQueue.pop();
+		if (!req)
 		{
 			break;
 		}
-		req = *mRequestQueue.begin();
-		mRequestQueue.erase(mRequestQueue.begin());
 		if ((req->getFlags() & FLAG_ABORT) || (mStatus == QUITTING))
 		{
 			req->setStatus(STATUS_ABORTED);
@@ -534,7 +531,10 @@ LLQueuedThread::QueuedRequest::QueuedRequest(LLQueuedThread::handle_t handle, U3
 	LLSimpleHashEntry<LLQueuedThread::handle_t>(handle),
 	mStatus(STATUS_UNKNOWN),
 	mPriority(priority),
-	mFlags(flags)
+	mFlags(flags),
+	mQueuedPriority(priority),
+	mQueueIndex(-1),
+	mPriorityChanged(false)
 {
 }
 
@@ -555,3 +555,168 @@ void LLQueuedThread::QueuedRequest::deleteRequest()
 	setStatus(STATUS_DELETE);
 	delete this;
 }
+
+//============================================================================
+
+static const size_t REQUEST_QUEUE_ARITY = 4;
+static const size_t REQUEST_QUEUE_REBUILD_FRACTION = 8; // rebuild when more than 1/8 of the queue changed
+
+void LLQueuedThread::RequestQueue::insert(QueuedRequest* req)
+{
+	llassert(req->mQueueIndex < 0);
+	req->mQueuedPriority = req->mPriority;
+	req->mPriorityChanged = false;
+	mHeap.push_back(req);
+	place(mHeap.size() - 1, req);
+	siftUp(mHeap.size() - 1);
+}
+
+bool LLQueuedThread::RequestQueue::erase(QueuedRequest* req)
+{
+	if (!contains(req))
+	{
+		return false;
+	}
+	if (req->mPriorityChanged)
+	{
+		std::vector<QueuedRequest*>::iterator iter = std::find(mChanged.begin(), mChanged.end(), req);
+		llassert(iter != mChanged.end());
+		*iter = mChanged.back();
+		mChanged.pop_back();
+		req->mPriorityChanged = false;
+	}
+	size_t idx = req->mQueueIndex;
+	QueuedRequest* last = mHeap.back();
+	mHeap.pop_back();
+	req->mQueueIndex = -1;
+	if (last != req)
+	{
+		place(idx, last);
+		siftUp(idx);
+		siftDown(last->mQueueIndex);
+	}
+	return true;
+}
+
+void LLQueuedThread::RequestQueue::reprioritize(QueuedRequest* req)
+{
+	if (!contains(req) || req->mPriorityChanged)
+	{
+		return;
+	}
+	if (req->mPriority != req->mQueuedPriority)
+	{
+		req->mPriorityChanged = true;
+		mChanged.push_back(req);
+	}
+}
+
+LLQueuedThread::QueuedRequest* LLQueuedThread::RequestQueue::top()
+{
+	commit();
+	return mHeap.empty() ? NULL : mHeap.front();
+}
+
+LLQueuedThread::QueuedRequest* LLQueuedThread::RequestQueue::pop()
+{
+	QueuedRequest* req = top();
+	if (req)
+	{
+		erase(req);
+	}
+	return req;
+}
+
+void LLQueuedThread::RequestQueue::clear()
+{
+	for (std::vector<QueuedRequest*>::iterator iter = mHeap.begin(); iter != mHeap.end(); ++iter)
+	{
+		(*iter)->mQueueIndex = -1;
+		(*iter)->mPriorityChanged = false;
+	}
+	mHeap.clear();
+	mChanged.clear();
+}
+
+void LLQueuedThread::RequestQueue::siftUp(size_t idx)
+{
+	QueuedRequest* req = mHeap[idx];
+	while (idx > 0)
+	{
+		size_t parent = (idx - 1) / REQUEST_QUEUE_ARITY;
+		if (!before(req, mHeap[parent]))
+		{
+			break;
+		}
+		place(idx, mHeap[parent]);
+		idx = parent;
+	}
+	place(idx, req);
+}
+
+void LLQueuedThread::RequestQueue::siftDown(size_t idx)
+{
+	QueuedRequest* req = mHeap[idx];
+	size_t count = mHeap.size();
+	while (true)
+	{
+		size_t first = idx * REQUEST_QUEUE_ARITY + 1;
+		if (first >= count)
+		{
+			break;
+		}
+		size_t last = llmin(first + REQUEST_QUEUE_ARITY, count);
+		size_t best = first;
+		for (size_t child = first + 1; child < last; ++child)
+		{
+			if (before(mHeap[child], mHeap[best]))
+			{
+				best = child;
+			}
+		}
+		if (!before(mHeap[best], req))
+		{
+			break;
+		}
+		place(idx, mHeap[best]);
+		idx = best;
+	}
+	place(idx, req);
+}
+
+// Applies the priority changes recorded by reprioritize()
+void LLQueuedThread::RequestQueue::commit()
+{
+	if (mChanged.empty())
+	{
+		return;
+	}
+	if (mChanged.size() > mHeap.size() / REQUEST_QUEUE_REBUILD_FRACTION)
+	{
+		for (std::vector<QueuedRequest*>::iterator iter = mChanged.begin(); iter != mChanged.end(); ++iter)
+		{
+			(*iter)->mQueuedPriority = (*iter)->mPriority;
+			(*iter)->mPriorityChanged = false;
+		}
+		// Bottom-up heap construction
+		for (size_t idx = mHeap.size() / REQUEST_QUEUE_ARITY + 1; idx-- > 0; )
+		{
+			if (idx < mHeap.size())
+			{
+				siftDown(idx);
+			}
+		}
+	}
+	else
+	{
+		for (std::vector<QueuedRequest*>::iterator iter = mChanged.begin(); iter != mChanged.end(); ++iter)
+		{
+			QueuedRequest* req = *iter;
+			req->mQueuedPriority = req->mPriority;
+			req->mPriorityChanged = false;
+			siftUp(req->mQueueIndex);
+			siftDown(req->mQueueIndex);
+		}
+	}
+	mChanged.clear();
+}
@@ -31,6 +31,7 @@
 #include <string>
 #include <map>
 #include <set>
+#include <vector>
 
 #include "llapr.h"
 
@@ -71,12 +72,15 @@ public:
 
 	typedef U32 handle_t;
 	
+	class RequestQueue;
+
 	//------------------------------------------------------------------------
 public:
 
 	class LL_COMMON_API QueuedRequest : public LLSimpleHashEntry<handle_t>
 	{
 		friend class LLQueuedThread;
+		friend class RequestQueue;
 		
 	protected:
 		virtual ~QueuedRequest(); // use deleteRequest()
@@ -123,7 +127,7 @@ public:
 
 		void setPriority(U32 pri)
 		{
-			// Only do this on a request that is not in a queued list!
+			// A queued request must also be passed to RequestQueue::reprioritize()
 			mPriority = pri;
 		};
 		
@@ -131,15 +135,66 @@ public:
 		LLAtomic32<status_t> mStatus;
 		U32 mPriority;
 		U32 mFlags;
+
+	private:
+		// Owned by the RequestQueue the request is in
+		U32 mQueuedPriority; // priority the queue orders the request by
+		S32 mQueueIndex; // position in the heap, -1 if not queued
+		bool mPriorityChanged; // mPriority differs from mQueuedPriority
 	};
 
-protected:
-	struct queued_request_less
+	// Indexed 4-ary heap of requests, highest priority first (see higherPriority()).
+	// Each request knows its position in the heap, so it can be found,
+	// removed or moved without a search.
+	// reprioritize() only records a change of priority. All recorded changes
+	// are applied at the next top() or pop(), by moving each request or, when
+	// many requests changed, by rebuilding the heap in O(N). Changing the
+	// priority of every queued request once per frame is then O(N), not
+	// O(N log N) as with erasing and re-inserting each one in a sorted set.
+	// Not thread safe, a request can be in one queue at a time.
+	class LL_COMMON_API RequestQueue
 	{
-		bool operator()(const QueuedRequest* lhs, const QueuedRequest* rhs) const
+	public:
+		typedef std::vector<QueuedRequest*>::const_iterator iterator; // in no particular order
+		typedef iterator const_iterator;
+
+		bool empty() const { return mHeap.empty(); }
+		size_t size() const { return mHeap.size(); }
+		iterator begin() const { return mHeap.begin(); }
+		iterator end() const { return mHeap.end(); }
+		bool contains(const QueuedRequest* req) const
 		{
-			return lhs->higherPriority(*rhs); // higher priority in front of queue (set)
+			return req->mQueueIndex >= 0 && (size_t)req->mQueueIndex < mHeap.size()
+				&& mHeap[req->mQueueIndex] == req;
 		}
+
+		void insert(QueuedRequest* req);
+		bool erase(QueuedRequest* req); // false if req is not in this queue
+		void reprioritize(QueuedRequest* req); // call after req->setPriority()
+		QueuedRequest* top(); // NULL if empty
+		QueuedRequest* pop(); // NULL if empty
+		void clear();
+
+	private:
+		bool before(const QueuedRequest* lhs, const QueuedRequest* rhs) const
+		{
+			if (lhs->mQueuedPriority == rhs->mQueuedPriority)
+				return lhs->getHashKey() < rhs->getHashKey();
+			else
+				return lhs->mQueuedPriority > rhs->mQueuedPriority;
+		}
+		void place(size_t idx, QueuedRequest* req)
+		{
+			mHeap[idx] = req;
+			req->mQueueIndex = (S32)idx;
+		}
+		void siftUp(size_t idx);
+		void siftDown(size_t idx);
+		void commit();
+
+	private:
+		std::vector<QueuedRequest*> mHeap;
+		std::vector<QueuedRequest*> mChanged; // requests with a priority change to apply
 	};
 
 
@@ -200,7 +255,7 @@ protected:
 	BOOL mStarted;  // required when mThreaded is false to call startThread() from update()
 	LLAtomic32<BOOL> mIdleThread; // request queue is empty (or we are quitting) and the thread is idle
 	
-	typedef std::set<QueuedRequest*, queued_request_less> request_queue_t;
+	typedef RequestQueue request_queue_t;
 	request_queue_t mRequestQueue;
 
 	enum { REQUEST_HASH_SIZE = 512 }; // must be power of 2
@@ -114,6 +114,7 @@ public:
 	virtual Binary	asBinary() const			{ return std::vector<U8>(); }
 	
 	virtual bool has(const String&) const		{ return false; }
+	virtual const LLSD* find(const char*) const	{ return NULL; }
 	virtual LLSD get(const String&) const		{ return LLSD(); }
 	virtual void erase(const String&)			{ }
 	virtual const LLSD& ref(const String&) const{ return undef(); }
@@ -344,6 +345,8 @@ namespace
 		virtual LLSD::Boolean asBoolean() const { return !mData.empty(); }
 
 		virtual bool has(const LLSD::String&) const; 
+		virtual const LLSD* find(const char*) const;
+		        LLSD* find(const char* k)	{ return const_cast<LLSD*>(static_cast<const ImplMap*>(this)->find(k)); }
 
 		using LLSD::Impl::get; // Unhiding get(LLSD::Integer)
 		using LLSD::Impl::erase; // Unhiding erase(LLSD::Integer)
@@ -382,6 +385,32 @@ namespace
 		return i != mData.end();
 	}
 	
+	// Maps up to this size are scanned instead of building a String for
+	// find(). Most maps, like the blocks of a message, are this small.
+	static const size_t SMALL_MAP_SIZE = 8;
+
+	const LLSD* ImplMap::find(const char* k) const
+	{
+		if (mData.size() > SMALL_MAP_SIZE)
+		{
+			DataMap::const_iterator i = mData.find(k);
+			return (i != mData.end()) ? &i->second : NULL;
+		}
+		for (DataMap::const_iterator i = mData.begin(); i != mData.end(); ++i)
+		{
+			int cmp = i->first.compare(k);
+			if (cmp == 0)
+			{
+				return &i->second;
+			}
+			if (cmp > 0)
+			{
+				break; // keys are in order, k is not there
+			}
+		}
+		return NULL;
+	}
+
 	LLSD ImplMap::get(const LLSD::String& k) const
 	{
 		DataMap::const_iterator i = mData.find(k);
@@ -757,6 +786,21 @@ LLSD&		LLSD::operator[](const String& k)
 const LLSD& LLSD::operator[](const String& k) const
 										{ return safe(impl).ref(k); }
 
+bool LLSD::has(const char* k) const		{ return safe(impl).find(k) != NULL; }
+
+LLSD& LLSD::operator[](const char* k)
+{
+	ImplMap& map = makeMap(impl);
+	LLSD* value = map.find(k);
+	return value ? *value : map.ref(String(k));
+}
+
+const LLSD& LLSD::operator[](const char* k) const
+{
+	const LLSD* value = safe(impl).find(k);
+	return value ? *value : Impl::undef();
+}
+
 
 LLSD LLSD::emptyArray()
 {
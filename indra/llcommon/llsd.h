@@ -59,6 +59,20 @@
 	array.  LLSD objects have value semantics (copying them copies the value,
 	though it can be considered efficient, due to shareing.), and mutable.
 
+	Sharing is structural: copying an LLSD, or passing one by value, only
+	bumps a use count, however deep the tree.  A map or array is copied when
+	it is modified while shared, and then only that one level is copied; the
+	elements of the copy keep sharing their own values with the original.
+	So posting one event to many listeners that each keep a copy costs a
+	use count per listener, and a listener that adds a key to its copy pays
+	for a copy of the top level map only.
+
+	A reference to an element (as returned by the non-const operator[]) is
+	only valid until the container is next modified, and writes through it
+	are not checked for sharing.  Do not hold one across a copy of any
+	enclosing value, such as across a post() of the enclosing event: take
+	it again afterwards.
+
 	Undefined is the singular value given to LLSD objects that are not
 	initialized with any data.  It is also used as the return value for
 	operations that return an LLSD,
@@ -222,9 +236,17 @@ public:
 		LLSD& with(const String&, const LLSD&);
 		
 		LLSD& operator[](const String&);
-		LLSD& operator[](const char* c)			{ return (*this)[String(c)]; }
 		const LLSD& operator[](const String&) const;
-		const LLSD& operator[](const char* c) const	{ return (*this)[String(c)]; }
+
+		/**
+			Lookups by C string, such as literal keys or the interned names
+			of the message system, build no temporary String when the key is
+			present. Small maps are searched in place. A String key kept
+			around, for instance a static one, avoids the copy as well.
+		*/
+		bool has(const char*) const;
+		LLSD& operator[](const char*);
+		const LLSD& operator[](const char*) const;
 	//@}
 	
 	/** @name Array Values */
@@ -301,6 +301,126 @@ static const char BINARY_TRUE_SERIAL = '1';
 static const char BINARY_FALSE_SERIAL = '0';
 
 
+/**
+ * LLSDElementListener
+ */
+LLSDElementListener::LLSDElementListener(S32 depth)
+	: mDepth(depth), mLevel(0)
+{
+}
+
+void LLSDElementListener::reset()
+{
+	mLevel = 0;
+	mKey.clear();
+	mPath.clear();
+	mElement.clear();
+	mStack.clear();
+}
+
+LLSD* LLSDElementListener::addValue()
+{
+	if (mLevel < mDepth)
+	{
+		return NULL;
+	}
+	if (mLevel == mDepth)
+	{
+		mPath.push_back(mKey);
+		return &mElement;
+	}
+	// Pointers stay valid: values are only added to the innermost
+	// open map or array.
+	LLSD& parent = *mStack.back();
+	if (parent.isMap())
+	{
+		return &parent[mKey];
+	}
+	parent.append(LLSD());
+	return &parent[parent.size() - 1];
+}
+
+void LLSDElementListener::beginContainer(const LLSD& empty)
+{
+	LLSD* value = addValue();
+	if (value)
+	{
+		*value = empty;
+		mStack.push_back(value);
+	}
+	else
+	{
+		mPath.push_back(mKey);
+	}
+	mKey.clear();
+	++mLevel;
+}
+
+void LLSDElementListener::endContainer()
+{
+	if (mLevel <= 0)
+	{
+		return;
+	}
+	--mLevel;
+	if (mLevel >= mDepth)
+	{
+		mStack.pop_back();
+	}
+	if (mLevel == mDepth)
+	{
+		element(mElement);
+		mElement.clear();
+	}
+	if (mLevel <= mDepth)
+	{
+		mPath.pop_back();
+	}
+}
+
+void LLSDElementListener::beginMap()
+{
+	beginContainer(LLSD::emptyMap());
+}
+
+void LLSDElementListener::endMap()
+{
+	endContainer();
+}
+
+void LLSDElementListener::beginArray()
+{
+	beginContainer(LLSD::emptyArray());
+}
+
+void LLSDElementListener::endArray()
+{
+	endContainer();
+}
+
+void LLSDElementListener::key(const std::string& key)
+{
+	mKey = key;
+}
+
+void LLSDElementListener::value(const LLSD& value)
+{
+	LLSD* dest = addValue();
+	mKey.clear();
+	if (!dest)
+	{
+		return;
+	}
+	*dest = value;
+	if (mLevel == mDepth)
+	{
+		element(mElement);
+		mElement.clear();
+		mPath.pop_back();
+	}
+}
+
+
 /**
  * LLSDParser
  */
@@ -330,6 +450,61 @@ S32 LLSDParser::parseLines(std::istream& istr, LLSD& data)
 }
 
 
+S32 LLSDParser::parse(std::istream& istr, LLSDParseListener& listener, S32 max_bytes)
+{
+	mCheckLimits = (LLSDSerialize::SIZE_UNLIMITED == max_bytes) ? false : true;
+	mMaxBytesLeft = max_bytes;
+	return doParseEvents(istr, listener);
+}
+
+S32 LLSDParser::parseLines(std::istream& istr, LLSDParseListener& listener)
+{
+	mCheckLimits = false;
+	mParseLines = true;
+	return doParseEvents(istr, listener);
+}
+
+static void replay_llsd(const LLSD& data, LLSDParseListener& listener)
+{
+	switch (data.type())
+	{
+	case LLSD::TypeMap:
+		listener.beginMap();
+		for (LLSD::map_const_iterator iter = data.beginMap(); iter != data.endMap(); ++iter)
+		{
+			listener.key(iter->first);
+			replay_llsd(iter->second, listener);
+		}
+		listener.endMap();
+		break;
+
+	case LLSD::TypeArray:
+		listener.beginArray();
+		for (LLSD::array_const_iterator iter = data.beginArray(); iter != data.endArray(); ++iter)
+		{
+			replay_llsd(*iter, listener);
+		}
+		listener.endArray();
+		break;
+
+	default:
+		listener.value(data);
+		break;
+	}
+}
+
+// virtual
+S32 LLSDParser::doParseEvents(std::istream& istr, LLSDParseListener& listener) const
+{
+	LLSD data;
+	S32 count = doParse(istr, data);
+	if (count > 0)
+	{
+		replay_llsd(data, listener);
+	}
+	return count;
+}
+
 int LLSDParser::get(std::istream& istr) const
 {
 	if(mCheckLimits) --mMaxBytesLeft;
@@ -1029,180 +1204,795 @@ S32 LLSDBinaryParser::doParse(std::istream& istr, LLSD& data) const
 		}
 		else
 		{
-			parse_count = PARSE_FAILURE;
+			parse_count = PARSE_FAILURE;
+		}
+		if(istr.fail())
+		{
+			llinfos << "STREAM FAILURE reading binary link." << llendl;
+			parse_count = PARSE_FAILURE;
+		}
+		break;
+	}
+
+	case 'd':
+	{
+		F64 real = 0.0;
+		read(istr, (char*)&real, sizeof(F64));	 /*Flawfinder: ignore*/
+		data = LLDate(real);
+		if(istr.fail())
+		{
+			llinfos << "STREAM FAILURE reading binary date." << llendl;
+			parse_count = PARSE_FAILURE;
+		}
+		break;
+	}
+
+	case 'b':
+	{
+		// We probably have a valid raw binary stream. determine
+		// the size, and read it.
+		U32 size_nbo = 0;
+		read(istr, (char*)&size_nbo, sizeof(U32));	/*Flawfinder: ignore*/
+		S32 size = (S32)ntohl(size_nbo);
+		if(mCheckLimits && (size > mMaxBytesLeft))
+		{
+			parse_count = PARSE_FAILURE;
+		}
+		else
+		{
+			std::vector<U8> value;
+			if(size > 0)
+			{
+				value.resize(size);
+				account(fullread(istr, (char*)&value[0], size));
+			}
+			data = value;
+		}
+		if(istr.fail())
+		{
+			llinfos << "STREAM FAILURE reading binary." << llendl;
+			parse_count = PARSE_FAILURE;
+		}
+		break;
+	}
+
+	default:
+		parse_count = PARSE_FAILURE;
+		llinfos << "Unrecognized character while parsing: int(" << (int)c
+			<< ")" << llendl;
+		break;
+	}
+	if(PARSE_FAILURE == parse_count)
+	{
+		data.clear();
+	}
+	return parse_count;
+}
+
+S32 LLSDBinaryParser::parseMap(std::istream& istr, LLSD& map) const
+{
+	map = LLSD::emptyMap();
+	U32 value_nbo = 0;
+	read(istr, (char*)&value_nbo, sizeof(U32));		 /*Flawfinder: ignore*/
+	S32 size = (S32)ntohl(value_nbo);
+	S32 parse_count = 0;
+	S32 count = 0;
+	char c = get(istr);
+	while(c != '}' && (count < size) && istr.good())
+	{
+		std::string name;
+		switch(c)
+		{
+		case 'k':
+			if(!parseString(istr, name))
+			{
+				return PARSE_FAILURE;
+			}
+			break;
+		case '\'':
+		case '"':
+		{
+			int cnt = deserialize_string_delim(istr, name, c);
+			if(PARSE_FAILURE == cnt) return PARSE_FAILURE;
+			account(cnt);
+			break;
+		}
+		}
+		LLSD child;
+		S32 child_count = doParse(istr, child);
+		if(child_count > 0)
+		{
+			// There must be a value for every key, thus child_count
+			// must be greater than 0.
+			parse_count += child_count;
+			map.insert(name, child);
+		}
+		else
+		{
+			return PARSE_FAILURE;
+		}
+		++count;
+		c = get(istr);
+	}
+	if((c != '}') || (count < size))
+	{
+		// Make sure it is correctly terminated and we parsed as many
+		// as were said to be there.
+		return PARSE_FAILURE;
+	}
+	return parse_count;
+}
+
+S32 LLSDBinaryParser::parseArray(std::istream& istr, LLSD& array) const
+{
+	array = LLSD::emptyArray();
+	U32 value_nbo = 0;
+	read(istr, (char*)&value_nbo, sizeof(U32));		 /*Flawfinder: ignore*/
+	S32 size = (S32)ntohl(value_nbo);
+
+	// *FIX: This would be a good place to reserve some space in the
+	// array...
+
+	S32 parse_count = 0;
+	S32 count = 0;
+	char c = istr.peek();
+	while((c != ']') && (count < size) && istr.good())
+	{
+		LLSD child;
+		S32 child_count = doParse(istr, child);
+		if(PARSE_FAILURE == child_count)
+		{
+			return PARSE_FAILURE;
+		}
+		if(child_count)
+		{
+			parse_count += child_count;
+			array.append(child);
+		}
+		++count;
+		c = istr.peek();
+	}
+	c = get(istr);
+	if((c != ']') || (count < size))
+	{
+		// Make sure it is correctly terminated and we parsed as many
+		// as were said to be there.
+		return PARSE_FAILURE;
+	}
+	return parse_count;
+}
+
+bool LLSDBinaryParser::parseString(
+	std::istream& istr,
+	std::string& value) const
+{
+	// *FIX: This is memory inefficient.
+	U32 value_nbo = 0;
+	read(istr, (char*)&value_nbo, sizeof(U32));		 /*Flawfinder: ignore*/
+	S32 size = (S32)ntohl(value_nbo);
+	if(mCheckLimits && (size > mMaxBytesLeft)) return false;
+	std::vector<char> buf;
+	if(size)
+	{
+		buf.resize(size);
+		account(fullread(istr, &buf[0], size));
+		value.assign(buf.begin(), buf.end());
+	}
+	return true;
+}
+
+
+namespace
+{
+	// Reads the 4 byte network order count or size at p, false if truncated.
+	inline bool read_buffer_u32(const U8*& p, const U8* end, U32& value)
+	{
+		if (end - p < (ptrdiff_t) sizeof(U32))
+		{
+			return false;
+		}
+		U32 value_nbo = 0;
+		memcpy(&value_nbo, p, sizeof(U32));		/*Flawfinder: ignore*/
+		value = ntohl(value_nbo);
+		p += sizeof(U32);
+		return true;
+	}
+
+	// Reads a size prefixed string at p.
+	bool read_buffer_string(const U8*& p, const U8* end, std::string& value)
+	{
+		U32 size = 0;
+		if (!read_buffer_u32(p, end, size) || (U32) (end - p) < size)
+		{
+			return false;
+		}
+		value.assign((const char*) p, size);
+		p += size;
+		return true;
+	}
+
+	// Reads a notation style string ending with delim, the buffer
+	// equivalent of deserialize_string_delim().
+	bool read_buffer_string_delim(const U8*& p, const U8* end, char delim, std::string& value)
+	{
+		value.clear();
+		while (p < end)
+		{
+			char c = (char) *p++;
+			if (c == delim)
+			{
+				return true;
+			}
+			if (c != '\\')
+			{
+				value += c;
+				continue;
+			}
+			if (p >= end)
+			{
+				break;
+			}
+			c = (char) *p++;
+			switch (c)
+			{
+			case 'x':
+				if (end - p < 2)
+				{
+					p = end;
+					return false;
+				}
+				value += (char) ((hex_as_nybble(p[0]) << 4) | hex_as_nybble(p[1]));
+				p += 2;
+				break;
+			case 'a': value += '\a'; break;
+			case 'b': value += '\b'; break;
+			case 'f': value += '\f'; break;
+			case 'n': value += '\n'; break;
+			case 'r': value += '\r'; break;
+			case 't': value += '\t'; break;
+			case 'v': value += '\v'; break;
+			default: value += c; break;
+			}
+		}
+		return false;
+	}
+}
+
+S32 LLSDBinaryParser::parseBuffer(const U8*& data, const U8* end, LLSD& sd) const
+{
+	if (!data || data >= end)
+	{
+		sd.clear();
+		return 0;
+	}
+	return doParseBuffer(data, end, sd);
+}
+
+S32 LLSDBinaryParser::doParseBuffer(const U8*& p, const U8* end, LLSD& data) const
+{
+	// Same format and counts as doParse(), except that truncated data is
+	// always a failure.
+	if (p >= end)
+	{
+		data.clear();
+		return PARSE_FAILURE;
+	}
+	S32 parse_count = 1;
+	char c = (char) *p++;
+	switch(c)
+	{
+	case '{':
+	{
+		S32 child_count = parseMapBuffer(p, end, data);
+		parse_count = (child_count == PARSE_FAILURE) ? PARSE_FAILURE : parse_count + child_count;
+		break;
+	}
+
+	case '[':
+	{
+		S32 child_count = parseArrayBuffer(p, end, data);
+		parse_count = (child_count == PARSE_FAILURE) ? PARSE_FAILURE : parse_count + child_count;
+		break;
+	}
+
+	case '!':
+		data.clear();
+		break;
+
+	case '0':
+		data = false;
+		break;
+
+	case '1':
+		data = true;
+		break;
+
+	case 'i':
+	{
+		U32 value = 0;
+		if (read_buffer_u32(p, end, value))
+		{
+			data = (S32) value;
+		}
+		else
+		{
+			parse_count = PARSE_FAILURE;
+		}
+		break;
+	}
+
+	case 'r':
+	case 'd':
+	{
+		if (end - p < (ptrdiff_t) sizeof(F64))
+		{
+			parse_count = PARSE_FAILURE;
+			break;
+		}
+		F64 real = 0.0;
+		memcpy(&real, p, sizeof(F64));		/*Flawfinder: ignore*/
+		p += sizeof(F64);
+		// Dates are written in host byte order, see LLSDBinaryFormatter
+		if ('r' == c)
+		{
+			data = ll_ntohd(real);
+		}
+		else
+		{
+			data = LLDate(real);
+		}
+		break;
+	}
+
+	case 'u':
+	{
+		if (end - p < UUID_BYTES)
+		{
+			parse_count = PARSE_FAILURE;
+			break;
+		}
+		LLUUID id;
+		memcpy(id.mData, p, UUID_BYTES);		/*Flawfinder: ignore*/
+		p += UUID_BYTES;
+		data = id;
+		break;
+	}
+
+	case '\'':
+	case '"':
+	case 's':
+	case 'l':
+	{
+		std::string value;
+		bool ok = ('s' == c || 'l' == c) ? read_buffer_string(p, end, value)
+										 : read_buffer_string_delim(p, end, c, value);
+		if (!ok)
+		{
+			parse_count = PARSE_FAILURE;
+		}
+		else if ('l' == c)
+		{
+			data = LLURI(value);
+		}
+		else
+		{
+			data = value;
+		}
+		break;
+	}
+
+	case 'b':
+	{
+		U32 size = 0;
+		if (!read_buffer_u32(p, end, size) || (U32) (end - p) < size)
+		{
+			parse_count = PARSE_FAILURE;
+			break;
+		}
+		data = LLSD::Binary(p, p + size);
+		p += size;
+		break;
+	}
+
+	default:
+		parse_count = PARSE_FAILURE;
+		llinfos << "Unrecognized character while parsing: int(" << (int)c
+			<< ")" << llendl;
+		break;
+	}
+	if(PARSE_FAILURE == parse_count)
+	{
+		data.clear();
+	}
+	return parse_count;
+}
+
+S32 LLSDBinaryParser::parseMapBuffer(const U8*& p, const U8* end, LLSD& map) const
+{
+	map = LLSD::emptyMap();
+	U32 size = 0;
+	if (!read_buffer_u32(p, end, size))
+	{
+		return PARSE_FAILURE;
+	}
+	S32 parse_count = 0;
+	std::string name;
+	for (U32 count = 0; count < size; ++count)
+	{
+		if (p >= end)
+		{
+			return PARSE_FAILURE;
+		}
+		char c = (char) *p++;
+		switch (c)
+		{
+		case 'k':
+			if (!read_buffer_string(p, end, name))
+			{
+				return PARSE_FAILURE;
+			}
+			break;
+		case '\'':
+		case '"':
+			if (!read_buffer_string_delim(p, end, c, name))
+			{
+				return PARSE_FAILURE;
+			}
+			break;
+		case '}':
+			// Fewer entries than the count said
+			return PARSE_FAILURE;
+		default:
+			name.clear();
+			break;
+		}
+		LLSD child;
+		S32 child_count = doParseBuffer(p, end, child);
+		if (child_count <= 0)
+		{
+			return PARSE_FAILURE;
+		}
+		parse_count += child_count;
+		map.insert(name, child);
+	}
+	if (p >= end || *p++ != '}')
+	{
+		return PARSE_FAILURE;
+	}
+	return parse_count;
+}
+
+S32 LLSDBinaryParser::parseArrayBuffer(const U8*& p, const U8* end, LLSD& array) const
+{
+	array = LLSD::emptyArray();
+	U32 size = 0;
+	// Every value takes at least one byte, so a larger count is malformed.
+	// Checking it first keeps a bad count from sizing the array.
+	if (!read_buffer_u32(p, end, size) || size > (U32) (end - p))
+	{
+		return PARSE_FAILURE;
+	}
+	if (size > 0)
+	{
+		array[(S32) size - 1] = LLSD();
+	}
+	S32 parse_count = 0;
+	for (U32 i = 0; i < size; ++i)
+	{
+		if (p < end && *p == ']')
+		{
+			// Fewer entries than the count said
+			return PARSE_FAILURE;
+		}
+		// Parse straight into the element instead of appending a copy
+		S32 child_count = doParseBuffer(p, end, array[(S32) i]);
+		if (PARSE_FAILURE == child_count)
+		{
+			return PARSE_FAILURE;
+		}
+		parse_count += child_count;
+	}
+	if (p >= end || *p++ != ']')
+	{
+		return PARSE_FAILURE;
+	}
+	return parse_count;
+}
+
+
+/**
+ * LLSDBinaryView
+ */
+LLSDBinaryView::LLSDBinaryView() :
+	mData(NULL),
+	mEnd(NULL)
+{
+}
+
+LLSDBinaryView::LLSDBinaryView(const U8* data, const U8* end) :
+	mData(data),
+	mEnd(end)
+{
+	if (mData && mData >= mEnd)
+	{
+		mData = NULL;
+	}
+}
+
+LLSD::Type LLSDBinaryView::type() const
+{
+	if (!mData)
+	{
+		return LLSD::TypeUndefined;
+	}
+	switch (*mData)
+	{
+	case '0':
+	case '1':
+		return LLSD::TypeBoolean;
+	case 'i':
+		return LLSD::TypeInteger;
+	case 'r':
+		return LLSD::TypeReal;
+	case 'u':
+		return LLSD::TypeUUID;
+	case 's':
+	case '\'':
+	case '"':
+		return LLSD::TypeString;
+	case 'l':
+		return LLSD::TypeURI;
+	case 'd':
+		return LLSD::TypeDate;
+	case 'b':
+		return LLSD::TypeBinary;
+	case '[':
+		return LLSD::TypeArray;
+	case '{':
+		return LLSD::TypeMap;
+	default:
+		return LLSD::TypeUndefined;
+	}
+}
+
+S32 LLSDBinaryView::size() const
+{
+	U32 count = 0;
+	if ((isArray() || isMap()) && readU32(mData + 1, count))
+	{
+		return (S32) llmin(count, (U32) S32_MAX);
+	}
+	return 0;
+}
+
+LLSDBinaryView LLSDBinaryView::operator[](S32 index) const
+{
+	if (index < 0 || index >= size() || !isArray())
+	{
+		return LLSDBinaryView();
+	}
+	const U8* p = mData + 1 + sizeof(U32);
+	for (S32 i = 0; i < index && p; ++i)
+	{
+		p = skip(p);
+	}
+	return LLSDBinaryView(p, mEnd);
+}
+
+LLSDBinaryView LLSDBinaryView::operator[](const char* key) const
+{
+	if (!isMap())
+	{
+		return LLSDBinaryView();
+	}
+	const size_t key_len = strlen(key);
+	const S32 count = size();
+	const U8* p = mData + 1 + sizeof(U32);
+	for (S32 i = 0; i < count && p; ++i)
+	{
+		const char* name = NULL;
+		S32 name_len = 0;
+		p = readKey(p, name, name_len);
+		if (!p)
+		{
+			break;
 		}
-		if(istr.fail())
+		if ((size_t) name_len == key_len && !memcmp(name, key, key_len))
 		{
-			llinfos << "STREAM FAILURE reading binary link." << llendl;
-			parse_count = PARSE_FAILURE;
+			return LLSDBinaryView(p, mEnd);
 		}
-		break;
+		p = skip(p);
 	}
+	return LLSDBinaryView();
+}
 
-	case 'd':
+bool LLSDBinaryView::has(const char* key) const
+{
+	// a key with an undefined value still counts, as with LLSD::has()
+	LLSDBinaryView value = (*this)[key];
+	return value.mData != NULL;
+}
+
+LLSD::Integer LLSDBinaryView::asInteger() const
+{
+	switch (type())
 	{
-		F64 real = 0.0;
-		read(istr, (char*)&real, sizeof(F64));	 /*Flawfinder: ignore*/
-		data = LLDate(real);
-		if(istr.fail())
-		{
-			llinfos << "STREAM FAILURE reading binary date." << llendl;
-			parse_count = PARSE_FAILURE;
-		}
-		break;
+	case LLSD::TypeInteger:
+	{
+		U32 value = 0;
+		readU32(mData + 1, value);
+		return (S32) value;
+	}
+	case LLSD::TypeReal:
+		return (S32) asReal();
+	case LLSD::TypeBoolean:
+		return *mData == '1' ? 1 : 0;
+	default:
+		return 0;
 	}
+}
 
-	case 'b':
+LLSD::Real LLSDBinaryView::asReal() const
+{
+	switch (type())
 	{
-		// We probably have a valid raw binary stream. determine
-		// the size, and read it.
-		U32 size_nbo = 0;
-		read(istr, (char*)&size_nbo, sizeof(U32));	/*Flawfinder: ignore*/
-		S32 size = (S32)ntohl(size_nbo);
-		if(mCheckLimits && (size > mMaxBytesLeft))
-		{
-			parse_count = PARSE_FAILURE;
-		}
-		else
-		{
-			std::vector<U8> value;
-			if(size > 0)
-			{
-				value.resize(size);
-				account(fullread(istr, (char*)&value[0], size));
-			}
-			data = value;
-		}
-		if(istr.fail())
+	case LLSD::TypeReal:
+	{
+		if (mEnd - mData < (S32) (1 + sizeof(F64)))
 		{
-			llinfos << "STREAM FAILURE reading binary." << llendl;
-			parse_count = PARSE_FAILURE;
+			return 0.0;
 		}
-		break;
+		F64 real_nbo = 0.0;
+		memcpy(&real_nbo, mData + 1, sizeof(F64));
+		return ll_ntohd(real_nbo);
 	}
-
+	case LLSD::TypeInteger:
+	case LLSD::TypeBoolean:
+		return (F64) asInteger();
 	default:
-		parse_count = PARSE_FAILURE;
-		llinfos << "Unrecognized character while parsing: int(" << (int)c
-			<< ")" << llendl;
-		break;
+		return 0.0;
 	}
-	if(PARSE_FAILURE == parse_count)
+}
+
+const U8* LLSDBinaryView::asBinary(S32& size) const
+{
+	size = 0;
+	U32 value_size = 0;
+	if (type() != LLSD::TypeBinary || !readU32(mData + 1, value_size))
 	{
-		data.clear();
+		return NULL;
 	}
-	return parse_count;
+	const U8* data = mData + 1 + sizeof(U32);
+	if ((U32) (mEnd - data) < value_size)
+	{
+		return NULL;
+	}
+	size = (S32) value_size;
+	return data;
 }
 
-S32 LLSDBinaryParser::parseMap(std::istream& istr, LLSD& map) const
+const U8* LLSDBinaryView::skip(const U8* p) const
 {
-	map = LLSD::emptyMap();
-	U32 value_nbo = 0;
-	read(istr, (char*)&value_nbo, sizeof(U32));		 /*Flawfinder: ignore*/
-	S32 size = (S32)ntohl(value_nbo);
-	S32 parse_count = 0;
-	S32 count = 0;
-	char c = get(istr);
-	while(c != '}' && (count < size) && istr.good())
+	if (!p || p >= mEnd)
 	{
-		std::string name;
-		switch(c)
+		return NULL;
+	}
+	U32 size = 0;
+	switch (*p)
+	{
+	case '!':
+	case '0':
+	case '1':
+		return p + 1;
+	case 'i':
+		size = sizeof(U32);
+		break;
+	case 'r':
+	case 'd':
+		size = sizeof(F64);
+		break;
+	case 'u':
+		size = UUID_BYTES;
+		break;
+	case 's':
+	case 'l':
+	case 'b':
+	case 'k':
+		if (!readU32(p + 1, size) || size > (U32) S32_MAX)
 		{
-		case 'k':
-			if(!parseString(istr, name))
+			return NULL;
+		}
+		size += sizeof(U32);
+		break;
+	case '\'':
+	case '"':
+		for (const U8* q = p + 1; q < mEnd; ++q)
+		{
+			if (*q == '\\')
 			{
-				return PARSE_FAILURE;
+				++q;
+			}
+			else if (*q == *p)
+			{
+				return q + 1;
 			}
-			break;
-		case '\'':
-		case '"':
-		{
-			int cnt = deserialize_string_delim(istr, name, c);
-			if(PARSE_FAILURE == cnt) return PARSE_FAILURE;
-			account(cnt);
-			break;
 		}
+		return NULL;
+	case '[':
+	case '{':
+	{
+		U32 count = 0;
+		if (!readU32(p + 1, count))
+		{
+			return NULL;
 		}
-		LLSD child;
-		S32 child_count = doParse(istr, child);
-		if(child_count > 0)
+		const bool is_map = (*p == '{');
+		const U8* q = p + 1 + sizeof(U32);
+		for (U32 i = 0; i < count && q; ++i)
 		{
-			// There must be a value for every key, thus child_count
-			// must be greater than 0.
-			parse_count += child_count;
-			map.insert(name, child);
+			if (is_map)
+			{
+				const char* key = NULL;
+				S32 key_len = 0;
+				q = readKey(q, key, key_len);
+			}
+			q = skip(q);
 		}
-		else
+		if (!q || q >= mEnd || *q != (is_map ? '}' : ']'))
 		{
-			return PARSE_FAILURE;
+			return NULL;
 		}
-		++count;
-		c = get(istr);
+		return q + 1;
 	}
-	if((c != '}') || (count < size))
+	default:
+		return NULL;
+	}
+	if ((U32) (mEnd - p - 1) < size)
 	{
-		// Make sure it is correctly terminated and we parsed as many
-		// as were said to be there.
-		return PARSE_FAILURE;
+		return NULL;
 	}
-	return parse_count;
+	return p + 1 + size;
 }
 
-S32 LLSDBinaryParser::parseArray(std::istream& istr, LLSD& array) const
+const U8* LLSDBinaryView::readKey(const U8* p, const char*& key, S32& key_len) const
 {
-	array = LLSD::emptyArray();
-	U32 value_nbo = 0;
-	read(istr, (char*)&value_nbo, sizeof(U32));		 /*Flawfinder: ignore*/
-	S32 size = (S32)ntohl(value_nbo);
-
-	// *FIX: This would be a good place to reserve some space in the
-	// array...
-
-	S32 parse_count = 0;
-	S32 count = 0;
-	char c = istr.peek();
-	while((c != ']') && (count < size) && istr.good())
+	if (!p || p >= mEnd)
 	{
-		LLSD child;
-		S32 child_count = doParse(istr, child);
-		if(PARSE_FAILURE == child_count)
-		{
-			return PARSE_FAILURE;
-		}
-		if(child_count)
+		return NULL;
+	}
+	if (*p == 'k')
+	{
+		const U8* end = skip(p);
+		if (end)
 		{
-			parse_count += child_count;
-			array.append(child);
+			key = (const char*) (p + 1 + sizeof(U32));
+			key_len = (S32) (end - (const U8*) key);
 		}
-		++count;
-		c = istr.peek();
+		return end;
 	}
-	c = get(istr);
-	if((c != ']') || (count < size))
+	if (*p == '\'' || *p == '"')
 	{
-		// Make sure it is correctly terminated and we parsed as many
-		// as were said to be there.
-		return PARSE_FAILURE;
+		// escapes are not decoded, keys are compared as written
+		const U8* end = skip(p);
+		if (end)
+		{
+			key = (const char*) (p + 1);
+			key_len = (S32) (end - p - 2);
+		}
+		return end;
 	}
-	return parse_count;
+	return NULL;
 }
 
-bool LLSDBinaryParser::parseString(
-	std::istream& istr,
-	std::string& value) const
+bool LLSDBinaryView::readU32(const U8* p, U32& value) const
 {
-	// *FIX: This is memory inefficient.
-	U32 value_nbo = 0;
-	read(istr, (char*)&value_nbo, sizeof(U32));		 /*Flawfinder: ignore*/
-	S32 size = (S32)ntohl(value_nbo);
-	if(mCheckLimits && (size > mMaxBytesLeft)) return false;
-	std::vector<char> buf;
-	if(size)
+	if (!p || mEnd - p < (S32) sizeof(U32))
 	{
-		buf.resize(size);
-		account(fullread(istr, &buf[0], size));
-		value.assign(buf.begin(), buf.end());
+		return false;
 	}
+	U32 value_nbo = 0;
+	memcpy(&value_nbo, p, sizeof(U32));
+	value = ntohl(value_nbo);
 	return true;
 }
 
@@ -2074,96 +2864,106 @@ std::string zip_llsd(LLSD& data)
 }
 
 //decompress a block of LLSD from provided istream
-// not very efficient -- creats a copy of decompressed LLSD block in memory
-// and deserializes from that copy using LLSDSerialize
+// and parse the decompressed buffer in place
 bool unzip_llsd(LLSD& data, std::istream& is, S32 size)
+{
+	U8 *in = new U8[size];
+	is.read((char*) in, size); 
+
+	S32 cur_size = 0;
+	U8* result = unzip_llsd_buffer(in, size, cur_size);
+	delete [] in;
+
+	if (!result)
+	{
+		return false;
+	}
+
+	//result now points to the decompressed LLSD block
+	const U8* read = result;
+	S32 count = LLSDSerialize::fromBinary(data, read, result + cur_size);
+	free(result);
+	if (count <= 0)
+	{
+		llwarns << "Failed to unzip LLSD block" << llendl;
+		return false;
+	}
+
+	return true;
+}
+
+U8* unzip_llsd_buffer(const U8* in, S32 size, S32& out_size)
 {
 	U8* result = NULL;
 	U32 cur_size = 0;
+	// compressed mesh and LLSD data usually inflates 2-4x, start there
+	// and grow geometrically so large blocks are not copied per chunk
+	U32 capacity = llmax((U32) size * 4, (U32) 65536);
 	z_stream strm;
-		
-	const U32 CHUNK = 65536;
 
-	U8 *in = new U8[size];
-	is.read((char*) in, size); 
+	out_size = 0;
+	if (!in || size <= 0)
+	{
+		return NULL;
+	}
+
+	result = (U8*) malloc(capacity);
+	if (!result)
+	{
+		return NULL;
+	}
 
-	U8 out[CHUNK];
-		
 	strm.zalloc = Z_NULL;
 	strm.zfree = Z_NULL;
 	strm.opaque = Z_NULL;
 	strm.avail_in = size;
-	strm.next_in = in;
+	strm.next_in = (Bytef*) in;
 
 	S32 ret = inflateInit(&strm);
+	if (ret != Z_OK)
+	{
+		free(result);
+		return NULL;
+	}
 
 	do
 	{
-		strm.avail_out = CHUNK;
-		strm.next_out = out;
-		ret = inflate(&strm, Z_NO_FLUSH);
-		if (ret == Z_STREAM_ERROR)
+		if (cur_size == capacity)
 		{
-			inflateEnd(&strm);
-			free(result);
-			delete [] in;
-			return false;
-		}
-		
-		switch (ret)
-		{
-		case Z_NEED_DICT:
-			ret = Z_DATA_ERROR;
-		case Z_DATA_ERROR:
-		case Z_MEM_ERROR:
-			inflateEnd(&strm);
-			free(result);
-			delete [] in;
-			return false;
-			break;
+			capacity *= 2;
+			U8* grown = (U8*) realloc(result, capacity);
+			if (!grown)
+			{
+				ret = Z_MEM_ERROR;
+				break;
+			}
+			result = grown;
 		}
-
-		U32 have = CHUNK-strm.avail_out;
-
-		result = (U8*) realloc(result, cur_size + have);
-		memcpy(result+cur_size, out, have);
-		cur_size += have;
-
+		strm.avail_out = capacity - cur_size;
+		strm.next_out = result + cur_size;
+		ret = inflate(&strm, Z_NO_FLUSH);
+		cur_size = capacity - strm.avail_out;
 	} while (ret == Z_OK);
 
 	inflateEnd(&strm);
-	delete [] in;
 
 	if (ret != Z_STREAM_END)
 	{
 		free(result);
-		return false;
+		return NULL;
 	}
 
-	//result now points to the decompressed LLSD block
+	static const char deprecated_header[] = "<? LLSD/Binary ?>";
+	const U32 header_size = sizeof(deprecated_header) - 1;
+	if (cur_size >= header_size && !memcmp(result, deprecated_header, header_size))
 	{
-		std::string res_str((char*) result, cur_size);
-
-		std::string deprecated_header("<? LLSD/Binary ?>");
-
-		if (res_str.substr(0, deprecated_header.size()) == deprecated_header)
-		{
-			res_str = res_str.substr(deprecated_header.size()+1, cur_size);
-		}
-		cur_size = res_str.size();
-
-		std::istringstream istr(res_str);
-		
-		if (!LLSDSerialize::fromBinary(data, istr, cur_size))
-		{
-			llwarns << "Failed to unzip LLSD block" << llendl;
-			free(result);
-			return false;
-		}
+		U32 skip = llmin(header_size + 1, cur_size);
+		memmove(result, result + skip, cur_size - skip);
+		cur_size -= skip;
 	}
 
-	free(result);
-	return true;
+	out_size = cur_size;
+	return result;
 }
 
 
@@ -34,6 +34,78 @@
 #include "llrefcount.h"
 #include "llsd.h"
 
+/** 
+ * @class LLSDParseListener
+ * @brief Receives the values of a document as it is parsed.
+ *
+ * Lets a caller consume a large document piece by piece instead of
+ * holding the whole LLSD tree. Maps and arrays are reported between
+ * begin and end calls, and inside a map key() comes before each
+ * value. The default methods ignore everything.
+ */
+class LL_COMMON_API LLSDParseListener
+{
+public:
+	virtual ~LLSDParseListener() {}
+
+	virtual void beginMap() {}
+	virtual void endMap() {}
+	virtual void beginArray() {}
+	virtual void endArray() {}
+	virtual void key(const std::string& key) {}
+	// A value that is not a map or an array.
+	virtual void value(const LLSD& value) {}
+};
+
+/** 
+ * @class LLSDElementListener
+ * @brief Builds each value found at a given depth and hands it over.
+ *
+ * For documents that are collections of independent entries, such as
+ * the name caches: only one entry is held in memory at a time. The
+ * structure above the entries is not built.
+ */
+class LL_COMMON_API LLSDElementListener : public LLSDParseListener
+{
+public:
+	// Elements are the values nested depth maps or arrays deep, 0 for
+	// the whole document.
+	LLSDElementListener(S32 depth);
+
+	// Forgets a partially parsed document.
+	void reset();
+
+	virtual void beginMap();
+	virtual void endMap();
+	virtual void beginArray();
+	virtual void endArray();
+	virtual void key(const std::string& key);
+	virtual void value(const LLSD& value);
+
+protected:
+	// Called with each complete element, which is dropped afterwards.
+	virtual void element(const LLSD& value) = 0;
+
+	// Keys leading to the current element, one per level and ending
+	// with the key of the element. The top of the document and the
+	// values in arrays have empty keys.
+	const std::vector<std::string>& getPath() const { return mPath; }
+
+private:
+	void beginContainer(const LLSD& empty);
+	void endContainer();
+	// The value the next one goes into, NULL above the element depth.
+	LLSD* addValue();
+
+private:
+	S32 mDepth;
+	S32 mLevel; // maps and arrays currently open
+	std::string mKey;
+	std::vector<std::string> mPath;
+	LLSD mElement;
+	std::vector<LLSD*> mStack; // open maps and arrays inside mElement
+};
+
 /** 
  * @class LLSDParser
  * @brief Abstract base class for LLSD parsers.
@@ -85,6 +157,18 @@ public:
 	 */
 	S32 parseLines(std::istream& istr, LLSD& data);
 
+	/** 
+	 * @brief Parses a stream, reporting its values to a listener.
+	 *
+	 * Parsers that cannot stream build the tree and replay it. The XML
+	 * parser reports values as it reads them.
+	 * @return Returns the number of LLSD objects parsed. Returns
+	 * PARSE_FAILURE (-1) on parse failure, after the listener may
+	 * already have seen part of the document.
+	 */
+	S32 parse(std::istream& istr, LLSDParseListener& listener, S32 max_bytes);
+	S32 parseLines(std::istream& istr, LLSDParseListener& listener);
+
 	/** 
 	 * @brief Resets the parser so parse() or parseLines() can be called again for another <llsd> chunk.
 	 */
@@ -108,6 +192,13 @@ protected:
 	 */
 	virtual S32 doParse(std::istream& istr, LLSD& data) const = 0;
 
+	/** 
+	 * @brief Virtual default function for parsing to a listener.
+	 *
+	 * Parses with doParse() and replays the result.
+	 */
+	virtual S32 doParseEvents(std::istream& istr, LLSDParseListener& listener) const;
+
 	/** 
 	 * @brief Virtual default function for resetting the parser
 	 */
@@ -319,6 +410,11 @@ protected:
 	 */
 	virtual S32 doParse(std::istream& istr, LLSD& data) const;
 
+	/** 
+	 * @brief Parses the istream, reporting each value as it is read.
+	 */
+	virtual S32 doParseEvents(std::istream& istr, LLSDParseListener& listener) const;
+
 	/** 
 	 * @brief Virtual default function for resetting the parser
 	 */
@@ -350,6 +446,23 @@ public:
 	 */
 	LLSDBinaryParser();
 
+	/** 
+	 * @brief Parses one binary LLSD value held in a contiguous buffer.
+	 *
+	 * Faster than parse() on a stream for large documents: the data is
+	 * read in place instead of a byte at a time through the istream,
+	 * strings and binary values are copied in one block each and arrays
+	 * are sized once from their count. The buffer bounds every read, so
+	 * no byte limit is needed.
+	 * @param data The first byte of the value, advanced past it.
+	 * @param end One past the last byte of the buffer.
+	 * @param sd[out] The newly parsed structured data.
+	 * @return Returns the number of LLSD objects parsed into sd, 0 if
+	 * the buffer is empty. Returns PARSE_FAILURE (-1) on malformed or
+	 * truncated data.
+	 */
+	S32 parseBuffer(const U8*& data, const U8* end, LLSD& sd) const;
+
 protected:
 	/** 
 	 * @brief Call this method to parse a stream for LLSD.
@@ -394,6 +507,16 @@ private:
 	 * @return Retuns true if a complete string was parsed.
 	 */
 	bool parseString(std::istream& istr, std::string& value) const;
+
+	/** 
+	 * @brief Buffer versions of doParse(), parseMap() and parseArray().
+	 *
+	 * @param p The next byte to read, advanced past what was parsed.
+	 * @param end One past the last byte of the buffer.
+	 */
+	S32 doParseBuffer(const U8*& p, const U8* end, LLSD& data) const;
+	S32 parseMapBuffer(const U8*& p, const U8* end, LLSD& map) const;
+	S32 parseArrayBuffer(const U8*& p, const U8* end, LLSD& array) const;
 };
 
 
@@ -762,6 +885,12 @@ public:
 		LLPointer<LLSDXMLParser> p = new LLSDXMLParser();
 		return p->parseLines(str, sd);
 	}
+	// Same, reporting the values to listener as they are read.
+	static S32 fromXMLDocument(LLSDParseListener& listener, std::istream& str)
+	{
+		LLPointer<LLSDXMLParser> p = new LLSDXMLParser();
+		return p->parseLines(str, listener);
+	}
 	static S32 fromXML(LLSD& sd, std::istream& str)
 	{
 		return fromXMLEmbedded(sd, str);
@@ -788,10 +917,71 @@ public:
 		(void)p->parse(str, sd, max_bytes);
 		return sd;
 	}
+	// Parses from a buffer, advancing data past the value. See
+	// LLSDBinaryParser::parseBuffer().
+	static S32 fromBinary(LLSD& sd, const U8*& data, const U8* end)
+	{
+		LLPointer<LLSDBinaryParser> p = new LLSDBinaryParser;
+		return p->parseBuffer(data, end, sd);
+	}
+};
+
+/**
+ * @class LLSDBinaryView
+ * @brief Read-only view of a value inside a binary LLSD buffer.
+ *
+ * Walks the serialized data in place instead of building an LLSD tree,
+ * so a large block (such as a mesh LOD) can be read without allocating
+ * a node per value. Binary values are returned as pointers into the
+ * buffer, which must outlive the view.
+ * Accessors return an undefined view or a default value when the data
+ * is malformed or of another type, like the LLSD accessors do.
+ */
+class LL_COMMON_API LLSDBinaryView
+{
+public:
+	LLSDBinaryView();
+	// data points at the first byte of a value, end one past the buffer.
+	LLSDBinaryView(const U8* data, const U8* end);
+
+	LLSD::Type type() const;
+	bool isDefined() const { return type() != LLSD::TypeUndefined; }
+	bool isMap() const { return type() == LLSD::TypeMap; }
+	bool isArray() const { return type() == LLSD::TypeArray; }
+
+	// Number of entries of a map or array, 0 otherwise.
+	S32 size() const;
+	// Linear walks, cheap for the small maps of the mesh format.
+	LLSDBinaryView operator[](S32 index) const;
+	LLSDBinaryView operator[](const char* key) const;
+	bool has(const char* key) const;
+	// The value following this one in its array or map, for walking
+	// all the entries without starting from the first one each time.
+	LLSDBinaryView next() const { return LLSDBinaryView(skip(mData), mEnd); }
+
+	LLSD::Integer asInteger() const;
+	LLSD::Real asReal() const;
+	// Returns the binary data and its size, NULL if not a binary value.
+	const U8* asBinary(S32& size) const;
+
+private:
+	// Returns the first byte after the value at p, NULL if it is malformed.
+	const U8* skip(const U8* p) const;
+	// Returns the first byte after the key at p and its text, NULL if malformed.
+	const U8* readKey(const U8* p, const char*& key, S32& key_len) const;
+	bool readU32(const U8* p, U32& value) const;
+
+private:
+	const U8* mData;
+	const U8* mEnd;
 };
 
 //dirty little zip functions -- yell at davep
 LL_COMMON_API std::string zip_llsd(LLSD& data);
 LL_COMMON_API bool unzip_llsd(LLSD& data, std::istream& is, S32 size);
+// Inflates a block written by zip_llsd without parsing it. Returns a
+// malloc()ed buffer holding the binary LLSD (deprecated header removed)
+// and sets out_size, or NULL on failure. Free it with free().
+LL_COMMON_API U8* unzip_llsd_buffer(const U8* in, S32 size, S32& out_size);
 
 #endif // LL_LLSDSERIALIZE_H
@@ -28,7 +28,6 @@
 #include "llsdserialize_xml.h"
 
 #include <iostream>
-#include <deque>
 
 #include "apr_base64.h"
 #include <boost/regex.hpp>
@@ -255,6 +254,8 @@ public:
 	
 	S32 parse(std::istream& input, LLSD& data);
 	S32 parseLines(std::istream& input, LLSD& data);
+	S32 parse(std::istream& input, LLSDParseListener& listener);
+	S32 parseLines(std::istream& input, LLSDParseListener& listener);
 
 	void parsePart(const char *buf, int len);
 	
@@ -295,16 +296,25 @@ private:
 	static const XML_Char* findAttribute(const XML_Char* name, const XML_Char** pairs);
 	
 
+	// Builds the whole document for the LLSD versions of parse().
+	class ResultListener : public LLSDElementListener
+	{
+	public:
+		ResultListener() : LLSDElementListener(0) { }
+		virtual void element(const LLSD& value) { mResult = value; }
+		LLSD mResult;
+	};
+
 	XML_Parser	mParser;
 
-	LLSD mResult;
+	ResultListener mResult;
+	LLSDParseListener* mListener;	// receives the values, mResult by default
 	S32 mParseCount;
 	
 	bool mInLLSDElement;			// true if we're on LLSD
 	bool mGracefullStop;			// true if we found the </llsd
 	
-	typedef std::deque<LLSD*> LLSDRefStack;
-	LLSDRefStack mStack;
+	std::vector<Element> mStack;	// values being read, outermost first
 	
 	int mDepth;
 	bool mSkipping;
@@ -316,6 +326,7 @@ private:
 
 
 LLSDXMLParser::Impl::Impl()
+:	mListener(&mResult)
 {
 	mParser = XML_ParserCreate(NULL);
 	reset();
@@ -356,6 +367,23 @@ static unsigned get_till_eol(std::istream& input, char *buf, unsigned bufsize)
 
 S32 LLSDXMLParser::Impl::parse(std::istream& input, LLSD& data)
 {
+	// mResult may already hold what parsePart() read
+	S32 count = parse(input, mResult);
+	data = (count == LLSDParser::PARSE_FAILURE) ? LLSD() : mResult.mResult;
+	return count;
+}
+
+S32 LLSDXMLParser::Impl::parseLines(std::istream& input, LLSD& data)
+{
+	S32 count = parseLines(input, mResult);
+	data = (count == LLSDParser::PARSE_FAILURE) ? LLSD() : mResult.mResult;
+	return count;
+}
+
+S32 LLSDXMLParser::Impl::parse(std::istream& input, LLSDParseListener& listener)
+{
+	mListener = &listener;
+
 	XML_Status status;
 	
 	static const int BUFFER_SIZE = 1024;
@@ -400,21 +428,19 @@ S32 LLSDXMLParser::Impl::parse(std::istream& input, LLSD& data)
 			((char*) buffer)[count ? count - 1 : 0] = '\0';
 		}
 		llinfos << "LLSDXMLParser::Impl::parse: XML_STATUS_ERROR parsing:" << (char*) buffer << llendl;
-		data = LLSD();
 		return LLSDParser::PARSE_FAILURE;
 	}
 
 	clear_eol(input);
-	data = mResult;
 	return mParseCount;
 }
 
 
-S32 LLSDXMLParser::Impl::parseLines(std::istream& input, LLSD& data)
+S32 LLSDXMLParser::Impl::parseLines(std::istream& input, LLSDParseListener& listener)
 {
-	XML_Status status = XML_STATUS_OK;
+	mListener = &listener;
 
-	data = LLSD();
+	XML_Status status = XML_STATUS_OK;
 
 	static const int BUFFER_SIZE = 1024;
 
@@ -482,14 +508,15 @@ S32 LLSDXMLParser::Impl::parseLines(std::istream& input, LLSD& data)
 	}
 
 	clear_eol(input);
-	data = mResult;
 	return mParseCount;
 }
 
 
 void LLSDXMLParser::Impl::reset()
 {
-	mResult.clear();
+	mResult.reset();
+	mResult.mResult.clear();
+	mListener = &mResult;
 	mParseCount = 0;
 
 	mInLLSDElement = false;
@@ -596,7 +623,7 @@ void LLSDXMLParser::Impl::startElementHandler(const XML_Char* name, const XML_Ch
 			return;
 	
 		case ELEMENT_KEY:
-			if (mStack.empty()  ||  !(mStack.back()->isMap()))
+			if (mStack.empty()  ||  mStack.back() != ELEMENT_MAP)
 			{
 				return startSkipping();
 			}
@@ -619,43 +646,35 @@ void LLSDXMLParser::Impl::startElementHandler(const XML_Char* name, const XML_Ch
 	
 	if (mStack.empty())
 	{
-		mStack.push_back(&mResult);
+		// top level value
 	}
-	else if (mStack.back()->isMap())
+	else if (mStack.back() == ELEMENT_MAP)
 	{
 		if (mCurrentKey.empty()) { return startSkipping(); }
 		
-		LLSD& map = *mStack.back();
-		LLSD& newElement = map[mCurrentKey];
-		mStack.push_back(&newElement);		
-
+		mListener->key(mCurrentKey);
 		mCurrentKey.clear();
 	}
-	else if (mStack.back()->isArray())
+	else if (mStack.back() != ELEMENT_ARRAY)
 	{
-		LLSD& array = *mStack.back();
-		array.append(LLSD());
-		LLSD& newElement = array[array.size()-1];
-		mStack.push_back(&newElement);
-	}
-	else {
 		// improperly nested value in a non-structure
 		return startSkipping();
 	}
 
+	mStack.push_back(element);
 	++mParseCount;
 	switch (element)
 	{
 		case ELEMENT_MAP:
-			*mStack.back() = LLSD::emptyMap();
+			mListener->beginMap();
 			break;
 		
 		case ELEMENT_ARRAY:
-			*mStack.back() = LLSD::emptyArray();
+			mListener->beginArray();
 			break;
 			
 		default:
-			// all the other values will be set in the end element handler
+			// all the other values are reported in the end element handler
 			;
 	}
 }
@@ -700,9 +719,9 @@ void LLSDXMLParser::Impl::endElementHandler(const XML_Char* name)
 	
 	if (!mInLLSDElement) { return; }
 
-	LLSD& value = *mStack.back();
 	mStack.pop_back();
 	
+	LLSD value;
 	switch (element)
 	{
 		case ELEMENT_UNDEF:
@@ -775,15 +794,22 @@ void LLSDXMLParser::Impl::endElementHandler(const XML_Char* name)
 			break;
 		}
 		
-		case ELEMENT_UNKNOWN:
-			value.clear();
-			break;
-			
+		case ELEMENT_MAP:
+			mListener->endMap();
+			mCurrentContent.clear();
+			return;
+
+		case ELEMENT_ARRAY:
+			mListener->endArray();
+			mCurrentContent.clear();
+			return;
+
 		default:
-			// other values, map and array, have already been set
+			// ELEMENT_UNDEF and ELEMENT_UNKNOWN
 			break;
 	}
 
+	mListener->value(value);
 	mCurrentContent.clear();
 }
 
@@ -919,6 +945,17 @@ S32 LLSDXMLParser::doParse(std::istream& input, LLSD& data) const
 	return impl.parse(input, data);
 }
 
+// virtual
+S32 LLSDXMLParser::doParseEvents(std::istream& input, LLSDParseListener& listener) const
+{
+	if (mParseLines)
+	{
+		return impl.parseLines(input, listener);
+	}
+
+	return impl.parse(input, listener);
+}
+
 //	virtual 
 void LLSDXMLParser::doReset()
 {
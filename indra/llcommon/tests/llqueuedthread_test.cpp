@@ -0,0 +1,159 @@
+/**
+ * @file llqueuedthread_test.cpp
+ * @date 2012-03-12
+ * @brief Tests the priority queue of LLQueuedThread.
+ *
+ * $LicenseInfo:firstyear=2012&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2012, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "../llqueuedthread.h"
+
+#include "../test/lltut.h"
+
+namespace
+{
+	typedef LLQueuedThread::RequestQueue RequestQueue;
+
+	class TestRequest : public LLQueuedThread::QueuedRequest
+	{
+	public:
+		TestRequest(LLQueuedThread::handle_t handle, U32 priority)
+			: LLQueuedThread::QueuedRequest(handle, priority)
+		{
+		}
+		void changePriority(U32 pri) { setPriority(pri); }
+		void destroy() { deleteRequest(); }
+
+	protected:
+		/*virtual*/ bool processRequest() { return true; }
+	};
+
+	// Pops everything, checking the order against higherPriority()
+	bool pop_in_order(RequestQueue& queue, size_t expected)
+	{
+		size_t count = 0;
+		LLQueuedThread::QueuedRequest* prev = NULL;
+		while (LLQueuedThread::QueuedRequest* req = queue.pop())
+		{
+			if (prev && req->higherPriority(*prev))
+			{
+				return false;
+			}
+			prev = req;
+			++count;
+		}
+		return count == expected;
+	}
+}
+
+namespace tut
+{
+	struct queuedthread_test
+	{
+		enum { NUM_REQUESTS = 200 };
+
+		queuedthread_test()
+		{
+			for (U32 i = 0; i < NUM_REQUESTS; ++i)
+			{
+				// scatter the priorities, with some duplicates
+				mRequests.push_back(new TestRequest(i + 1, (i * 37) % 101));
+			}
+		}
+		~queuedthread_test()
+		{
+			mQueue.clear();
+			for (size_t i = 0; i < mRequests.size(); ++i)
+			{
+				mRequests[i]->destroy();
+			}
+		}
+		void insertAll()
+		{
+			for (size_t i = 0; i < mRequests.size(); ++i)
+			{
+				mQueue.insert(mRequests[i]);
+			}
+		}
+
+		std::vector<TestRequest*> mRequests;
+		RequestQueue mQueue;
+	};
+	typedef test_group<queuedthread_test> queuedthread_group_t;
+	typedef queuedthread_group_t::object queuedthread_object_t;
+	tut::queuedthread_group_t queuedthread_instance("LLQueuedThread");
+
+	template<> template<>
+	void queuedthread_object_t::test<1>()
+	{
+		set_test_name("pop order");
+		ensure("starts empty", mQueue.empty() && mQueue.pop() == NULL);
+		insertAll();
+		ensure_equals("size", mQueue.size(), (size_t)NUM_REQUESTS);
+		ensure("contains", mQueue.contains(mRequests[17]));
+		ensure("pops in priority order", pop_in_order(mQueue, NUM_REQUESTS));
+		ensure("not contained once popped", !mQueue.contains(mRequests[17]));
+	}
+
+	template<> template<>
+	void queuedthread_object_t::test<2>()
+	{
+		set_test_name("erase");
+		insertAll();
+		for (size_t i = 0; i < mRequests.size(); i += 3)
+		{
+			ensure("erase queued", mQueue.erase(mRequests[i]));
+			ensure("erase twice", !mQueue.erase(mRequests[i]));
+		}
+		ensure("pops in priority order after erase", pop_in_order(mQueue, NUM_REQUESTS - (NUM_REQUESTS + 2) / 3));
+	}
+
+	template<> template<>
+	void queuedthread_object_t::test<3>()
+	{
+		set_test_name("few priority changes");
+		insertAll();
+		mRequests[5]->changePriority(1000);
+		mQueue.reprioritize(mRequests[5]);
+		mRequests[9]->changePriority(0);
+		mQueue.reprioritize(mRequests[9]);
+		ensure("top is the raised request", mQueue.top() == mRequests[5]);
+		ensure("pops in priority order", pop_in_order(mQueue, NUM_REQUESTS));
+	}
+
+	template<> template<>
+	void queuedthread_object_t::test<4>()
+	{
+		set_test_name("many priority changes");
+		insertAll();
+		for (size_t i = 0; i < mRequests.size(); ++i)
+		{
+			mRequests[i]->changePriority((U32)((i * 53) % 89));
+			mQueue.reprioritize(mRequests[i]);
+		}
+		// a changed request erased before the changes are applied
+		mQueue.erase(mRequests[0]);
+		ensure("pops in priority order", pop_in_order(mQueue, NUM_REQUESTS - 1));
+	}
+}
@@ -33,6 +33,7 @@
 #include "../llsd.h"
 #include "../llsdserialize.h"
 #include "../llformat.h"
+#include "../lltimer.h"
 
 #include "../test/lltut.h"
 
@@ -703,6 +704,93 @@ namespace tut
 			expected,
 			1);
 	}
+
+	// Records the events of a parse as text
+	class EventRecorder : public LLSDParseListener
+	{
+	public:
+		virtual void beginMap() { mEvents += "{"; }
+		virtual void endMap() { mEvents += "}"; }
+		virtual void beginArray() { mEvents += "["; }
+		virtual void endArray() { mEvents += "]"; }
+		virtual void key(const std::string& key) { mEvents += key + ":"; }
+		virtual void value(const LLSD& value) { mEvents += value.asString() + ","; }
+		std::string mEvents;
+	};
+
+	// Collects the elements at a depth with their paths
+	class ElementCollector : public LLSDElementListener
+	{
+	public:
+		ElementCollector(S32 depth) : LLSDElementListener(depth) {}
+		virtual void element(const LLSD& value)
+		{
+			std::string path;
+			for (size_t i = 0; i < getPath().size(); ++i)
+			{
+				path += "/" + getPath()[i];
+			}
+			mPaths.append(path);
+			mElements.append(value);
+		}
+		LLSD mPaths;
+		LLSD mElements;
+	};
+
+	template<> template<> 
+	void TestLLSDXMLParsingObject::test<5>()
+	{
+		// values are reported to a listener as they are read
+		std::string xml =
+			"<llsd><map>"
+			"<key>agents</key><map>"
+				"<key>a</key><map><key>ctime</key><integer>5</integer><key>first</key><string>Ann</string></map>"
+				"<key>b</key><array><integer>1</integer><array/><undef/></array>"
+			"</map>"
+			"<key>count</key><integer>2</integer>"
+			"<key></key><string>no key, skipped</string>"
+			"</map></llsd>\n";
+
+		std::istringstream stream(xml);
+		EventRecorder recorder;
+		S32 count = mParser->parse(stream, recorder, xml.size());
+		ensure_equals("event count", count, 10);
+		ensure_equals("events", recorder.mEvents,
+			std::string("{agents:{a:{ctime:5,first:Ann,}b:[1,[],]}count:2,}"));
+
+		std::istringstream lines(xml);
+		ElementCollector collector(2);
+		mParser->reset();
+		count = mParser->parseLines(lines, collector);
+		ensure_equals("element parse count", count, 10);
+		ensure_equals("elements", collector.mElements.size(), 2);
+		ensure_equals("element path", collector.mPaths[0].asString(), std::string("//agents/a"));
+		ensure_equals("element map", collector.mElements[0]["first"].asString(), std::string("Ann"));
+		ensure_equals("element path 2", collector.mPaths[1].asString(), std::string("//agents/b"));
+		ensure_equals("element array", collector.mElements[1].size(), 3);
+		ensure("element nested array", collector.mElements[1][1].isArray());
+
+		// depth 0 builds the same tree as parse()
+		std::istringstream whole(xml);
+		ElementCollector document(0);
+		mParser->reset();
+		mParser->parse(whole, document, xml.size());
+		LLSD expected;
+		std::istringstream tree(xml);
+		mParser->reset();
+		mParser->parse(tree, expected, xml.size());
+		ensure_equals("document elements", document.mElements.size(), 1);
+		ensure_equals("document", document.mElements[0], expected);
+		ensure_equals("document path", document.mPaths[0].asString(), std::string("/"));
+
+		// other parsers replay the parsed tree
+		std::stringstream binary;
+		LLSDSerialize::toBinary(expected, binary);
+		LLPointer<LLSDParser> binary_parser = new LLSDBinaryParser;
+		EventRecorder replayed;
+		binary_parser->parse(binary, replayed, binary.str().size());
+		ensure_equals("replayed events", replayed.mEvents, recorder.mEvents);
+	}
 	/*
 	TODO:
 		test XML parsing
@@ -1289,12 +1377,164 @@ namespace tut
 			1);
 	}
 
-/*
 	template<> template<> 
 	void TestLLSDBinaryParsingObject::test<11>()
 	{
+		// LLSDBinaryView reads the same values as the parser, in place
+		LLSD::Binary blob;
+		blob.push_back(0xde);
+		blob.push_back(0xad);
+		blob.push_back(0xbe);
+		LLSD face;
+		face["Position"] = blob;
+		face["Domain"] = LLSD::emptyMap();
+		face["Domain"]["Min"].append(-1.5);
+		face["Domain"]["Min"].append(2);
+		face["Name"] = "face";
+		face["Empty"] = LLSD();
+		LLSD input;
+		input.append(face);
+		input.append(LLSD::emptyMap());
+		input.append(true);
+
+		std::stringstream stream;
+		LLSDSerialize::toBinary(input, stream);
+		std::string str = stream.str();
+		const U8* data = (const U8*) str.data();
+		LLSDBinaryView view(data, data + str.size());
+
+		ensure("array", view.isArray());
+		ensure_equals("array size", view.size(), 3);
+		ensure("map", view[0].isMap());
+		ensure_equals("map size", view[0].size(), 4);
+		S32 size = 0;
+		const U8* bin = view[0]["Position"].asBinary(size);
+		ensure_equals("binary size", size, 3);
+		ensure("binary data", bin && !memcmp(bin, &blob[0], 3));
+		ensure_equals("real", view[0]["Domain"]["Min"][0].asReal(), -1.5);
+		ensure_equals("integer", view[0]["Domain"]["Min"][1].asInteger(), 2);
+		ensure("has undefined", view[0].has("Empty"));
+		ensure("missing key", !view[0].has("Normal") && !view[0]["Normal"].isDefined());
+		ensure("out of range", !view[0]["Domain"]["Min"][2].isDefined());
+		ensure("not binary", view[0]["Name"].asBinary(size) == NULL && size == 0);
+		ensure("next", view[0].next().isMap() && view[0].next().size() == 0);
+		ensure_equals("boolean", view[2].asInteger(), 1);
+
+		// truncated data reads as undefined instead of running off the end
+		LLSDBinaryView truncated(data, data + str.size() / 2);
+		ensure("truncated", !truncated[2].isDefined());
+	}
+
+	static LLSD make_parse_document(S32 width)
+	{
+		LLSD doc;
+		for (S32 i = 0; i < width; ++i)
+		{
+			LLSD item;
+			item["item_id"] = LLUUID::generateNewID();
+			item["name"] = llformat("item %d", i);
+			item["desc"] = "\"quoted\" and\nescaped";
+			item["flags"] = i;
+			item["price"] = i * 0.5;
+			item["created"] = LLDate(1234567890.0 + i);
+			item["link"] = LLURI("http://example.com/item");
+			item["data"] = LLSD::Binary(i % 64 + 1, (U8) i);
+			item["empty"] = LLSD();
+			item["tags"].append(true);
+			item["tags"].append(false);
+			doc.append(item);
+		}
+		return doc;
+	}
+
+	template<> template<> 
+	void TestLLSDBinaryParsingObject::test<12>()
+	{
+		// parseBuffer() reads the same values and counts as parse()
+		LLSD input = make_parse_document(20);
+		std::stringstream stream;
+		LLSDSerialize::toBinary(input, stream);
+		std::string str = stream.str();
+		str += "trailing";
+
+		LLSD streamed;
+		S32 stream_count = mParser->parse(stream, streamed, str.size());
+		const U8* data = (const U8*) str.data();
+		const U8* read = data;
+		LLSD buffered;
+		S32 buffer_count = mParser->parseBuffer(read, data + str.size(), buffered);
+		ensure_equals("buffer value", buffered, input);
+		ensure_equals("buffer value matches stream", buffered, streamed);
+		ensure_equals("buffer count", buffer_count, stream_count);
+		ensure_equals("buffer bytes read", (S32) (read - data), (S32) (str.size() - 8));
+
+		// notation style strings and keys
+		std::string notation("{\0\0\0\x01'k\\x41y's\0\0\0\x02hi}", 21);
+		data = (const U8*) notation.data();
+		read = data;
+		LLSD expected;
+		expected["kAy"] = "hi";
+		ensure_equals("notation key count", mParser->parseBuffer(read, data + notation.size(), buffered), 2);
+		ensure_equals("notation key", buffered, expected);
+
+		// every truncation fails instead of running off the end
+		data = (const U8*) str.data();
+		for (size_t size = 1; size < str.size() - 8; size += 7)
+		{
+			read = data;
+			LLSD truncated;
+			ensure_equals("truncated count", mParser->parseBuffer(read, data + size, truncated), (S32) LLSDParser::PARSE_FAILURE);
+			ensure("truncated value", truncated.isUndefined());
+		}
+
+		// an array count larger than the data does not size the array
+		std::string huge("[\x7f\xff\xff\xff!]", 7);
+		data = (const U8*) huge.data();
+		read = data;
+		ensure_equals("huge array", mParser->parseBuffer(read, data + huge.size(), buffered), (S32) LLSDParser::PARSE_FAILURE);
+
+		read = data;
+		ensure_equals("empty buffer", mParser->parseBuffer(read, data, buffered), 0);
+	}
+
+	template<> template<> 
+	void TestLLSDBinaryParsingObject::test<13>()
+	{
+		// Throughput of parse() on a stream against parseBuffer(), on a
+		// document about the size of a large inventory or mesh payload
+		LLSD input = make_parse_document(10000);
+		std::stringstream stream;
+		LLSDSerialize::toBinary(input, stream);
+		const std::string str = stream.str();
+		const U8* data = (const U8*) str.data();
+		const S32 passes = 3;
+
+		LLTimer timer;
+		for (S32 i = 0; i < passes; ++i)
+		{
+			std::istringstream istr(str);
+			LLSD parsed;
+			mParser->reset();
+			mParser->parse(istr, parsed, str.size());
+			ensure_equals("stream parse", parsed.size(), input.size());
+		}
+		F64 stream_time = timer.getElapsedTimeF64();
+
+		timer.reset();
+		for (S32 i = 0; i < passes; ++i)
+		{
+			const U8* read = data;
+			LLSD parsed;
+			mParser->parseBuffer(read, data + str.size(), parsed);
+			ensure_equals("buffer parse", parsed.size(), input.size());
+		}
+		F64 buffer_time = timer.getElapsedTimeF64();
+
+		F64 megabytes = (F64) str.size() * passes / (1024.0 * 1024.0);
+		std::cout << "binary LLSD parse of " << str.size() << " bytes: stream "
+				  << megabytes / llmax(stream_time, 1.0e-6) << " MB/s, buffer "
+				  << megabytes / llmax(buffer_time, 1.0e-6) << " MB/s" << std::endl;
 	}
-*/
 
    /**
 	 * @class TestLLSDCrossCompatible
@@ -57,6 +57,7 @@ LLImageJ2C::LLImageJ2C() : 	LLImageFormatted(IMG_CODEC_J2C),
 							mRawDiscardLevel(-1),
 							mRate(0.0f),
 							mReversible(FALSE),
+							mIncrementalDecode(FALSE),
 							mAreaUsedForDataSizeCalcs(0)
 {
 	mImpl = fallbackCreateLLImageJ2CImpl();
@@ -362,6 +363,23 @@ void LLImageJ2C::setReversible(const BOOL reversible)
  	mReversible = reversible;
 }
 
+void LLImageJ2C::setIncrementalDecode(BOOL incremental)
+{
+	if (mIncrementalDecode && !incremental)
+	{
+		resetDecodeState();
+	}
+	mIncrementalDecode = incremental;
+}
+
+void LLImageJ2C::resetDecodeState()
+{
+	if (mImpl)
+	{
+		mImpl->resetDecodeState();
+	}
+}
+
 
 BOOL LLImageJ2C::loadAndValidate(const std::string &filename)
 {
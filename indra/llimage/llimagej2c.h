@@ -71,6 +71,14 @@ public:
 	void setMaxBytes(S32 max_bytes);
 	S32 getMaxBytes() const { return mMaxBytes; }
 
+	// Incremental decode: keep the codec state between decodes so that a later
+	// decode at a lower discard level, after more data has been appended,
+	// carries on from what was already parsed instead of starting over.
+	void setIncrementalDecode(BOOL incremental);
+	BOOL isIncrementalDecode() const { return mIncrementalDecode; }
+	// Drop any codec state kept for incremental decoding
+	void resetDecodeState();
+
 	static S32 calcHeaderSizeJ2C();
 	static S32 calcDataSizeJ2C(S32 w, S32 h, S32 comp, S32 discard_level, F32 rate = 0.f);
 
@@ -92,6 +100,7 @@ protected:
 	S8  mRawDiscardLevel;
 	F32 mRate;
 	BOOL mReversible;
+	BOOL mIncrementalDecode;
 	LLImageJ2CImpl *mImpl;
 	std::string mLastError;
 
@@ -121,6 +130,9 @@ protected:
 							BOOL reversible=FALSE) = 0;
 	virtual BOOL initDecode(LLImageJ2C &base, LLImageRaw &raw_image, int discard_level = -1, int* region = NULL) = 0;
 	virtual BOOL initEncode(LLImageJ2C &base, LLImageRaw &raw_image, int blocks_size = -1, int precincts_size = -1, int levels = 0) = 0;
+	// Release the codec state kept between decodes when base.isIncrementalDecode()
+	// is set. Implementations that cannot decode incrementally do nothing.
+	virtual void resetDecodeState() {}
 
 	friend class LLImageJ2C;
 };
@@ -28,22 +28,59 @@
 
 #include "llimageworker.h"
 #include "llimagedxt.h"
+#include "llstl.h"
 
 //----------------------------------------------------------------------------
 
 // MAIN THREAD
-LLImageDecodeThread::LLImageDecodeThread(bool threaded)
-	: LLQueuedThread("imagedecode", threaded)
+LLImageDecodeThread::LLImageDecodeThread(bool threaded, U32 num_threads)
+	: LLQueuedThread("imagedecode", threaded && num_threads <= 1),
+	  mNextWorker(0)
 {
 	mCreationMutex = new LLMutex(getAPRPool());
+	if (threaded && num_threads > 1)
+	{
+		// The queued thread only keeps the request handles, the workers do the decoding
+		for (U32 i = 0; i < num_threads; i++)
+		{
+			mWorkers.push_back(new Worker(this, i));
+		}
+		for (U32 i = 0; i < num_threads; i++)
+		{
+			mWorkers[i]->start();
+		}
+	}
 }
 
 //virtual 
 LLImageDecodeThread::~LLImageDecodeThread()
 {
+	shutdown();
+	for_each(mWorkers.begin(), mWorkers.end(), DeletePointer());
+	mWorkers.clear();
 	delete mCreationMutex ;
 }
 
+//virtual
+void LLImageDecodeThread::shutdown()
+{
+	if (!mWorkers.empty())
+	{
+		// Requests still queued are deleted with the request hash
+		for (U32 i = 0; i < mWorkers.size(); i++)
+		{
+			mWorkers[i]->shutdown();
+		}
+		for (U32 i = 0; i < mWorkers.size(); i++)
+		{
+			LLMutexLock lock(&mWorkers[i]->mQueueMutex);
+			mWorkers[i]->mQueue.clear();
+		}
+		mQueuedCount = 0;
+	}
+	LLQueuedThread::shutdown();
+}
+
 // MAIN THREAD
 // virtual
 S32 LLImageDecodeThread::update(U32 max_time_ms)
@@ -57,6 +94,11 @@ S32 LLImageDecodeThread::update(U32 max_time_ms)
 						     info.priority, info.discard, info.needs_aux,
 						     info.responder);
 
+		if (!mWorkers.empty())
+		{
+			queueRequest(req);
+			continue;
+		}
 		bool res = addRequest(req);
 		if (!res)
 		{
@@ -64,8 +106,71 @@ S32 LLImageDecodeThread::update(U32 max_time_ms)
 		}
 	}
 	mCreationList.clear();
-	S32 res = LLQueuedThread::update(max_time_ms);
-	return res;
+	if (mWorkers.empty())
+	{
+		S32 res = LLQueuedThread::update(max_time_ms);
+		return res;
+	}
+
+	// Unpause the workers and wake them all so that idle ones can steal
+	for (U32 i = 0; i < mWorkers.size(); i++)
+	{
+		mWorkers[i]->unpause();
+	}
+	updateWorkerStats();
+	return getPending();
+}
+
+//virtual
+S32 LLImageDecodeThread::getPending()
+{
+	if (mWorkers.empty())
+	{
+		return LLQueuedThread::getPending();
+	}
+	return mQueuedCount;
+}
+
+// MAIN THREAD
+void LLImageDecodeThread::pause()
+{
+	LLThread::pause();
+	for (U32 i = 0; i < mWorkers.size(); i++)
+	{
+		mWorkers[i]->pause();
+	}
+}
+
+// MAIN THREAD
+void LLImageDecodeThread::setPriority(handle_t handle, U32 priority)
+{
+	if (mWorkers.empty())
+	{
+		LLQueuedThread::setPriority(handle, priority);
+		return;
+	}
+	lockData();
+	ImageRequest* req = (ImageRequest*)mRequestHash.find(handle);
+	if (req)
+	{
+		// The request may sit in any of the queues once stolen, or in none while it is processed
+		bool requeued = false;
+		for (U32 i = 0; i < mWorkers.size() && !requeued; i++)
+		{
+			LLMutexLock lock(&mWorkers[i]->mQueueMutex);
+			if (mWorkers[i]->mQueue.contains(req))
+			{
+				req->setPriority(priority);
+				mWorkers[i]->mQueue.reprioritize(req);
+				requeued = true;
+			}
+		}
+		if (!requeued)
+		{
+			req->setPriority(priority);
+		}
+	}
+	unlockData();
 }
 
 LLImageDecodeThread::handle_t LLImageDecodeThread::decodeImage(LLImageFormatted* image, 
@@ -77,6 +182,171 @@ LLImageDecodeThread::handle_t LLImageDecodeThread::decodeImage(LLImageFormatted*
 	return handle;
 }
 
+// MAIN THREAD
+void LLImageDecodeThread::getWorkerStats(S32 worker, S32& pending, F32& utilization)
+{
+	if (mWorkers.empty())
+	{
+		// Not measured for a single thread, only whether it is busy right now
+		pending = getPending();
+		utilization = mIdleThread ? 0.f : 1.f;
+		return;
+	}
+	Worker* workerp = mWorkers[worker];
+	LLMutexLock lock(&workerp->mQueueMutex);
+	pending = (S32)workerp->mQueue.size();
+	utilization = workerp->mUtilization;
+}
+
+// MAIN THREAD
+void LLImageDecodeThread::updateWorkerStats()
+{
+	const F32 STATS_PERIOD = 1.f; // seconds
+	F32 elapsed = mStatsTimer.getElapsedTimeF32();
+	if (elapsed < STATS_PERIOD)
+	{
+		return;
+	}
+	mStatsTimer.reset();
+	for (U32 i = 0; i < mWorkers.size(); i++)
+	{
+		Worker* workerp = mWorkers[i];
+		LLMutexLock lock(&workerp->mQueueMutex);
+		workerp->mUtilization = llmin((F32)workerp->mBusyTime * 0.000001f / elapsed, 1.f);
+		workerp->mBusyTime = 0;
+	}
+}
+
+// MAIN THREAD
+void LLImageDecodeThread::queueRequest(ImageRequest* req)
+{
+	lockData();
+	req->setStatus(STATUS_QUEUED);
+	mRequestHash.insert(req);
+	unlockData();
+
+	pushRequest(mNextWorker, req);
+	mNextWorker = (mNextWorker + 1) % (S32)mWorkers.size();
+}
+
+void LLImageDecodeThread::pushRequest(S32 worker, ImageRequest* req)
+{
+	Worker* workerp = mWorkers[worker];
+	workerp->mQueueMutex.lock();
+	workerp->mQueue.insert(req);
+	mQueuedCount++;
+	workerp->mQueueMutex.unlock();
+	workerp->wake();
+}
+
+// WORKER THREAD
+// Takes the best request from the worker's own queue or, when that is empty,
+// steals the best request waiting in the other queues.
+LLImageDecodeThread::ImageRequest* LLImageDecodeThread::popRequest(S32 worker)
+{
+	Worker* workerp = mWorkers[worker];
+	{
+		LLMutexLock lock(&workerp->mQueueMutex);
+		ImageRequest* req = (ImageRequest*)workerp->mQueue.pop();
+		if (req)
+		{
+			mQueuedCount--;
+			return req;
+		}
+	}
+
+	// Peek at the head of the other queues to find the best victim
+	Worker* victimp = NULL;
+	QueuedRequest* best = NULL;
+	for (U32 i = 0; i < mWorkers.size(); i++)
+	{
+		Worker* otherp = mWorkers[i];
+		if (otherp == workerp)
+		{
+			continue;
+		}
+		LLMutexLock lock(&otherp->mQueueMutex);
+		QueuedRequest* head = otherp->mQueue.top();
+		if (head && (!best || head->getPriority() > best->getPriority()))
+		{
+			best = head;
+			victimp = otherp;
+		}
+	}
+	if (!victimp)
+	{
+		return NULL;
+	}
+
+	// The victim may have taken its head meanwhile, take whatever is at the front now
+	LLMutexLock lock(&victimp->mQueueMutex);
+	ImageRequest* req = (ImageRequest*)victimp->mQueue.pop();
+	if (req)
+	{
+		mQueuedCount--;
+	}
+	return req;
+}
+
+// WORKER THREAD
+// Same request handling as LLQueuedThread::processNextRequest().
+// Returns false if there was nothing to do.
+bool LLImageDecodeThread::processWorkerRequest(S32 worker)
+{
+	ImageRequest* req = popRequest(worker);
+	if (!req)
+	{
+		return false;
+	}
+
+	Worker* workerp = mWorkers[worker];
+	lockData();
+	if ((req->getFlags() & FLAG_ABORT) || workerp->isQuitting())
+	{
+		req->setStatus(STATUS_ABORTED);
+		req->finishRequest(false);
+		if (req->getFlags() & FLAG_AUTO_COMPLETE)
+		{
+			mRequestHash.erase(req);
+			req->deleteRequest();
+		}
+		unlockData();
+		return true;
+	}
+	llassert_always(req->getStatus() == STATUS_QUEUED);
+	req->setStatus(STATUS_INPROGRESS);
+	unlockData();
+
+	LLTimer busy_timer;
+	bool complete = req->processRequest();
+	U64 busy_time = (U64)(busy_timer.getElapsedTimeF64() * 1000000.0);
+
+	workerp->mQueueMutex.lock();
+	workerp->mBusyTime += busy_time;
+	workerp->mQueueMutex.unlock();
+
+	lockData();
+	if (complete)
+	{
+		req->setStatus(STATUS_COMPLETE);
+		req->finishRequest(true);
+		if (req->getFlags() & FLAG_AUTO_COMPLETE)
+		{
+			mRequestHash.erase(req);
+			req->deleteRequest();
+		}
+		unlockData();
+	}
+	else
+	{
+		// Time slice ran out, back in our own queue
+		req->setStatus(STATUS_QUEUED);
+		unlockData();
+		pushRequest(worker, req);
+	}
+	return true;
+}
+
 // Used by unit test only
 // Returns the size of the mutex guarded list as an indication of sanity
 S32 LLImageDecodeThread::tut_size()
@@ -92,6 +362,47 @@ LLImageDecodeThread::Responder::~Responder()
 
 //----------------------------------------------------------------------------
 
+LLImageDecodeThread::Worker::Worker(LLImageDecodeThread* owner, S32 index)
+	: LLThread(llformat("imagedecode %d", index)),
+	  mQueueMutex(NULL),
+	  mBusyTime(0),
+	  mUtilization(0.f),
+	  mOwner(owner),
+	  mIndex(index)
+{
+}
+
+LLImageDecodeThread::Worker::~Worker()
+{
+}
+
+//virtual
+bool LLImageDecodeThread::Worker::runCondition()
+{
+	// mRunCondition must be locked here
+	return mOwner->mQueuedCount > 0;
+}
+
+//virtual
+void LLImageDecodeThread::Worker::run()
+{
+	// call checkPause() immediately so we don't try to do anything before the class is fully constructed
+	checkPause();
+	while (1)
+	{
+		// blocks until there is a request in any of the queues, or we are quitting
+		checkPause();
+		if (isQuitting())
+		{
+			break;
+		}
+		mOwner->processWorkerRequest(mIndex);
+	}
+	llinfos << "LLImageDecodeThread worker " << mIndex << " EXITING." << llendl;
+}
+
+//----------------------------------------------------------------------------
+
 LLImageDecodeThread::ImageRequest::ImageRequest(handle_t handle, LLImageFormatted* image, 
 												U32 priority, S32 discard, BOOL needs_aux,
 												LLImageDecodeThread::Responder* responder)
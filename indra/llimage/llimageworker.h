@@ -29,6 +29,7 @@
 
 #include "llimage.h"
 #include "llpointer.h"
+#include "lltimer.h"
 #include "llworkerthread.h"
 
 class LLImageDecodeThread : public LLQueuedThread
@@ -59,6 +60,8 @@ public:
 		bool tut_isOK();
 		
 	private:
+		friend class LLImageDecodeThread; // the worker pool sets the request status
+
 		// input
 		LLPointer<LLImageFormatted> mFormattedImage;
 		S32 mDiscardLevel;
@@ -72,18 +75,65 @@ public:
 	};
 	
 public:
-	LLImageDecodeThread(bool threaded = true);
+	// With num_threads > 1 (and threaded) requests are run by a pool of
+	// worker threads instead of the queued thread itself.
+	LLImageDecodeThread(bool threaded = true, U32 num_threads = 1);
 	virtual ~LLImageDecodeThread();
 
 	handle_t decodeImage(LLImageFormatted* image,
 						 U32 priority, S32 discard, BOOL needs_aux,
 						 Responder* responder);
 	S32 update(U32 max_time_ms);
+	/*virtual*/ void shutdown();
+	/*virtual*/ S32 getPending();
+
+	void pause(); // pauses all the decode threads, update() unpauses them
+	void setPriority(handle_t handle, U32 priority);
+
+	S32 getNumWorkers() { return llmax((S32)mWorkers.size(), 1); }
+	// Fraction of the time the worker spent decoding since the previous stats period
+	void getWorkerStats(S32 worker, S32& pending, F32& utilization);
 
 	// Used by unit tests to check the consistency of the thread instance
 	S32 tut_size();
 	
 private:
+	// Worker pool: each worker runs the requests in its own priority queue
+	// and steals the best waiting request from the other queues when its
+	// own runs dry.
+	class Worker : public LLThread
+	{
+	public:
+		Worker(LLImageDecodeThread* owner, S32 index);
+		virtual ~Worker();
+
+		LLMutex mQueueMutex;
+		request_queue_t mQueue; // protected by mQueueMutex
+		U64 mBusyTime; // microseconds spent in processRequest(), protected by mQueueMutex
+		F32 mUtilization; // MAIN THREAD
+
+	protected:
+		/*virtual*/ bool runCondition();
+		/*virtual*/ void run();
+
+	private:
+		LLImageDecodeThread* mOwner;
+		S32 mIndex;
+	};
+	friend class Worker;
+
+	void queueRequest(ImageRequest* req);
+	void pushRequest(S32 worker, ImageRequest* req);
+	ImageRequest* popRequest(S32 worker);
+	bool processWorkerRequest(S32 worker);
+	void updateWorkerStats();
+
+	typedef std::vector<Worker*> worker_list_t;
+	worker_list_t mWorkers; // empty unless running a pool
+	LLAtomic32<S32> mQueuedCount; // requests waiting in the worker queues
+	S32 mNextWorker;
+	LLTimer mStatsTimer;
+
 	struct creation_info
 	{
 		handle_t handle;
@@ -240,6 +240,44 @@ namespace tut
 		ensure("LLImageDecodeThread: threaded work unit not processed", done == true);
 	}
 
+	template<> template<>
+	void imagedecodethread_object_t::test<3>()
+	{
+		// Test a *threaded* instance running a pool of workers
+		mThread = new LLImageDecodeThread(true, 4);
+		ensure("LLImageDecodeThread: pool constructor failed", mThread != NULL);
+		ensure("LLImageDecodeThread: pool worker count incorrect", mThread->getNumWorkers() == 4);
+		// Insert more work orders than there are workers
+		const S32 NUM_REQUESTS = 10;
+		bool done[NUM_REQUESTS];
+		for (S32 i = 0; i < NUM_REQUESTS; i++)
+		{
+			done[i] = false;
+			LLImageDecodeThread::handle_t decodeHandle = mThread->decodeImage(NULL, LLQueuedThread::PRIORITY_NORMAL + i, 0, FALSE, new responder_test(&done[i]));
+			ensure("LLImageDecodeThread: pool decodeImage(), returned handle is null", decodeHandle != 0);
+		}
+		// Hand the work orders to the workers
+		mThread->update(1);
+		// Wait till all of them have been handled
+		const U32 INCREMENT_TIME = 500;				// 500 milliseconds
+		const U32 MAX_TIME = 20 * INCREMENT_TIME;	// Do the loop 20 times max, i.e. wait 10 seconds but no more
+		U32 total_time = 0;
+		S32 done_count = 0;
+		while ((done_count < NUM_REQUESTS) && (total_time < MAX_TIME))
+		{
+			ms_sleep(INCREMENT_TIME);
+			total_time += INCREMENT_TIME;
+			done_count = 0;
+			for (S32 i = 0; i < NUM_REQUESTS; i++)
+			{
+				done_count += done[i] ? 1 : 0;
+			}
+		}
+		// Verifies that every responder has now been called
+		ensure("LLImageDecodeThread: pool work units not all processed", done_count == NUM_REQUESTS);
+		ensure("LLImageDecodeThread: pool queues not empty", mThread->getPending() == 0);
+	}
+
 	// ---------------------------------------------------------------------------------------
 	// Test the LLImageDecodeThread::ImageRequest interface
 	// ---------------------------------------------------------------------------------------
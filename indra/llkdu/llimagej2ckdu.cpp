@@ -243,8 +243,23 @@ void LLImageJ2CKDU::setupCodeStream(LLImageJ2C &base, BOOL keep_codestream, ECod
 
 	mCodeStreamp->create(mInputp);
 
-	// Set the maximum number of bytes to use from the codestream
-	mCodeStreamp->set_max_bytes(max_bytes);
+	if (keep_codestream && base.isIncrementalDecode())
+	{
+		// Keep the parsed packets so that tiles can be reopened at a lower
+		// discard level once more data has been appended (see continueCodeStream()).
+		// The source bounds the reads, so the byte limit is left open unless
+		// one was set explicitly.
+		mCodeStreamp->set_persistent();
+		if (base.getMaxBytes())
+		{
+			mCodeStreamp->set_max_bytes(max_bytes);
+		}
+	}
+	else
+	{
+		// Set the maximum number of bytes to use from the codestream
+		mCodeStreamp->set_max_bytes(max_bytes);
+	}
 
 	//	If you want to flip or rotate the image for some reason, change
 	// the resolution, or identify a restricted region of interest, this is
@@ -325,6 +340,35 @@ void LLImageJ2CKDU::cleanupCodeStream()
 	mTileIndicesp = NULL;
 }
 
+// Incremental decode: reuse the codestream kept from the previous decode if
+// the data it was read from has only grown since. Returns TRUE if it can be reused.
+BOOL LLImageJ2CKDU::continueCodeStream(LLImageJ2C &base)
+{
+	if (!mCodeStreamp || !mInputp || !base.isIncrementalDecode() || mTPosp)
+	{
+		// Nothing kept, or a decode is still in progress
+		return FALSE;
+	}
+	if (!base.getData() || base.getMaxBytes())
+	{
+		// A byte limit is fixed when the codestream is created
+		return FALSE;
+	}
+	if (!mInputp->extend(base.getData(), base.getDataSize()))
+	{
+		// The source ran dry or the data changed: the codestream may be
+		// missing packets, start over.
+		return FALSE;
+	}
+	return TRUE;
+}
+
+//virtual
+void LLImageJ2CKDU::resetDecodeState()
+{
+	cleanupCodeStream();
+}
+
 BOOL LLImageJ2CKDU::initDecode(LLImageJ2C &base, LLImageRaw &raw_image, int discard_level, int* region)
 {
 	return initDecode(base,raw_image,0.0f,MODE_FAST,0,4,discard_level,region);
@@ -365,7 +409,11 @@ BOOL LLImageJ2CKDU::initDecode(LLImageJ2C &base, LLImageRaw &raw_image, F32 deco
 	try
 	{
 		base.updateRawDiscardLevel();
-		setupCodeStream(base, TRUE, mode);
+		if (!continueCodeStream(base))
+		{
+			cleanupCodeStream();
+			setupCodeStream(base, TRUE, mode);
+		}
 
 		mRawImagep = &raw_image;
 		mCodeStreamp->change_appearance(false, true, false);
@@ -435,7 +483,7 @@ BOOL LLImageJ2CKDU::decodeImpl(LLImageJ2C &base, LLImageRaw &raw_image, F32 deco
 
 	LLTimer decode_timer;
 
-	if (!mCodeStreamp)
+	if (!mTPosp)
 	{
 		if (!initDecode(base, raw_image, decode_time, mode, first_channel, max_channel_count))
 		{
@@ -525,7 +573,18 @@ BOOL LLImageJ2CKDU::decodeImpl(LLImageJ2C &base, LLImageRaw &raw_image, F32 deco
 		mTPosp->x = 0;
 	}
 
-	cleanupCodeStream();
+	if (base.isIncrementalDecode() && base.getRawDiscardLevel() > 0)
+	{
+		// Keep the codestream for the next, higher resolution decode
+		delete mTPosp;
+		mTPosp = NULL;
+		delete mTileIndicesp;
+		mTileIndicesp = NULL;
+	}
+	else
+	{
+		cleanupCodeStream();
+	}
 
 	return TRUE;
 }
@@ -735,6 +794,12 @@ BOOL LLImageJ2CKDU::getMetadata(LLImageJ2C &base)
 	// catch it here.
 	try
 	{
+		if (continueCodeStream(base))
+		{
+			// Same codestream with more data, the dimensions are known already
+			return TRUE;
+		}
+		cleanupCodeStream();
 		setupCodeStream(base, FALSE, MODE_FAST);
 		return TRUE;
 	}
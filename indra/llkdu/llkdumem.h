@@ -45,6 +45,8 @@ public:
 		mData = input_buffer;
 		mSize = size;
 		mCurPos = 0;
+		mReadHash = HASH_SEED;
+		mExhausted = false;
 	}
 
 	~LLKDUMemSource()
@@ -59,8 +61,10 @@ public:
 		if ((mSize - mCurPos) < (U32)num_bytes)
 		{
 			num_out = mSize -mCurPos;
+			mExhausted = true;
 		}
 		memcpy(buf, mData + mCurPos, num_out);
+		mReadHash = hashBytes(mReadHash, mData + mCurPos, num_out);
 		mCurPos += num_out;
 		return num_out;
 	}
@@ -68,12 +72,43 @@ public:
 	void reset()
 	{
 		mCurPos = 0;
+		mReadHash = HASH_SEED;
+		mExhausted = false;
+	}
+
+	// Switch to a new buffer holding the same codestream with more bytes
+	// appended, keeping the read position. Fails if the source already ran
+	// out of data or if the bytes read so far are not the same in the new buffer.
+	bool extend(U8 *input_buffer, U32 size)
+	{
+		if (mExhausted || size < mSize ||
+			hashBytes(HASH_SEED, input_buffer, mCurPos) != mReadHash)
+		{
+			return false;
+		}
+		mData = input_buffer;
+		mSize = size;
+		return true;
 	}
 
 private:
+	static const U32 HASH_SEED = 2166136261U;
+
+	// FNV-1a, only used to check that the data read so far did not change
+	static U32 hashBytes(U32 hash, const U8 *data, U32 size)
+	{
+		for (U32 i = 0; i < size; ++i)
+		{
+			hash = (hash ^ data[i]) * 16777619U;
+		}
+		return hash;
+	}
+
 	U8 *mData;
 	U32 mSize;
 	U32 mCurPos;
+	U32 mReadHash;
+	bool mExhausted;
 };
 
 class LLKDUMemTarget: public kdu_compressed_target
@@ -248,6 +248,59 @@ S32 LLCamera::AABBInFrustumNoFarClip(const LLVector4a& center, const LLVector4a&
 	return result?1:2;
 }
 
+void LLCamera::AABBInFrustum4(const LLVector4a* center, const LLVector4a* radius, S32* results)
+{
+	AABBInFrustum4(center, radius, results, mPlaneCount);
+}
+
+void LLCamera::AABBInFrustumNoFarClip4(const LLVector4a* center, const LLVector4a* radius, S32* results)
+{
+	AABBInFrustum4(center, radius, results, 5);
+}
+
+void LLCamera::AABBInFrustum4(const LLVector4a* center, const LLVector4a* radius, S32* results, U32 skip_plane)
+{
+	U32 outside = 0;	// bit n is set once box n is found outside a plane
+	U32 crossing = 0;	// bit n is set once box n is found crossing a plane
+	LLVector4a n, rscale, minp, maxp, t, d;
+	for (U32 i = 0; i < mPlaneCount && outside != 0xf; i++)
+	{
+		U8 mask = mPlaneMask[i];
+		if (i == skip_plane || mask == 0xff)
+		{
+			continue;
+		}
+
+		// same arithmetic as AABBInFrustum(), one component at a time:
+		// the corners nearest to and farthest along the plane normal are
+		// center -/+ radius flipped by the mask, dotted with the normal
+		const LLPlane& p(mAgentPlanes[i]);
+		minp.clear();
+		maxp.clear();
+		for (U32 j = 0; j < 3; j++)
+		{
+			n.splat(p[j]);
+			rscale.setMul(radius[j], LLVector4a((mask & (1 << j)) ? 1.f : -1.f));
+			t.setSub(center[j], rscale);
+			t.mul(n);
+			minp.add(t);
+			t.setAdd(center[j], rscale);
+			t.mul(n);
+			maxp.add(t);
+		}
+		d.splat(-p[3]);
+
+		outside |= minp.greaterThan(d).getGatheredBits();
+		crossing |= maxp.greaterThan(d).getGatheredBits();
+	}
+
+	for (U32 j = 0; j < 4; j++)
+	{
+		U32 bit = 1 << j;
+		results[j] = (outside & bit) ? 0 : ((crossing & bit) ? 1 : 2);
+	}
+}
+
 int LLCamera::sphereInFrustumQuick(const LLVector3 &sphere_center, const F32 radius) 
 {
 	LLVector3 dist = sphere_center-mFrustCenter;
@@ -188,6 +188,11 @@ public:
 	S32 sphereInFrustumFull(const LLVector3 &center, const F32 radius) const { return sphereInFrustum(center, radius); }
 	S32 AABBInFrustum(const LLVector4a& center, const LLVector4a& radius);
 	S32 AABBInFrustumNoFarClip(const LLVector4a& center, const LLVector4a& radius);
+	// Same tests on 4 boxes at once, in structure of arrays form: lane n of
+	// center[i] and radius[i] holds component i (x, y, z) of box n.
+	// The result for box n is stored in results[n].
+	void AABBInFrustum4(const LLVector4a* center, const LLVector4a* radius, S32* results);
+	void AABBInFrustumNoFarClip4(const LLVector4a* center, const LLVector4a* radius, S32* results);
 
 	//does a quick 'n dirty sphere-sphere check
 	S32 sphereInFrustumQuick(const LLVector3 &sphere_center, const F32 radius); 
@@ -208,6 +213,8 @@ protected:
 	void calculateFrustumPlanes(F32 left, F32 right, F32 top, F32 bottom);
 	void calculateFrustumPlanesFromWindow(F32 x1, F32 y1, F32 x2, F32 y2);
 	void calculateWorldFrustumPlanes();
+	// skip_plane is a plane to ignore, or mPlaneCount
+	void AABBInFrustum4(const LLVector4a* center, const LLVector4a* radius, S32* results, U32 skip_plane);
 };
 
 
@@ -2398,14 +2398,106 @@ bool LLVolumeFace::VertexData::compareNormal(const LLVolumeFace::VertexData& rhs
 bool LLVolume::unpackVolumeFaces(std::istream& is, S32 size)
 {
 	//input stream is now pointing at a zlib compressed block of LLSD
-	//decompress block
-	LLSD mdl;
-	if (!unzip_llsd(mdl, is, size))
+	if (size <= 0)
 	{
 		llwarns << "not a valid mesh asset!" << llendl;
 		return false;
 	}
-	
+
+	std::vector<U8> buffer(size);
+	is.read((char*) &buffer[0], size);
+	if (is.gcount() != size)
+	{
+		llwarns << "not a valid mesh asset!" << llendl;
+		return false;
+	}
+
+	return unpackVolumeFaces(&buffer[0], size);
+}
+
+// Dequantizes count U16 triplets (positions, normals) into x, y, z of out:
+// out = v * scale + offset, scale already including the 1/65535.
+static void dequantize_u16x3(const U8* in, U32 count, LLVector4a* out, const LLVector4a& scale, const LLVector4a& offset)
+{
+	const __m128i zero = _mm_setzero_si128();
+	U32 j = 0;
+	// 8 byte loads pick up the first U16 of the next vertex in w, which
+	// stays in bounds for all but the last vertex
+	for (; j + 1 < count; ++j)
+	{
+		__m128i v = _mm_loadl_epi64((const __m128i*) (in + j * 6));
+		LLVector4a val(_mm_cvtepi32_ps(_mm_unpacklo_epi16(v, zero)));
+		out[j].setMul(val, scale);
+		out[j].add(offset);
+	}
+	if (j < count)
+	{
+		U16 v[3];
+		memcpy(v, in + j * 6, sizeof(v));
+		out[j].set((F32) v[0], (F32) v[1], (F32) v[2]);
+		out[j].mul(scale);
+		out[j].add(offset);
+	}
+}
+
+// Dequantizes count U16 pairs (texture coordinates) into out, two per vector.
+// out must have room for a whole number of LLVector4a.
+static void dequantize_u16x2(const U8* in, U32 count, LLVector2* out, const LLVector4a& scale, const LLVector4a& offset)
+{
+	const __m128i zero = _mm_setzero_si128();
+	LLVector4a* out4 = (LLVector4a*) out;
+	U32 j = 0;
+	for (; j + 1 < count; j += 2)
+	{
+		__m128i v = _mm_loadl_epi64((const __m128i*) (in + j * 4));
+		LLVector4a val(_mm_cvtepi32_ps(_mm_unpacklo_epi16(v, zero)));
+		out4->setMul(val, scale);
+		out4->add(offset);
+		out4++;
+	}
+	if (j < count)
+	{
+		U16 t[2];
+		memcpy(t, in + j * 4, sizeof(t));
+		out4->set((F32) t[0], (F32) t[1], 0.f, 0.f);
+		out4->mul(scale);
+		out4->add(offset);
+	}
+}
+
+static void load_domain(const LLSDBinaryView& domain, LLVector4a& min, LLVector4a& max)
+{
+	LLSDBinaryView min_sd = domain["Min"];
+	LLSDBinaryView max_sd = domain["Max"];
+	min.set((F32) min_sd[0].asReal(), (F32) min_sd[1].asReal(), (F32) min_sd[2].asReal());
+	max.set((F32) max_sd[0].asReal(), (F32) max_sd[1].asReal(), (F32) max_sd[2].asReal());
+}
+
+bool LLVolume::unpackVolumeFaces(const U8* data, S32 size)
+{
+	//data is a zlib compressed block of LLSD, inflate it and read the
+	//faces straight out of the binary LLSD without building LLSD nodes
+	S32 mdl_size = 0;
+	U8* mdl_data = unzip_llsd_buffer(data, size, mdl_size);
+	if (!mdl_data)
+	{
+		llwarns << "not a valid mesh asset!" << llendl;
+		return false;
+	}
+
+	bool success = unpackVolumeFaces(LLSDBinaryView(mdl_data, mdl_data + mdl_size));
+	free(mdl_data);
+	return success;
+}
+
+bool LLVolume::unpackVolumeFaces(const LLSDBinaryView& mdl)
+{
+	if (!mdl.isArray())
+	{
+		llwarns << "not a valid mesh asset!" << llendl;
+		return false;
+	}
+
 	{
 		U32 face_count = mdl.size();
 
@@ -2417,11 +2509,21 @@ bool LLVolume::unpackVolumeFaces(std::istream& is, S32 size)
 
 		mVolumeFaces.resize(face_count);
 
-		for (U32 i = 0; i < face_count; ++i)
+		// faces follow each other in the block, walk them in order
+		// instead of indexing the array from the start for each one
+		LLSDBinaryView face_sd = mdl[0];
+
+		for (U32 i = 0; i < face_count; ++i, face_sd = face_sd.next())
 		{
 			LLVolumeFace& face = mVolumeFaces[i];
 
-			if (mdl[i].has("NoGeometry"))
+			if (!face_sd.isMap())
+			{
+				llwarns << "not a valid mesh asset!" << llendl;
+				return false;
+			}
+
+			if (face_sd.has("NoGeometry"))
 			{ //face has no geometry, continue
 				face.resizeIndices(3);
 				face.resizeVertices(1);
@@ -2432,118 +2534,83 @@ bool LLVolume::unpackVolumeFaces(std::istream& is, S32 size)
 				continue;
 			}
 
-			LLSD::Binary pos = mdl[i]["Position"];
-			LLSD::Binary norm = mdl[i]["Normal"];
-			LLSD::Binary tc = mdl[i]["TexCoord0"];
-			LLSD::Binary idx = mdl[i]["TriangleList"];
-
-			
+			S32 pos_size = 0;
+			S32 norm_size = 0;
+			S32 tc_size = 0;
+			S32 idx_size = 0;
+			const U8* pos = face_sd["Position"].asBinary(pos_size);
+			const U8* norm = face_sd["Normal"].asBinary(norm_size);
+			const U8* tc = face_sd["TexCoord0"].asBinary(tc_size);
+			const U8* idx = face_sd["TriangleList"].asBinary(idx_size);
 
 			//copy out indices
-			face.resizeIndices(idx.size()/2);
+			face.resizeIndices(idx_size/2);
 			
-			if (idx.empty() || face.mNumIndices < 3)
+			if (!idx || idx_size == 0 || face.mNumIndices < 3)
 			{ //why is there an empty index list?
 				llwarns <<"Empty face present!" << llendl;
 				continue;
 			}
 
-			U16* indices = (U16*) &(idx[0]);
-			U32 count = idx.size()/2;
-			for (U32 j = 0; j < count; ++j)
-			{
-				face.mIndices[j] = indices[j];
-			}
+			memcpy(face.mIndices, idx, (idx_size/2)*sizeof(U16));
 
 			//copy out vertices
-			U32 num_verts = pos.size()/(3*2);
+			U32 num_verts = pos ? pos_size/(3*2) : 0;
 			face.resizeVertices(num_verts);
 
-			LLVector3 minp;
-			LLVector3 maxp;
-			LLVector2 min_tc; 
-			LLVector2 max_tc; 
-		
-			minp.setValue(mdl[i]["PositionDomain"]["Min"]);
-			maxp.setValue(mdl[i]["PositionDomain"]["Max"]);
 			LLVector4a min_pos, max_pos;
-			min_pos.load3(minp.mV);
-			max_pos.load3(maxp.mV);
+			load_domain(face_sd["PositionDomain"], min_pos, max_pos);
 
-			min_tc.setValue(mdl[i]["TexCoord0Domain"]["Min"]);
-			max_tc.setValue(mdl[i]["TexCoord0Domain"]["Max"]);
+			LLVector4a min_tc, max_tc;
+			load_domain(face_sd["TexCoord0Domain"], min_tc, max_tc);
 
-			LLVector4a pos_range;
-			pos_range.setSub(max_pos, min_pos);
-			LLVector2 tc_range2 = max_tc - min_tc;
-			LLVector4a tc_range;
-			tc_range.set(tc_range2[0], tc_range2[1], tc_range2[0], tc_range2[1]);
-			LLVector4a min_tc4(min_tc[0], min_tc[1], min_tc[0], min_tc[1]);
+			LLVector4a inv_max(1.f/65535.f);
 
-			LLVector4a* pos_out = face.mPositions;
-			LLVector4a* norm_out = face.mNormals;
-			LLVector4a* tc_out = (LLVector4a*) face.mTexCoords;
+			// positions: v/65535 * range + min
+			LLVector4a pos_scale;
+			pos_scale.setSub(max_pos, min_pos);
+			pos_scale.mul(inv_max);
+			dequantize_u16x3(pos, num_verts, face.mPositions, pos_scale, min_pos);
 
+			// normals: v/65535 * 2 - 1
+			if (norm && (U32) norm_size >= num_verts*3*2)
 			{
-				U16* v = (U16*) &(pos[0]);
-				for (U32 j = 0; j < num_verts; ++j)
-				{
-					pos_out->set((F32) v[0], (F32) v[1], (F32) v[2]);
-					pos_out->div(65535.f);
-					pos_out->mul(pos_range);
-					pos_out->add(min_pos);
-					pos_out++;
-					v += 3;
-				}
-
+				LLVector4a norm_scale(2.f/65535.f);
+				LLVector4a norm_offset(-1.f);
+				dequantize_u16x3(norm, num_verts, face.mNormals, norm_scale, norm_offset);
 			}
-
+			else
 			{
-				U16* n = (U16*) &(norm[0]);
-				for (U32 j = 0; j < num_verts; ++j)
-				{
-					norm_out->set((F32) n[0], (F32) n[1], (F32) n[2]);
-					norm_out->div(65535.f);
-					norm_out->mul(2.f);
-					norm_out->sub(1.f);
-					norm_out++;
-					n += 3;
-				}
+				llwarns << "Missing or short normal list!" << llendl;
+				memset(face.mNormals, 0, num_verts*sizeof(LLVector4a));
 			}
 
+			// texture coordinates: v/65535 * range + min, two per vector
+			if (tc && (U32) tc_size >= num_verts*2*2)
 			{
-				U16* t = (U16*) &(tc[0]);
-				for (U32 j = 0; j < num_verts; j+=2)
-				{
-					if (j < num_verts-1)
-					{
-						tc_out->set((F32) t[0], (F32) t[1], (F32) t[2], (F32) t[3]);
-					}
-					else
-					{
-						tc_out->set((F32) t[0], (F32) t[1], 0.f, 0.f);
-					}
-
-					t += 4;
-
-					tc_out->div(65535.f);
-					tc_out->mul(tc_range);
-					tc_out->add(min_tc4);
-
-					tc_out++;
-				}
+				LLVector4a tc_range;
+				tc_range.setSub(max_tc, min_tc);
+				LLVector4a tc_scale(tc_range[0], tc_range[1], tc_range[0], tc_range[1]);
+				tc_scale.mul(inv_max);
+				LLVector4a tc_offset(min_tc[0], min_tc[1], min_tc[0], min_tc[1]);
+				dequantize_u16x2(tc, num_verts, face.mTexCoords, tc_scale, tc_offset);
+			}
+			else
+			{
+				llwarns << "Missing or short texture coordinate list!" << llendl;
+				memset(face.mTexCoords, 0, num_verts*sizeof(LLVector2));
 			}
 
-			if (mdl[i].has("Weights"))
+			S32 weights_size = 0;
+			const U8* weights = face_sd["Weights"].asBinary(weights_size);
+			if (weights)
 			{
 				face.allocateWeights(num_verts);
 
-				LLSD::Binary weights = mdl[i]["Weights"];
-
-				U32 idx = 0;
+				S32 idx = 0;
 
 				U32 cur_vertex = 0;
-				while (idx < weights.size() && cur_vertex < num_verts)
+				while (idx < weights_size && cur_vertex < num_verts)
 				{
 					const U8 END_INFLUENCES = 0xFF;
 					U8 joint = weights[idx++];
@@ -2551,7 +2618,7 @@ bool LLVolume::unpackVolumeFaces(std::istream& is, S32 size)
 					U32 cur_influence = 0;
 					LLVector4 wght(0,0,0,0);
 
-					while (joint != END_INFLUENCES && idx < weights.size())
+					while (joint != END_INFLUENCES && idx + 1 < weights_size)
 					{
 						U16 influence = weights[idx++];
 						influence |= ((U16) weights[idx++] << 8);
@@ -2559,7 +2626,7 @@ bool LLVolume::unpackVolumeFaces(std::istream& is, S32 size)
 						F32 w = llclamp((F32) influence / 65535.f, 0.f, 0.99999f);
 						wght.mV[cur_influence++] = (F32) joint + w;
 
-						if (cur_influence >= 4)
+						if (cur_influence >= 4 || idx >= weights_size)
 						{
 							joint = END_INFLUENCES;
 						}
@@ -2574,7 +2641,7 @@ bool LLVolume::unpackVolumeFaces(std::istream& is, S32 size)
 					cur_vertex++;
 				}
 
-				if (cur_vertex != num_verts || idx != weights.size())
+				if (cur_vertex != num_verts || idx != weights_size)
 				{
 					llwarns << "Vertex weight count does not match vertex count!" << llendl;
 				}
@@ -41,6 +41,7 @@ class LLVector4a;
 class LLVolumeFace;
 class LLVolume;
 class LLVolumeTriangle;
+class LLSDBinaryView;
 
 #include "lldarray.h"
 #include "lluuid.h"
@@ -1057,6 +1058,11 @@ protected:
 	void createVolumeFaces();
 public:
 	virtual bool unpackVolumeFaces(std::istream& is, S32 size);
+	// Same as above from a buffer, without copying it to a stream first.
+	bool unpackVolumeFaces(const U8* data, S32 size);
+private:
+	bool unpackVolumeFaces(const LLSDBinaryView& mdl);
+public:
 
 	virtual void makeTetrahedron();
 	virtual BOOL isTetrahedron();
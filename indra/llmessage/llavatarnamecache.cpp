@@ -442,25 +442,35 @@ void LLAvatarNameCache::cleanupClass()
 {
 }
 
+namespace LLAvatarNameCache
+{
+	// Adds the names of the cache file as they are parsed, so that the
+	// file is never held as a whole LLSD tree.
+	class CacheImporter : public LLSDElementListener
+	{
+	public:
+		CacheImporter() : LLSDElementListener(2) { } // data["agents"][id]
+
+		virtual void element(const LLSD& value)
+		{
+			// by convention LLSD storage is a map
+			// we only store one entry in the map
+			if (getPath()[1] != "agents") return;
+
+			LLUUID agent_id(getPath()[2]);
+			LLAvatarName av_name;
+			av_name.fromLLSD(value);
+			sCache[agent_id] = av_name;
+		}
+	};
+}
+
 void LLAvatarNameCache::importFile(std::istream& istr)
 {
-	LLSD data;
-	S32 parse_count = LLSDSerialize::fromXMLDocument(data, istr);
+	CacheImporter importer;
+	S32 parse_count = LLSDSerialize::fromXMLDocument(importer, istr);
 	if (parse_count < 1) return;
 
-	// by convention LLSD storage is a map
-	// we only store one entry in the map
-	LLSD agents = data["agents"];
-
-	LLUUID agent_id;
-	LLAvatarName av_name;
-	LLSD::map_const_iterator it = agents.beginMap();
-	for ( ; it != agents.endMap(); ++it)
-	{
-		agent_id.set(it->first);
-		av_name.fromLLSD( it->second );
-		sCache[agent_id] = av_name;
-	}
     LL_INFOS("AvNameCache") << "loaded " << sCache.size() << LL_ENDL;
 
 	// Some entries may have expired since the cache was stored,
@@ -306,62 +306,77 @@ boost::signals2::connection LLCacheName::addObserver(const LLCacheNameCallback&
 	return impl.mSignal.connect(callback);
 }
 
-bool LLCacheName::importFile(std::istream& istr)
+namespace
 {
-	LLSD data;
-	if(LLSDSerialize::fromXMLDocument(data, istr) < 1)
-		return false;
+	// Adds the entries of a name cache file as they are parsed, so that
+	// the file is never held as a whole LLSD tree.
+	class NameCacheImporter : public LLSDElementListener
+	{
+	public:
+		NameCacheImporter(Cache& cache, ReverseCache& reverse_cache, U32 delete_before_time)
+		:	LLSDElementListener(2), // data[AGENTS or GROUPS][id]
+			mCache(cache),
+			mReverseCache(reverse_cache),
+			mDeleteBeforeTime(delete_before_time),
+			mAgentCount(0),
+			mGroupCount(0)
+		{ }
+
+		virtual void element(const LLSD& value)
+		{
+			const std::string& section = getPath()[1];
+			bool is_group = (section == GROUPS);
+			if (!is_group && section != AGENTS) return;
+
+			U32 ctime = (U32)value[CTIME].asInteger();
+			if(ctime < mDeleteBeforeTime) return;
+
+			LLUUID id(getPath()[2]);
+			LLCacheNameEntry* entry = new LLCacheNameEntry();
+			entry->mIsGroup = is_group;
+			entry->mCreateTime = ctime;
+			if (is_group)
+			{
+				entry->mGroupName = value[NAME].asString();
+				mCache[id] = entry;
+				mReverseCache[entry->mGroupName] = id;
+				++mGroupCount;
+			}
+			else
+			{
+				entry->mFirstName = value[FIRST].asString();
+				entry->mLastName = value[LAST].asString();
+				mCache[id] = entry;
+				std::string fullname = LLCacheName::buildFullName(entry->mFirstName, entry->mLastName);
+				mReverseCache[fullname] = id;
+				++mAgentCount;
+			}
+		}
+
+	private:
+		Cache& mCache;
+		ReverseCache& mReverseCache;
+		U32 mDeleteBeforeTime;
 
+	public:
+		S32 mAgentCount;
+		S32 mGroupCount;
+	};
+}
+
+bool LLCacheName::importFile(std::istream& istr)
+{
 	// We'll expire entries more than a week old
 	U32 now = (U32)time(NULL);
 	const U32 SECS_PER_DAY = 60 * 60 * 24;
 	U32 delete_before_time = now - (7 * SECS_PER_DAY);
 
-	// iterate over the agents
-	S32 count = 0;
-	LLSD agents = data[AGENTS];
-	LLSD::map_iterator iter = agents.beginMap();
-	LLSD::map_iterator end = agents.endMap();
-	for( ; iter != end; ++iter)
-	{
-		LLUUID id((*iter).first);
-		LLSD agent = (*iter).second;
-		U32 ctime = (U32)agent[CTIME].asInteger();
-		if(ctime < delete_before_time) continue;
-
-		LLCacheNameEntry* entry = new LLCacheNameEntry();
-		entry->mIsGroup = false;
-		entry->mCreateTime = ctime;
-		entry->mFirstName = agent[FIRST].asString();
-		entry->mLastName = agent[LAST].asString();
-		impl.mCache[id] = entry;
-		std::string fullname = buildFullName(entry->mFirstName, entry->mLastName);
-		impl.mReverseCache[fullname] = id;
-
-		++count;
-	}
-	llinfos << "LLCacheName loaded " << count << " agent names" << llendl;
-
-	count = 0;
-	LLSD groups = data[GROUPS];
-	iter = groups.beginMap();
-	end = groups.endMap();
-	for( ; iter != end; ++iter)
-	{
-		LLUUID id((*iter).first);
-		LLSD group = (*iter).second;
-		U32 ctime = (U32)group[CTIME].asInteger();
-		if(ctime < delete_before_time) continue;
+	NameCacheImporter importer(impl.mCache, impl.mReverseCache, delete_before_time);
+	if(LLSDSerialize::fromXMLDocument(importer, istr) < 1)
+		return false;
 
-		LLCacheNameEntry* entry = new LLCacheNameEntry();
-		entry->mIsGroup = true;
-		entry->mCreateTime = ctime;
-		entry->mGroupName = group[NAME].asString();
-		impl.mCache[id] = entry;
-		impl.mReverseCache[entry->mGroupName] = id;
-		++count;
-	}
-	llinfos << "LLCacheName loaded " << count << " group names" << llendl;
+	llinfos << "LLCacheName loaded " << importer.mAgentCount << " agent names" << llendl;
+	llinfos << "LLCacheName loaded " << importer.mGroupCount << " group names" << llendl;
 	return true;
 }
 
@@ -597,6 +597,8 @@ public:
 	
 	CURLMsg* info_read(S32* msgs_in_queue);
 
+	void setopt(CURLMoption option, long value);
+
 	S32 mQueued;
 	S32 mErrorCount;
 	
@@ -656,6 +658,11 @@ CURLMsg* LLCurl::Multi::info_read(S32* msgs_in_queue)
 }
 
 
+void LLCurl::Multi::setopt(CURLMoption option, long value)
+{
+	check_curl_multi_code(curl_multi_setopt(mCurlMultiHandle, option, value));
+}
+
 S32 LLCurl::Multi::perform()
 {
 	S32 q = 0;
@@ -944,6 +951,137 @@ S32 LLCurlRequest::getQueued()
 	return queued;
 }
 
+////////////////////////////////////////////////////////////////////////////
+// For generating many requests to a few hosts
+// using one persistent multi per host
+
+LLCurlPooledRequest::LLCurlPooledRequest(bool pipelining, S32 max_connections) :
+	mPipelining(pipelining),
+	mMaxConnections(llmax(max_connections, 1)),
+	mProcessing(FALSE)
+{
+	mThreadID = LLThread::currentID();
+}
+
+LLCurlPooledRequest::~LLCurlPooledRequest()
+{
+	llassert_always(mThreadID == LLThread::currentID());
+	for (host_map_t::iterator iter = mHosts.begin(); iter != mHosts.end(); ++iter)
+	{
+		delete iter->second;
+	}
+	mHosts.clear();
+}
+
+//static
+std::string LLCurlPooledRequest::getHostKey(const std::string& url)
+{
+	size_t start = url.find("://");
+	start = (start == std::string::npos) ? 0 : start + 3;
+	size_t end = url.find_first_of("/?#", start);
+	return url.substr(0, end);
+}
+
+void LLCurlPooledRequest::setMultiOptions(LLCurl::Multi* multi)
+{
+	multi->setopt(CURLMOPT_PIPELINING, mPipelining ? 1L : 0L);
+	multi->setopt(CURLMOPT_MAXCONNECTS, (long)mMaxConnections);
+}
+
+void LLCurlPooledRequest::setPipelining(bool pipelining)
+{
+	llassert_always(mThreadID == LLThread::currentID());
+	if (pipelining != mPipelining)
+	{
+		mPipelining = pipelining;
+		for (host_map_t::iterator iter = mHosts.begin(); iter != mHosts.end(); ++iter)
+		{
+			setMultiOptions(iter->second);
+		}
+	}
+}
+
+void LLCurlPooledRequest::setMaxConnections(S32 max_connections)
+{
+	llassert_always(mThreadID == LLThread::currentID());
+	max_connections = llmax(max_connections, 1);
+	if (max_connections != mMaxConnections)
+	{
+		mMaxConnections = max_connections;
+		for (host_map_t::iterator iter = mHosts.begin(); iter != mHosts.end(); ++iter)
+		{
+			setMultiOptions(iter->second);
+		}
+	}
+}
+
+LLCurl::Multi* LLCurlPooledRequest::getMulti(const std::string& url)
+{
+	llassert_always(mThreadID == LLThread::currentID());
+	std::string host = getHostKey(url);
+	host_map_t::iterator iter = mHosts.find(host);
+	if (iter != mHosts.end())
+	{
+		return iter->second;
+	}
+	LLCurl::Multi* multi = new LLCurl::Multi();
+	setMultiOptions(multi);
+	mHosts[host] = multi;
+	return multi;
+}
+
+bool LLCurlPooledRequest::getByteRange(const std::string& url,
+									   const headers_t& headers,
+									   S32 offset, S32 length,
+									   LLCurl::ResponderPtr responder)
+{
+	if (mProcessing)
+	{
+		llerrs << "Posting to a LLCurlPooledRequest instance from within a responder is not allowed (causes DNS timeouts)." << llendl;
+	}
+	LLCurl::Multi* multi = getMulti(url);
+	LLCurl::Easy* easy = multi->allocEasy();
+	if (!easy)
+	{
+		return false;
+	}
+	easy->prepRequest(url, headers, responder);
+	easy->setopt(CURLOPT_HTTPGET, 1);
+	if (length > 0)
+	{
+		std::string range = llformat("Range: bytes=%d-%d", offset,offset+length-1);
+		easy->slist_append(range.c_str());
+	}
+	easy->setHeaders();
+	return multi->addEasy(easy);
+}
+
+// Note: call once per frame
+S32 LLCurlPooledRequest::process()
+{
+	llassert_always(mThreadID == LLThread::currentID());
+	S32 res = 0;
+
+	mProcessing = TRUE;
+	for (host_map_t::iterator iter = mHosts.begin(); iter != mHosts.end(); ++iter)
+	{
+		res += iter->second->process();
+	}
+	mProcessing = FALSE;
+	return res;
+}
+
+S32 LLCurlPooledRequest::getQueued()
+{
+	llassert_always(mThreadID == LLThread::currentID());
+	S32 queued = 0;
+	for (host_map_t::iterator iter = mHosts.begin(); iter != mHosts.end(); ++iter)
+	{
+		queued += iter->second->mQueued;
+	}
+	return queued;
+}
+
 ////////////////////////////////////////////////////////////////////////////
 // For generating one easy request
 // associated with a single multi request
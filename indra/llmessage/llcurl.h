@@ -221,6 +221,46 @@ private:
 	U32 mThreadID; // debug
 };
 
+// Sends GET requests over one long-lived multi handle per host, so the
+// connections in each multi's connection cache stay open for the next
+// requests. LLCurlRequest instead replaces its multi handle (and drops
+// its connections) every MAX_ACTIVE_REQUEST_COUNT requests.
+// When pipelining is on, requests to a host may be sent on a connection
+// that is still receiving earlier responses.
+// Must be used on the thread that created it, like LLCurlRequest.
+class LLCurlPooledRequest
+{
+public:
+	typedef std::vector<std::string> headers_t;
+
+	LLCurlPooledRequest(bool pipelining, S32 max_connections);
+	~LLCurlPooledRequest();
+
+	bool getByteRange(const std::string& url, const headers_t& headers, S32 offset, S32 length, LLCurl::ResponderPtr responder);
+
+	void setPipelining(bool pipelining);
+	void setMaxConnections(S32 max_connections); // per host
+
+	S32  process();
+	S32  getQueued();
+	S32  getNumHosts() const { return (S32)mHosts.size(); }
+
+	// "scheme://host:port" part of url
+	static std::string getHostKey(const std::string& url);
+
+private:
+	LLCurl::Multi* getMulti(const std::string& url);
+	void setMultiOptions(LLCurl::Multi* multi);
+
+private:
+	typedef std::map<std::string, LLCurl::Multi*> host_map_t;
+	host_map_t mHosts;
+	bool mPipelining;
+	S32 mMaxConnections;
+	BOOL mProcessing;
+	U32 mThreadID; // debug
+};
+
 class LLCurlEasyRequest
 {
 public:
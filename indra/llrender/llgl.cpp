@@ -131,6 +131,18 @@ PFNGLGETBUFFERPOINTERVARBPROC		glGetBufferPointervARB = NULL;
 PFNGLMAPBUFFERRANGEPROC			glMapBufferRange;
 PFNGLFLUSHMAPPEDBUFFERRANGEPROC	glFlushMappedBufferRange;
 
+#ifdef GL_ARB_sync
+// GL_ARB_sync
+PFNGLFENCESYNCPROC				glFenceSync = NULL;
+PFNGLDELETESYNCPROC				glDeleteSync = NULL;
+PFNGLCLIENTWAITSYNCPROC			glClientWaitSync = NULL;
+#endif
+
+#ifdef GL_ARB_buffer_storage
+// GL_ARB_buffer_storage
+PFNGLBUFFERSTORAGEPROC			glBufferStorage = NULL;
+#endif
+
 
 // vertex object prototypes
 PFNGLNEWOBJECTBUFFERATIPROC			glNewObjectBufferATI = NULL;
@@ -337,6 +349,8 @@ LLGLManager::LLGLManager() :
 
 	mHasVertexBufferObject(FALSE),
 	mHasMapBufferRange(FALSE),
+	mHasSync(FALSE),
+	mHasBufferStorage(FALSE),
 	mHasPBuffer(FALSE),
 	mHasShaderObjects(FALSE),
 	mHasVertexShader(FALSE),
@@ -768,6 +782,12 @@ void LLGLManager::initExtensions()
 	mHasOcclusionQuery2 = ExtensionExists("GL_ARB_occlusion_query2", gGLHExts.mSysExts);
 	mHasVertexBufferObject = ExtensionExists("GL_ARB_vertex_buffer_object", gGLHExts.mSysExts);
 	mHasMapBufferRange = ExtensionExists("GL_ARB_map_buffer_range", gGLHExts.mSysExts);
+#ifdef GL_ARB_sync
+	mHasSync = ExtensionExists("GL_ARB_sync", gGLHExts.mSysExts);
+#endif
+#ifdef GL_ARB_buffer_storage
+	mHasBufferStorage = ExtensionExists("GL_ARB_buffer_storage", gGLHExts.mSysExts);
+#endif
 	mHasDepthClamp = ExtensionExists("GL_ARB_depth_clamp", gGLHExts.mSysExts) || ExtensionExists("GL_NV_depth_clamp", gGLHExts.mSysExts);
 	// mask out FBO support when packed_depth_stencil isn't there 'cause we need it for LLRenderTarget -Brad
 #ifdef GL_ARB_framebuffer_object
@@ -803,6 +823,8 @@ void LLGLManager::initExtensions()
 		mHasARBEnvCombine = FALSE;
 		mHasCompressedTextures = FALSE;
 		mHasVertexBufferObject = FALSE;
+		mHasSync = FALSE;
+		mHasBufferStorage = FALSE;
 		mHasFramebufferObject = FALSE;
 		mHasDrawBuffers = FALSE;
 		mHasBlendFuncSeparate = FALSE;
@@ -860,6 +882,8 @@ void LLGLManager::initExtensions()
 		if (strchr(blacklist,'s')) mHasTextureRectangle = FALSE;
 		if (strchr(blacklist,'t')) mHasBlendFuncSeparate = FALSE;//S
 		if (strchr(blacklist,'u')) mHasDepthClamp = FALSE;
+		if (strchr(blacklist,'v')) mHasSync = FALSE;
+		if (strchr(blacklist,'w')) mHasBufferStorage = FALSE;
 		
 	}
 #endif // LL_LINUX || LL_SOLARIS
@@ -967,6 +991,20 @@ void LLGLManager::initExtensions()
 		glMapBufferRange = (PFNGLMAPBUFFERRANGEPROC) GLH_EXT_GET_PROC_ADDRESS("glMapBufferRange");
 		glFlushMappedBufferRange = (PFNGLFLUSHMAPPEDBUFFERRANGEPROC) GLH_EXT_GET_PROC_ADDRESS("glFlushMappedBufferRange");
 	}
+#ifdef GL_ARB_sync
+	if (mHasSync)
+	{
+		glFenceSync = (PFNGLFENCESYNCPROC) GLH_EXT_GET_PROC_ADDRESS("glFenceSync");
+		glDeleteSync = (PFNGLDELETESYNCPROC) GLH_EXT_GET_PROC_ADDRESS("glDeleteSync");
+		glClientWaitSync = (PFNGLCLIENTWAITSYNCPROC) GLH_EXT_GET_PROC_ADDRESS("glClientWaitSync");
+	}
+#endif
+#ifdef GL_ARB_buffer_storage
+	if (mHasBufferStorage)
+	{
+		glBufferStorage = (PFNGLBUFFERSTORAGEPROC) GLH_EXT_GET_PROC_ADDRESS("glBufferStorage");
+	}
+#endif
 	if (mHasFramebufferObject)
 	{
 		llinfos << "initExtensions() FramebufferObject-related procs..." << llendl;
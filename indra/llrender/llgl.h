@@ -89,6 +89,8 @@ public:
 	// ARB Extensions
 	BOOL mHasVertexBufferObject;
 	BOOL mHasMapBufferRange;
+	BOOL mHasSync;
+	BOOL mHasBufferStorage;
 	BOOL mHasPBuffer;
 	BOOL mHasShaderObjects;
 	BOOL mHasVertexShader;
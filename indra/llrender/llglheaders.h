@@ -72,6 +72,18 @@ extern PFNGLGETBUFFERPOINTERVARBPROC	glGetBufferPointervARB;
 extern PFNGLMAPBUFFERRANGEPROC			glMapBufferRange;
 extern PFNGLFLUSHMAPPEDBUFFERRANGEPROC	glFlushMappedBufferRange;
 
+#ifdef GL_ARB_sync
+// GL_ARB_sync
+extern PFNGLFENCESYNCPROC				glFenceSync;
+extern PFNGLDELETESYNCPROC				glDeleteSync;
+extern PFNGLCLIENTWAITSYNCPROC			glClientWaitSync;
+#endif
+
+#ifdef GL_ARB_buffer_storage
+// GL_ARB_buffer_storage
+extern PFNGLBUFFERSTORAGEPROC			glBufferStorage;
+#endif
+
 // GL_ATI_vertex_array_object
 extern PFNGLNEWOBJECTBUFFERATIPROC			glNewObjectBufferATI;
 extern PFNGLISOBJECTBUFFERATIPROC			glIsObjectBufferATI;
@@ -314,6 +326,18 @@ extern PFNGLGETBUFFERPOINTERVARBPROC	glGetBufferPointervARB;
 extern PFNGLMAPBUFFERRANGEPROC			glMapBufferRange;
 extern PFNGLFLUSHMAPPEDBUFFERRANGEPROC	glFlushMappedBufferRange;
 
+#ifdef GL_ARB_sync
+// GL_ARB_sync
+extern PFNGLFENCESYNCPROC				glFenceSync;
+extern PFNGLDELETESYNCPROC				glDeleteSync;
+extern PFNGLCLIENTWAITSYNCPROC			glClientWaitSync;
+#endif
+
+#ifdef GL_ARB_buffer_storage
+// GL_ARB_buffer_storage
+extern PFNGLBUFFERSTORAGEPROC			glBufferStorage;
+#endif
+
 // GL_ATI_vertex_array_object
 extern PFNGLNEWOBJECTBUFFERATIPROC			glNewObjectBufferATI;
 extern PFNGLISOBJECTBUFFERATIPROC			glIsObjectBufferATI;
@@ -28,6 +28,7 @@
 #include "llmemory.h"
 
 #include <boost/static_assert.hpp>
+#include <algorithm>
 #include "llsys.h"
 #include "llvertexbuffer.h"
 // #include "llrender.h"
@@ -60,6 +61,13 @@ U32 LLVertexBuffer::sAllocatedBytes = 0;
 BOOL LLVertexBuffer::sMapped = FALSE;
 BOOL LLVertexBuffer::sUseStreamDraw = TRUE;
 BOOL LLVertexBuffer::sPreferStreamDraw = FALSE;
+BOOL LLVertexBuffer::sUseStreamRing = FALSE;
+BOOL LLVertexBuffer::sUseDynamicRing = FALSE;
+LLVBORing* LLVertexBuffer::sVertexRing = NULL;
+LLVBORing* LLVertexBuffer::sIndexRing = NULL;
+BOOL LLVertexBuffer::sUseStaticPool = FALSE;
+LLVBOSlabPool LLVertexBuffer::sStaticVBOSlabs(GL_ARRAY_BUFFER_ARB, 4*1024*1024);
+LLVBOSlabPool LLVertexBuffer::sStaticIBOSlabs(GL_ELEMENT_ARRAY_BUFFER_ARB, 1024*1024);
 S32	LLVertexBuffer::sWeight4Loc = -1;
 
 std::vector<U32> LLVertexBuffer::sDeleteList;
@@ -92,6 +100,362 @@ U32 LLVertexBuffer::sGLMode[LLRender::NUM_MODES] =
 	GL_LINE_LOOP,
 };
 
+//============================================================================
+
+const S32 VERTEX_RING_SIZE = 4*1024*1024;
+const S32 INDEX_RING_SIZE = 1024*1024;
+
+LLVBORing::LLVBORing(U32 target, S32 size)
+: mTarget(target),
+  mName(0),
+  mSize(size),
+  mHead(0),
+  mClients(0),
+  mNextFence(1),
+  mPassedFence(0),
+  mReleased(FALSE),
+  mMappedData(NULL)
+{
+	GLint bound = 0;
+	glGetIntegerv(mTarget == GL_ARRAY_BUFFER_ARB ? GL_ARRAY_BUFFER_BINDING_ARB : GL_ELEMENT_ARRAY_BUFFER_BINDING_ARB, &bound);
+
+	stop_glerror();
+	glGenBuffersARB(1, (GLuint*) &mName);
+	glBindBufferARB(mTarget, mName);
+#ifdef GL_ARB_buffer_storage
+	if (gGLManager.mHasBufferStorage)
+	{ //map once, copies go straight to the buffer
+		U32 flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(mTarget, mSize, NULL, flags);
+		mMappedData = (U8*) glMapBufferRange(mTarget, 0, mSize, flags);
+	}
+	else
+#endif
+	{
+		glBufferDataARB(mTarget, mSize, NULL, GL_STREAM_DRAW_ARB);
+	}
+	glBindBufferARB(mTarget, bound);
+	stop_glerror();
+}
+
+LLVBORing::~LLVBORing()
+{
+#ifdef GL_ARB_sync
+	for (U32 i = 0; i < mFences.size(); ++i)
+	{
+		glDeleteSync((GLsync) mFences[i].second);
+	}
+#endif
+	mFences.clear();
+
+	//deleting the buffer also unmaps it
+	glDeleteBuffersARB(1, (GLuint*) &mName);
+	stop_glerror();
+}
+
+S32 LLVBORing::allocate(S32 size)
+{
+	size = (size + 0xF) & ~0xF;
+	if (size > mSize/4)
+	{ //large buffers would starve the ring
+		return -1;
+	}
+
+	reclaim();
+
+	if (mBlocks.empty())
+	{
+		mHead = 0;
+	}
+
+	S32 tail = mBlocks.empty() ? 0 : mBlocks.front().mOffset;
+	S32 offset = -1;
+
+	if (mBlocks.empty() || mHead > tail)
+	{
+		if (mSize - mHead >= size)
+		{
+			offset = mHead;
+		}
+		else if (tail >= size)
+		{ //wrap around, the end of the ring is reclaimed with the next fence
+			Block pad = { mHead, mSize - mHead, mNextFence };
+			mBlocks.push_back(pad);
+			mReleased = TRUE;
+			offset = 0;
+		}
+	}
+	else if (tail - mHead >= size)
+	{
+		offset = mHead;
+	}
+
+	if (offset < 0)
+	{ //let the blocks released since the last fence be reclaimed sooner
+		fence();
+		return -1;
+	}
+
+	Block block = { offset, size, 0 };
+	mBlocks.push_back(block);
+	mHead = offset + size;
+	return offset;
+}
+
+void LLVBORing::release(S32 offset)
+{
+	for (std::deque<Block>::iterator iter = mBlocks.begin(); iter != mBlocks.end(); ++iter)
+	{
+		if (iter->mOffset == offset && iter->mFence == 0)
+		{
+			iter->mFence = mNextFence;
+			mReleased = TRUE;
+			return;
+		}
+	}
+
+	llerrs << "Released a block that is not in the ring: " << offset << llendl;
+}
+
+void LLVBORing::copy(S32 offset, const U8* data, S32 size)
+{
+	if (mMappedData)
+	{
+		memcpy(mMappedData + offset, data, size);
+		return;
+	}
+
+#ifdef GL_ARB_map_buffer_range
+	//the block is not used by any draw yet, no need to sync
+	U8* dst = (U8*) glMapBufferRange(mTarget, offset, size, GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+	if (dst)
+	{
+		memcpy(dst, data, size);
+	}
+	else
+	{
+		llwarns << "glMapBufferRange returned NULL (ring block)" << llendl;
+	}
+	glUnmapBufferARB(mTarget);
+	stop_glerror();
+#else
+	llassert_always(!gGLManager.mHasMapBufferRange);
+#endif
+}
+
+void LLVBORing::fence()
+{
+	if (!mReleased)
+	{
+		return;
+	}
+
+#ifdef GL_ARB_sync
+	GLsync sync = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	mFences.push_back(std::make_pair(mNextFence, (void*) sync));
+#endif
+	mNextFence++;
+	mReleased = FALSE;
+}
+
+void LLVBORing::reclaim()
+{
+#ifdef GL_ARB_sync
+	while (!mFences.empty())
+	{
+		GLenum ret = glClientWaitSync((GLsync) mFences.front().second, 0, 0);
+		if (ret != GL_ALREADY_SIGNALED && ret != GL_CONDITION_SATISFIED)
+		{
+			break;
+		}
+
+		mPassedFence = mFences.front().first;
+		glDeleteSync((GLsync) mFences.front().second);
+		mFences.pop_front();
+	}
+#endif
+
+	while (!mBlocks.empty() && mBlocks.front().mFence != 0 && mBlocks.front().mFence <= mPassedFence)
+	{
+		mBlocks.pop_front();
+	}
+}
+
+const S32 SLAB_MIN_BLOCK = 64;
+
+LLVBOSlab::LLVBOSlab(U32 target, S32 size)
+: mName(0),
+  mUsed(0)
+{
+	llassert(size >= SLAB_MIN_BLOCK && (size & (size-1)) == 0);
+
+	S32 orders = 1;
+	while ((SLAB_MIN_BLOCK << (orders-1)) < size)
+	{
+		orders++;
+	}
+	mFreeBlocks.resize(orders);
+	mFreeBlocks[orders-1].insert(0);
+
+	GLint bound = 0;
+	glGetIntegerv(target == GL_ARRAY_BUFFER_ARB ? GL_ARRAY_BUFFER_BINDING_ARB : GL_ELEMENT_ARRAY_BUFFER_BINDING_ARB, &bound);
+
+	stop_glerror();
+	glGenBuffersARB(1, (GLuint*) &mName);
+	glBindBufferARB(target, mName);
+	glBufferDataARB(target, size, NULL, GL_STATIC_DRAW_ARB);
+	glBindBufferARB(target, bound);
+	stop_glerror();
+}
+
+LLVBOSlab::~LLVBOSlab()
+{
+	glDeleteBuffersARB(1, (GLuint*) &mName);
+	stop_glerror();
+}
+
+S32 LLVBOSlab::getOrder(S32 size) const
+{
+	S32 order = 0;
+	while ((SLAB_MIN_BLOCK << order) < size)
+	{
+		order++;
+	}
+	return order;
+}
+
+BOOL LLVBOSlab::canAllocate(S32 size) const
+{
+	for (U32 i = getOrder(size); i < mFreeBlocks.size(); ++i)
+	{
+		if (!mFreeBlocks[i].empty())
+		{
+			return TRUE;
+		}
+	}
+	return FALSE;
+}
+
+S32 LLVBOSlab::allocate(S32 size)
+{
+	S32 order = getOrder(size);
+	S32 count = (S32) mFreeBlocks.size();
+
+	S32 i = order;
+	while (i < count && mFreeBlocks[i].empty())
+	{
+		i++;
+	}
+
+	if (i >= count)
+	{
+		return -1;
+	}
+
+	//take the lowest free block, keeps live blocks packed at the front
+	S32 offset = *mFreeBlocks[i].begin();
+	mFreeBlocks[i].erase(mFreeBlocks[i].begin());
+
+	while (i > order)
+	{ //split, the upper half stays free
+		i--;
+		mFreeBlocks[i].insert(offset + (SLAB_MIN_BLOCK << i));
+	}
+
+	mBlocks[offset] = order;
+	mUsed += SLAB_MIN_BLOCK << order;
+	return offset;
+}
+
+void LLVBOSlab::release(S32 offset)
+{
+	std::map<S32, S32>::iterator iter = mBlocks.find(offset);
+	if (iter == mBlocks.end())
+	{
+		llerrs << "Released a block that is not in the slab: " << offset << llendl;
+	}
+
+	S32 order = iter->second;
+	mBlocks.erase(iter);
+	mUsed -= SLAB_MIN_BLOCK << order;
+
+	while (order < (S32) mFreeBlocks.size()-1)
+	{ //merge with the buddy while it is free
+		S32 buddy = offset ^ (SLAB_MIN_BLOCK << order);
+		std::set<S32>::iterator found = mFreeBlocks[order].find(buddy);
+		if (found == mFreeBlocks[order].end())
+		{
+			break;
+		}
+		mFreeBlocks[order].erase(found);
+		offset = llmin(offset, buddy);
+		order++;
+	}
+
+	mFreeBlocks[order].insert(offset);
+}
+
+LLVBOSlabPool::LLVBOSlabPool(U32 target, S32 slab_size)
+: mTarget(target),
+  mSlabSize(slab_size)
+{
+}
+
+S32 LLVBOSlabPool::allocate(S32 size, LLVBOSlab*& slab)
+{
+	slab = NULL;
+	if (size <= 0 || size > mSlabSize/4)
+	{ //large buffers get a buffer of their own
+		return -1;
+	}
+
+	//fill the fullest slab first so lightly used ones drain and get deleted
+	for (slab_list_t::iterator iter = mSlabs.begin(); iter != mSlabs.end(); ++iter)
+	{
+		if ((*iter)->canAllocate(size) && (!slab || (*iter)->getUsed() > slab->getUsed()))
+		{
+			slab = *iter;
+		}
+	}
+
+	if (!slab)
+	{
+		slab = new LLVBOSlab(mTarget, mSlabSize);
+		mSlabs.push_back(slab);
+	}
+
+	S32 offset = slab->allocate(size);
+	llassert(offset >= 0);
+	return offset;
+}
+
+void LLVBOSlabPool::release(LLVBOSlab* slab, S32 offset)
+{
+	slab->release(offset);
+
+	if (slab->isEmpty() && mSlabs.size() > 1)
+	{ //keep one slab around so a single buffer coming and going does not thrash
+		mSlabs.erase(std::find(mSlabs.begin(), mSlabs.end(), slab));
+		delete slab;
+	}
+}
+
+void LLVBOSlabPool::cleanup()
+{
+	for (slab_list_t::iterator iter = mSlabs.begin(); iter != mSlabs.end(); )
+	{
+		if ((*iter)->isEmpty())
+		{
+			delete *iter;
+			iter = mSlabs.erase(iter);
+		}
+		else
+		{
+			++iter;
+		}
+	}
+}
+
 //static
 void LLVertexBuffer::setupClientArrays(U32 data_mask)
 {
@@ -412,6 +776,19 @@ void LLVertexBuffer::cleanupClass()
 	unbind();
 	clientCopy(); // deletes GL buffers
 
+	//rings are kept while buffers still point into them
+	if (sVertexRing && !sVertexRing->hasClients())
+	{
+		delete sVertexRing;
+		sVertexRing = NULL;
+	}
+	if (sIndexRing && !sIndexRing->hasClients())
+	{
+		delete sIndexRing;
+		sIndexRing = NULL;
+	}
+	sStaticVBOSlabs.cleanup();
+	sStaticIBOSlabs.cleanup();
 	//llassert_always(!sCount) ;
 }
 
@@ -422,6 +799,15 @@ void LLVertexBuffer::clientCopy(F64 max_time)
 		glDeleteBuffersARB(sDeleteList.size(), (GLuint*) &(sDeleteList[0]));
 		sDeleteList.clear();
 	}
+
+	if (sVertexRing)
+	{
+		sVertexRing->fence();
+	}
+	if (sIndexRing)
+	{
+		sIndexRing->fence();
+	}
 }
 
 //----------------------------------------------------------------------------
@@ -444,7 +830,12 @@ LLVertexBuffer::LLVertexBuffer(U32 typemask, S32 usage) :
 	mFilthy(FALSE),
 	mEmpty(TRUE),
 	mResized(FALSE),
-	mDynamicSize(FALSE)
+	mDynamicSize(FALSE),
+	mUseRing(FALSE),
+	mRingOffset(-1),
+	mRingIndexOffset(-1),
+	mVertexSlab(NULL),
+	mIndexSlab(NULL)
 {
 	LLMemType mt2(LLMemType::MTYPE_VERTEX_CONSTRUCTOR);
 	if (!sEnableVBOs)
@@ -462,6 +853,12 @@ LLVertexBuffer::LLVertexBuffer(U32 typemask, S32 usage) :
 		mUsage = GL_STREAM_DRAW_ARB;
 	}
 
+	if (useVBOs() && gGLManager.mHasSync && gGLManager.mHasMapBufferRange)
+	{
+		mUseRing = (mUsage == GL_STREAM_DRAW_ARB && sUseStreamRing) ||
+					(mUsage == GL_DYNAMIC_DRAW_ARB && sUseDynamicRing);
+	}
+
 	//zero out offsets
 	for (U32 i = 0; i < TYPE_MAX; i++)
 	{
@@ -534,7 +931,17 @@ LLVertexBuffer::~LLVertexBuffer()
 
 void LLVertexBuffer::genBuffer()
 {
-	if (mUsage == GL_STREAM_DRAW_ARB)
+	if (mUseRing)
+	{ //a block is taken when the buffer is first unmapped
+		if (!sVertexRing)
+		{
+			sVertexRing = new LLVBORing(GL_ARRAY_BUFFER_ARB, VERTEX_RING_SIZE);
+		}
+		sVertexRing->addClient();
+		mGLBuffer = sVertexRing->getName();
+		mRingOffset = -1;
+	}
+	else if (mUsage == GL_STREAM_DRAW_ARB)
 	{
 		mGLBuffer = sStreamVBOPool.allocate();
 	}
@@ -544,15 +951,34 @@ void LLVertexBuffer::genBuffer()
 	}
 	else
 	{
-		BOOST_STATIC_ASSERT(sizeof(mGLBuffer) == sizeof(GLuint));
-		glGenBuffersARB(1, (GLuint*)&mGLBuffer);
+		S32 offset = sUseStaticPool ? sStaticVBOSlabs.allocate(getSize(), mVertexSlab) : -1;
+		if (offset >= 0)
+		{ //share a slab, draws use the block at mAlignedOffset
+			mGLBuffer = mVertexSlab->getName();
+			mAlignedOffset = offset;
+		}
+		else
+		{
+			BOOST_STATIC_ASSERT(sizeof(mGLBuffer) == sizeof(GLuint));
+			glGenBuffersARB(1, (GLuint*)&mGLBuffer);
+		}
 	}
 	sGLCount++;
 }
 
 void LLVertexBuffer::genIndices()
 {
-	if (mUsage == GL_STREAM_DRAW_ARB)
+	if (mUseRing)
+	{
+		if (!sIndexRing)
+		{
+			sIndexRing = new LLVBORing(GL_ELEMENT_ARRAY_BUFFER_ARB, INDEX_RING_SIZE);
+		}
+		sIndexRing->addClient();
+		mGLIndices = sIndexRing->getName();
+		mRingIndexOffset = -1;
+	}
+	else if (mUsage == GL_STREAM_DRAW_ARB)
 	{
 		mGLIndices = sStreamIBOPool.allocate();
 	}
@@ -562,15 +988,37 @@ void LLVertexBuffer::genIndices()
 	}
 	else
 	{
-		BOOST_STATIC_ASSERT(sizeof(mGLBuffer) == sizeof(GLuint));
-		glGenBuffersARB(1, (GLuint*)&mGLIndices);
+		S32 offset = sUseStaticPool ? sStaticIBOSlabs.allocate(getIndicesSize(), mIndexSlab) : -1;
+		if (offset >= 0)
+		{
+			mGLIndices = mIndexSlab->getName();
+			mAlignedIndexOffset = offset;
+		}
+		else
+		{
+			BOOST_STATIC_ASSERT(sizeof(mGLBuffer) == sizeof(GLuint));
+			glGenBuffersARB(1, (GLuint*)&mGLIndices);
+		}
 	}
 	sGLCount++;
 }
 
 void LLVertexBuffer::releaseBuffer()
 {
-	if (mUsage == GL_STREAM_DRAW_ARB)
+	if (mUseRing)
+	{
+		if (mGLBuffer != sVertexRing->getName())
+		{ //ring was full at the last upload
+			(mUsage == GL_STREAM_DRAW_ARB ? sStreamVBOPool : sDynamicVBOPool).release(mGLBuffer);
+		}
+		else if (mRingOffset >= 0)
+		{
+			sVertexRing->release(mRingOffset);
+		}
+		mRingOffset = -1;
+		sVertexRing->removeClient();
+	}
+	else if (mUsage == GL_STREAM_DRAW_ARB)
 	{
 		sStreamVBOPool.release(mGLBuffer);
 	}
@@ -578,6 +1026,12 @@ void LLVertexBuffer::releaseBuffer()
 	{
 		sDynamicVBOPool.release(mGLBuffer);
 	}
+	else if (mVertexSlab)
+	{
+		sStaticVBOSlabs.release(mVertexSlab, mAlignedOffset);
+		mVertexSlab = NULL;
+		mAlignedOffset = 0;
+	}
 	else
 	{
 		sDeleteList.push_back(mGLBuffer);
@@ -587,7 +1041,20 @@ void LLVertexBuffer::releaseBuffer()
 
 void LLVertexBuffer::releaseIndices()
 {
-	if (mUsage == GL_STREAM_DRAW_ARB)
+	if (mUseRing)
+	{
+		if (mGLIndices != sIndexRing->getName())
+		{
+			(mUsage == GL_STREAM_DRAW_ARB ? sStreamIBOPool : sDynamicIBOPool).release(mGLIndices);
+		}
+		else if (mRingIndexOffset >= 0)
+		{
+			sIndexRing->release(mRingIndexOffset);
+		}
+		mRingIndexOffset = -1;
+		sIndexRing->removeClient();
+	}
+	else if (mUsage == GL_STREAM_DRAW_ARB)
 	{
 		sStreamIBOPool.release(mGLIndices);
 	}
@@ -595,6 +1062,12 @@ void LLVertexBuffer::releaseIndices()
 	{
 		sDynamicIBOPool.release(mGLIndices);
 	}
+	else if (mIndexSlab)
+	{
+		sStaticIBOSlabs.release(mIndexSlab, mAlignedIndexOffset);
+		mIndexSlab = NULL;
+		mAlignedIndexOffset = 0;
+	}
 	else
 	{
 		sDeleteList.push_back(mGLIndices);
@@ -909,11 +1382,20 @@ BOOL LLVertexBuffer::useVBOs() const
 //----------------------------------------------------------------------------
 void LLVertexBuffer::freeClientBuffer()
 {
-	if(useVBOs() && sDisableVBOMapping && (mMappedData || mMappedIndexData))
+	if(!useVBOs())
+	{
+		return ;
+	}
+
+	//buffers in a slab keep their data in client memory until it is unmapped
+	if((sDisableVBOMapping || mUseRing || mVertexSlab) && mMappedData)
 	{
 		ll_aligned_free_16(mMappedData) ;
-		ll_aligned_free_16(mMappedIndexData) ;
 		mMappedData = NULL ;
+	}
+	if((sDisableVBOMapping || mUseRing || mIndexSlab) && mMappedIndexData)
+	{
+		ll_aligned_free_16(mMappedIndexData) ;
 		mMappedIndexData = NULL ;
 	}
 }
@@ -934,6 +1416,84 @@ void LLVertexBuffer::allocateClientIndexBuffer()
 	}
 }
 
+//copy the client vertices to a new block of the ring, buffer must be bound
+void LLVertexBuffer::uploadRingVertices()
+{
+	LLVBOPool& pool = mUsage == GL_STREAM_DRAW_ARB ? sStreamVBOPool : sDynamicVBOPool;
+	BOOL on_ring = mGLBuffer == sVertexRing->getName();
+
+	if (on_ring && mRingOffset >= 0)
+	{ //draws already issued may still read the old block, the ring fences it
+		sVertexRing->release(mRingOffset);
+		mRingOffset = -1;
+	}
+
+	stop_glerror();
+	S32 offset = sVertexRing->allocate(getSize());
+	if (offset >= 0)
+	{
+		if (!on_ring)
+		{
+			pool.release(mGLBuffer);
+			mGLBuffer = sVertexRing->getName();
+			glBindBufferARB(GL_ARRAY_BUFFER_ARB, mGLBuffer);
+		}
+		sVertexRing->copy(offset, mMappedData, getSize());
+		mRingOffset = offset;
+		mAlignedOffset = offset;
+	}
+	else
+	{ //ring is full, use a buffer of our own until the next upload
+		if (on_ring)
+		{
+			mGLBuffer = pool.allocate();
+			glBindBufferARB(GL_ARRAY_BUFFER_ARB, mGLBuffer);
+		}
+		glBufferDataARB(GL_ARRAY_BUFFER_ARB, getSize(), mMappedData, mUsage);
+		mAlignedOffset = 0;
+	}
+	stop_glerror();
+}
+
+//copy the client indices to a new block of the ring, buffer must be bound
+void LLVertexBuffer::uploadRingIndices()
+{
+	LLVBOPool& pool = mUsage == GL_STREAM_DRAW_ARB ? sStreamIBOPool : sDynamicIBOPool;
+	BOOL on_ring = mGLIndices == sIndexRing->getName();
+
+	if (on_ring && mRingIndexOffset >= 0)
+	{
+		sIndexRing->release(mRingIndexOffset);
+		mRingIndexOffset = -1;
+	}
+
+	stop_glerror();
+	S32 offset = sIndexRing->allocate(getIndicesSize());
+	if (offset >= 0)
+	{
+		if (!on_ring)
+		{
+			pool.release(mGLIndices);
+			mGLIndices = sIndexRing->getName();
+			glBindBufferARB(GL_ELEMENT_ARRAY_BUFFER_ARB, mGLIndices);
+		}
+		sIndexRing->copy(offset, mMappedIndexData, getIndicesSize());
+		mRingIndexOffset = offset;
+		mAlignedIndexOffset = offset;
+	}
+	else
+	{
+		if (on_ring)
+		{
+			mGLIndices = pool.allocate();
+			glBindBufferARB(GL_ELEMENT_ARRAY_BUFFER_ARB, mGLIndices);
+		}
+		glBufferDataARB(GL_ELEMENT_ARRAY_BUFFER_ARB, getIndicesSize(), mMappedIndexData, mUsage);
+		mAlignedIndexOffset = 0;
+	}
+	stop_glerror();
+}
+
 bool expand_region(LLVertexBuffer::MappedRegion& region, S32 index, S32 count)
 {
 	S32 end = index+count;
@@ -968,7 +1528,7 @@ U8* LLVertexBuffer::mapVertexBuffer(S32 type, S32 index, S32 count, bool map_ran
 	if (useVBOs())
 	{
 
-		if (sDisableVBOMapping || gGLManager.mHasMapBufferRange)
+		if (sDisableVBOMapping || mVertexSlab || gGLManager.mHasMapBufferRange)
 		{
 			if (count == -1)
 			{
@@ -993,7 +1553,7 @@ U8* LLVertexBuffer::mapVertexBuffer(S32 type, S32 index, S32 count, bool map_ran
 			if (!mapped)
 			{
 				//not already mapped, map new region
-				MappedRegion region(type, !sDisableVBOMapping && map_range ? -1 : index, count);
+				MappedRegion region(type, !sDisableVBOMapping && !mVertexSlab && map_range ? -1 : index, count);
 				mMappedVertexRegions.push_back(region);
 			}
 		}
@@ -1010,7 +1570,7 @@ U8* LLVertexBuffer::mapVertexBuffer(S32 type, S32 index, S32 count, bool map_ran
 			mVertexLocked = TRUE;
 			stop_glerror();	
 
-			if(sDisableVBOMapping)
+			if(sDisableVBOMapping || mUseRing || mVertexSlab)
 			{
 				map_range = false;
 				allocateClientVertexBuffer() ;
@@ -1114,7 +1674,7 @@ U8* LLVertexBuffer::mapIndexBuffer(S32 index, S32 count, bool map_range)
 
 	if (useVBOs())
 	{
-		if (sDisableVBOMapping || gGLManager.mHasMapBufferRange)
+		if (sDisableVBOMapping || mIndexSlab || gGLManager.mHasMapBufferRange)
 		{
 			if (count == -1)
 			{
@@ -1136,7 +1696,7 @@ U8* LLVertexBuffer::mapIndexBuffer(S32 index, S32 count, bool map_range)
 			if (!mapped)
 			{
 				//not already mapped, map new region
-				MappedRegion region(TYPE_INDEX, !sDisableVBOMapping && map_range ? -1 : index, count);
+				MappedRegion region(TYPE_INDEX, !sDisableVBOMapping && !mIndexSlab && map_range ? -1 : index, count);
 				mMappedIndexRegions.push_back(region);
 			}
 		}
@@ -1154,7 +1714,7 @@ U8* LLVertexBuffer::mapIndexBuffer(S32 index, S32 count, bool map_range)
 			mIndexLocked = TRUE;
 			stop_glerror();	
 
-			if(sDisableVBOMapping)
+			if(sDisableVBOMapping || mUseRing || mIndexSlab)
 			{
 				map_range = false;
 				allocateClientIndexBuffer() ;
@@ -1243,7 +1803,28 @@ void LLVertexBuffer::unmapBuffer(S32 type)
 	{
 		updated_all = (mIndexLocked && type < 0) ; //both vertex and index buffers done updating
 
-		if(sDisableVBOMapping)
+		if (mUseRing)
+		{
+			uploadRingVertices();
+			mMappedVertexRegions.clear();
+		}
+		else if (mVertexSlab)
+		{ //copy the mapped regions into the block, the client copy is not needed after that
+			stop_glerror();
+			for (U32 i = 0; i < mMappedVertexRegions.size(); ++i)
+			{
+				const MappedRegion& region = mMappedVertexRegions[i];
+				S32 offset = mOffsets[region.mType]+sTypeSize[region.mType]*region.mIndex;
+				S32 length = sTypeSize[region.mType]*region.mCount;
+				glBufferSubDataARB(GL_ARRAY_BUFFER_ARB, mAlignedOffset+offset, length, mMappedData+offset);
+				stop_glerror();
+			}
+
+			mMappedVertexRegions.clear();
+			ll_aligned_free_16(mMappedData);
+			mMappedData = NULL;
+		}
+		else if(sDisableVBOMapping)
 		{
 			if (!mMappedVertexRegions.empty())
 			{
@@ -1302,7 +1883,28 @@ void LLVertexBuffer::unmapBuffer(S32 type)
 	
 	if (mMappedIndexData && mIndexLocked && (type < 0 || type == TYPE_INDEX))
 	{
-		if(sDisableVBOMapping)
+		if (mUseRing)
+		{
+			uploadRingIndices();
+			mMappedIndexRegions.clear();
+		}
+		else if (mIndexSlab)
+		{
+			stop_glerror();
+			for (U32 i = 0; i < mMappedIndexRegions.size(); ++i)
+			{
+				const MappedRegion& region = mMappedIndexRegions[i];
+				S32 offset = sizeof(U16)*region.mIndex;
+				S32 length = sizeof(U16)*region.mCount;
+				glBufferSubDataARB(GL_ELEMENT_ARRAY_BUFFER_ARB, mAlignedIndexOffset+offset, length, mMappedIndexData+offset);
+				stop_glerror();
+			}
+
+			mMappedIndexRegions.clear();
+			ll_aligned_free_16(mMappedIndexData);
+			mMappedIndexData = NULL;
+		}
+		else if(sDisableVBOMapping)
 		{
 			if (!mMappedIndexRegions.empty())
 			{
@@ -1492,6 +2094,10 @@ void LLVertexBuffer::setBuffer(U32 data_mask, S32 type)
 			sVBOActive = TRUE;
 			setup = TRUE; // ... or the bound buffer changed
 		}
+		if (mUseRing || mVertexSlab)
+		{
+			setup = TRUE; // ... or the buffer may share its GL name at another offset
+		}
 		if (mGLIndices && (mGLIndices != sGLRenderIndices || !sIBOActive))
 		{
 			/*if (sMapped)
@@ -1578,13 +2184,14 @@ void LLVertexBuffer::setBuffer(U32 data_mask, S32 type)
 				}
 			}
 
-			if (mGLBuffer)
+			//buffers in the rings get a new block on the next upload, slab blocks are never reallocated
+			if (mGLBuffer && !mVertexSlab && !(mUseRing && mGLBuffer == sVertexRing->getName()))
 			{
 				stop_glerror();
 				glBufferDataARB(GL_ARRAY_BUFFER_ARB, getSize(), NULL, mUsage);
 				stop_glerror();
 			}
-			if (mGLIndices)
+			if (mGLIndices && !mIndexSlab && !(mUseRing && mGLIndices == sIndexRing->getName()))
 			{
 				stop_glerror();
 				glBufferDataARB(GL_ELEMENT_ARRAY_BUFFER_ARB, getIndicesSize(), NULL, mUsage);
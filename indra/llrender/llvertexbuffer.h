@@ -37,6 +37,8 @@
 #include <set>
 #include <vector>
 #include <list>
+#include <deque>
+#include <map>
 
 //============================================================================
 // NOTES
@@ -71,6 +73,108 @@ protected:
 };
 
 
+//============================================================================
+// ring of GL buffer space for streaming vertex and index data
+//  Blocks are handed out and reclaimed in order.  A released block is reused
+//  once the GPU has passed a fence placed after the release, so writes into
+//  the ring never wait on the driver.  The buffer is mapped once when
+//  GL_ARB_buffer_storage is available, otherwise each copy maps its block
+//  unsynchronized.
+
+class LLVBORing
+{
+public:
+	LLVBORing(U32 target, S32 size);
+	~LLVBORing();
+
+	U32 getName() const						{ return mName; }
+	BOOL hasClients() const					{ return mClients > 0; }
+	void addClient()						{ mClients++; }
+	void removeClient()						{ mClients--; }
+
+	// offset of a new block of at least size bytes, -1 if the ring is full
+	S32 allocate(S32 size);
+	void release(S32 offset);
+	// copy data into a block, the ring must be bound to its target
+	void copy(S32 offset, const U8* data, S32 size);
+	// place a fence after the draws issued so far, called once per pass
+	void fence();
+
+private:
+	struct Block
+	{
+		S32 mOffset;
+		S32 mSize;
+		U32 mFence; // fence placed after the release, 0 while in use
+	};
+
+	void reclaim();
+
+	U32 mTarget;
+	U32 mName;
+	S32 mSize;
+	S32 mHead; // offset of the next block
+	S32 mClients; // vertex buffers that may hold blocks
+	std::deque<Block> mBlocks; // in allocation order
+	std::deque<std::pair<U32, void*> > mFences; // serial and GLsync of fences not yet passed
+	U32 mNextFence; // serial of the next fence placed
+	U32 mPassedFence; // serial of the last fence the GPU has passed
+	BOOL mReleased; // blocks were released since the last fence
+	U8* mMappedData; // persistent mapping, NULL if each copy maps
+};
+
+
+//============================================================================
+// large GL buffer shared by many static vertex or index buffers
+//  Space is handed out by a buddy allocator, freed blocks merge with their
+//  free buddies so the slab does not fragment as buffers come and go.
+
+class LLVBOSlab
+{
+public:
+	LLVBOSlab(U32 target, S32 size);
+	~LLVBOSlab();
+
+	U32 getName() const						{ return mName; }
+	S32 getUsed() const						{ return mUsed; }
+	BOOL isEmpty() const					{ return mUsed == 0; }
+
+	// offset of a free block of at least size bytes, -1 if none is left
+	S32 allocate(S32 size);
+	void release(S32 offset);
+
+	BOOL canAllocate(S32 size) const;
+
+private:
+	S32 getOrder(S32 size) const;
+
+	U32 mName;
+	S32 mUsed; // bytes in allocated blocks
+	std::vector<std::set<S32> > mFreeBlocks; // offsets of free blocks by order
+	std::map<S32, S32> mBlocks; // order of each allocated block by offset
+};
+
+// set of slabs for one buffer target, slabs are created and deleted as needed
+
+class LLVBOSlabPool
+{
+public:
+	LLVBOSlabPool(U32 target, S32 slab_size);
+
+	// offset of a block of at least size bytes in slab, -1 if size is too large to share
+	S32 allocate(S32 size, LLVBOSlab*& slab);
+	void release(LLVBOSlab* slab, S32 offset);
+	// delete slabs with no blocks in use, called when the GL context goes away
+	void cleanup();
+
+private:
+	typedef std::vector<LLVBOSlab*> slab_list_t;
+	U32 mTarget;
+	S32 mSlabSize;
+	slab_list_t mSlabs;
+};
+
+
 //============================================================================
 // base class 
 
@@ -109,13 +213,20 @@ public:
 
 	static BOOL	sUseStreamDraw;
 	static BOOL	sPreferStreamDraw;
+	static BOOL	sUseStreamRing; // stream buffers live in the rings
+	static BOOL	sUseDynamicRing; // dynamic buffers live in the rings
+	static LLVBORing* sVertexRing;
+	static LLVBORing* sIndexRing;
+	static BOOL	sUseStaticPool; // static buffers share the slabs
+	static LLVBOSlabPool sStaticVBOSlabs;
+	static LLVBOSlabPool sStaticIBOSlabs;
 
 	static void initClass(bool use_vbo, bool no_vbo_mapping);
 	static void cleanupClass();
 	static void setupClientArrays(U32 data_mask);
 	static void drawArrays(U32 mode, const std::vector<LLVector3>& pos, const std::vector<LLVector3>& norm);
 
- 	static void clientCopy(F64 max_time = 0.005); //copy data from client to GL
+ 	static void clientCopy(F64 max_time = 0.005); //copy data from client to GL, fence the rings
 	static void unbind(); //unbind any bound vertex buffer
 
 	//get the size of a vertex with the given typemask
@@ -184,6 +295,8 @@ protected:
 	void freeClientBuffer() ;
 	void allocateClientVertexBuffer() ;
 	void allocateClientIndexBuffer() ;
+	void uploadRingVertices();
+	void uploadRingIndices();
 
 public:
 	LLVertexBuffer(U32 typemask, S32 usage);
@@ -265,6 +378,11 @@ protected:
 	BOOL	mEmpty;			// if TRUE, client buffer is empty (or NULL). Old values have been discarded.	
 	BOOL	mResized;		// if TRUE, client buffer has been resized and GL buffer has not
 	BOOL	mDynamicSize;	// if TRUE, buffer has been resized at least once (and should be padded)
+	BOOL	mUseRing;		// if TRUE, data is kept in client memory and copied to a block of the rings when unmapped
+	S32		mRingOffset;	// block of sVertexRing holding the vertices, -1 if none
+	S32		mRingIndexOffset;	// block of sIndexRing holding the indices, -1 if none
+	LLVBOSlab*	mVertexSlab;	// slab holding the vertices at mAlignedOffset, NULL if the buffer has its own
+	LLVBOSlab*	mIndexSlab;	// slab holding the indices at mAlignedIndexOffset, NULL if the buffer has its own
 	S32		mOffsets[TYPE_MAX];
 
 	std::vector<MappedRegion> mMappedVertexRegions;
@@ -33,20 +33,26 @@
 #include <map>
 #if LL_WINDOWS
 #include <share.h>
+#include <io.h>
+#include <windows.h>
 #elif LL_SOLARIS
 #include <sys/types.h>
 #include <unistd.h>
 #include <fcntl.h>
 #else
 #include <sys/file.h>
+#include <unistd.h>
 #endif
     
+#include "llcrc.h"
 #include "llstl.h"
 #include "lltimer.h"
     
 const S32 FILE_BLOCK_MASK = 0x000003FF;	 // 1024-byte blocks
 const S32 VFS_CLEANUP_SIZE = 5242880;  // how much space we free up in a single stroke
 const S32 BLOCK_LENGTH_INVALID = -1;	// mLength for invalid LLVFSFileBlocks
+const U32 VFS_JOURNAL_MAGIC = 0x4c4e4a56; // "VJNL"
+const S32 VFS_JOURNAL_CHECKPOINT_SIZE = 256 * 1024; // flush the index and restart the journal past this size
 
 LLVFS *gVFS = NULL;
 
@@ -123,6 +129,8 @@ public:
 		mSize = 0;
 		mIndexLocation = -1;
 		mAccessTime = (U32)time(NULL);
+		mReaders = 0;
+		mWriting = FALSE;
 
 		for (S32 i = 0; i < (S32)VFSLOCK_COUNT; i++)
 		{
@@ -212,6 +220,8 @@ public:
 	S32  mIndexLocation; // location of index entry
 	U32  mAccessTime;
 	BOOL mLocks[VFSLOCK_COUNT]; // number of outstanding locks of each type
+	S32  mReaders; // getData() calls reading the data outside of mDataMutex
+	BOOL mWriting; // a storeData() call is writing the data outside of mDataMutex
     
 	static const S32 SERIAL_SIZE;
 };
@@ -227,14 +237,78 @@ struct LLVFSFileBlock_less
 
 
 const S32 LLVFSFileBlock::SERIAL_SIZE = 34;
+
+// Journal record: magic, index location, serialized LLVFSFileBlock (zeros for a removal), CRC of the rest.
+// The journal never leaves this machine so it is stored in native byte order.
+const S32 VFS_JOURNAL_RECORD_SIZE = 4 + 4 + LLVFSFileBlock::SERIAL_SIZE + 4;
      
 
+// Positional reads and writes of the data file. They do not use or move the
+// shared FILE position, so that several threads can access the file at once.
+static S32 read_at(LLFILE *fp, U8 *buffer, S32 length, U32 location)
+{
+#if LL_WINDOWS
+	HANDLE handle = (HANDLE)_get_osfhandle(_fileno(fp));
+	OVERLAPPED overlapped;
+	memset(&overlapped, 0, sizeof(overlapped));
+	overlapped.Offset = location;
+	DWORD bytes_read = 0;
+	if (!ReadFile(handle, buffer, length, &bytes_read, &overlapped))
+	{
+		return 0;
+	}
+	return (S32)bytes_read;
+#else
+	S32 total = 0;
+	while (total < length)
+	{
+		ssize_t res = pread(fileno(fp), buffer + total, length - total, (off_t)location + total);
+		if (res <= 0)
+		{
+			break;
+		}
+		total += (S32)res;
+	}
+	return total;
+#endif
+}
+
+static S32 write_at(LLFILE *fp, const U8 *buffer, S32 length, U32 location)
+{
+#if LL_WINDOWS
+	HANDLE handle = (HANDLE)_get_osfhandle(_fileno(fp));
+	OVERLAPPED overlapped;
+	memset(&overlapped, 0, sizeof(overlapped));
+	overlapped.Offset = location;
+	DWORD bytes_written = 0;
+	if (!WriteFile(handle, buffer, length, &bytes_written, &overlapped))
+	{
+		return 0;
+	}
+	return (S32)bytes_written;
+#else
+	S32 total = 0;
+	while (total < length)
+	{
+		ssize_t res = pwrite(fileno(fp), buffer + total, length - total, (off_t)location + total);
+		if (res <= 0)
+		{
+			break;
+		}
+		total += (S32)res;
+	}
+	return total;
+#endif
+}
+
 LLVFS::LLVFS(const std::string& index_filename, const std::string& data_filename, const BOOL read_only, const U32 presize, const BOOL remove_after_crash)
 :	mRemoveAfterCrash(remove_after_crash),
 	mDataFP(NULL),
-	mIndexFP(NULL)
+	mIndexFP(NULL),
+	mJournalFP(NULL),
+	mJournalSize(0)
 {
-	mDataMutex = new LLMutex(0);
+	mDataMutex = new LLCondition(0);
 
 	S32 i;
 	for (i = 0; i < VFSLOCK_COUNT; i++)
@@ -267,6 +341,7 @@ LLVFS::LLVFS(const std::string& index_filename, const std::string& data_filename
 			// Since we're creating this data file, assume any index file is bogus
 			// remove the index, since this vfs is now blank
 			LLFile::remove(mIndexFilename);
+			LLFile::remove(getJournalFilename(mIndexFilename));
 		}
 		else
 		{
@@ -283,12 +358,17 @@ LLVFS::LLVFS(const std::string& index_filename, const std::string& data_filename
 	}
 
 	// Did we leave this file open for writing last time?
-	// If so, close it and start over.
+	// If so, replay the journal, or close it and start over if there is none.
 	if (!mReadOnly && mRemoveAfterCrash)
 	{
 		llstat marker_info;
 		std::string marker = mDataFilename + ".open";
-		if (!LLFile::stat(marker, &marker_info))
+		if (!LLFile::stat(marker, &marker_info)
+			&& LLFile::isfile(getJournalFilename(mIndexFilename)))
+		{
+			LL_WARNS("VFS") << "VFS: File left open on last run, recovering " << mDataFilename << " from the journal" << LL_ENDL;
+		}
+		else if (!LLFile::stat(marker, &marker_info))
 		{
 			// marker exists, kill the lock and the VFS files
 			unlockAndClose(mDataFP);
@@ -314,6 +394,12 @@ LLVFS::LLVFS(const std::string& index_filename, const std::string& data_filename
 		}
 	}
 
+	// bring the index up to date with the updates journaled before a crash
+	if (!mReadOnly)
+	{
+		replayJournal();
+	}
+
 	// determine the real file size
 	fseek(mDataFP, 0, SEEK_END);
 	U32 data_size = ftell(mDataFP);
@@ -540,6 +626,15 @@ LLVFS::LLVFS(const std::string& index_filename, const std::string& data_filename
 		addFreeBlock(first_block);
 	}
 
+	if (!mReadOnly)
+	{
+		mJournalFP = LLFile::fopen(getJournalFilename(mIndexFilename), "wb");	/* Flawfinder: ignore */
+		if (!mJournalFP)
+		{
+			LL_WARNS("VFS") << "Couldn't open the VFS journal, the index may not survive a crash" << LL_ENDL;
+		}
+	}
+
 	// Open marker file to look for bad shutdowns
 	if (!mReadOnly && mRemoveAfterCrash)
 	{
@@ -568,6 +663,14 @@ LLVFS::~LLVFS()
 	unlockAndClose(mIndexFP);
 	mIndexFP = NULL;
 
+	// the index is complete once closed, the journal is not needed anymore
+	if (mJournalFP)
+	{
+		fclose(mJournalFP);
+		mJournalFP = NULL;
+		LLFile::remove(getJournalFilename(mIndexFilename));
+	}
+
 	fileblock_map::const_iterator it;
 	for (it = mFileBlocks.begin(); it != mFileBlocks.end(); ++it)
 	{
@@ -645,10 +748,11 @@ void LLVFS::presizeDataFile(const U32 size)
 	fseek(mDataFP, size-1, SEEK_SET);
 	S32 tmp = 0;
 	tmp = (S32)fwrite(&tmp, 1, 1, mDataFP);
-	// fflush(mDataFP);
+	fflush(mDataFP); // data is read and written with read_at()/write_at() from now on
 
 	// also remove any index, since this vfs is now blank
 	LLFile::remove(mIndexFilename);
+	LLFile::remove(getJournalFilename(mIndexFilename));
 
 	if (tmp)
 	{
@@ -660,6 +764,110 @@ void LLVFS::presizeDataFile(const U32 size)
 	}
 }
 
+// static
+std::string LLVFS::getJournalFilename(const std::string& index_filename)
+{
+	return index_filename + ".journal";
+}
+
+// Applies the journaled index updates (in order, a torn record ends the journal)
+// then removes the journal. Called before the index is read.
+void LLVFS::replayJournal()
+{
+	std::string journal_filename = getJournalFilename(mIndexFilename);
+	LLFILE* journal_fp = LLFile::fopen(journal_filename, "rb");	/* Flawfinder: ignore */
+	if (!journal_fp)
+	{
+		return;
+	}
+
+	S32 count = 0;
+	LLFILE* index_fp = LLFile::fopen(mIndexFilename, "r+b");	/* Flawfinder: ignore */
+	if (index_fp)
+	{
+		U8 buffer[VFS_JOURNAL_RECORD_SIZE];
+		while (fread(buffer, VFS_JOURNAL_RECORD_SIZE, 1, journal_fp) == 1)
+		{
+			U32 magic;
+			S32 index_location;
+			U32 crc;
+			memcpy(&magic, buffer, 4);
+			memcpy(&index_location, buffer + 4, 4);
+			memcpy(&crc, buffer + VFS_JOURNAL_RECORD_SIZE - 4, 4);
+			LLCRC check;
+			check.update(buffer, VFS_JOURNAL_RECORD_SIZE - 4);
+			if (magic != VFS_JOURNAL_MAGIC || crc != check.getCRC() || index_location < 0)
+			{
+				LL_WARNS("VFS") << "VFS: Ignoring torn journal record " << count << LL_ENDL;
+				break;
+			}
+			fseek(index_fp, index_location, SEEK_SET);
+			if (fwrite(buffer + 8, LLVFSFileBlock::SERIAL_SIZE, 1, index_fp) != 1)
+			{
+				LL_WARNS("VFS") << "VFS: Short write replaying the journal" << LL_ENDL;
+				break;
+			}
+			count++;
+		}
+		fclose(index_fp);
+	}
+	// else the index is gone, the journal belongs to a deleted VFS
+
+	fclose(journal_fp);
+	LLFile::remove(journal_filename);
+
+	if (count)
+	{
+		LL_INFOS("VFS") << "VFS: Replayed " << count << " journaled index updates" << LL_ENDL;
+	}
+}
+
+// NOTE! mDataMutex must be LOCKED before calling this
+void LLVFS::appendJournal(S32 index_location, const U8 *entry)
+{
+	if (!mJournalFP)
+	{
+		return;
+	}
+
+	// write_at() is unbuffered, the data the entry points to is already in the file.
+
+	U8 buffer[VFS_JOURNAL_RECORD_SIZE];
+	memcpy(buffer, &VFS_JOURNAL_MAGIC, 4);
+	memcpy(buffer + 4, &index_location, 4);
+	memcpy(buffer + 8, entry, LLVFSFileBlock::SERIAL_SIZE);
+	LLCRC crc;
+	crc.update(buffer, VFS_JOURNAL_RECORD_SIZE - 4);
+	U32 crc_value = crc.getCRC();
+	memcpy(buffer + VFS_JOURNAL_RECORD_SIZE - 4, &crc_value, 4);
+
+	// One small sequential write per update, flushed so it survives the process
+	if (fwrite(buffer, VFS_JOURNAL_RECORD_SIZE, 1, mJournalFP) != 1 || fflush(mJournalFP) != 0)
+	{
+		llwarns << "VFS: Short write to the journal" << llendl;
+	}
+	mJournalSize += VFS_JOURNAL_RECORD_SIZE;
+}
+
+// NOTE! mDataMutex must be LOCKED before calling this
+void LLVFS::checkpointJournal()
+{
+	// Once the index is flushed it holds everything journaled so far,
+	// replaying the journal again after a crash at any point here is harmless.
+	fflush(mIndexFP);
+
+	if (mJournalFP)
+	{
+		fclose(mJournalFP);
+	}
+	mJournalFP = LLFile::fopen(getJournalFilename(mIndexFilename), "wb");	/* Flawfinder: ignore */
+	mJournalSize = 0;
+	if (!mJournalFP)
+	{
+		llwarns << "VFS: Couldn't restart the journal" << llendl;
+	}
+}
+
 BOOL LLVFS::getExists(const LLUUID &file_id, const LLAssetType::EType file_type)
 {
 	LLVFSFileBlock *block = NULL;
@@ -743,7 +951,7 @@ BOOL LLVFS::checkAvailable(S32 max_size)
 {
 	lockData();
 	
-	blocks_length_map_t::iterator iter = mFreeBlocksByLength.lower_bound(max_size); // first entry >= size
+	blocks_length_map_t::iterator iter = mFreeBlocksByLength.lower_bound(std::make_pair(max_size, 0U)); // first entry >= size
 	const BOOL res(iter == mFreeBlocksByLength.end() ? FALSE : TRUE);
 
 	unlockData();
@@ -775,6 +983,7 @@ BOOL LLVFS::setMaxSize(const LLUUID &file_id, const LLAssetType::EType file_type
 	if (it != mFileBlocks.end())
 	{
 		block = (*it).second;
+		waitForAccess(block);
 	}
     
 	// round all sizes upward to KB increments
@@ -872,11 +1081,9 @@ BOOL LLVFS::setMaxSize(const LLUUID &file_id, const LLAssetType::EType file_type
 					{
 						// move the file into the new block
 						std::vector<U8> buffer(block->mSize);
-						fseek(mDataFP, block->mLocation, SEEK_SET);
-						if (fread(&buffer[0], block->mSize, 1, mDataFP) == 1)
+						if (read_at(mDataFP, &buffer[0], block->mSize, block->mLocation) == block->mSize)
 						{
-							fseek(mDataFP, new_data_location, SEEK_SET);
-							if (fwrite(&buffer[0], block->mSize, 1, mDataFP) != 1)
+							if (write_at(mDataFP, &buffer[0], block->mSize, new_data_location) != block->mSize)
 							{
 								llwarns << "Short write" << llendl;
 							}
@@ -969,6 +1176,7 @@ void LLVFS::renameFile(const LLUUID &file_id, const LLAssetType::EType file_type
 	if (it != mFileBlocks.end())
 	{
 		LLVFSFileBlock *src_block = (*it).second;
+		waitForAccess(src_block);
 
 		// this will purge the data but leave the file block in place, w/ locks, if any
 		// WAS: removeFile(new_id, new_type); NOW uses removeFileBlock() to avoid mutex lock recursion
@@ -976,6 +1184,7 @@ void LLVFS::renameFile(const LLUUID &file_id, const LLAssetType::EType file_type
 		if (new_it != mFileBlocks.end())
 		{
 			LLVFSFileBlock *new_block = (*new_it).second;
+			waitForAccess(new_block);
 			removeFileBlock(new_block);
 		}
 		
@@ -1014,6 +1223,17 @@ void LLVFS::renameFile(const LLUUID &file_id, const LLAssetType::EType file_type
 	unlockData();
 }
 
+// mDataMutex must be LOCKED before calling this
+// Waits for the getData()/storeData() calls accessing the block outside of the
+// mutex, the block must not be moved, resized or freed before they are done.
+void LLVFS::waitForAccess(LLVFSFileBlock *block)
+{
+	while (block->mReaders > 0 || block->mWriting)
+	{
+		mDataMutex->wait();
+	}
+}
+
 // mDataMutex must be LOCKED before calling this
 void LLVFS::removeFileBlock(LLVFSFileBlock *fileblock)
 {
@@ -1055,6 +1275,7 @@ void LLVFS::removeFile(const LLUUID &file_id, const LLAssetType::EType file_type
 	if (it != mFileBlocks.end())
 	{
 		LLVFSFileBlock *block = (*it).second;
+		waitForAccess(block);
 		removeFileBlock(block);
 	}
 	else
@@ -1077,7 +1298,7 @@ S32 LLVFS::getData(const LLUUID &file_id, const LLAssetType::EType file_type, U8
 	llassert(location >= 0);
 	llassert(length >= 0);
 
-	BOOL do_read = FALSE;
+	LLVFSFileBlock *block = NULL;
 	
     lockData();
 	
@@ -1085,13 +1306,20 @@ S32 LLVFS::getData(const LLUUID &file_id, const LLAssetType::EType file_type, U8
 	fileblock_map::iterator it = mFileBlocks.find(spec);
 	if (it != mFileBlocks.end())
 	{
-		LLVFSFileBlock *block = (*it).second;
+		block = (*it).second;
+
+		// don't read a half written append
+		while (block->mWriting)
+		{
+			mDataMutex->wait();
+		}
 
 		block->mAccessTime = (U32)time(NULL);
     
 		if (location > block->mSize)
 		{
 			llwarns << "VFS: Attempt to read location " << location << " in file " << file_id << " of length " << block->mSize << llendl;
+			block = NULL;
 		}
 		else
 		{
@@ -1100,17 +1328,25 @@ S32 LLVFS::getData(const LLUUID &file_id, const LLAssetType::EType file_type, U8
 				length = block->mSize - location;
 			}
 			location += block->mLocation;
-			do_read = TRUE;
+			// pins the block, it can't be moved or freed until we are done
+			block->mReaders++;
 		}
 	}
 
-	if (do_read)
+	unlockData();
+
+	if (block)
 	{
-		fseek(mDataFP, location, SEEK_SET);
-		bytesread = (S32)fread(buffer, 1, length, mDataFP);
+		// Reads of different files (and of the same file) run concurrently
+		bytesread = read_at(mDataFP, buffer, length, location);
+
+		lockData();
+		if (--block->mReaders == 0)
+		{
+			mDataMutex->broadcast();
+		}
+		unlockData();
 	}
-	
-	unlockData();
 
 	return bytesread;
 }
@@ -1135,6 +1371,7 @@ S32 LLVFS::storeData(const LLUUID &file_id, const LLAssetType::EType file_type,
 	if (it != mFileBlocks.end())
 	{
 		LLVFSFileBlock *block = (*it).second;
+		waitForAccess(block);
 
 		S32 in_loc = location;
 		if (location == -1)
@@ -1175,20 +1412,25 @@ S32 LLVFS::storeData(const LLUUID &file_id, const LLAssetType::EType file_type,
 				length = block->mLength - location;
 			}
 			U32 file_location = location + block->mLocation;
+
+			// Write outside of mDataMutex, the block can't be moved or freed meanwhile
+			block->mWriting = TRUE;
+			unlockData();
 			
-			fseek(mDataFP, file_location, SEEK_SET);
-			S32 write_len = (S32)fwrite(buffer, 1, length, mDataFP);
+			S32 write_len = write_at(mDataFP, buffer, length, file_location);
 			if (write_len != length)
 			{
 				llwarns << llformat("VFS Write Error: %d != %d",write_len,length) << llendl;
 			}
-			// fflush(mDataFP);
 			
+			lockData();
+			block->mWriting = FALSE;
 			if (location + length > block->mSize)
 			{
 				block->mSize = location + write_len;
 				sync(block);
 			}
+			mDataMutex->broadcast();
 			unlockData();
 			
 			return write_len;
@@ -1277,26 +1519,18 @@ BOOL LLVFS::isLocked(const LLUUID &file_id, const LLAssetType::EType file_type,
 void LLVFS::eraseBlockLength(LLVFSBlock *block)
 {
 	// find the corresponding map entry in the length map and erase it
-	S32 length = block->mLength;
-	blocks_length_map_t::iterator iter = mFreeBlocksByLength.lower_bound(length);
-	blocks_length_map_t::iterator end = mFreeBlocksByLength.end();
-	bool found_block = false;
-	while(iter != end)
-	{
-		LLVFSBlock *tblock = iter->second;
-		llassert(tblock->mLength == length); // there had -better- be an entry with our length!
-		if (tblock == block)
-		{
-			mFreeBlocksByLength.erase(iter);
-			found_block = true;
-			break;
-		}
-		++iter;
-	}
-	if(!found_block)
+	blocks_length_map_t::iterator iter = mFreeBlocksByLength.find(std::make_pair(block->mLength, block->mLocation));
+	if (iter == mFreeBlocksByLength.end() || iter->second != block)
 	{
 		llerrs << "eraseBlock could not find block" << llendl;
+		return;
 	}
+	mFreeBlocksByLength.erase(iter);
+}
+
+void LLVFS::insertBlockLength(LLVFSBlock *block)
+{
+	mFreeBlocksByLength.insert(blocks_length_map_t::value_type(std::make_pair(block->mLength, block->mLocation), block));
 }
 
 
@@ -1353,7 +1587,7 @@ void LLVFS::addFreeBlock(LLVFSBlock *block)
 		eraseBlockLength(prev_block);
 		eraseBlock(next_block);
 		prev_block->mLength += block->mLength + next_block->mLength;
-		mFreeBlocksByLength.insert(blocks_length_map_t::value_type(prev_block->mLength, prev_block));
+		insertBlockLength(prev_block);
 		delete block;
 		block = NULL;
 		delete next_block;
@@ -1366,7 +1600,7 @@ void LLVFS::addFreeBlock(LLVFSBlock *block)
 		// therefore only need to update the length map. JC
 		eraseBlockLength(prev_block);
 		prev_block->mLength += block->mLength;
-		mFreeBlocksByLength.insert(blocks_length_map_t::value_type(prev_block->mLength, prev_block)); // multimap insert
+		insertBlockLength(prev_block);
 		delete block;
 		block = NULL;
 	}
@@ -1380,7 +1614,7 @@ void LLVFS::addFreeBlock(LLVFSBlock *block)
 		next_block->mLength += block->mLength;
 		// Don't hint here, next_free_it iterator may be invalid.
 		mFreeBlocksByLocation.insert(blocks_location_map_t::value_type(next_block->mLocation, next_block)); // multimap insert
-		mFreeBlocksByLength.insert(blocks_length_map_t::value_type(next_block->mLength, next_block)); // multimap insert			
+		insertBlockLength(next_block);
 		delete block;
 		block = NULL;
 	}
@@ -1389,7 +1623,7 @@ void LLVFS::addFreeBlock(LLVFSBlock *block)
 		// Can't merge with other free blocks.
 		// Hint that insert should go near next_free_it.
  		mFreeBlocksByLocation.insert(next_free_it, blocks_location_map_t::value_type(block->mLocation, block)); // multimap insert
- 		mFreeBlocksByLength.insert(blocks_length_map_t::value_type(block->mLength, block)); // multimap insert
+ 		insertBlockLength(block);
 	}
 }
 
@@ -1515,6 +1749,9 @@ void LLVFS::sync(LLVFSFileBlock *block, BOOL remove)
 		block->serialize(buffer);
 	}
 
+	// Write ahead so that the buffered index write below can be lost in a crash
+	appendJournal(seek_pos, buffer);
+
 	// If set_index_to_end, file pointer is already at seek_pos
 	// and we don't need to do anything.  Only seek if not at end.
 	if (!set_index_to_end)
@@ -1527,8 +1764,11 @@ void LLVFS::sync(LLVFSFileBlock *block, BOOL remove)
 		llwarns << "Short write" << llendl;
 	}
 
-	// *NOTE:  Why was this commented out?
-	// fflush(mIndexFP);
+	// No fflush(mIndexFP) per update, the journal covers it until the next checkpoint
+	if (mJournalSize >= VFS_JOURNAL_CHECKPOINT_SIZE)
+	{
+		checkpointJournal();
+	}
 	
 	return;
 }
@@ -1553,8 +1793,9 @@ LLVFSBlock *LLVFS::findFreeBlock(S32 size, LLVFSFileBlock *immune)
 
 	while (! block)
 	{
-		// look for a suitable free block
-		blocks_length_map_t::iterator iter = mFreeBlocksByLength.lower_bound(size); // first entry >= size
+		// look for a suitable free block: the smallest one that fits, lowest location first,
+		// keeps the large free extents whole and the files packed at the start of the data file
+		blocks_length_map_t::iterator iter = mFreeBlocksByLength.lower_bound(std::make_pair(size, 0U)); // first entry >= size
 		if (iter != mFreeBlocksByLength.end())
 			block = iter->second;
     	
@@ -1571,6 +1812,8 @@ LLVFSBlock *LLVFS::findFreeBlock(S32 size, LLVFSFileBlock *immune)
 
 					if (tmp != immune &&
 						tmp->mLength > 0 &&
+						! tmp->mReaders &&
+						! tmp->mWriting &&
 						! tmp->mLocks[VFSLOCK_READ] &&
 						! tmp->mLocks[VFSLOCK_APPEND] &&
 						! tmp->mLocks[VFSLOCK_OPEN])
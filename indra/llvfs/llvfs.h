@@ -90,10 +90,16 @@ public:
 			const U32 presize, 
 			const BOOL remove_after_crash);
 
+	// Index updates are journaled to this file before they are written to the index,
+	// so that the index can be brought up to date after a crash. Rename/remove it with the index.
+	static std::string getJournalFilename(const std::string& index_filename);
+
 	BOOL isValid() const			{ return (VFSVALID_OK == mValid); }
 	EVFSValid getValidState() const	{ return mValid; }
 
 	// ---------- The following fucntions lock/unlock mDataMutex ----------
+	// getData() and storeData() do the file I/O itself outside of the mutex, with
+	// positional reads/writes. Reads of a file can run together, a write waits for them.
 	BOOL getExists(const LLUUID &file_id, const LLAssetType::EType file_type);
 	S32	 getSize(const LLUUID &file_id, const LLAssetType::EType file_type);
 
@@ -131,14 +137,19 @@ public:
 
 protected:
 	void removeFileBlock(LLVFSFileBlock *fileblock);
+	void waitForAccess(LLVFSFileBlock *block);
 	
 	void eraseBlockLength(LLVFSBlock *block);
+	void insertBlockLength(LLVFSBlock *block);
 	void eraseBlock(LLVFSBlock *block);
 	void addFreeBlock(LLVFSBlock *block);
 	//void mergeFreeBlocks();
 	void useFreeSpace(LLVFSBlock *free_block, S32 length);
 	void sync(LLVFSFileBlock *block, BOOL remove = FALSE);
 	void presizeDataFile(const U32 size);
+	void replayJournal();
+	void appendJournal(S32 index_location, const U8 *entry);
+	void checkpointJournal();
 
 	static LLFILE *openAndLock(const std::string& filename, const char* mode, BOOL read_lock);
 	static void unlockAndClose(FILE *fp);
@@ -152,18 +163,21 @@ protected:
 	void unlockData() { mDataMutex->unlock(); }	
 	
 protected:
-	LLMutex* mDataMutex;
+	LLCondition* mDataMutex; // also signaled when a read or write outside of the mutex completes
 	
 	typedef std::map<LLVFSFileSpecifier, LLVFSFileBlock*> fileblock_map;
 	fileblock_map mFileBlocks;
 
-	typedef std::multimap<S32, LLVFSBlock*>	blocks_length_map_t;
+	// keyed by (length, location) so that best fit lookups and removals are both O(log n)
+	typedef std::map<std::pair<S32, U32>, LLVFSBlock*> blocks_length_map_t;
 	blocks_length_map_t 	mFreeBlocksByLength;
 	typedef std::multimap<U32, LLVFSBlock*>	blocks_location_map_t;
 	blocks_location_map_t 	mFreeBlocksByLocation;
 
 	LLFILE *mDataFP;
 	LLFILE *mIndexFP;
+	LLFILE *mJournalFP;
+	S32 mJournalSize;
 
 	std::deque<S32> mIndexHoles;
 
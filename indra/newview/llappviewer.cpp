@@ -1913,8 +1913,8 @@ bool LLAppViewer::initThreads()
 	LLLFSThread::initClass(enable_threads && false);
 
 	// Image decoding
-	LLAppViewer::sImageDecodeThread = new LLImageDecodeThread(enable_threads && true);
-	LLAppViewer::sTextureCache = new LLTextureCache(enable_threads && true);
+	LLAppViewer::sImageDecodeThread = new LLImageDecodeThread(enable_threads && true, gSavedSettings.getU32("ImageDecodeThreads"));
+	LLAppViewer::sTextureCache = new LLTextureCache(enable_threads && true, gSavedSettings.getU32("TextureCacheThreads"));
 	LLAppViewer::sTextureFetch = new LLTextureFetch(LLAppViewer::getTextureCache(),
 													sImageDecodeThread,
 													enable_threads && true,
@@ -3587,7 +3587,7 @@ U32 LLAppViewer::getObjectCacheVersion()
 {
 	// Viewer object cache version, change if object update
 	// format changes. JC
-	const U32 INDRA_OBJECT_CACHE_VERSION = 14;
+	const U32 INDRA_OBJECT_CACHE_VERSION = 15;
 
 	return INDRA_OBJECT_CACHE_VERSION;
 }
@@ -3785,6 +3785,7 @@ bool LLAppViewer::initCache()
 		
 		LLFile::remove(old_vfs_data_file);
 		LLFile::remove(old_vfs_index_file);
+		LLFile::remove(LLVFS::getJournalFilename(old_vfs_index_file));
 	}
 	else if (old_salt != new_salt)
 	{
@@ -3793,6 +3794,7 @@ bool LLAppViewer::initCache()
 		LL_DEBUGS("AppCache") << "Renaming " << old_vfs_index_file << " to " << new_vfs_index_file << LL_ENDL;
 		LLFile::rename(old_vfs_data_file, new_vfs_data_file);
 		LLFile::rename(old_vfs_index_file, new_vfs_index_file);
+		LLFile::rename(LLVFS::getJournalFilename(old_vfs_index_file), LLVFS::getJournalFilename(new_vfs_index_file));
 	}
 
 	// Startup the VFS...
@@ -4206,6 +4208,12 @@ void LLAppViewer::idle()
 	    // floating throughout the various object lists.
 	    //
 		idleNameCache();
+
+		//volumes may change while processing messages
+		if (gPipeline.getGeometryPool())
+		{
+			gPipeline.getGeometryPool()->sync();
+		}
     
 		idleNetwork();
 	    	        
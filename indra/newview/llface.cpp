@@ -1059,11 +1059,117 @@ BOOL LLFace::getGeometryVolume(const LLVolume& volume,
 								bool force_rebuild)
 {
 	LLFastTimer t(FTM_FACE_GET_GEOM);
+
+	GeometryParams params;
+	if (!getGeometryParams(volume, f, mat_vert_in, mat_norm_in, index_offset, params, force_rebuild))
+	{
+		return FALSE;
+	}
+
+	LLStrider<LLVector3> vert;
+	LLStrider<LLVector2> tex_coords;
+	LLStrider<LLVector2> tex_coords2;
+	LLStrider<LLVector3> norm;
+	LLStrider<LLColor4U> colors;
+	LLStrider<LLVector3> binorm;
+	LLStrider<U16> indicesp;
+	LLStrider<LLVector4> wght;
+
+	// INDICES
+	if (params.mRebuildIndices)
+	{
+		mVertexBuffer->getIndexStrider(indicesp, mIndicesIndex, mIndicesCount, true);
+		params.genIndices(indicesp.get());
+		mVertexBuffer->setBuffer(0);
+	}
+
+	if (params.mRebuildTCoord)
+	{
+		if (!params.mInAtlas && !params.mRebuildBump)
+		{ //not in atlas or not bump mapped, might be able to do a cheap update
+			mVertexBuffer->getTexCoord0Strider(tex_coords, mGeomIndex, mGeomCount);
+			params.genTexCoords(tex_coords.get());
+			mVertexBuffer->setBuffer(0);
+		}
+		else
+		{ //either bump mapped or in atlas, just do the whole expensive loop
+			mVertexBuffer->getTexCoord0Strider(tex_coords, mGeomIndex, mGeomCount, true);
+
+			if (params.mRebuildBump)
+			{ //bump texture coordinates are offset from these, keep a copy
+				std::vector<LLVector2> bump_tc(params.mNumVertices);
+				if (params.mNumVertices > 0)
+				{
+					params.genTexCoords(&bump_tc[0]);
+					memcpy(tex_coords.get(), &bump_tc[0], params.mNumVertices*sizeof(LLVector2));
+				}
+				mVertexBuffer->setBuffer(0);
+
+				mVertexBuffer->getTexCoord1Strider(tex_coords2, mGeomIndex, mGeomCount, true);
+				if (params.mNumVertices > 0)
+				{
+					params.genBumpTexCoords(&bump_tc[0], tex_coords2.get());
+				}
+				mVertexBuffer->setBuffer(0);
+			}
+			else
+			{
+				params.genTexCoords(tex_coords.get());
+				mVertexBuffer->setBuffer(0);
+			}
+		}
+	}
+
+	if (params.mRebuildPos)
+	{
+		mVertexBuffer->getVertexStrider(vert, mGeomIndex, mGeomCount, true);
+		params.genPositions((LLVector4a*) vert.get());
+		mVertexBuffer->setBuffer(0);
+	}
+
+	if (params.mRebuildNormal)
+	{
+		mVertexBuffer->getNormalStrider(norm, mGeomIndex, mGeomCount, true);
+		params.genNormals((LLVector4a*) norm.get());
+		mVertexBuffer->setBuffer(0);
+	}
+
+	if (params.mRebuildBinormal)
+	{
+		mVertexBuffer->getBinormalStrider(binorm, mGeomIndex, mGeomCount, true);
+		params.genBinormals((LLVector4a*) binorm.get());
+		mVertexBuffer->setBuffer(0);
+	}
+
+	if (params.mRebuildWeights)
+	{
+		mVertexBuffer->getWeight4Strider(wght, mGeomIndex, mGeomCount, true);
+		params.genWeights((LLVector4a*) wght.get());
+		mVertexBuffer->setBuffer(0);
+	}
+
+	if (params.mRebuildColor)
+	{
+		mVertexBuffer->getColorStrider(colors, mGeomIndex, mGeomCount, true);
+		params.genColors(colors.get());
+		mVertexBuffer->setBuffer(0);
+	}
+
+	return TRUE;
+}
+
+BOOL LLFace::getGeometryParams(const LLVolume& volume,
+							   const S32 &f,
+								const LLMatrix4& mat_vert_in, const LLMatrix3& mat_norm_in,
+								const U16 &index_offset,
+								GeometryParams& params,
+								bool force_rebuild)
+{
 	llassert(verify());
 	const LLVolumeFace &vf = volume.getVolumeFace(f);
 	S32 num_vertices = (S32)vf.mNumVertices;
 	S32 num_indices = (S32) vf.mNumIndices;
-	
+
 	if (mVertexBuffer.notNull())
 	{
 		if (num_indices + (S32) mIndicesIndex > mVertexBuffer->getNumIndices())
@@ -1087,21 +1193,16 @@ BOOL LLFace::getGeometryVolume(const LLVolume& volume,
 		}
 	}
 
-	LLStrider<LLVector3> vert;
-	LLVector4a* vertices = NULL;
-	LLStrider<LLVector2> tex_coords;
-	LLStrider<LLVector2> tex_coords2;
-	LLVector4a* normals = NULL;
-	LLStrider<LLVector3> norm;
-	LLStrider<LLColor4U> colors;
-	LLVector4a* binormals = NULL;
-	LLStrider<LLVector3> binorm;
-	LLStrider<U16> indicesp;
-	LLVector4a* weights = NULL;
-	LLStrider<LLVector4> wght;
+	params.mVolumeFace = &vf;
+	params.mNumVertices = num_vertices;
+	params.mNumIndices = num_indices;
+	params.mMatVert = mat_vert_in;
+	params.mMatNormal = mat_norm_in;
+	params.mIndexOffset = index_offset;
+	params.mTextureIndex = (F32) (mTextureIndex < 255 ? mTextureIndex : 0);
 
 	BOOL full_rebuild = force_rebuild || mDrawablep->isState(LLDrawable::REBUILD_VOLUME);
-	
+
 	BOOL global_volume = mDrawablep->getVOVolume()->isVolumeGlobal();
 	LLVector3 scale;
 	if (global_volume)
@@ -1112,43 +1213,41 @@ BOOL LLFace::getGeometryVolume(const LLVolume& volume,
 	{
 		scale = mVObjp->getScale();
 	}
-	
+
 	bool rebuild_pos = full_rebuild || mDrawablep->isState(LLDrawable::REBUILD_POSITION);
 	bool rebuild_color = full_rebuild || mDrawablep->isState(LLDrawable::REBUILD_COLOR);
 	bool rebuild_tcoord = full_rebuild || mDrawablep->isState(LLDrawable::REBUILD_TCOORD);
-	bool rebuild_normal = rebuild_pos && mVertexBuffer->hasDataType(LLVertexBuffer::TYPE_NORMAL);
-	bool rebuild_binormal = rebuild_pos && mVertexBuffer->hasDataType(LLVertexBuffer::TYPE_BINORMAL);
-	bool rebuild_weights = rebuild_pos && mVertexBuffer->hasDataType(LLVertexBuffer::TYPE_WEIGHT4);
+	params.mRebuildIndices = full_rebuild;
+	params.mRebuildPos = rebuild_pos;
+	params.mRebuildColor = rebuild_color;
+	params.mRebuildTCoord = rebuild_tcoord;
+	params.mRebuildNormal = rebuild_pos && mVertexBuffer->hasDataType(LLVertexBuffer::TYPE_NORMAL);
+	params.mRebuildBinormal = rebuild_pos && mVertexBuffer->hasDataType(LLVertexBuffer::TYPE_BINORMAL);
+	params.mRebuildWeights = rebuild_pos && mVertexBuffer->hasDataType(LLVertexBuffer::TYPE_WEIGHT4) && vf.mWeights;
+	params.mRebuildBump = false;
 
 	const LLTextureEntry *tep = mVObjp->getTE(f);
 	const U8 bump_code = tep ? tep->getBumpmap() : 0;
 
-	F32 tcoord_xoffset = 0.f ;
-	F32 tcoord_yoffset = 0.f ;
-	F32 tcoord_xscale = 1.f ;
-	F32 tcoord_yscale = 1.f ;
-	BOOL in_atlas = FALSE ;
+	params.mInAtlas = false;
+	params.mAtlasOffset.setVec(0.f, 0.f);
+	params.mAtlasScale.setVec(1.f, 1.f);
+	params.mAddressMode = LLTexUnit::TAM_WRAP;
 
 	if (rebuild_tcoord)
 	{
-		in_atlas = isAtlasInUse() ;
-		if(in_atlas)
+		if (isAtlasInUse())
 		{
-			const LLVector2* tmp = getTexCoordOffset() ;
-			tcoord_xoffset = tmp->mV[0] ; 
-			tcoord_yoffset = tmp->mV[1] ;
-
-			tmp = getTexCoordScale() ;
-			tcoord_xscale = tmp->mV[0] ; 
-			tcoord_yscale = tmp->mV[1] ;	
+			params.mInAtlas = true;
+			params.mAtlasOffset = *getTexCoordOffset();
+			params.mAtlasScale = *getTexCoordScale();
+			params.mAddressMode = mTexture->getAddressMode();
 		}
 	}
-	
+
 	BOOL is_static = mDrawablep->isStatic();
 	BOOL is_global = is_static;
 
-	LLVector3 center_sum(0.f, 0.f, 0.f);
-	
 	if (is_global)
 	{
 		setState(GLOBAL);
@@ -1171,52 +1270,21 @@ BOOL LLFace::getGeometryVolume(const LLVolume& volume,
 				0.5f,
 				0.75f
 			};
-			
+
 			if (getPoolType() != LLDrawPool::POOL_ALPHA && (LLPipeline::sRenderDeferred || (LLPipeline::sRenderBump && tep->getShiny())))
 			{
 				color.mV[3] = U8 (alpha[tep->getShiny()] * 255);
 			}
 		}
 	}
-
-	// INDICES
-	if (full_rebuild)
-	{
-		mVertexBuffer->getIndexStrider(indicesp, mIndicesIndex, mIndicesCount, true);
-
-		__m128i* dst = (__m128i*) indicesp.get();
-		__m128i* src = (__m128i*) vf.mIndices;
-		__m128i offset = _mm_set1_epi16(index_offset);
-
-		S32 end = num_indices/8;
-		
-		for (S32 i = 0; i < end; i++)
-		{
-			__m128i res = _mm_add_epi16(src[i], offset);
-			_mm_storeu_si128(dst+i, res);
-		}
-
-		for (S32 i = end*8; i < num_indices; ++i)
-		{
-			indicesp[i] = vf.mIndices[i]+index_offset;
-		}
-
-		mVertexBuffer->setBuffer(0);
-	}
-	
-	LLMatrix4a mat_normal;
-	mat_normal.loadu(mat_norm_in);
-	
-	//if it's not fullbright and has no normals, bake sunlight based on face normal
-	//bool bake_sunlight = !getTextureEntry()->getFullbright() &&
-	//  !mVertexBuffer->hasDataType(LLVertexBuffer::TYPE_NORMAL);
+	params.mColor = color;
 
 	F32 r = 0, os = 0, ot = 0, ms = 0, mt = 0, cos_ang = 0, sin_ang = 0;
+	bool do_xform = false;
+	U8 tex_mode = 0;
 
 	if (rebuild_tcoord)
 	{
-		bool do_xform;
-			
 		if (tep)
 		{
 			r  = tep->getRotation();
@@ -1227,7 +1295,7 @@ BOOL LLFace::getGeometryVolume(const LLVolume& volume,
 			cos_ang = cos(r);
 			sin_ang = sin(r);
 
-			if (cos_ang != 1.f || 
+			if (cos_ang != 1.f ||
 				sin_ang != 0.f ||
 				os != 0.f ||
 				ot != 0.f ||
@@ -1239,28 +1307,28 @@ BOOL LLFace::getGeometryVolume(const LLVolume& volume,
 			else
 			{
 				do_xform = false;
-			}	
+			}
 		}
 		else
 		{
 			do_xform = false;
 		}
-						
+
 		//bump setup
-		LLVector4a binormal_dir( -sin_ang, cos_ang, 0.f );
-		LLVector4a bump_s_primary_light_ray(0.f, 0.f, 0.f);
-		LLVector4a bump_t_primary_light_ray(0.f, 0.f, 0.f);
+		params.mBinormalDir.setVec(-sin_ang, cos_ang);
+		params.mBumpSRay.clearVec();
+		params.mBumpTRay.clearVec();
 
-		LLQuaternion bump_quat;
-		if (mDrawablep->isActive())
+		params.mBumpActive = mDrawablep->isActive();
+		if (params.mBumpActive)
 		{
-			bump_quat = LLQuaternion(mDrawablep->getRenderMatrix());
+			params.mBumpQuat = LLQuaternion(mDrawablep->getRenderMatrix());
 		}
-		
+
 		if (bump_code)
 		{
 			mVObjp->getVolume()->genBinormals(f);
-			F32 offset_multiple; 
+			F32 offset_multiple;
 			switch( bump_code )
 			{
 				case BE_NO_BUMP:
@@ -1295,14 +1363,14 @@ BOOL LLFace::getGeometryVolume(const LLVolume& volume,
 				tep->getScale( &s_scale, &t_scale );
 			}
 			// Use the nudged south when coming from above sun angle, such
-			// that emboss mapping always shows up on the upward faces of cubes when 
+			// that emboss mapping always shows up on the upward faces of cubes when
 			// it's noon (since a lot of builders build with the sun forced to noon).
 			LLVector3   sun_ray  = gSky.mVOSkyp->mBumpSunDir;
 			LLVector3   moon_ray = gSky.getMoonDirection();
 			LLVector3& primary_light_ray = (sun_ray.mV[VZ] > 0) ? sun_ray : moon_ray;
 
-			bump_s_primary_light_ray.load3((offset_multiple * s_scale * primary_light_ray).mV);
-			bump_t_primary_light_ray.load3((offset_multiple * t_scale * primary_light_ray).mV);
+			params.mBumpSRay = offset_multiple * s_scale * primary_light_ray;
+			params.mBumpTRay = offset_multiple * t_scale * primary_light_ray;
 		}
 
 		U8 texgen = getTextureEntry()->getTexGen();
@@ -1310,12 +1378,11 @@ BOOL LLFace::getGeometryVolume(const LLVolume& volume,
 		{ //planar texgen needs binormals
 			mVObjp->getVolume()->genBinormals(f);
 		}
+		params.mTexGen = texgen;
 
-		U8 tex_mode = 0;
-	
 		if (isState(TEXTURE_ANIM))
 		{
-			LLVOVolume* vobj = (LLVOVolume*) (LLViewerObject*) mVObjp;	
+			LLVOVolume* vobj = (LLVOVolume*) (LLViewerObject*) mVObjp;
 			tex_mode = vobj->mTexAnimMode;
 
 			if (!tex_mode)
@@ -1339,395 +1406,410 @@ BOOL LLFace::getGeometryVolume(const LLVolume& volume,
 			}
 		}
 
-		LLVector4a scalea;
-		scalea.load3(scale.mV);
+		params.mScale = scale;
+		params.mRebuildBump = bump_code && mVertexBuffer->hasDataType(LLVertexBuffer::TYPE_TEXCOORD1);
+		params.mDoTexMat = tex_mode && mTextureMatrix;
+		if (params.mDoTexMat)
+		{
+			params.mTextureMatrix = *mTextureMatrix;
+		}
+	}
 
-		bool do_bump = bump_code && mVertexBuffer->hasDataType(LLVertexBuffer::TYPE_TEXCOORD1);
-		bool do_tex_mat = tex_mode && mTextureMatrix;
+	params.mDoXform = do_xform;
+	params.mCosAng = cos_ang;
+	params.mSinAng = sin_ang;
+	params.mOffsetS = os;
+	params.mOffsetT = ot;
+	params.mScaleS = ms;
+	params.mScaleT = mt;
 
-		if (!in_atlas && !do_bump)
-		{ //not in atlas or not bump mapped, might be able to do a cheap update
-			mVertexBuffer->getTexCoord0Strider(tex_coords, mGeomIndex, mGeomCount);
+	if (rebuild_tcoord)
+	{
+		mTexExtents[0].setVec(0,0);
+		mTexExtents[1].setVec(1,1);
+		xform(mTexExtents[0], cos_ang, sin_ang, os, ot, ms, mt);
+		xform(mTexExtents[1], cos_ang, sin_ang, os, ot, ms, mt);
+
+		F32 es = vf.mTexCoordExtents[1].mV[0] - vf.mTexCoordExtents[0].mV[0] ;
+		F32 et = vf.mTexCoordExtents[1].mV[1] - vf.mTexCoordExtents[0].mV[1] ;
+		mTexExtents[0][0] *= es ;
+		mTexExtents[1][0] *= es ;
+		mTexExtents[0][1] *= et ;
+		mTexExtents[1][1] *= et ;
+	}
+
+	mLastVertexBuffer = mVertexBuffer;
+	mLastGeomCount = mGeomCount;
+	mLastGeomIndex = mGeomIndex;
+	mLastIndicesCount = mIndicesCount;
+	mLastIndicesIndex = mIndicesIndex;
+
+	return TRUE;
+}
+
+void LLFace::GeometryParams::genIndices(U16* dst_indices) const
+{
+	const LLVolumeFace& vf = *mVolumeFace;
 
-			if (texgen != LLTextureEntry::TEX_GEN_PLANAR)
+	__m128i* dst = (__m128i*) dst_indices;
+	__m128i* src = (__m128i*) vf.mIndices;
+	__m128i offset = _mm_set1_epi16(mIndexOffset);
+
+	S32 end = mNumIndices/8;
+
+	for (S32 i = 0; i < end; i++)
+	{
+		__m128i res = _mm_add_epi16(src[i], offset);
+		_mm_storeu_si128(dst+i, res);
+	}
+
+	for (S32 i = end*8; i < mNumIndices; ++i)
+	{
+		dst_indices[i] = vf.mIndices[i]+mIndexOffset;
+	}
+}
+
+void LLFace::GeometryParams::genTexCoords(LLVector2* tex_coords) const
+{
+	const LLVolumeFace& vf = *mVolumeFace;
+	S32 num_vertices = mNumVertices;
+	F32 cos_ang = mCosAng, sin_ang = mSinAng, os = mOffsetS, ot = mOffsetT, ms = mScaleS, mt = mScaleT;
+	U8 texgen = mTexGen;
+
+	LLVector4a scalea;
+	scalea.load3(mScale.mV);
+
+	if (!mInAtlas && !mRebuildBump)
+	{ //not in atlas or not bump mapped, might be able to do a cheap update
+		if (texgen != LLTextureEntry::TEX_GEN_PLANAR)
+		{
+			if (!mDoTexMat)
 			{
-				if (!do_tex_mat)
+				if (!mDoXform)
 				{
-					if (!do_xform)
-					{
-						LLVector4a::memcpyNonAliased16((F32*) tex_coords.get(), (F32*) vf.mTexCoords, num_vertices*2*sizeof(F32));
-					}
-					else
-					{
-						for (S32 i = 0; i < num_vertices; i++)
-						{	
-							LLVector2 tc(vf.mTexCoords[i]);
-							xform(tc, cos_ang, sin_ang, os, ot, ms, mt);
-							*tex_coords++ = tc;	
-						}
-					}
+					LLVector4a::memcpyNonAliased16((F32*) tex_coords, (F32*) vf.mTexCoords, num_vertices*2*sizeof(F32));
 				}
 				else
-				{ //do tex mat, no texgen, no atlas, no bump
+				{
 					for (S32 i = 0; i < num_vertices; i++)
-					{	
+					{
 						LLVector2 tc(vf.mTexCoords[i]);
-						//LLVector4a& norm = vf.mNormals[i];
-						//LLVector4a& center = *(vf.mCenter);
-
-						LLVector3 tmp(tc.mV[0], tc.mV[1], 0.f);
-						tmp = tmp * *mTextureMatrix;
-						tc.mV[0] = tmp.mV[0];
-						tc.mV[1] = tmp.mV[1];
-						*tex_coords++ = tc;	
+						xform(tc, cos_ang, sin_ang, os, ot, ms, mt);
+						*tex_coords++ = tc;
 					}
 				}
 			}
 			else
-			{ //no bump, no atlas, tex gen planar
-				if (do_tex_mat)
-				{
-					for (S32 i = 0; i < num_vertices; i++)
-					{	
-						LLVector2 tc(vf.mTexCoords[i]);
-						LLVector4a& norm = vf.mNormals[i];
-						LLVector4a& center = *(vf.mCenter);
-						LLVector4a vec = vf.mPositions[i];	
-						vec.mul(scalea);
-						planarProjection(tc, norm, center, vec);
-						
-						LLVector3 tmp(tc.mV[0], tc.mV[1], 0.f);
-						tmp = tmp * *mTextureMatrix;
-						tc.mV[0] = tmp.mV[0];
-						tc.mV[1] = tmp.mV[1];
-				
-						*tex_coords++ = tc;	
-					}
-				}
-				else
+			{ //do tex mat, no texgen, no atlas, no bump
+				for (S32 i = 0; i < num_vertices; i++)
 				{
-					for (S32 i = 0; i < num_vertices; i++)
-					{	
-						LLVector2 tc(vf.mTexCoords[i]);
-						LLVector4a& norm = vf.mNormals[i];
-						LLVector4a& center = *(vf.mCenter);
-						LLVector4a vec = vf.mPositions[i];	
-						vec.mul(scalea);
-						planarProjection(tc, norm, center, vec);
-						
-						xform(tc, cos_ang, sin_ang, os, ot, ms, mt);
+					LLVector2 tc(vf.mTexCoords[i]);
+					//LLVector4a& norm = vf.mNormals[i];
+					//LLVector4a& center = *(vf.mCenter);
 
-						*tex_coords++ = tc;	
-					}
+					LLVector3 tmp(tc.mV[0], tc.mV[1], 0.f);
+					tmp = tmp * mTextureMatrix;
+					tc.mV[0] = tmp.mV[0];
+					tc.mV[1] = tmp.mV[1];
+					*tex_coords++ = tc;
 				}
 			}
-
-			mVertexBuffer->setBuffer(0);
 		}
 		else
-		{ //either bump mapped or in atlas, just do the whole expensive loop
-			mVertexBuffer->getTexCoord0Strider(tex_coords, mGeomIndex, mGeomCount, true);
-
-			std::vector<LLVector2> bump_tc;
-		
-			for (S32 i = 0; i < num_vertices; i++)
-			{	
-				LLVector2 tc(vf.mTexCoords[i]);
-			
-				LLVector4a& norm = vf.mNormals[i];
-				
-				LLVector4a& center = *(vf.mCenter);
-		   
-				if (texgen != LLTextureEntry::TEX_GEN_DEFAULT)
+		{ //no bump, no atlas, tex gen planar
+			if (mDoTexMat)
+			{
+				for (S32 i = 0; i < num_vertices; i++)
 				{
+					LLVector2 tc(vf.mTexCoords[i]);
+					LLVector4a& norm = vf.mNormals[i];
+					LLVector4a& center = *(vf.mCenter);
 					LLVector4a vec = vf.mPositions[i];
-				
 					vec.mul(scalea);
+					planarProjection(tc, norm, center, vec);
 
-					switch (texgen)
-					{
-						case LLTextureEntry::TEX_GEN_PLANAR:
-							planarProjection(tc, norm, center, vec);
-							break;
-						case LLTextureEntry::TEX_GEN_SPHERICAL:
-							sphericalProjection(tc, norm, center, vec);
-							break;
-						case LLTextureEntry::TEX_GEN_CYLINDRICAL:
-							cylindricalProjection(tc, norm, center, vec);
-							break;
-						default:
-							break;
-					}		
-				}
-
-				if (tex_mode && mTextureMatrix)
-				{
 					LLVector3 tmp(tc.mV[0], tc.mV[1], 0.f);
-					tmp = tmp * *mTextureMatrix;
+					tmp = tmp * mTextureMatrix;
 					tc.mV[0] = tmp.mV[0];
 					tc.mV[1] = tmp.mV[1];
+
+					*tex_coords++ = tc;
 				}
-				else
+			}
+			else
+			{
+				for (S32 i = 0; i < num_vertices; i++)
 				{
+					LLVector2 tc(vf.mTexCoords[i]);
+					LLVector4a& norm = vf.mNormals[i];
+					LLVector4a& center = *(vf.mCenter);
+					LLVector4a vec = vf.mPositions[i];
+					vec.mul(scalea);
+					planarProjection(tc, norm, center, vec);
+
 					xform(tc, cos_ang, sin_ang, os, ot, ms, mt);
+
+					*tex_coords++ = tc;
 				}
+			}
+		}
+	}
+	else
+	{ //either bump mapped or in atlas, just do the whole expensive loop
+		for (S32 i = 0; i < num_vertices; i++)
+		{
+			LLVector2 tc(vf.mTexCoords[i]);
 
-				if(in_atlas)
-				{
-					//
-					//manually calculate tex-coord per vertex for varying address modes.
-					//should be removed if shader can handle this.
-					//
+			LLVector4a& norm = vf.mNormals[i];
 
-					S32 int_part = 0 ;
-					switch(mTexture->getAddressMode())
-					{
-					case LLTexUnit::TAM_CLAMP:
-						if(tc.mV[0] < 0.f)
-						{
-							tc.mV[0] = 0.f ;
-						}
-						else if(tc.mV[0] > 1.f)
-						{
-							tc.mV[0] = 1.f;
-						}
-
-						if(tc.mV[1] < 0.f)
-						{
-							tc.mV[1] = 0.f ;
-						}
-						else if(tc.mV[1] > 1.f)
-						{
-							tc.mV[1] = 1.f;
-						}
+			LLVector4a& center = *(vf.mCenter);
+
+			if (texgen != LLTextureEntry::TEX_GEN_DEFAULT)
+			{
+				LLVector4a vec = vf.mPositions[i];
+
+				vec.mul(scalea);
+
+				switch (texgen)
+				{
+					case LLTextureEntry::TEX_GEN_PLANAR:
+						planarProjection(tc, norm, center, vec);
 						break;
-					case LLTexUnit::TAM_MIRROR:
-						if(tc.mV[0] < 0.f)
-						{
-							tc.mV[0] = -tc.mV[0] ;
-						}
-						int_part = (S32)tc.mV[0] ;
-						if(int_part & 1) //odd number
-						{
-							tc.mV[0] = int_part + 1 - tc.mV[0] ;
-						}
-						else //even number
-						{
-							tc.mV[0] -= int_part ;
-						}
-
-						if(tc.mV[1] < 0.f)
-						{
-							tc.mV[1] = -tc.mV[1] ;
-						}
-						int_part = (S32)tc.mV[1] ;
-						if(int_part & 1) //odd number
-						{
-							tc.mV[1] = int_part + 1 - tc.mV[1] ;
-						}
-						else //even number
-						{
-							tc.mV[1] -= int_part ;
-						}
+					case LLTextureEntry::TEX_GEN_SPHERICAL:
+						sphericalProjection(tc, norm, center, vec);
 						break;
-					case LLTexUnit::TAM_WRAP:
-						if(tc.mV[0] > 1.f)
-							tc.mV[0] -= (S32)(tc.mV[0] - 0.00001f) ;
-						else if(tc.mV[0] < -1.f)
-							tc.mV[0] -= (S32)(tc.mV[0] + 0.00001f) ;
-
-						if(tc.mV[1] > 1.f)
-							tc.mV[1] -= (S32)(tc.mV[1] - 0.00001f) ;
-						else if(tc.mV[1] < -1.f)
-							tc.mV[1] -= (S32)(tc.mV[1] + 0.00001f) ;
-
-						if(tc.mV[0] < 0.f)
-						{
-							tc.mV[0] = 1.0f + tc.mV[0] ;
-						}
-						if(tc.mV[1] < 0.f)
-						{
-							tc.mV[1] = 1.0f + tc.mV[1] ;
-						}
+					case LLTextureEntry::TEX_GEN_CYLINDRICAL:
+						cylindricalProjection(tc, norm, center, vec);
 						break;
 					default:
 						break;
-					}
-				
-					tc.mV[0] = tcoord_xoffset + tcoord_xscale * tc.mV[0] ;
-					tc.mV[1] = tcoord_yoffset + tcoord_yscale * tc.mV[1] ;
-				}
-				
-
-				*tex_coords++ = tc;
-				if (do_bump)
-				{
-					bump_tc.push_back(tc);
 				}
 			}
 
-			mVertexBuffer->setBuffer(0);
-
+			if (mDoTexMat)
+			{
+				LLVector3 tmp(tc.mV[0], tc.mV[1], 0.f);
+				tmp = tmp * mTextureMatrix;
+				tc.mV[0] = tmp.mV[0];
+				tc.mV[1] = tmp.mV[1];
+			}
+			else
+			{
+				xform(tc, cos_ang, sin_ang, os, ot, ms, mt);
+			}
 
-			if (do_bump)
+			if(mInAtlas)
 			{
-				mVertexBuffer->getTexCoord1Strider(tex_coords2, mGeomIndex, mGeomCount, true);
-		
-				for (S32 i = 0; i < num_vertices; i++)
+				//
+				//manually calculate tex-coord per vertex for varying address modes.
+				//should be removed if shader can handle this.
+				//
+
+				S32 int_part = 0 ;
+				switch(mAddressMode)
 				{
-					LLVector4a tangent;
-					tangent.setCross3(vf.mBinormals[i], vf.mNormals[i]);
-
-					LLMatrix4a tangent_to_object;
-					tangent_to_object.setRows(tangent, vf.mBinormals[i], vf.mNormals[i]);
-					LLVector4a t;
-					tangent_to_object.rotate(binormal_dir, t);
-					LLVector4a binormal;
-					mat_normal.rotate(t, binormal);
-						
-					//VECTORIZE THIS
-					if (mDrawablep->isActive())
+				case LLTexUnit::TAM_CLAMP:
+					if(tc.mV[0] < 0.f)
+					{
+						tc.mV[0] = 0.f ;
+					}
+					else if(tc.mV[0] > 1.f)
 					{
-						LLVector3 t;
-						t.set(binormal.getF32ptr());
-						t *= bump_quat;
-						binormal.load3(t.mV);
+						tc.mV[0] = 1.f;
 					}
 
-					binormal.normalize3fast();
-					LLVector2 tc = bump_tc[i];
-					tc += LLVector2( bump_s_primary_light_ray.dot3(tangent).getF32(), bump_t_primary_light_ray.dot3(binormal).getF32() );
-					
-					*tex_coords2++ = tc;
+					if(tc.mV[1] < 0.f)
+					{
+						tc.mV[1] = 0.f ;
+					}
+					else if(tc.mV[1] > 1.f)
+					{
+						tc.mV[1] = 1.f;
+					}
+					break;
+				case LLTexUnit::TAM_MIRROR:
+					if(tc.mV[0] < 0.f)
+					{
+						tc.mV[0] = -tc.mV[0] ;
+					}
+					int_part = (S32)tc.mV[0] ;
+					if(int_part & 1) //odd number
+					{
+						tc.mV[0] = int_part + 1 - tc.mV[0] ;
+					}
+					else //even number
+					{
+						tc.mV[0] -= int_part ;
+					}
+
+					if(tc.mV[1] < 0.f)
+					{
+						tc.mV[1] = -tc.mV[1] ;
+					}
+					int_part = (S32)tc.mV[1] ;
+					if(int_part & 1) //odd number
+					{
+						tc.mV[1] = int_part + 1 - tc.mV[1] ;
+					}
+					else //even number
+					{
+						tc.mV[1] -= int_part ;
+					}
+					break;
+				case LLTexUnit::TAM_WRAP:
+					if(tc.mV[0] > 1.f)
+						tc.mV[0] -= (S32)(tc.mV[0] - 0.00001f) ;
+					else if(tc.mV[0] < -1.f)
+						tc.mV[0] -= (S32)(tc.mV[0] + 0.00001f) ;
+
+					if(tc.mV[1] > 1.f)
+						tc.mV[1] -= (S32)(tc.mV[1] - 0.00001f) ;
+					else if(tc.mV[1] < -1.f)
+						tc.mV[1] -= (S32)(tc.mV[1] + 0.00001f) ;
+
+					if(tc.mV[0] < 0.f)
+					{
+						tc.mV[0] = 1.0f + tc.mV[0] ;
+					}
+					if(tc.mV[1] < 0.f)
+					{
+						tc.mV[1] = 1.0f + tc.mV[1] ;
+					}
+					break;
+				default:
+					break;
 				}
 
-				mVertexBuffer->setBuffer(0);
+				tc.mV[0] = mAtlasOffset.mV[0] + mAtlasScale.mV[0] * tc.mV[0] ;
+				tc.mV[1] = mAtlasOffset.mV[1] + mAtlasScale.mV[1] * tc.mV[1] ;
 			}
+
+			*tex_coords++ = tc;
 		}
 	}
+}
 
-	if (rebuild_pos)
-	{
-		mVertexBuffer->getVertexStrider(vert, mGeomIndex, mGeomCount, true);
-		vertices = (LLVector4a*) vert.get();
-	
-		LLMatrix4a mat_vert;
-		mat_vert.loadu(mat_vert_in);
+void LLFace::GeometryParams::genBumpTexCoords(const LLVector2* tex_coords, LLVector2* tex_coords2) const
+{
+	const LLVolumeFace& vf = *mVolumeFace;
 
-		LLVector4a* src = vf.mPositions;
-		LLVector4a* dst = vertices;
+	LLMatrix4a mat_normal;
+	mat_normal.loadu(mMatNormal);
 
-		LLVector4a* end = dst+num_vertices;
-		do
-		{	
-			mat_vert.affineTransform(*src++, *dst++);
-		}
-		while(dst < end);
+	LLVector4a binormal_dir( mBinormalDir.mV[0], mBinormalDir.mV[1], 0.f );
+	LLVector4a bump_s_primary_light_ray;
+	LLVector4a bump_t_primary_light_ray;
+	bump_s_primary_light_ray.load3(mBumpSRay.mV);
+	bump_t_primary_light_ray.load3(mBumpTRay.mV);
 
-		F32 index = (F32) (mTextureIndex < 255 ? mTextureIndex : 0);
-		F32 *index_dst = (F32*) vertices;
-		F32 *index_end = (F32*) end;
+	for (S32 i = 0; i < mNumVertices; i++)
+	{
+		LLVector4a tangent;
+		tangent.setCross3(vf.mBinormals[i], vf.mNormals[i]);
+
+		LLMatrix4a tangent_to_object;
+		tangent_to_object.setRows(tangent, vf.mBinormals[i], vf.mNormals[i]);
+		LLVector4a t;
+		tangent_to_object.rotate(binormal_dir, t);
+		LLVector4a binormal;
+		mat_normal.rotate(t, binormal);
 
-		index_dst += 3;
-		index_end += 3;
-		do
+		//VECTORIZE THIS
+		if (mBumpActive)
 		{
-			*index_dst = index;
-			index_dst += 4;
+			LLVector3 t;
+			t.set(binormal.getF32ptr());
+			t *= mBumpQuat;
+			binormal.load3(t.mV);
 		}
-		while (index_dst < index_end);
 
-		mVertexBuffer->setBuffer(0);
-	}
-		
-	if (rebuild_normal)
-	{
-		mVertexBuffer->getNormalStrider(norm, mGeomIndex, mGeomCount, true);
-		normals = (LLVector4a*) norm.get();
-	
-		for (S32 i = 0; i < num_vertices; i++)
-		{	
-			LLVector4a normal;
-			mat_normal.rotate(vf.mNormals[i], normal);
-			normal.normalize3fast();
-			normals[i] = normal;
-		}
+		binormal.normalize3fast();
+		LLVector2 tc = tex_coords[i];
+		tc += LLVector2( bump_s_primary_light_ray.dot3(tangent).getF32(), bump_t_primary_light_ray.dot3(binormal).getF32() );
 
-		mVertexBuffer->setBuffer(0);
+		*tex_coords2++ = tc;
 	}
-		
-	if (rebuild_binormal)
+}
+
+void LLFace::GeometryParams::genPositions(LLVector4a* vertices) const
+{
+	LLMatrix4a mat_vert;
+	mat_vert.loadu(mMatVert);
+
+	LLVector4a* src = mVolumeFace->mPositions;
+	LLVector4a* dst = vertices;
+
+	LLVector4a* end = dst+mNumVertices;
+	while (dst < end)
 	{
-		mVertexBuffer->getBinormalStrider(binorm, mGeomIndex, mGeomCount, true);
-		binormals = (LLVector4a*) binorm.get();
-		
-		for (S32 i = 0; i < num_vertices; i++)
-		{	
-			LLVector4a binormal;
-			mat_normal.rotate(vf.mBinormals[i], binormal);
-			binormal.normalize3fast();
-			binormals[i] = binormal;
-		}
+		mat_vert.affineTransform(*src++, *dst++);
+	}
 
-		mVertexBuffer->setBuffer(0);
+	F32 *index_dst = (F32*) vertices;
+	F32 *index_end = (F32*) end;
+
+	index_dst += 3;
+	index_end += 3;
+	while (index_dst < index_end)
+	{
+		*index_dst = mTextureIndex;
+		index_dst += 4;
 	}
-	
-	if (rebuild_weights && vf.mWeights)
+}
+
+void LLFace::GeometryParams::genNormals(LLVector4a* normals) const
+{
+	LLMatrix4a mat_normal;
+	mat_normal.loadu(mMatNormal);
+
+	for (S32 i = 0; i < mNumVertices; i++)
 	{
-		mVertexBuffer->getWeight4Strider(wght, mGeomIndex, mGeomCount, true);
-		weights = (LLVector4a*) wght.get();
-		LLVector4a::memcpyNonAliased16((F32*) weights, (F32*) vf.mWeights, num_vertices*4*sizeof(F32));
-		mVertexBuffer->setBuffer(0);
+		LLVector4a normal;
+		mat_normal.rotate(mVolumeFace->mNormals[i], normal);
+		normal.normalize3fast();
+		normals[i] = normal;
 	}
+}
 
-	if (rebuild_color)
+void LLFace::GeometryParams::genBinormals(LLVector4a* binormals) const
+{
+	LLMatrix4a mat_normal;
+	mat_normal.loadu(mMatNormal);
+
+	for (S32 i = 0; i < mNumVertices; i++)
 	{
-		mVertexBuffer->getColorStrider(colors, mGeomIndex, mGeomCount, true);
+		LLVector4a binormal;
+		mat_normal.rotate(mVolumeFace->mBinormals[i], binormal);
+		binormal.normalize3fast();
+		binormals[i] = binormal;
+	}
+}
 
-		LLVector4a src;
+void LLFace::GeometryParams::genWeights(LLVector4a* weights) const
+{
+	LLVector4a::memcpyNonAliased16((F32*) weights, (F32*) mVolumeFace->mWeights, mNumVertices*4*sizeof(F32));
+}
 
-		U32 vec[4];
-		vec[0] = vec[1] = vec[2] = vec[3] = color.mAll;
-		
-		src.loadua((F32*) vec);
+void LLFace::GeometryParams::genColors(LLColor4U* colors) const
+{
+	LLVector4a src;
 
-		LLVector4a* dst = (LLVector4a*) colors.get();
-		S32 num_vecs = num_vertices/4;
-		if (num_vertices%4 > 0)
-		{
-			++num_vecs;
-		}
+	U32 vec[4];
+	vec[0] = vec[1] = vec[2] = vec[3] = mColor.mAll;
 
-		for (S32 i = 0; i < num_vecs; i++)
-		{	
-			dst[i] = src;
-		}
+	src.loadua((F32*) vec);
 
-		mVertexBuffer->setBuffer(0);
+	LLVector4a* dst = (LLVector4a*) colors;
+	S32 num_vecs = mNumVertices/4;
+	if (mNumVertices%4 > 0)
+	{
+		++num_vecs;
 	}
 
-	if (rebuild_tcoord)
+	for (S32 i = 0; i < num_vecs; i++)
 	{
-		mTexExtents[0].setVec(0,0);
-		mTexExtents[1].setVec(1,1);
-		xform(mTexExtents[0], cos_ang, sin_ang, os, ot, ms, mt);
-		xform(mTexExtents[1], cos_ang, sin_ang, os, ot, ms, mt);
-		
-		F32 es = vf.mTexCoordExtents[1].mV[0] - vf.mTexCoordExtents[0].mV[0] ;
-		F32 et = vf.mTexCoordExtents[1].mV[1] - vf.mTexCoordExtents[0].mV[1] ;
-		mTexExtents[0][0] *= es ;
-		mTexExtents[1][0] *= es ;
-		mTexExtents[0][1] *= et ;
-		mTexExtents[1][1] *= et ;
+		dst[i] = src;
 	}
-
-	mLastVertexBuffer = mVertexBuffer;
-	mLastGeomCount = mGeomCount;
-	mLastGeomIndex = mGeomIndex;
-	mLastIndicesCount = mIndicesCount;
-	mLastIndicesIndex = mIndicesIndex;
-
-	return TRUE;
 }
 
 //check if the face has a media
@@ -33,6 +33,7 @@
 #include "v2math.h"
 #include "v3math.h"
 #include "v4math.h"
+#include "m3math.h"
 #include "m4math.h"
 #include "v4coloru.h"
 #include "llquaternion.h"
@@ -45,6 +46,7 @@
 
 class LLFacePool;
 class LLVolume;
+class LLVolumeFace;
 class LLViewerTexture;
 class LLTextureEntry;
 class LLVertexProgram;
@@ -150,6 +152,61 @@ public:
 	const LLColor4&	getFaceColor() const { return mFaceColor; } 
 	const LLColor4& getRenderColor() const;
 
+	// Everything getGeometryVolume() reads to generate the vertex data of a
+	// face besides the volume face itself. The gen methods only read these
+	// and the volume face, so they can run off the main thread.
+	class GeometryParams
+	{
+	public:
+		void genIndices(U16* dst) const;
+		void genTexCoords(LLVector2* dst) const;
+		void genBumpTexCoords(const LLVector2* tex_coords, LLVector2* dst) const;
+		void genPositions(LLVector4a* dst) const;
+		void genNormals(LLVector4a* dst) const;
+		void genBinormals(LLVector4a* dst) const;
+		void genWeights(LLVector4a* dst) const;
+		void genColors(LLColor4U* dst) const;
+
+		const LLVolumeFace* mVolumeFace;
+		S32 mNumVertices;
+		S32 mNumIndices;
+
+		// attributes to write
+		bool mRebuildIndices;
+		bool mRebuildTCoord;
+		bool mRebuildBump; // texture coordinates 1, with mRebuildTCoord
+		bool mRebuildPos;
+		bool mRebuildNormal;
+		bool mRebuildBinormal;
+		bool mRebuildWeights;
+		bool mRebuildColor;
+
+		LLMatrix4 mMatVert;
+		LLMatrix3 mMatNormal;
+		U16 mIndexOffset;
+		F32 mTextureIndex;
+		LLColor4U mColor;
+
+		// texture coordinates
+		U8 mTexGen;
+		bool mDoXform;
+		bool mDoTexMat;
+		LLMatrix4 mTextureMatrix;
+		F32 mCosAng, mSinAng, mOffsetS, mOffsetT, mScaleS, mScaleT;
+		LLVector3 mScale;
+		bool mInAtlas;
+		LLTexUnit::eTextureAddressMode mAddressMode;
+		LLVector2 mAtlasOffset;
+		LLVector2 mAtlasScale;
+
+		// bump map texture coordinates
+		LLVector2 mBinormalDir;
+		LLVector3 mBumpSRay;
+		LLVector3 mBumpTRay;
+		bool mBumpActive;
+		LLQuaternion mBumpQuat;
+	};
+
 	//for volumes
 	void updateRebuildFlags();
 	bool canRenderAsMask(); // logic helper
@@ -158,6 +215,15 @@ public:
 						const LLMatrix4& mat_vert, const LLMatrix3& mat_normal,
 						const U16 &index_offset,
 						bool force_rebuild = false);
+	// First half of getGeometryVolume(), fills in params and updates the face
+	// as if its geometry had been written. FALSE if it does not fit in the
+	// vertex buffer.
+	BOOL getGeometryParams(const LLVolume& volume,
+						const S32 &f,
+						const LLMatrix4& mat_vert, const LLMatrix3& mat_normal,
+						const U16 &index_offset,
+						GeometryParams& params,
+						bool force_rebuild = false);
 
 	// For avatar
 	U16			 getGeometryAvatar(
@@ -0,0 +1,242 @@
+/**
+ * @file llmeshheaderindex.cpp
+ * @brief On-disk index of mesh asset headers.
+ *
+ * $LicenseInfo:firstyear=2012&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2012, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "llviewerprecompiledheaders.h"
+
+#include "llmeshheaderindex.h"
+
+#include "llapr.h"
+#include "llsd.h"
+
+// File layout: IndexHeader, then mCount IndexRecords, in host byte order.
+static const char INDEX_MAGIC[4] = { 'M', 'H', 'I', 'X' };
+static const U32 INDEX_VERSION = 2;
+// Entries kept on save, about 88 bytes each
+static const U32 MAX_INDEX_ENTRIES = 65536;
+
+static const char* const section_name[LLMeshHeaderIndex::NUM_SECTIONS] =
+{
+	"lowest_lod",
+	"low_lod",
+	"medium_lod",
+	"high_lod",
+	"skin",
+	"physics_convex",
+	"physics_mesh"
+};
+
+struct IndexHeader
+{
+	char mMagic[4];
+	U32 mVersion;
+	U32 mCount;
+	U32 mSession;
+};
+
+LLMeshHeaderIndex::LLMeshHeaderIndex()
+:	mMutex(NULL),
+	mSession(1),
+	mDirty(false)
+{
+}
+
+LLMeshHeaderIndex::~LLMeshHeaderIndex()
+{
+}
+
+bool LLMeshHeaderIndex::load(const std::string& filename)
+{
+	LLMutexLock lock(&mMutex);
+	mFilename = filename;
+	mEntries.clear();
+	mSession = 1;
+	mDirty = false;
+
+	S32 file_size = LLAPRFile::size(filename);
+	if (file_size < (S32) sizeof(IndexHeader))
+	{
+		return false;
+	}
+
+	std::vector<U8> buffer(file_size);
+	if (LLAPRFile::readEx(filename, &buffer[0], 0, file_size) != file_size)
+	{
+		llwarns << "Could not read mesh header index " << filename << llendl;
+		return false;
+	}
+
+	IndexHeader header;
+	memcpy(&header, &buffer[0], sizeof(IndexHeader));
+	const size_t record_size = sizeof(LLUUID) + sizeof(Entry);
+	if (memcmp(header.mMagic, INDEX_MAGIC, sizeof(INDEX_MAGIC))
+		|| header.mVersion != INDEX_VERSION
+		|| sizeof(IndexHeader) + header.mCount * record_size != (size_t) file_size)
+	{
+		llwarns << "Discarding invalid mesh header index " << filename << llendl;
+		return false;
+	}
+
+	mSession = header.mSession + 1;
+	mEntries.rehash(header.mCount);
+	const U8* data = &buffer[sizeof(IndexHeader)];
+	for (U32 i = 0; i < header.mCount; ++i, data += record_size)
+	{
+		LLUUID mesh_id;
+		memcpy(mesh_id.mData, data, sizeof(LLUUID));
+		memcpy(&mEntries[mesh_id], data + sizeof(LLUUID), sizeof(Entry));
+	}
+
+	llinfos << "Loaded " << mEntries.size() << " mesh headers from " << filename << llendl;
+	return true;
+}
+
+static bool last_used_greater(const std::pair<U32, LLUUID>& lhs, const std::pair<U32, LLUUID>& rhs)
+{
+	return lhs.first > rhs.first;
+}
+
+bool LLMeshHeaderIndex::save()
+{
+	LLMutexLock lock(&mMutex);
+	if (!mDirty || mFilename.empty())
+	{
+		return true;
+	}
+
+	// Most recently used entries first, so the oldest ones are dropped
+	// when the index is full
+	std::vector<std::pair<U32, LLUUID> > order;
+	order.reserve(mEntries.size());
+	for (entry_map_t::const_iterator iter = mEntries.begin(); iter != mEntries.end(); ++iter)
+	{
+		order.push_back(std::make_pair(iter->second.mLastUsed, iter->first));
+	}
+	if (order.size() > MAX_INDEX_ENTRIES)
+	{
+		std::sort(order.begin(), order.end(), last_used_greater);
+		order.resize(MAX_INDEX_ENTRIES);
+	}
+
+	const size_t record_size = sizeof(LLUUID) + sizeof(Entry);
+	std::vector<U8> buffer(sizeof(IndexHeader) + order.size() * record_size);
+
+	IndexHeader header;
+	memcpy(header.mMagic, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+	header.mVersion = INDEX_VERSION;
+	header.mCount = order.size();
+	header.mSession = mSession;
+	memcpy(&buffer[0], &header, sizeof(IndexHeader));
+
+	U8* data = &buffer[sizeof(IndexHeader)];
+	for (size_t i = 0; i < order.size(); ++i, data += record_size)
+	{
+		const LLUUID& mesh_id = order[i].second;
+		memcpy(data, mesh_id.mData, sizeof(LLUUID));
+		memcpy(data + sizeof(LLUUID), &mEntries[mesh_id], sizeof(Entry));
+	}
+
+	// Write a temporary file and swap it in, so that a crash leaves either
+	// the old index or the new one
+	std::string tmp_filename = mFilename + ".tmp";
+	S32 size = (S32) buffer.size();
+	if (LLAPRFile::writeEx(tmp_filename, &buffer[0], 0, size) != size)
+	{
+		llwarns << "Could not write mesh header index " << tmp_filename << llendl;
+		LLAPRFile::remove(tmp_filename);
+		return false;
+	}
+	LLAPRFile::remove(mFilename);
+	if (!LLAPRFile::rename(tmp_filename, mFilename))
+	{
+		llwarns << "Could not write mesh header index " << mFilename << llendl;
+		return false;
+	}
+
+	mDirty = false;
+	return true;
+}
+
+void LLMeshHeaderIndex::update(const LLUUID& mesh_id, const LLSD& header, U32 header_size, U32 cost)
+{
+	Entry entry;
+	memset(&entry, 0, sizeof(Entry));
+	entry.mHeaderSize = header_size;
+	entry.mResourceCost = cost;
+	entry.mVersion = header.has("version") ? header["version"].asInteger() : -1;
+	for (S32 i = 0; i < NUM_SECTIONS; ++i)
+	{
+		if (header.has(section_name[i]))
+		{
+			entry.mOffset[i] = header[section_name[i]]["offset"].asInteger();
+			entry.mSize[i] = header[section_name[i]]["size"].asInteger();
+		}
+	}
+
+	LLMutexLock lock(&mMutex);
+	entry.mLastUsed = mSession;
+	mEntries[mesh_id] = entry;
+	mDirty = true;
+}
+
+bool LLMeshHeaderIndex::find(const LLUUID& mesh_id, LLSD& header, U32& header_size, U32& cost)
+{
+	LLMutexLock lock(&mMutex);
+	entry_map_t::iterator iter = mEntries.find(mesh_id);
+	if (iter == mEntries.end())
+	{
+		return false;
+	}
+
+	Entry& entry = iter->second;
+	if (entry.mLastUsed != mSession)
+	{
+		entry.mLastUsed = mSession;
+		mDirty = true;
+	}
+
+	header = LLSD::emptyMap();
+	if (entry.mVersion >= 0)
+	{
+		header["version"] = entry.mVersion;
+	}
+	for (S32 i = 0; i < NUM_SECTIONS; ++i)
+	{
+		if (entry.mSize[i] > 0)
+		{
+			header[section_name[i]]["offset"] = entry.mOffset[i];
+			header[section_name[i]]["size"] = entry.mSize[i];
+		}
+	}
+	header_size = entry.mHeaderSize;
+	cost = entry.mResourceCost;
+	return true;
+}
+
+S32 LLMeshHeaderIndex::getCount()
+{
+	LLMutexLock lock(&mMutex);
+	return (S32) mEntries.size();
+}
@@ -0,0 +1,102 @@
+/**
+ * @file llmeshheaderindex.h
+ * @brief On-disk index of mesh asset headers.
+ *
+ * $LicenseInfo:firstyear=2012&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2012, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLMESHHEADERINDEX_H
+#define LL_LLMESHHEADERINDEX_H
+
+#include <boost/unordered_map.hpp>
+
+#include "lluuid.h"
+#include "llthread.h"
+
+class LLSD;
+
+// Compact index of the mesh headers seen in earlier sessions, so that a
+// mesh whose header is indexed can have its LODs requested (and its
+// streaming cost computed) without first reading the header from the VFS
+// or fetching it over HTTP. Mesh assets never change, so entries never
+// go stale.
+// Each entry keeps the offset and size of the sections of the asset, the
+// header version, the size of the header and the resource cost. The whole index is loaded at
+// startup and written back on exit, keeping the most recently used entries.
+//
+// All methods are thread safe.
+class LLMeshHeaderIndex
+{
+public:
+	// Asset sections, in the order of the header_lod names for the LODs.
+	enum ESection
+	{
+		SECTION_LOWEST_LOD = 0,
+		SECTION_LOW_LOD,
+		SECTION_MEDIUM_LOD,
+		SECTION_HIGH_LOD,
+		SECTION_SKIN,
+		SECTION_PHYSICS_CONVEX,
+		SECTION_PHYSICS_MESH,
+		NUM_SECTIONS
+	};
+
+	LLMeshHeaderIndex();
+	~LLMeshHeaderIndex();
+
+	bool load(const std::string& filename);
+	// Writes the index back to the file it was loaded from if it changed.
+	bool save();
+
+	// Records the parsed header of mesh_id.
+	void update(const LLUUID& mesh_id, const LLSD& header, U32 header_size, U32 cost);
+	// Rebuilds the header of mesh_id from its entry, false if it is not indexed.
+	bool find(const LLUUID& mesh_id, LLSD& header, U32& header_size, U32& cost);
+
+	S32 getCount();
+
+private:
+	struct Entry
+	{
+		U32 mHeaderSize;
+		U32 mResourceCost;
+		U32 mLastUsed; // session the entry was last used in
+		S32 mVersion; // "version" of the header, -1 if it has none
+		S32 mOffset[NUM_SECTIONS];
+		S32 mSize[NUM_SECTIONS];
+	};
+
+	struct uuid_hash
+	{
+		size_t operator()(const LLUUID& id) const { return id.getCRC32(); }
+	};
+	typedef boost::unordered_map<LLUUID, Entry, uuid_hash> entry_map_t;
+
+private:
+	LLMutex mMutex; // protects everything below
+	std::string mFilename;
+	entry_map_t mEntries;
+	U32 mSession;
+	bool mDirty;
+};
+
+#endif // LL_LLMESHHEADERINDEX_H
@@ -78,6 +78,16 @@ LLMeshRepository gMeshRepo;
 
 const U32 MAX_MESH_REQUESTS_PER_SECOND = 100;
 
+// Byte ranges of the same mesh asset requested within MESH_RANGE_WINDOW
+// seconds of each other are fetched with a single GET when they are at
+// most MESH_RANGE_MAX_GAP bytes apart, up to MESH_RANGE_MAX_BYTES per GET
+const F32 MESH_RANGE_WINDOW = 0.03f;
+const S32 MESH_RANGE_MAX_GAP = 8192;
+const S32 MESH_RANGE_MAX_BYTES = 1024*1024;
+
+// In the cache directory, so that clearing the cache also clears the index
+const char* MESH_HEADER_INDEX_FILENAME = "mesh_headers.idx";
+
 U32 LLMeshRepository::sBytesReceived = 0;
 U32 LLMeshRepository::sHTTPRequestCount = 0;
 U32 LLMeshRepository::sHTTPRetryCount = 0;
@@ -396,70 +406,18 @@ public:
 
 };
 
-class LLMeshLODResponder : public LLCurl::Responder
-{
-public:
-	LLVolumeParams mMeshParams;
-	S32 mLOD;
-	U32 mRequestedBytes;
-	U32 mOffset;
-
-	LLMeshLODResponder(const LLVolumeParams& mesh_params, S32 lod, U32 offset, U32 requested_bytes)
-		: mMeshParams(mesh_params), mLOD(lod), mOffset(offset), mRequestedBytes(requested_bytes)
-	{
-	}
-
-	virtual void completedRaw(U32 status, const std::string& reason,
-							  const LLChannelDescriptors& channels,
-							  const LLIOPipe::buffer_ptr_t& buffer);
-
-};
-
-class LLMeshSkinInfoResponder : public LLCurl::Responder
-{
-public:
-	LLUUID mMeshID;
-	U32 mRequestedBytes;
-	U32 mOffset;
-
-	LLMeshSkinInfoResponder(const LLUUID& id, U32 offset, U32 size)
-		: mMeshID(id), mRequestedBytes(size), mOffset(offset)
-	{
-	}
-
-	virtual void completedRaw(U32 status, const std::string& reason,
-							  const LLChannelDescriptors& channels,
-							  const LLIOPipe::buffer_ptr_t& buffer);
-
-};
-
-class LLMeshDecompositionResponder : public LLCurl::Responder
-{
-public:
-	LLUUID mMeshID;
-	U32 mRequestedBytes;
-	U32 mOffset;
-
-	LLMeshDecompositionResponder(const LLUUID& id, U32 offset, U32 size)
-		: mMeshID(id), mRequestedBytes(size), mOffset(offset)
-	{
-	}
-
-	virtual void completedRaw(U32 status, const std::string& reason,
-							  const LLChannelDescriptors& channels,
-							  const LLIOPipe::buffer_ptr_t& buffer);
-
-};
-
-class LLMeshPhysicsShapeResponder : public LLCurl::Responder
+// Fetches a byte range of a mesh asset covering one or more coalesced
+// RangeRequests, and hands each of them its slice of the response.
+class LLMeshRangeResponder : public LLCurl::Responder
 {
 public:
 	LLUUID mMeshID;
+	std::vector<LLMeshRepoThread::RangeRequest> mRanges;
 	U32 mRequestedBytes;
 	U32 mOffset;
 
-	LLMeshPhysicsShapeResponder(const LLUUID& id, U32 offset, U32 size)
-		: mMeshID(id), mRequestedBytes(size), mOffset(offset)
+	LLMeshRangeResponder(const LLUUID& id, const std::vector<LLMeshRepoThread::RangeRequest>& ranges, U32 offset, U32 size)
+		: mMeshID(id), mRanges(ranges), mRequestedBytes(size), mOffset(offset)
 	{
 	}
 
@@ -624,6 +582,187 @@ public:
 	}
 };
 
+LLMeshDecodePool::DecodeRequest::DecodeRequest(EDecodeType type, const LLVolumeParams& mesh_params, S32 lod,
+												U8* data, S32 data_size, S32 offset, S32 size)
+: mType(type),
+  mMeshParams(mesh_params),
+  mMeshID(mesh_params.getSculptID()),
+  mLOD(lod),
+  mData(data),
+  mDataSize(data_size),
+  mOffset(offset),
+  mSize(size)
+{
+}
+
+LLMeshDecodePool::DecodeRequest::DecodeRequest(EDecodeType type, const LLUUID& mesh_id,
+												U8* data, S32 data_size, S32 offset, S32 size)
+: mType(type),
+  mMeshID(mesh_id),
+  mLOD(0),
+  mData(data),
+  mDataSize(data_size),
+  mOffset(offset),
+  mSize(size)
+{
+}
+
+LLMeshDecodePool::DecodeRequest::~DecodeRequest()
+{
+	delete [] mData;
+}
+
+LLMeshDecodePool::LLMeshDecodePool(LLMeshRepoThread* thread, U32 num_threads)
+: mThread(thread),
+  mQueueMutex(NULL),
+  mQueued(0)
+{
+	for (U32 i = 0; i < num_threads; ++i)
+	{
+		mWorkers.push_back(new Worker(this, i));
+	}
+	for (U32 i = 0; i < mWorkers.size(); ++i)
+	{
+		mWorkers[i]->start();
+	}
+}
+
+LLMeshDecodePool::~LLMeshDecodePool()
+{
+	shutdown();
+	for_each(mWorkers.begin(), mWorkers.end(), DeletePointer());
+	mWorkers.clear();
+}
+
+void LLMeshDecodePool::shutdown()
+{
+	for (U32 i = 0; i < mWorkers.size(); ++i)
+	{
+		mWorkers[i]->shutdown();
+	}
+
+	LLMutexLock lock(&mQueueMutex);
+	while (!mQueue.empty())
+	{
+		delete mQueue.front();
+		mQueue.pop();
+	}
+	mQueued = 0;
+}
+
+void LLMeshDecodePool::decode(DecodeRequest* req)
+{
+	if (mWorkers.empty())
+	{
+		processRequest(req);
+		return;
+	}
+
+	{
+		LLMutexLock lock(&mQueueMutex);
+		mQueue.push(req);
+		mQueued++;
+	}
+
+	//wake all the workers, idle ones race for the request and busy ones
+	//pick it up when they are done
+	for (U32 i = 0; i < mWorkers.size(); ++i)
+	{
+		mWorkers[i]->wake();
+	}
+}
+
+LLMeshDecodePool::DecodeRequest* LLMeshDecodePool::popRequest()
+{
+	LLMutexLock lock(&mQueueMutex);
+	if (mQueue.empty())
+	{
+		return NULL;
+	}
+	DecodeRequest* req = mQueue.front();
+	mQueue.pop();
+	mQueued--;
+	return req;
+}
+
+void LLMeshDecodePool::processRequest(DecodeRequest* req)
+{
+	bool success = false;
+
+	switch (req->mType)
+	{
+	case DECODE_LOD:
+		success = mThread->lodReceived(req->mMeshParams, req->mLOD, req->mData, req->mDataSize);
+		break;
+	case DECODE_SKIN_INFO:
+		success = mThread->skinInfoReceived(req->mMeshID, req->mData, req->mDataSize);
+		break;
+	case DECODE_DECOMPOSITION:
+		success = mThread->decompositionReceived(req->mMeshID, req->mData, req->mDataSize);
+		break;
+	case DECODE_PHYSICS_SHAPE:
+		success = mThread->physicsShapeReceived(req->mMeshID, req->mData, req->mDataSize);
+		break;
+	}
+
+	if (req->isFromCache())
+	{
+		if (!success)
+		{ //reading from VFS failed for whatever reason, fetch from sim
+			delete [] req->mData;
+			req->mData = NULL;
+			req->mDataSize = 0;
+			mThread->decodeFailed(req);
+			req = NULL;
+		}
+	}
+	else if (success)
+	{ //good fetch from sim, write to VFS for caching
+		LLVFile file(gVFS, req->mMeshID, LLAssetType::AT_MESH, LLVFile::WRITE);
+
+		if (file.getSize() >= req->mOffset+req->mSize)
+		{
+			file.seek(req->mOffset);
+			file.write(req->mData, req->mSize);
+			LLMeshRepository::sCacheBytesWritten += req->mSize;
+		}
+	}
+
+	delete req;
+}
+
+LLMeshDecodePool::Worker::Worker(LLMeshDecodePool* owner, S32 index)
+: LLThread(llformat("mesh decode %d", index)),
+  mOwner(owner)
+{
+}
+
+//virtual
+bool LLMeshDecodePool::Worker::runCondition()
+{
+	// mRunCondition must be locked here
+	return mOwner->mQueued > 0;
+}
+
+//virtual
+void LLMeshDecodePool::Worker::run()
+{
+	while (1)
+	{
+		// blocks until there is a request in the queue, or we are quitting
+		checkPause();
+		if (isQuitting())
+		{
+			break;
+		}
+		LLMeshDecodePool::DecodeRequest* req = mOwner->popRequest();
+		if (req)
+		{
+			mOwner->processRequest(req);
+		}
+	}
+}
+
 LLMeshRepoThread::LLMeshRepoThread()
 : LLThread("mesh repo", NULL) 
 { 
@@ -631,10 +770,18 @@ LLMeshRepoThread::LLMeshRepoThread()
 	mMutex = new LLMutex(NULL);
 	mHeaderMutex = new LLMutex(NULL);
 	mSignal = new LLCondition(NULL);
+	mDecodePool = new LLMeshDecodePool(this, llmin(gSavedSettings.getU32("MeshThreadCount"), (U32) 16));
 }
 
 LLMeshRepoThread::~LLMeshRepoThread()
 {
+	delete mDecodePool;
+	mDecodePool = NULL;
+	while (!mDecodeFailedQ.empty())
+	{
+		delete mDecodeFailedQ.front();
+		mDecodeFailedQ.pop();
+	}
 	delete mMutex;
 	mMutex = NULL;
 	delete mHeaderMutex;
@@ -739,6 +886,37 @@ void LLMeshRepoThread::run()
 				mPhysicsShapeRequests = incomplete;
 			}
 
+			{ //fetch cached data that failed to decode from the sim instead
+				std::queue<LLMeshDecodePool::DecodeRequest*> failed;
+				{
+					LLMutexLock lock(mMutex);
+					failed.swap(mDecodeFailedQ);
+				}
+				while (!failed.empty())
+				{
+					LLMeshDecodePool::DecodeRequest* req = failed.front();
+					failed.pop();
+					switch (req->mType)
+					{
+					case LLMeshDecodePool::DECODE_LOD:
+						fetchMeshLOD(req->mMeshParams, req->mLOD, false);
+						break;
+					case LLMeshDecodePool::DECODE_SKIN_INFO:
+						fetchMeshSkinInfo(req->mMeshID, false);
+						break;
+					case LLMeshDecodePool::DECODE_DECOMPOSITION:
+						fetchMeshDecomposition(req->mMeshID, false);
+						break;
+					case LLMeshDecodePool::DECODE_PHYSICS_SHAPE:
+						fetchMeshPhysicsShape(req->mMeshID, false);
+						break;
+					}
+					delete req;
+				}
+			}
+
+			sendRanges();
+
 			mCurlRequest->process();
 		}
 	}
@@ -773,12 +951,108 @@ void LLMeshRepoThread::loadMeshPhysicsShape(const LLUUID& mesh_id)
 	mPhysicsShapeRequests.insert(mesh_id);
 }
 
+void LLMeshRepoThread::queueRange(const std::string& http_url, const RangeRequest& range)
+{ //repo thread only
+	LLUUID mesh_id = range.mType == LLMeshDecodePool::DECODE_LOD ? range.mMeshParams.getSculptID() : range.mMeshID;
+
+	pending_range_map::iterator iter = mPendingRanges.find(mesh_id);
+	if (iter == mPendingRanges.end())
+	{
+		iter = mPendingRanges.insert(std::make_pair(mesh_id, PendingRanges())).first;
+		iter->second.mURL = http_url;
+		iter->second.mQueuedTime = gFrameTimeSeconds;
+	}
+	iter->second.mRanges.push_back(range);
+}
+
+void LLMeshRepoThread::sendRanges()
+{ //repo thread only
+	std::vector<std::string> headers;
+	headers.push_back("Accept: application/octet-stream");
+
+	pending_range_map::iterator iter = mPendingRanges.begin();
+	while (iter != mPendingRanges.end())
+	{
+		PendingRanges& pending = iter->second;
+		if (gFrameTimeSeconds - pending.mQueuedTime < MESH_RANGE_WINDOW)
+		{ //wait a little longer for other ranges of this mesh
+			++iter;
+			continue;
+		}
+
+		std::vector<RangeRequest>& ranges = pending.mRanges;
+		std::sort(ranges.begin(), ranges.end());
+
+		U32 first = 0;
+		while (first < ranges.size())
+		{ //merge the following ranges that are close enough into one GET
+			S32 offset = ranges[first].mOffset;
+			S32 end = offset + ranges[first].mSize;
+			U32 last = first + 1;
+			while (last < ranges.size()
+				   && ranges[last].mOffset <= end + MESH_RANGE_MAX_GAP
+				   && llmax(end, ranges[last].mOffset + ranges[last].mSize) - offset <= MESH_RANGE_MAX_BYTES)
+			{
+				end = llmax(end, ranges[last].mOffset + ranges[last].mSize);
+				++last;
+			}
+
+			std::vector<RangeRequest> group(ranges.begin() + first, ranges.begin() + last);
+			LLMeshRepository::sHTTPRequestCount++;
+			mCurlRequest->getByteRange(pending.mURL, headers, offset, end - offset,
+									   new LLMeshRangeResponder(iter->first, group, offset, end - offset));
+			first = last;
+		}
+
+		mPendingRanges.erase(iter++);
+	}
+}
+
+void LLMeshRepoThread::rangeReceived(const RangeRequest& range, U8* data, S32 data_size)
+{
+	if (range.mType == LLMeshDecodePool::DECODE_LOD)
+	{
+		decodeReceived(new LLMeshDecodePool::DecodeRequest(range.mType, range.mMeshParams, range.mLOD,
+															data, data_size, range.mOffset, range.mSize));
+	}
+	else
+	{
+		decodeReceived(new LLMeshDecodePool::DecodeRequest(range.mType, range.mMeshID,
+															data, data_size, range.mOffset, range.mSize));
+	}
+}
+
+void LLMeshRepoThread::retryRange(const RangeRequest& range)
+{
+	switch (range.mType)
+	{
+	case LLMeshDecodePool::DECODE_LOD:
+		loadMeshLOD(range.mMeshParams, range.mLOD);
+		break;
+	case LLMeshDecodePool::DECODE_SKIN_INFO:
+		loadMeshSkinInfo(range.mMeshID);
+		break;
+	case LLMeshDecodePool::DECODE_DECOMPOSITION:
+		loadMeshDecomposition(range.mMeshID);
+		break;
+	case LLMeshDecodePool::DECODE_PHYSICS_SHAPE:
+		loadMeshPhysicsShape(range.mMeshID);
+		break;
+	}
+}
+
 
 void LLMeshRepoThread::loadMeshLOD(const LLVolumeParams& mesh_params, S32 lod)
 { //protected by mSignal, no locking needed here
 
-	mesh_header_map::iterator iter = mMeshHeader.find(mesh_params.getSculptID());
-	if (iter != mMeshHeader.end())
+	bool have_header = false;
+	{
+		LLMutexLock lock(mHeaderMutex);
+		have_header = mMeshHeader.find(mesh_params.getSculptID()) != mMeshHeader.end()
+			|| loadIndexedHeader(mesh_params.getSculptID());
+	}
+
+	if (have_header)
 	{ //if we have the header, request LOD byte range
 		LODRequest req(mesh_params, lod);
 		{
@@ -829,7 +1103,7 @@ std::string LLMeshRepoThread::constructUrl(LLUUID mesh_id)
 	return http_url;
 }
 
-bool LLMeshRepoThread::fetchMeshSkinInfo(const LLUUID& mesh_id)
+bool LLMeshRepoThread::fetchMeshSkinInfo(const LLUUID& mesh_id, bool can_use_cache)
 { //protected by mMutex
 	mHeaderMutex->lock();
 
@@ -852,7 +1126,7 @@ bool LLMeshRepoThread::fetchMeshSkinInfo(const LLUUID& mesh_id)
 		{
 			//check VFS for mesh skin info
 			LLVFile file(gVFS, mesh_id, LLAssetType::AT_MESH);
-			if (file.getSize() >= offset+size)
+			if (can_use_cache && file.getSize() >= offset+size)
 			{
 				LLMeshRepository::sCacheBytesRead += size;
 				file.seek(offset);
@@ -867,28 +1141,21 @@ bool LLMeshRepoThread::fetchMeshSkinInfo(const LLUUID& mesh_id)
 				}
 
 				if (!zero)
-				{ //attempt to parse
-					if (skinInfoReceived(mesh_id, buffer, size))
-					{
-						delete[] buffer;
-						return true;
-					}
+				{ //parse on the decode pool, which fetches from the sim if this fails
+					decodeReceived(new LLMeshDecodePool::DecodeRequest(LLMeshDecodePool::DECODE_SKIN_INFO, mesh_id,
+																		buffer, size, -1, size));
+					return true;
 				}
 
 				delete[] buffer;
 			}
 
 			//reading from VFS failed for whatever reason, fetch from sim
-			std::vector<std::string> headers;
-			headers.push_back("Accept: application/octet-stream");
-
 			std::string http_url = constructUrl(mesh_id);
 			if (!http_url.empty())
 			{
 				++sActiveLODRequests;
-				LLMeshRepository::sHTTPRequestCount++;
-				mCurlRequest->getByteRange(constructUrl(mesh_id), headers, offset, size,
-										   new LLMeshSkinInfoResponder(mesh_id, offset, size));
+				queueRange(http_url, RangeRequest(LLMeshDecodePool::DECODE_SKIN_INFO, mesh_id, offset, size));
 			}
 		}
 	}
@@ -901,7 +1168,7 @@ bool LLMeshRepoThread::fetchMeshSkinInfo(const LLUUID& mesh_id)
 	return true;
 }
 
-bool LLMeshRepoThread::fetchMeshDecomposition(const LLUUID& mesh_id)
+bool LLMeshRepoThread::fetchMeshDecomposition(const LLUUID& mesh_id, bool can_use_cache)
 { //protected by mMutex
 	mHeaderMutex->lock();
 
@@ -924,7 +1191,7 @@ bool LLMeshRepoThread::fetchMeshDecomposition(const LLUUID& mesh_id)
 		{
 			//check VFS for mesh skin info
 			LLVFile file(gVFS, mesh_id, LLAssetType::AT_MESH);
-			if (file.getSize() >= offset+size)
+			if (can_use_cache && file.getSize() >= offset+size)
 			{
 				LLMeshRepository::sCacheBytesRead += size;
 				file.seek(offset);
@@ -939,28 +1206,21 @@ bool LLMeshRepoThread::fetchMeshDecomposition(const LLUUID& mesh_id)
 				}
 
 				if (!zero)
-				{ //attempt to parse
-					if (decompositionReceived(mesh_id, buffer, size))
-					{
-						delete[] buffer;
-						return true;
-					}
+				{ //parse on the decode pool, which fetches from the sim if this fails
+					decodeReceived(new LLMeshDecodePool::DecodeRequest(LLMeshDecodePool::DECODE_DECOMPOSITION, mesh_id,
+																		buffer, size, -1, size));
+					return true;
 				}
 
 				delete[] buffer;
 			}
 
 			//reading from VFS failed for whatever reason, fetch from sim
-			std::vector<std::string> headers;
-			headers.push_back("Accept: application/octet-stream");
-
 			std::string http_url = constructUrl(mesh_id);
 			if (!http_url.empty())
 			{
 				++sActiveLODRequests;
-				LLMeshRepository::sHTTPRequestCount++;
-				mCurlRequest->getByteRange(http_url, headers, offset, size,
-										   new LLMeshDecompositionResponder(mesh_id, offset, size));
+				queueRange(http_url, RangeRequest(LLMeshDecodePool::DECODE_DECOMPOSITION, mesh_id, offset, size));
 			}
 		}
 	}
@@ -973,7 +1233,7 @@ bool LLMeshRepoThread::fetchMeshDecomposition(const LLUUID& mesh_id)
 	return true;
 }
 
-bool LLMeshRepoThread::fetchMeshPhysicsShape(const LLUUID& mesh_id)
+bool LLMeshRepoThread::fetchMeshPhysicsShape(const LLUUID& mesh_id, bool can_use_cache)
 { //protected by mMutex
 	mHeaderMutex->lock();
 
@@ -996,7 +1256,7 @@ bool LLMeshRepoThread::fetchMeshPhysicsShape(const LLUUID& mesh_id)
 		{
 			//check VFS for mesh physics shape info
 			LLVFile file(gVFS, mesh_id, LLAssetType::AT_MESH);
-			if (file.getSize() >= offset+size)
+			if (can_use_cache && file.getSize() >= offset+size)
 			{
 				LLMeshRepository::sCacheBytesRead += size;
 				file.seek(offset);
@@ -1011,28 +1271,21 @@ bool LLMeshRepoThread::fetchMeshPhysicsShape(const LLUUID& mesh_id)
 				}
 
 				if (!zero)
-				{ //attempt to parse
-					if (physicsShapeReceived(mesh_id, buffer, size))
-					{
-						delete[] buffer;
-						return true;
-					}
+				{ //parse on the decode pool, which fetches from the sim if this fails
+					decodeReceived(new LLMeshDecodePool::DecodeRequest(LLMeshDecodePool::DECODE_PHYSICS_SHAPE, mesh_id,
+																		buffer, size, -1, size));
+					return true;
 				}
 
 				delete[] buffer;
 			}
 
 			//reading from VFS failed for whatever reason, fetch from sim
-			std::vector<std::string> headers;
-			headers.push_back("Accept: application/octet-stream");
-
 			std::string http_url = constructUrl(mesh_id);
 			if (!http_url.empty())
 			{
 				++sActiveLODRequests;
-				LLMeshRepository::sHTTPRequestCount++;
-				mCurlRequest->getByteRange(http_url, headers, offset, size,
-										   new LLMeshPhysicsShapeResponder(mesh_id, offset, size));
+				queueRange(http_url, RangeRequest(LLMeshDecodePool::DECODE_PHYSICS_SHAPE, mesh_id, offset, size));
 			}
 		}
 		else
@@ -1091,7 +1344,7 @@ bool LLMeshRepoThread::fetchMeshHeader(const LLVolumeParams& mesh_params)
 	return retval;
 }
 
-bool LLMeshRepoThread::fetchMeshLOD(const LLVolumeParams& mesh_params, S32 lod)
+bool LLMeshRepoThread::fetchMeshLOD(const LLVolumeParams& mesh_params, S32 lod, bool can_use_cache)
 { //protected by mMutex
 	mHeaderMutex->lock();
 
@@ -1111,7 +1364,7 @@ bool LLMeshRepoThread::fetchMeshLOD(const LLVolumeParams& mesh_params, S32 lod)
 
 			//check VFS for mesh asset
 			LLVFile file(gVFS, mesh_id, LLAssetType::AT_MESH);
-			if (file.getSize() >= offset+size)
+			if (can_use_cache && file.getSize() >= offset+size)
 			{
 				LLMeshRepository::sCacheBytesRead += size;
 				file.seek(offset);
@@ -1126,37 +1379,32 @@ bool LLMeshRepoThread::fetchMeshLOD(const LLVolumeParams& mesh_params, S32 lod)
 				}
 
 				if (!zero)
-				{ //attempt to parse
-					if (lodReceived(mesh_params, lod, buffer, size))
-					{
-						delete[] buffer;
-						return false;
-					}
+				{ //parse on the decode pool, which fetches from the sim if this fails
+					decodeReceived(new LLMeshDecodePool::DecodeRequest(LLMeshDecodePool::DECODE_LOD, mesh_params, lod,
+																		buffer, size, -1, size));
+					return false;
 				}
 
 				delete[] buffer;
 			}
 
 			//reading from VFS failed for whatever reason, fetch from sim
-			std::vector<std::string> headers;
-			headers.push_back("Accept: application/octet-stream");
-
 			std::string http_url = constructUrl(mesh_id);
 			if (!http_url.empty())
 			{
 				++sActiveLODRequests;
 				retval = true;
-				LLMeshRepository::sHTTPRequestCount++;
-				mCurlRequest->getByteRange(constructUrl(mesh_id), headers, offset, size,
-										   new LLMeshLODResponder(mesh_params, lod, offset, size));
+				queueRange(http_url, RangeRequest(mesh_params, lod, offset, size));
 			}
 			else
 			{
+				LLMutexLock lock(mMutex);
 				mUnavailableQ.push(LODRequest(mesh_params, lod));
 			}
 		}
 		else
 		{
+			LLMutexLock lock(mMutex);
 			mUnavailableQ.push(LODRequest(mesh_params, lod));
 		}
 	}
@@ -1175,26 +1423,23 @@ bool LLMeshRepoThread::headerReceived(const LLVolumeParams& mesh_params, U8* dat
 	U32 header_size = 0;
 	if (data_size > 0)
 	{
-		std::string res_str((char*) data, data_size);
+		static const char deprecated_header[] = "<? LLSD/Binary ?>";
+		const S32 deprecated_header_size = sizeof(deprecated_header) - 1;
 
-		std::string deprecated_header("<? LLSD/Binary ?>");
-
-		if (res_str.substr(0, deprecated_header.size()) == deprecated_header)
+		const U8* read = data;
+		if (data_size > deprecated_header_size
+			&& !memcmp(data, deprecated_header, deprecated_header_size))
 		{
-			res_str = res_str.substr(deprecated_header.size()+1, data_size);
-			header_size = deprecated_header.size()+1;
+			read += deprecated_header_size + 1;
 		}
-		data_size = res_str.size();
-
-		std::istringstream stream(res_str);
 
-		if (!LLSDSerialize::fromBinary(header, stream, data_size))
+		if (LLSDSerialize::fromBinary(header, read, data + data_size) <= 0)
 		{
 			llwarns << "Mesh header parse error.  Not a valid mesh asset!" << llendl;
 			return false;
 		}
 
-		header_size += stream.tellg();
+		header_size = read - data;
 	}
 	else
 	{
@@ -1214,6 +1459,11 @@ bool LLMeshRepoThread::headerReceived(const LLVolumeParams& mesh_params, U8* dat
 		mMeshResourceCost[mesh_id] = cost;
 		mHeaderMutex->unlock();
 
+		if (!header.has("404"))
+		{ //remember the header for the next sessions
+			mHeaderIndex.update(mesh_id, header, header_size, cost);
+		}
+
 		//check for pending requests
 		pending_lod_map::iterator iter = mPendingLOD.find(mesh_params);
 		if (iter != mPendingLOD.end())
@@ -1231,13 +1481,22 @@ bool LLMeshRepoThread::headerReceived(const LLVolumeParams& mesh_params, U8* dat
 	return true;
 }
 
+void LLMeshRepoThread::decodeReceived(LLMeshDecodePool::DecodeRequest* req)
+{
+	mDecodePool->decode(req);
+}
+
+void LLMeshRepoThread::decodeFailed(LLMeshDecodePool::DecodeRequest* req)
+{ //picked up by run() on the next pass
+	LLMutexLock lock(mMutex);
+	mDecodeFailedQ.push(req);
+}
+
 bool LLMeshRepoThread::lodReceived(const LLVolumeParams& mesh_params, S32 lod, U8* data, S32 data_size)
 {
 	LLVolume* volume = new LLVolume(mesh_params, LLVolumeLODGroup::getVolumeScaleFromDetail(lod));
-	std::string mesh_string((char*) data, data_size);
-	std::istringstream stream(mesh_string);
 
-	if (volume->unpackVolumeFaces(stream, data_size))
+	if (volume->unpackVolumeFaces(data, data_size))
 	{
 		LoadedMesh mesh(volume, mesh_params, lod);
 		if (volume->getNumFaces() > 0)
@@ -1273,6 +1532,7 @@ bool LLMeshRepoThread::skinInfoReceived(const LLUUID& mesh_id, U8* data, S32 dat
 		info.mMeshID = mesh_id;
 
 		//llinfos<<"info pelvis offset"<<info.mPelvisOffset<<llendl;
+		LLMutexLock lock(mMutex);
 		mSkinInfoQ.push(info);
 	}
 
@@ -1299,6 +1559,7 @@ bool LLMeshRepoThread::decompositionReceived(const LLUUID& mesh_id, U8* data, S3
 	{
 		LLModel::Decomposition* d = new LLModel::Decomposition(decomp);
 		d->mMeshID = mesh_id;
+		LLMutexLock lock(mMutex);
 		mDecompositionQ.push(d);
 	}
 
@@ -1322,10 +1583,8 @@ bool LLMeshRepoThread::physicsShapeReceived(const LLUUID& mesh_id, U8* data, S32
 		volume_params.setType(LL_PCODE_PROFILE_SQUARE, LL_PCODE_PATH_LINE);
 		volume_params.setSculptID(mesh_id, LL_SCULPT_TYPE_MESH);
 		LLPointer<LLVolume> volume = new LLVolume(volume_params,0);
-		std::string mesh_string((char*) data, data_size);
-		std::istringstream stream(mesh_string);
 
-		if (volume->unpackVolumeFaces(stream, data_size))
+		if (volume->unpackVolumeFaces(data, data_size))
 		{
 			//load volume faces into decomposition buffer
 			S32 vertex_count = 0;
@@ -1358,6 +1617,7 @@ bool LLMeshRepoThread::physicsShapeReceived(const LLUUID& mesh_id, U8* data, S32
 		}
 	}
 
+	LLMutexLock lock(mMutex);
 	mDecompositionQ.push(d);
 	return true;
 }
@@ -1738,12 +1998,28 @@ static LLFastTimer::DeclareTimer FTM_NOTIFY_MESH_UNAVAILABLE("Notify Unavailable
 
 void LLMeshRepoThread::notifyLoadedMeshes()
 {
-	while (!mLoadedQ.empty())
+	std::queue<LoadedMesh> loaded_q;
+	std::queue<LODRequest> unavailable_q;
+	std::queue<LLMeshSkinInfo> skin_info_q;
+	std::queue<LLModel::Decomposition*> decomposition_q;
+
+	{ //take the completed work in one go, so the decode pool is not held
+	  //up while the main thread handles it
+		LLMutexLock lock(mMutex);
+		loaded_q.swap(mLoadedQ);
+		unavailable_q.swap(mUnavailableQ);
+		skin_info_q.swap(mSkinInfoQ);
+		decomposition_q.swap(mDecompositionQ);
+	}
+
+	if (!loaded_q.empty() && gPipeline.getGeometryPool())
+	{ //loaded meshes are copied into their volumes in place
+		gPipeline.getGeometryPool()->sync();
+	}
+
+	while (!loaded_q.empty())
 	{
-		mMutex->lock();
-		LoadedMesh mesh = mLoadedQ.front();
-		mLoadedQ.pop();
-		mMutex->unlock();
+		LoadedMesh& mesh = loaded_q.front();
 		
 		if (mesh.mVolume && mesh.mVolume->getNumVolumeFaces() > 0)
 		{
@@ -1754,28 +2030,26 @@ void LLMeshRepoThread::notifyLoadedMeshes()
 			gMeshRepo.notifyMeshUnavailable(mesh.mMeshParams, 
 				LLVolumeLODGroup::getVolumeDetailFromScale(mesh.mVolume->getDetail()));
 		}
+		loaded_q.pop();
 	}
 
-	while (!mUnavailableQ.empty())
+	while (!unavailable_q.empty())
 	{
-		mMutex->lock();
-		LODRequest req = mUnavailableQ.front();
-		mUnavailableQ.pop();
-		mMutex->unlock();
-		
+		LODRequest& req = unavailable_q.front();
 		gMeshRepo.notifyMeshUnavailable(req.mMeshParams, req.mLOD);
+		unavailable_q.pop();
 	}
 
-	while (!mSkinInfoQ.empty())
+	while (!skin_info_q.empty())
 	{
-		gMeshRepo.notifySkinInfoReceived(mSkinInfoQ.front());
-		mSkinInfoQ.pop();
+		gMeshRepo.notifySkinInfoReceived(skin_info_q.front());
+		skin_info_q.pop();
 	}
 
-	while (!mDecompositionQ.empty())
+	while (!decomposition_q.empty())
 	{
-		gMeshRepo.notifyDecompositionReceived(mDecompositionQ.front());
-		mDecompositionQ.pop();
+		gMeshRepo.notifyDecompositionReceived(decomposition_q.front());
+		decomposition_q.pop();
 	}
 }
 
@@ -1784,6 +2058,11 @@ S32 LLMeshRepoThread::getActualMeshLOD(const LLVolumeParams& mesh_params, S32 lo
 	LLMutexLock lock(mHeaderMutex);
 	mesh_header_map::iterator iter = mMeshHeader.find(mesh_params.getSculptID());
 
+	if (iter == mMeshHeader.end() && loadIndexedHeader(mesh_params.getSculptID()))
+	{
+		iter = mMeshHeader.find(mesh_params.getSculptID());
+	}
+
 	if (iter != mMeshHeader.end())
 	{
 		LLSD& header = iter->second;
@@ -1842,143 +2121,71 @@ U32 LLMeshRepoThread::getResourceCost(const LLUUID& mesh_id)
 		return iter->second;
 	}
 
-	return 0;
-}
-
-void LLMeshRepository::cacheOutgoingMesh(LLMeshUploadData& data, LLSD& header)
-{
-	mThread->mMeshHeader[data.mUUID] = header;
-
-	// we cache the mesh for default parameters
-	LLVolumeParams volume_params;
-	volume_params.setType(LL_PCODE_PROFILE_SQUARE, LL_PCODE_PATH_LINE);
-	volume_params.setSculptID(data.mUUID, LL_SCULPT_TYPE_MESH);
-
-	for (U32 i = 0; i < 4; i++)
+	if (loadIndexedHeader(mesh_id))
 	{
-		if (data.mModel[i].notNull())
-		{
-			LLPointer<LLVolume> volume = new LLVolume(volume_params, LLVolumeLODGroup::getVolumeScaleFromDetail(i));
-			volume->copyVolumeFaces(data.mModel[i]);
-		}
+		return mMeshResourceCost[mesh_id];
 	}
 
+	return 0;
 }
 
-void LLMeshLODResponder::completedRaw(U32 status, const std::string& reason,
-							  const LLChannelDescriptors& channels,
-							  const LLIOPipe::buffer_ptr_t& buffer)
-{
-
-	LLMeshRepoThread::sActiveLODRequests--;
-	S32 data_size = buffer->countAfter(channels.in(), NULL);
-
-	if (status < 200 || status > 400)
+bool LLMeshRepoThread::loadIndexedHeader(const LLUUID& mesh_id)
+{ //protected by mHeaderMutex
+	LLSD header;
+	U32 header_size = 0;
+	U32 cost = 0;
+	if (!mHeaderIndex.find(mesh_id, header, header_size, cost))
 	{
-		llwarns << status << ": " << reason << llendl;
+		return false;
 	}
 
-	if (data_size < mRequestedBytes)
+	//only the header fetch sizes the VFS entry that LODs are cached in,
+	//fetch the header again if the entry was evicted
+	const LLSD& sections = header;
+	S32 lod_bytes = 0;
+	for (U32 i = 0; i < LLModel::LOD_PHYSICS; ++i)
 	{
-		if (status == 499 || status == 503)
-		{ //timeout or service unavailable, try again
-			LLMeshRepository::sHTTPRetryCount++;
-			gMeshRepo.mThread->loadMeshLOD(mMeshParams, mLOD);
-		}
-		else
-		{
-			llwarns << "Unhandled status " << status << llendl;
-		}
-		return;
+		lod_bytes = llmax(lod_bytes, sections[header_lod[i]]["offset"].asInteger()+sections[header_lod[i]]["size"].asInteger());
 	}
+	lod_bytes = llmax(lod_bytes, sections["skin"]["offset"].asInteger() + sections["skin"]["size"].asInteger());
+	lod_bytes = llmax(lod_bytes, sections["physics_convex"]["offset"].asInteger() + sections["physics_convex"]["size"].asInteger());
 
-	LLMeshRepository::sBytesReceived += mRequestedBytes;
-
-	U8* data = NULL;
-
-	if (data_size > 0)
-	{
-		data = new U8[data_size];
-		buffer->readAfter(channels.in(), NULL, data, data_size);
-	}
-
-	if (gMeshRepo.mThread->lodReceived(mMeshParams, mLOD, data, data_size))
+	if (gVFS->getSize(mesh_id, LLAssetType::AT_MESH) < lod_bytes + (S32) header_size)
 	{
-		//good fetch from sim, write to VFS for caching
-		LLVFile file(gVFS, mMeshParams.getSculptID(), LLAssetType::AT_MESH, LLVFile::WRITE);
-
-		S32 offset = mOffset;
-		S32 size = mRequestedBytes;
-
-		if (file.getSize() >= offset+size)
-		{
-			file.seek(offset);
-			file.write(data, size);
-			LLMeshRepository::sCacheBytesWritten += size;
-		}
+		return false;
 	}
 
-	delete [] data;
+	mMeshHeaderSize[mesh_id] = header_size;
+	mMeshHeader[mesh_id] = header;
+	mMeshResourceCost[mesh_id] = cost;
+	return true;
 }
 
-void LLMeshSkinInfoResponder::completedRaw(U32 status, const std::string& reason,
-							  const LLChannelDescriptors& channels,
-							  const LLIOPipe::buffer_ptr_t& buffer)
+void LLMeshRepository::cacheOutgoingMesh(LLMeshUploadData& data, LLSD& header)
 {
-	S32 data_size = buffer->countAfter(channels.in(), NULL);
-
-	if (status < 200 || status > 400)
-	{
-		llwarns << status << ": " << reason << llendl;
-	}
-
-	if (data_size < mRequestedBytes)
-	{
-		if (status == 499 || status == 503)
-		{ //timeout or service unavailable, try again
-			LLMeshRepository::sHTTPRetryCount++;
-			gMeshRepo.mThread->loadMeshSkinInfo(mMeshID);
-		}
-		else
-		{
-			llwarns << "Unhandled status " << status << llendl;
-		}
-		return;
-	}
-
-	LLMeshRepository::sBytesReceived += mRequestedBytes;
-
-	U8* data = NULL;
+	mThread->mMeshHeader[data.mUUID] = header;
 
-	if (data_size > 0)
-	{
-		data = new U8[data_size];
-		buffer->readAfter(channels.in(), NULL, data, data_size);
-	}
+	// we cache the mesh for default parameters
+	LLVolumeParams volume_params;
+	volume_params.setType(LL_PCODE_PROFILE_SQUARE, LL_PCODE_PATH_LINE);
+	volume_params.setSculptID(data.mUUID, LL_SCULPT_TYPE_MESH);
 
-	if (gMeshRepo.mThread->skinInfoReceived(mMeshID, data, data_size))
+	for (U32 i = 0; i < 4; i++)
 	{
-		//good fetch from sim, write to VFS for caching
-		LLVFile file(gVFS, mMeshID, LLAssetType::AT_MESH, LLVFile::WRITE);
-
-		S32 offset = mOffset;
-		S32 size = mRequestedBytes;
-
-		if (file.getSize() >= offset+size)
+		if (data.mModel[i].notNull())
 		{
-			LLMeshRepository::sCacheBytesWritten += size;
-			file.seek(offset);
-			file.write(data, size);
+			LLPointer<LLVolume> volume = new LLVolume(volume_params, LLVolumeLODGroup::getVolumeScaleFromDetail(i));
+			volume->copyVolumeFaces(data.mModel[i]);
 		}
 	}
 
-	delete [] data;
 }
 
-void LLMeshDecompositionResponder::completedRaw(U32 status, const std::string& reason,
+void LLMeshRangeResponder::completedRaw(U32 status, const std::string& reason,
 							  const LLChannelDescriptors& channels,
 							  const LLIOPipe::buffer_ptr_t& buffer)
 {
+	LLMeshRepoThread::sActiveLODRequests -= (S32) mRanges.size();
 	S32 data_size = buffer->countAfter(channels.in(), NULL);
 
 	if (status < 200 || status > 400)
@@ -1991,7 +2198,10 @@ void LLMeshDecompositionResponder::completedRaw(U32 status, const std::string& r
 		if (status == 499 || status == 503)
 		{ //timeout or service unavailable, try again
 			LLMeshRepository::sHTTPRetryCount++;
-			gMeshRepo.mThread->loadMeshDecomposition(mMeshID);
+			for (U32 i = 0; i < mRanges.size(); ++i)
+			{
+				gMeshRepo.mThread->retryRange(mRanges[i]);
+			}
 		}
 		else
 		{
@@ -2002,85 +2212,24 @@ void LLMeshDecompositionResponder::completedRaw(U32 status, const std::string& r
 
 	LLMeshRepository::sBytesReceived += mRequestedBytes;
 
-	U8* data = NULL;
-
-	if (data_size > 0)
-	{
-		data = new U8[data_size];
-		buffer->readAfter(channels.in(), NULL, data, data_size);
-	}
-
-	if (gMeshRepo.mThread->decompositionReceived(mMeshID, data, data_size))
-	{
-		//good fetch from sim, write to VFS for caching
-		LLVFile file(gVFS, mMeshID, LLAssetType::AT_MESH, LLVFile::WRITE);
-
-		S32 offset = mOffset;
-		S32 size = mRequestedBytes;
-
-		if (file.getSize() >= offset+size)
-		{
-			LLMeshRepository::sCacheBytesWritten += size;
-			file.seek(offset);
-			file.write(data, size);
-		}
-	}
-
-	delete [] data;
-}
-
-void LLMeshPhysicsShapeResponder::completedRaw(U32 status, const std::string& reason,
-							  const LLChannelDescriptors& channels,
-							  const LLIOPipe::buffer_ptr_t& buffer)
-{
-	S32 data_size = buffer->countAfter(channels.in(), NULL);
-
-	if (status < 200 || status > 400)
-	{
-		llwarns << status << ": " << reason << llendl;
-	}
+	U8* data = new U8[data_size];
+	buffer->readAfter(channels.in(), NULL, data, data_size);
 
-	if (data_size < mRequestedBytes)
+	//parse on the decode pool, which writes good data to the VFS for caching
+	if (mRanges.size() == 1)
 	{
-		if (status == 499 || status == 503)
-		{ //timeout or service unavailable, try again
-			LLMeshRepository::sHTTPRetryCount++;
-			gMeshRepo.mThread->loadMeshPhysicsShape(mMeshID);
-		}
-		else
-		{
-			llwarns << "Unhandled status " << status << llendl;
-		}
+		gMeshRepo.mThread->rangeReceived(mRanges[0], data, data_size);
 		return;
 	}
 
-	LLMeshRepository::sBytesReceived += mRequestedBytes;
-
-	U8* data = NULL;
-
-	if (data_size > 0)
+	for (U32 i = 0; i < mRanges.size(); ++i)
 	{
-		data = new U8[data_size];
-		buffer->readAfter(channels.in(), NULL, data, data_size);
+		const LLMeshRepoThread::RangeRequest& range = mRanges[i];
+		U8* range_data = new U8[range.mSize];
+		memcpy(range_data, data + (range.mOffset - mOffset), range.mSize);
+		gMeshRepo.mThread->rangeReceived(range, range_data, range.mSize);
 	}
-
-	if (gMeshRepo.mThread->physicsShapeReceived(mMeshID, data, data_size))
-	{
-		//good fetch from sim, write to VFS for caching
-		LLVFile file(gVFS, mMeshID, LLAssetType::AT_MESH, LLVFile::WRITE);
-
-		S32 offset = mOffset;
-		S32 size = mRequestedBytes;
-
-		if (file.getSize() >= offset+size)
-		{
-			LLMeshRepository::sCacheBytesWritten += size;
-			file.seek(offset);
-			file.write(data, size);
-		}
-	}
-
-	delete [] data;
+	delete[] data;
 }
 
 void LLMeshHeaderResponder::completedRaw(U32 status, const std::string& reason,
@@ -2216,6 +2365,7 @@ void LLMeshRepository::init()
 	
 	
 	mThread = new LLMeshRepoThread();
+	mThread->mHeaderIndex.load(gDirUtilp->getExpandedFilename(LL_PATH_CACHE, MESH_HEADER_INDEX_FILENAME));
 	mThread->start();
 }
 
@@ -2235,6 +2385,7 @@ void LLMeshRepository::shutdown()
 	{
 		apr_sleep(10);
 	}
+	mThread->mHeaderIndex.save();
 	delete mThread;
 	mThread = NULL;
 
@@ -2422,6 +2573,11 @@ void LLMeshRepository::notifyLoadedMeshes()
 
 	//call completed callbacks on finished decompositions
 	mDecompThread->notifyCompleted();
+
+	{ //hand out meshes parsed by the decode pool, even while the repo thread is busy
+		LLMutexLock lock(mMeshMutex);
+		mThread->notifyLoadedMeshes();
+	}
 	
 	if (!mThread->mWaiting)
 	{ //curl thread is churning, wait for it to go idle
@@ -2531,8 +2687,6 @@ void LLMeshRepository::notifyLoadedMeshes()
 		mPendingPhysicsShapeRequests.pop();
 	}
 	
-	mThread->notifyLoadedMeshes();
-
 	mThread->mMutex->unlock();
 	mMeshMutex->unlock();
 
@@ -2802,6 +2956,11 @@ LLSD& LLMeshRepoThread::getMeshHeader(const LLUUID& mesh_id)
 		{
 			return iter->second;
 		}
+
+		if (loadIndexedHeader(mesh_id))
+		{
+			return mMeshHeader[mesh_id];
+		}
 	}
 
 	return dummy_ret;
@@ -28,6 +28,7 @@
 #define LL_MESH_REPOSITORY_H
 
 #include "llassettype.h"
+#include "llmeshheaderindex.h"
 #include "llmodel.h"
 #include "lluuid.h"
 #include "llviewertexture.h"
@@ -209,6 +210,81 @@ public:
 
 };
 
+class LLMeshRepoThread;
+
+// Pool of threads parsing the mesh data received by LLMeshRepoThread (LODs,
+// skin info, decompositions and physics shapes), so that the repo thread
+// only keeps track of requests and runs the HTTP fetches.
+// Results are posted to the completion queues of the repo thread, which
+// LLMeshRepoThread::notifyLoadedMeshes() drains on the main thread.
+class LLMeshDecodePool
+{
+public:
+	enum EDecodeType
+	{
+		DECODE_LOD,
+		DECODE_SKIN_INFO,
+		DECODE_DECOMPOSITION,
+		DECODE_PHYSICS_SHAPE
+	};
+
+	class DecodeRequest
+	{
+	public:
+		// data is new[]ed and owned by the request.
+		// offset and size locate the data in the VFS entry. Data fetched over
+		// HTTP is written to the VFS once it decodes, data read from the VFS
+		// (offset < 0) is fetched over HTTP again if it does not.
+		DecodeRequest(EDecodeType type, const LLVolumeParams& mesh_params, S32 lod,
+					  U8* data, S32 data_size, S32 offset, S32 size);
+		DecodeRequest(EDecodeType type, const LLUUID& mesh_id,
+					  U8* data, S32 data_size, S32 offset, S32 size);
+		~DecodeRequest();
+
+		bool isFromCache() const { return mOffset < 0; }
+
+		EDecodeType mType;
+		LLVolumeParams mMeshParams; // DECODE_LOD only
+		LLUUID mMeshID;
+		S32 mLOD;
+		U8* mData;
+		S32 mDataSize;
+		S32 mOffset;
+		S32 mSize;
+	};
+
+	LLMeshDecodePool(LLMeshRepoThread* thread, U32 num_threads);
+	~LLMeshDecodePool();
+
+	// Any thread. Takes ownership of req.
+	void decode(DecodeRequest* req);
+	void shutdown();
+
+private:
+	class Worker : public LLThread
+	{
+	public:
+		Worker(LLMeshDecodePool* owner, S32 index);
+
+	protected:
+		/*virtual*/ bool runCondition();
+		/*virtual*/ void run();
+
+	private:
+		LLMeshDecodePool* mOwner;
+	};
+	friend class Worker;
+
+	DecodeRequest* popRequest();
+	void processRequest(DecodeRequest* req);
+
+	LLMeshRepoThread* mThread;
+	LLMutex mQueueMutex;
+	std::queue<DecodeRequest*> mQueue; // protected by mQueueMutex
+	LLAtomic32<S32> mQueued; // requests in mQueue, for Worker::runCondition()
+	std::vector<Worker*> mWorkers; // empty to decode on the calling thread
+};
+
 class LLMeshRepoThread : public LLThread
 {
 public:
@@ -231,6 +307,9 @@ public:
 	std::map<LLUUID, U32> mMeshHeaderSize;
 	std::map<LLUUID, U32> mMeshResourceCost;
 
+	//headers seen in earlier sessions, moved to the maps above when first needed
+	LLMeshHeaderIndex mHeaderIndex;
+
 	class HeaderRequest
 	{ 
 	public:
@@ -260,6 +339,33 @@ public:
 		}
 	};
 
+	//byte range of a mesh asset to fetch over HTTP
+	class RangeRequest
+	{
+	public:
+		LLMeshDecodePool::EDecodeType mType;
+		LLVolumeParams mMeshParams; // DECODE_LOD only
+		LLUUID mMeshID;
+		S32 mLOD;
+		S32 mOffset;
+		S32 mSize;
+
+		RangeRequest(const LLVolumeParams& mesh_params, S32 lod, S32 offset, S32 size)
+			: mType(LLMeshDecodePool::DECODE_LOD), mMeshParams(mesh_params), mLOD(lod), mOffset(offset), mSize(size)
+		{
+		}
+
+		RangeRequest(LLMeshDecodePool::EDecodeType type, const LLUUID& mesh_id, S32 offset, S32 size)
+			: mType(type), mMeshID(mesh_id), mLOD(0), mOffset(offset), mSize(size)
+		{
+		}
+
+		bool operator<(const RangeRequest& rhs) const
+		{
+			return mOffset < rhs.mOffset;
+		}
+	};
+
 	struct CompareScoreGreater
 	{
 		bool operator()(const LODRequest& lhs, const LODRequest& rhs)
@@ -310,10 +416,31 @@ public:
 	//queue of successfully loaded meshes
 	std::queue<LoadedMesh> mLoadedQ;
 
+	//the completion queues above are filled by the decode pool, all of them
+	//are protected by mMutex
+
+	//decode pool parsing received data off this thread
+	LLMeshDecodePool* mDecodePool;
+
+	//queue of cached data that failed to decode, to fetch over HTTP instead
+	//(protected by mMutex)
+	std::queue<LLMeshDecodePool::DecodeRequest*> mDecodeFailedQ;
+
 	//map of pending header requests and currently desired LODs
 	typedef std::map<LLVolumeParams, std::vector<S32> > pending_lod_map;
 	pending_lod_map mPendingLOD;
 
+	//byte ranges waiting to be coalesced with other ranges of the same mesh
+	//(repo thread only)
+	struct PendingRanges
+	{
+		std::string mURL;
+		F32 mQueuedTime;
+		std::vector<RangeRequest> mRanges;
+	};
+	typedef std::map<LLUUID, PendingRanges> pending_range_map;
+	pending_range_map mPendingRanges;
+
 	static std::string constructUrl(LLUUID mesh_id);
 
 	LLMeshRepoThread();
@@ -323,13 +450,31 @@ public:
 
 	void loadMeshLOD(const LLVolumeParams& mesh_params, S32 lod);
 	bool fetchMeshHeader(const LLVolumeParams& mesh_params);
-	bool fetchMeshLOD(const LLVolumeParams& mesh_params, S32 lod);
+	bool fetchMeshLOD(const LLVolumeParams& mesh_params, S32 lod, bool can_use_cache = true);
 	bool headerReceived(const LLVolumeParams& mesh_params, U8* data, S32 data_size);
 	bool lodReceived(const LLVolumeParams& mesh_params, S32 lod, U8* data, S32 data_size);
 	bool skinInfoReceived(const LLUUID& mesh_id, U8* data, S32 data_size);
 	bool decompositionReceived(const LLUUID& mesh_id, U8* data, S32 data_size);
 	bool physicsShapeReceived(const LLUUID& mesh_id, U8* data, S32 data_size);
 	LLSD& getMeshHeader(const LLUUID& mesh_id);
+	//install the header of mesh_id from mHeaderIndex, false if it is not indexed
+	//(call with mHeaderMutex locked)
+	bool loadIndexedHeader(const LLUUID& mesh_id);
+
+	//hand received data to the decode pool, which calls the *Received functions above
+	void decodeReceived(LLMeshDecodePool::DecodeRequest* req);
+	//called by the decode pool when data read from the VFS does not decode
+	void decodeFailed(LLMeshDecodePool::DecodeRequest* req);
+
+	//fetch range from http_url, along with the other ranges of the same mesh
+	//requested in a short window
+	void queueRange(const std::string& http_url, const RangeRequest& range);
+	//issue the GETs for the ranges that have waited long enough
+	void sendRanges();
+	//hand data fetched for range to the decode pool, takes ownership of data
+	void rangeReceived(const RangeRequest& range, U8* data, S32 data_size);
+	//request range again after a failed fetch
+	void retryRange(const RangeRequest& range);
 
 	void notifyLoadedMeshes();
 	S32 getActualMeshLOD(const LLVolumeParams& mesh_params, S32 lod);
@@ -341,15 +486,15 @@ public:
 
 	//send request for skin info, returns true if header info exists 
 	//  (should hold onto mesh_id and try again later if header info does not exist)
-	bool fetchMeshSkinInfo(const LLUUID& mesh_id);
+	bool fetchMeshSkinInfo(const LLUUID& mesh_id, bool can_use_cache = true);
 
 	//send request for decomposition, returns true if header info exists 
 	//  (should hold onto mesh_id and try again later if header info does not exist)
-	bool fetchMeshDecomposition(const LLUUID& mesh_id);
+	bool fetchMeshDecomposition(const LLUUID& mesh_id, bool can_use_cache = true);
 
 	//send request for PhysicsShape, returns true if header info exists 
 	//  (should hold onto mesh_id and try again later if header info does not exist)
-	bool fetchMeshPhysicsShape(const LLUUID& mesh_id);
+	bool fetchMeshPhysicsShape(const LLUUID& mesh_id, bool can_use_cache = true);
 
 
 };
@@ -197,6 +197,45 @@ S32 AABBSphereIntersectR2(const LLVector4a& min, const LLVector4a& max, const LL
 	return 1;
 }
 
+void AABBSphereIntersect4(const LLVector4a* min, const LLVector4a* max, const LLVector3 &origin, const F32 &rad, S32* results)
+{
+	LLVector4a r, o, zero, lo, hi, t, dmin, dmax, d;
+	r.splat(rad*rad);
+	zero.clear();
+	dmin.clear();
+	dmax.clear();
+	d.clear();
+
+	for (U32 i = 0; i < 3; i++)
+	{
+		o.splat(origin.mV[i]);
+		lo.setSub(min[i], o);
+		hi.setSub(o, max[i]);
+
+		//squared distances from the origin to the min and max corners
+		t.setMul(lo, lo);
+		dmin.add(t);
+		t.setMul(hi, hi);
+		dmax.add(t);
+
+		//squared distance from the origin to the boxes, at most one of
+		//lo and hi is positive
+		lo.setMax(lo, zero);
+		hi.setMax(hi, zero);
+		t.setAdd(lo, hi);
+		t.mul(t);
+		d.add(t);
+	}
+
+	U32 inside = dmin.lessThan(r).getGatheredBits() & dmax.lessThan(r).getGatheredBits();
+	U32 outside = d.greaterThan(r).getGatheredBits();
+	for (U32 i = 0; i < 4; i++)
+	{
+		U32 bit = 1 << i;
+		results[i] = (inside & bit) ? 2 : ((outside & bit) ? 0 : 1);
+	}
+}
+
 
 typedef enum
 {
@@ -377,6 +416,9 @@ LLSpatialGroup::~LLSpatialGroup()
 	
 	sNodeCount--;
 
+	ll_aligned_free_16(mChildBounds);
+	mChildBounds = NULL;
+
 	if (gGLManager.mHasOcclusionQuery)
 	{
 		for (U32 i = 0; i < LLViewerCamera::NUM_CAMERAS; ++i)
@@ -914,6 +956,19 @@ void LLSpatialGroup::shift(const LLVector4a &offset)
 	mObjectExtents[0].add(offset);
 	mObjectExtents[1].add(offset);
 
+	LLVector4a* block = mChildBounds;
+	for (U32 i = 0; i < mChildBoundsCount; i += 4, block += CHILD_BOUNDS_STRIDE)
+	{
+		for (U32 j = 0; j < 3; j++)
+		{
+			LLVector4a t;
+			t.splat(offset[j]);
+			block[CHILD_CENTER + j].add(t);
+			block[CHILD_EXTENTS_MIN + j].add(t);
+			block[CHILD_EXTENTS_MAX + j].add(t);
+		}
+	}
+
 	//if (!mSpatialPartition->mRenderByGroup)
 	{
 		setState(GEOM_DIRTY);
@@ -1193,6 +1248,9 @@ LLSpatialGroup::LLSpatialGroup(OctreeNode* node, LLSpatialPartition* part) :
 
 	mViewAngle.splat(0.f);
 	mLastUpdateViewAngle.splat(-1.f);
+	mChildBounds = NULL;
+	mChildBoundsCount = 0;
+	mChildBoundsBlocks = 0;
 	mExtents[0] = mExtents[1] = mObjectBounds[0] = mObjectBounds[0] = mObjectBounds[1] = 
 		mObjectExtents[0] = mObjectExtents[1] = mViewAngle;
 
@@ -1489,12 +1547,14 @@ BOOL LLSpatialGroup::rebound()
 		mExtents[1] = group->mExtents[1];
 		
 		group->setState(SKIP_FRUSTUM_CHECK);
+		mChildBoundsCount = 0;
 	}
 	else if (mOctreeNode->isLeaf())
 	{ //copy object bounding box if this is a leaf
 		boundObjects(TRUE, mExtents[0], mExtents[1]);
 		mBounds[0] = mObjectBounds[0];
 		mBounds[1] = mObjectBounds[1];
+		mChildBoundsCount = 0;
 	}
 	else
 	{
@@ -1520,6 +1580,8 @@ BOOL LLSpatialGroup::rebound()
 			newMin.setMin(newMin, min);
 		}
 
+		updateChildBounds();
+
 		boundObjects(FALSE, newMin, newMax);
 		
 		mBounds[0].setAdd(newMin, newMax);
@@ -1535,6 +1597,34 @@ BOOL LLSpatialGroup::rebound()
 	return TRUE;
 }
 
+void LLSpatialGroup::updateChildBounds()
+{
+	U32 count = mOctreeNode->getChildCount();
+	U32 blocks = (count + 3) / 4;
+	if (blocks > mChildBoundsBlocks)
+	{
+		ll_aligned_free_16(mChildBounds);
+		mChildBounds = (LLVector4a*) ll_aligned_malloc_16(sizeof(LLVector4a) * CHILD_BOUNDS_STRIDE * blocks);
+		mChildBoundsBlocks = blocks;
+	}
+	mChildBoundsCount = count;
+
+	//unused lanes of the last block repeat the last child
+	for (U32 i = 0; i < blocks * 4; i++)
+	{
+		LLSpatialGroup* group = (LLSpatialGroup*) mOctreeNode->getChild(llmin(i, count - 1))->getListener(0);
+		LLVector4a* block = mChildBounds + (i / 4) * CHILD_BOUNDS_STRIDE;
+		U32 lane = i % 4;
+		for (U32 j = 0; j < 3; j++)
+		{
+			block[CHILD_CENTER + j].getF32ptr()[lane] = group->mBounds[0][j];
+			block[CHILD_RADIUS + j].getF32ptr()[lane] = group->mBounds[1][j];
+			block[CHILD_EXTENTS_MIN + j].getF32ptr()[lane] = group->mExtents[0][j];
+			block[CHILD_EXTENTS_MAX + j].getF32ptr()[lane] = group->mExtents[1][j];
+		}
+	}
+}
+
 static LLFastTimer::DeclareTimer FTM_OCCLUSION_READBACK("Readback Occlusion");
 void LLSpatialGroup::checkOcclusion()
 {
@@ -1902,6 +1992,19 @@ public:
 		return res;
 	}
 
+	//frustumCheck of four children at once, block is a block of LLSpatialGroup::getChildBounds
+	virtual void frustumCheckChildren(const LLVector4a* block, S32* res)
+	{
+		mCamera->AABBInFrustumNoFarClip4(block + LLSpatialGroup::CHILD_CENTER, block + LLSpatialGroup::CHILD_RADIUS, res);
+		S32 sphere[4];
+		AABBSphereIntersect4(block + LLSpatialGroup::CHILD_EXTENTS_MIN, block + LLSpatialGroup::CHILD_EXTENTS_MAX, 
+			mCamera->getOrigin(), mCamera->mFrustumCornerDist, sphere);
+		for (U32 i = 0; i < 4; i++)
+		{
+			res[i] = llmin(res[i], sphere[i]);
+		}
+	}
+
 	virtual S32 frustumCheckObjects(const LLSpatialGroup* group)
 	{
 		S32 res = mCamera->AABBInFrustumNoFarClip(group->mObjectBounds[0], group->mObjectBounds[1]);
@@ -1972,6 +2075,11 @@ public:
 		return mCamera->AABBInFrustumNoFarClip(group->mBounds[0], group->mBounds[1]);
 	}
 
+	virtual void frustumCheckChildren(const LLVector4a* block, S32* res)
+	{
+		mCamera->AABBInFrustumNoFarClip4(block + LLSpatialGroup::CHILD_CENTER, block + LLSpatialGroup::CHILD_RADIUS, res);
+	}
+
 	virtual S32 frustumCheckObjects(const LLSpatialGroup* group)
 	{
 		S32 res = mCamera->AABBInFrustumNoFarClip(group->mObjectBounds[0], group->mObjectBounds[1]);
@@ -1990,12 +2098,112 @@ public:
 		return mCamera->AABBInFrustum(group->mBounds[0], group->mBounds[1]);
 	}
 
+	virtual void frustumCheckChildren(const LLVector4a* block, S32* res)
+	{
+		mCamera->AABBInFrustum4(block + LLSpatialGroup::CHILD_CENTER, block + LLSpatialGroup::CHILD_RADIUS, res);
+	}
+
 	virtual S32 frustumCheckObjects(const LLSpatialGroup* group)
 	{
 		return mCamera->AABBInFrustum(group->mObjectBounds[0], group->mObjectBounds[1]);
 	}
 };
 
+// Frustum pass of a cull with T, collects the groups that T would visit
+// instead of processing them. Occlusion is left to the occlusion pass, as
+// reading back occlusion queries needs the GL context.
+// The children of a visited group are frustum checked four at a time from
+// its cached child bounds, giving the same results as T::frustumCheck.
+template <class T>
+class LLOctreeCullFrustum : public T
+{
+public:
+	LLOctreeCullFrustum(LLCamera* camera, LLSpatialPartition::cull_node_list_t& nodes)
+		: T(camera), mNodes(nodes), mDepth(0), mNextRes(-1) { }
+
+	virtual bool earlyFail(LLSpatialGroup* group)
+	{
+		return false;
+	}
+
+	virtual void traverse(const LLSpatialGroup::OctreeNode* n)
+	{
+		//pick up the result computed for n when its parent was visited
+		mNextRes = -1;
+		if (mDepth < mChildRes.size() && mChildRes[mDepth].mValid)
+		{
+			ChildResults& parent = mChildRes[mDepth];
+			mNextRes = parent.mRes[parent.mNext++];
+		}
+
+		++mDepth;
+		size_t count = mNodes.size();
+		T::traverse(n);
+		if (mNodes.size() == count)
+		{ //failed the frustum check, the occlusion pass still runs earlyFail on it
+			LLSpatialPartition::CullNode node;
+			node.mGroup = (LLSpatialGroup*) n->getListener(0);
+			node.mDepth = mDepth;
+			node.mHasObjects = false;
+			mNodes.push_back(node);
+		}
+		--mDepth;
+	}
+
+	virtual S32 frustumCheck(const LLSpatialGroup* group)
+	{
+		S32 res = mNextRes;
+		mNextRes = -1;
+		return res >= 0 ? res : T::frustumCheck(group);
+	}
+
+	virtual void visit(const LLSpatialGroup::OctreeNode* branch)
+	{
+		LLSpatialPartition::CullNode node;
+		node.mGroup = (LLSpatialGroup*) branch->getListener(0);
+		node.mDepth = mDepth;
+		node.mHasObjects = this->checkObjects(branch, node.mGroup);
+		mNodes.push_back(node);
+
+		if (mChildRes.size() <= mDepth)
+		{
+			mChildRes.resize(mDepth + 1);
+		}
+
+		ChildResults& children = mChildRes[mDepth];
+		U32 count = branch->getChildCount();
+		//children of a group fully in the frustum are not checked
+		children.mValid = this->mRes != 2 && count > 1 &&
+			!node.mGroup->isState(LLSpatialGroup::DIRTY) &&
+			node.mGroup->getChildBoundsCount() == count;
+
+		if (children.mValid)
+		{
+			children.mNext = 0;
+			const LLVector4a* block = node.mGroup->getChildBounds();
+			for (U32 i = 0; i < count; i += 4)
+			{
+				this->frustumCheckChildren(block, children.mRes + i);
+				block += LLSpatialGroup::CHILD_BOUNDS_STRIDE;
+			}
+		}
+	}
+
+	struct ChildResults
+	{
+		S32 mRes[8];
+		U32 mNext;
+		bool mValid;
+
+		ChildResults() : mNext(0), mValid(false) { }
+	};
+
+	LLSpatialPartition::cull_node_list_t& mNodes;
+	std::vector<ChildResults> mChildRes; // indexed by the depth of the parent
+	U32 mDepth;
+	S32 mNextRes;
+};
+
 class LLOctreeCullVisExtents: public LLOctreeCullShadow
 {
 public:
@@ -2297,6 +2505,28 @@ BOOL LLSpatialPartition::visibleObjectsInFrustum(LLCamera& camera)
 S32 LLSpatialPartition::cull(LLCamera &camera, std::vector<LLDrawable *>* results, BOOL for_select)
 {
 	LLMemType mt(LLMemType::MTYPE_SPACE_PARTITION);
+	reboundOctree();
+	
+	if (for_select)
+	{
+		LLOctreeSelect selecter(&camera, results);
+		selecter.traverse(mOctree);
+	}
+	else
+	{
+		cull_node_list_t nodes;
+		{
+			LLFastTimer ftm(FTM_FRUSTUM_CULL);
+			cullFrustum(camera, nodes);
+		}
+		cullOcclusion(camera, nodes);
+	}
+	
+	return 0;
+}
+
+void LLSpatialPartition::reboundOctree()
+{
 #if LL_OCTREE_PARANOIA_CHECK
 	((LLSpatialGroup*)mOctree->getListener(0))->checkStates();
 #endif
@@ -2309,33 +2539,50 @@ S32 LLSpatialPartition::cull(LLCamera &camera, std::vector<LLDrawable *>* result
 #if LL_OCTREE_PARANOIA_CHECK
 	((LLSpatialGroup*)mOctree->getListener(0))->validate();
 #endif
+}
 
-	
-	if (for_select)
-	{
-		LLOctreeSelect selecter(&camera, results);
-		selecter.traverse(mOctree);
-	}
-	else if (LLPipeline::sShadowRender)
+void LLSpatialPartition::cullFrustum(LLCamera& camera, cull_node_list_t& nodes)
+{
+	// No fast timers or memory tracking here, this may run on a cull thread
+	if (LLPipeline::sShadowRender)
 	{
-		LLFastTimer ftm(FTM_FRUSTUM_CULL);
-		LLOctreeCullShadow culler(&camera);
+		LLOctreeCullFrustum<LLOctreeCullShadow> culler(&camera, nodes);
 		culler.traverse(mOctree);
 	}
 	else if (mInfiniteFarClip || !LLPipeline::sUseFarClip)
 	{
-		LLFastTimer ftm(FTM_FRUSTUM_CULL);		
-		LLOctreeCullNoFarClip culler(&camera);
+		LLOctreeCullFrustum<LLOctreeCullNoFarClip> culler(&camera, nodes);
 		culler.traverse(mOctree);
 	}
 	else
 	{
-		LLFastTimer ftm(FTM_FRUSTUM_CULL);		
-		LLOctreeCull culler(&camera);
+		LLOctreeCullFrustum<LLOctreeCull> culler(&camera, nodes);
 		culler.traverse(mOctree);
 	}
-	
-	return 0;
+}
+
+void LLSpatialPartition::cullOcclusion(LLCamera& camera, const cull_node_list_t& nodes)
+{
+	LLOctreeCull culler(&camera);
+	U32 skip_depth = 0;
+
+	for (cull_node_list_t::const_iterator iter = nodes.begin(); iter != nodes.end(); ++iter)
+	{
+		if (skip_depth && iter->mDepth > skip_depth)
+		{ //below a group that failed early
+			continue;
+		}
+		skip_depth = 0;
+
+		if (culler.earlyFail(iter->mGroup))
+		{
+			skip_depth = iter->mDepth;
+		}
+		else if (iter->mHasObjects)
+		{
+			culler.processGroup(iter->mGroup);
+		}
+	}
 }
 
 BOOL earlyFail(LLCamera* camera, LLSpatialGroup* group)
@@ -4593,5 +4840,182 @@ void LLCullResult::assertDrawMapsEmpty()
 	}
 }
 
+LLSpatialCullPool::LLSpatialCullPool(U32 num_threads)
+: mCondition(NULL),
+  mJobCount(0),
+  mActiveJobs(0),
+  mNextJob(0),
+  mQueued(0)
+{
+	for (U32 i = 0; i < num_threads; ++i)
+	{
+		mWorkers.push_back(new Worker(this, i));
+	}
+	for (U32 i = 0; i < mWorkers.size(); ++i)
+	{
+		mWorkers[i]->start();
+	}
+}
+
+LLSpatialCullPool::~LLSpatialCullPool()
+{
+	shutdown();
+	for_each(mWorkers.begin(), mWorkers.end(), DeletePointer());
+	mWorkers.clear();
+}
+
+void LLSpatialCullPool::shutdown()
+{
+	for (U32 i = 0; i < mWorkers.size(); ++i)
+	{
+		mWorkers[i]->shutdown();
+	}
+}
+
+void LLSpatialCullPool::addPartition(LLSpatialPartition* part, S32 water_clip, F32 water_height)
+{
+	if (mJobCount == mJobs.size())
+	{
+		mJobs.resize(mJobCount + 1);
+	}
+
+	Job& job = mJobs[mJobCount++];
+	job.mPartition = part;
+	job.mWaterClip = water_clip;
+	job.mWaterHeight = water_height;
+	job.mDone = false;
+}
+
+void LLSpatialCullPool::cull(LLCamera& camera)
+{
+	mCamera = camera;
+	{
+		LLMutexLock lock(&mCondition);
+		mActiveJobs = mJobCount;
+		mNextJob = 0;
+		mQueued = (S32) mJobCount;
+	}
+
+	for (U32 i = 0; i < mWorkers.size(); ++i)
+	{
+		mWorkers[i]->wake();
+	}
+
+	for (U32 i = 0; i < mJobCount; ++i)
+	{
+		Job& job = mJobs[i];
+
+		mCondition.lock();
+		while (!job.mDone)
+		{
+			Job* next = popJob();
+			if (next)
+			{ //help with the frustum checks rather than wait for them
+				mCondition.unlock();
+				runJob(next);
+				mCondition.lock();
+				next->mDone = true;
+			}
+			else
+			{
+				mCondition.wait();
+			}
+		}
+		mCondition.unlock();
+
+		//bridged drawables are culled with the camera of the occlusion pass
+		setClipPlane(camera, job);
+		job.mPartition->cullOcclusion(camera, job.mNodes);
+	}
+
+	camera.disableUserClipPlane();
+
+	{
+		LLMutexLock lock(&mCondition);
+		mActiveJobs = 0;
+		mNextJob = 0;
+	}
+	mJobCount = 0;
+}
+
+LLSpatialCullPool::Job* LLSpatialCullPool::popJob()
+{
+	// mCondition must be locked here
+	if (mNextJob >= mActiveJobs)
+	{
+		return NULL;
+	}
+	mQueued--;
+	return &mJobs[mNextJob++];
+}
+
+//static
+void LLSpatialCullPool::setClipPlane(LLCamera& camera, const Job& job)
+{
+	if (job.mWaterClip != 0)
+	{
+		LLPlane plane(LLVector3(0,0, (F32) -job.mWaterClip), (F32) job.mWaterClip*job.mWaterHeight);
+		camera.setUserClipPlane(plane);
+	}
+	else
+	{
+		camera.disableUserClipPlane();
+	}
+}
+
+void LLSpatialCullPool::runJob(Job* job)
+{
+	LLCamera camera(mCamera);
+	setClipPlane(camera, *job);
+
+	job->mNodes.clear();
+	job->mPartition->cullFrustum(camera, job->mNodes);
+}
+
+void LLSpatialCullPool::jobDone(Job* job)
+{
+	LLMutexLock lock(&mCondition);
+	job->mDone = true;
+	mCondition.signal();
+}
+
+LLSpatialCullPool::Worker::Worker(LLSpatialCullPool* owner, S32 index)
+: LLThread(llformat("cull %d", index)),
+  mOwner(owner)
+{
+}
+
+//virtual
+bool LLSpatialCullPool::Worker::runCondition()
+{
+	// mRunCondition must be locked here
+	return mOwner->mQueued > 0;
+}
+
+//virtual
+void LLSpatialCullPool::Worker::run()
+{
+	while (1)
+	{
+		// blocks until there is a job to start, or we are quitting
+		checkPause();
+		if (isQuitting())
+		{
+			break;
+		}
+
+		Job* job;
+		{
+			LLMutexLock lock(&mOwner->mCondition);
+			job = mOwner->popJob();
+		}
+		if (job)
+		{
+			mOwner->runJob(job);
+			mOwner->jobDone(job);
+		}
+	}
+}
+
 
 
@@ -40,6 +40,7 @@
 #include "llface.h"
 #include "llviewercamera.h"
 #include "llvector4a.h"
+#include "llthread.h"
 #include <queue>
 
 #define SG_STATE_INHERIT_MASK (OCCLUDED)
@@ -53,6 +54,8 @@ class LLTextureAtlasSlot;
 
 S32 AABBSphereIntersect(const LLVector4a& min, const LLVector4a& max, const LLVector3 &origin, const F32 &rad);
 S32 AABBSphereIntersectR2(const LLVector4a& min, const LLVector4a& max, const LLVector3 &origin, const F32 &radius_squared);
+// AABBSphereIntersect() on 4 boxes, in the form of LLCamera::AABBInFrustum4()
+void AABBSphereIntersect4(const LLVector4a* min, const LLVector4a* max, const LLVector3 &origin, const F32 &rad, S32* results);
 
 S32 AABBSphereIntersect(const LLVector3& min, const LLVector3& max, const LLVector3 &origin, const F32 &rad);
 S32 AABBSphereIntersectR2(const LLVector3& min, const LLVector3& max, const LLVector3 &origin, const F32 &radius_squared);
@@ -269,6 +272,7 @@ public:
 		NEW_DRAWINFO			= 0x00000400,
 		IN_BUILD_Q1				= 0x00000800,
 		IN_BUILD_Q2				= 0x00001000,
+		GEOM_QUEUED				= 0x00002000, //mesh is being generated by LLVolumeGeometryPool
 		STATE_MASK				= 0x0000FFFF,
 	} eSpatialState;
 
@@ -378,8 +382,29 @@ public:
 	LLVector4a mObjectBounds[2]; // bounding box (center, size) of objects in this node
 	LLVector4a mViewAngle;
 	LLVector4a mLastUpdateViewAngle;
+
+	typedef enum
+	{
+		CHILD_CENTER = 0,		// x, y, z of mBounds[0]
+		CHILD_RADIUS = 3,		// x, y, z of mBounds[1]
+		CHILD_EXTENTS_MIN = 6,	// x, y, z of mExtents[0]
+		CHILD_EXTENTS_MAX = 9,	// x, y, z of mExtents[1]
+		CHILD_BOUNDS_STRIDE = 12
+	} eChildBoundsIndex;
+
+	// Bounds of the children of the node, for culling them 4 at a time (see
+	// LLCamera::AABBInFrustum4()): blocks of CHILD_BOUNDS_STRIDE vectors, lane
+	// n of a block holding child 4*block+n. Filled in by rebound().
+	const LLVector4a* getChildBounds() const { return mChildBounds; }
+	U32 getChildBoundsCount() const { return mChildBoundsCount; } // 0 if not filled in
 		
 private:
+	void updateChildBounds();
+
+	LLVector4a* mChildBounds;
+	U32 mChildBoundsCount;
+	U32 mChildBoundsBlocks; // allocated blocks
+
 	U32                     mCurUpdatingTime ;
 	//do not make the below two to use LLPointer
 	//because mCurUpdatingTime invalidates them automatically.
@@ -466,8 +491,25 @@ public:
 	virtual void rebuildGeom(LLSpatialGroup* group);
 	virtual void rebuildMesh(LLSpatialGroup* group);
 
+	// Group of the octree reached by the frustum checks of a cull, groups that
+	// failed the frustum check are kept so their occlusion state is updated
+	struct CullNode
+	{
+		LLSpatialGroup* mGroup;
+		U32 mDepth;			// depth in the octree, 1 for the root
+		bool mHasObjects;	// the group is in the frustum and its objects may be too
+	};
+	typedef std::vector<CullNode> cull_node_list_t;
+
 	BOOL visibleObjectsInFrustum(LLCamera& camera);
 	S32 cull(LLCamera &camera, std::vector<LLDrawable *>* results = NULL, BOOL for_select = FALSE); // Cull on arbitrary frustum
+
+	// cull() in passes, so that the frustum checks can run on another thread.
+	// reboundOctree() and cullOcclusion() are main thread only, cullFrustum()
+	// only reads the octree and collects the groups in traversal order.
+	void reboundOctree();
+	void cullFrustum(LLCamera& camera, cull_node_list_t& nodes);
+	void cullOcclusion(LLCamera& camera, const cull_node_list_t& nodes);
 	
 	BOOL isVisible(const LLVector3& v);
 	
@@ -603,6 +645,62 @@ private:
 	drawinfo_list_t::iterator mRenderMapEnd[LLRenderPass::NUM_RENDER_TYPES];
 };
 
+// Culls spatial partitions for one camera. The frustum checks of the
+// partitions run on a pool of threads, while the main thread runs the
+// occlusion checks (which issue GL queries) and fills the cull result,
+// one partition at a time in the order they were added.
+class LLSpatialCullPool
+{
+public:
+	LLSpatialCullPool(U32 num_threads);
+	~LLSpatialCullPool();
+
+	// Main thread only.
+	// part must have been rebound. It is culled with the user clip plane
+	// of the water of its region if water_clip is not 0.
+	void addPartition(LLSpatialPartition* part, S32 water_clip, F32 water_height);
+	// Culls the partitions added since the last call.
+	void cull(LLCamera& camera);
+	void shutdown();
+
+private:
+	struct Job
+	{
+		LLSpatialPartition* mPartition;
+		S32 mWaterClip;
+		F32 mWaterHeight;
+		bool mDone;
+		LLSpatialPartition::cull_node_list_t mNodes; // kept to reuse its storage
+	};
+
+	class Worker : public LLThread
+	{
+	public:
+		Worker(LLSpatialCullPool* owner, S32 index);
+
+	protected:
+		/*virtual*/ bool runCondition();
+		/*virtual*/ void run();
+
+	private:
+		LLSpatialCullPool* mOwner;
+	};
+	friend class Worker;
+
+	Job* popJob();
+	void runJob(Job* job);
+	void jobDone(Job* job);
+	static void setClipPlane(LLCamera& camera, const Job& job);
+
+	LLCamera mCamera; // copy of the camera of the cull in progress, the main thread changes its clip plane
+	LLCondition mCondition; // signaled when a job is done
+	std::vector<Job> mJobs;
+	U32 mJobCount; // jobs added for the next cull
+	U32 mActiveJobs; // jobs of the cull in progress, protected by mCondition
+	U32 mNextJob; // protected by mCondition
+	LLAtomic32<S32> mQueued; // jobs not started yet, for Worker::runCondition()
+	std::vector<Worker*> mWorkers; // empty to cull on the main thread
+};
 
 //spatial partition for water (implemented in LLVOWater.cpp)
 class LLWaterPartition : public LLSpatialPartition
@@ -690,6 +788,93 @@ class LLVolumeGeometryManager: public LLGeometryManager
 	void registerFace(LLSpatialGroup* group, LLFace* facep, U32 type);
 };
 
+// Generates the mesh of volume groups for LLVolumeGeometryManager::rebuildMesh()
+// on worker threads. The main thread gathers the inputs of each face and
+// copies the results into the vertex buffers, the workers only read volume
+// faces and write to staging memory. A group keeps the GEOM_QUEUED state
+// until its mesh is uploaded.
+// Jobs read the volumes of their faces, so sync() must be called before
+// anything may change them.
+class LLVolumeGeometryPool
+{
+public:
+	LLVolumeGeometryPool(U32 num_threads);
+	~LLVolumeGeometryPool();
+
+	// Main thread only.
+	// Queues the faces of group that need a rebuild, FALSE if there are
+	// no workers or no such faces. The workers are started by the first call.
+	BOOL queueGroup(LLSpatialGroup* group);
+	// Uploads the mesh of a queued group, generating it here if no worker
+	// has started on it yet.
+	void finishGroup(LLSpatialGroup* group);
+	// Uploads the meshes generated so far until max_dtime has passed.
+	void drain(F32 max_dtime);
+	// Generates the meshes of all queued groups, they are uploaded later.
+	void sync();
+	// Uploads the meshes of all queued groups.
+	void finish();
+	void shutdown();
+
+private:
+	struct FaceJob
+	{
+		LLPointer<LLDrawable> mDrawable;
+		S32 mFaceIndex;
+		LLPointer<LLVertexBuffer> mBuffer;
+		U16 mGeomIndex;
+		U16 mGeomCount;
+		S32 mIndicesIndex;
+		S32 mIndicesCount;
+		LLFace::GeometryParams mParams;
+		S32 mOffset[LLVertexBuffer::TYPE_MAX]; // of each attribute in Job::mData, -1 if not rebuilt
+		S32 mIndexOffset; // of the indices in Job::mData, -1 if not rebuilt
+	};
+
+	struct Job
+	{
+		typedef enum
+		{
+			QUEUED = 0,
+			RUNNING,
+			DONE
+		} eJobState;
+
+		LLPointer<LLSpatialGroup> mGroup;
+		std::vector<LLPointer<LLVolume> > mVolumes; // keeps the volumes read alive
+		std::vector<FaceJob> mFaces;
+		U8* mData; // staging memory
+		eJobState mState; // protected by mCondition
+	};
+
+	class Worker : public LLThread
+	{
+	public:
+		Worker(LLVolumeGeometryPool* owner, S32 index);
+
+	protected:
+		/*virtual*/ bool runCondition();
+		/*virtual*/ void run();
+
+	private:
+		LLVolumeGeometryPool* mOwner;
+	};
+	friend class Worker;
+
+	Job* popJob();
+	void runJob(Job* job);
+	void jobDone(Job* job);
+	void waitForJob(Job* job);
+	void uploadJob(Job* job);
+
+	LLCondition mCondition; // signaled when a job is done
+	std::deque<Job*> mQueue; // jobs not started yet, protected by mCondition
+	std::list<Job*> mJobs; // jobs not uploaded yet, in queue order
+	LLAtomic32<S32> mQueued; // size of mQueue, for Worker::runCondition()
+	U32 mNumThreads; // 0 to generate meshes in rebuildMesh()
+	std::vector<Worker*> mWorkers; // empty until a group is queued
+};
+
 //spatial partition that uses volume geometry manager (implemented in LLVOVolume.cpp)
 class LLVolumePartition : public LLSpatialPartition, public LLVolumeGeometryManager
 {
@@ -39,7 +39,7 @@
 
 // Cache organization:
 // cache/texture.entries
-//  Unordered array of Entry structs
+//  Unordered array of Entry structs, memory mapped and looked up through mHeaderIDMap
 // cache/texture.cache
 //  First TEXTURE_CACHE_ENTRY_SIZE bytes of each texture in texture.entries in same order
 // cache/textures/[0-F]/UUID.texture
@@ -49,6 +49,22 @@
 const S32 TEXTURE_CACHE_ENTRY_SIZE = FIRST_PACKET_SIZE;//1024;
 const F32 TEXTURE_CACHE_PURGE_AMOUNT = .20f; // % amount to reduce the cache by when it exceeds its limit
 const F32 TEXTURE_CACHE_LRU_SIZE = .10f; // % amount for LRU list (low overhead to regenerate)
+const U32 TEXTURE_CACHE_MAX_THREADS = 16;
+const S32 TEXTURE_PACK_COMPACT_STEP = 1024 * 1024; // bytes moved per compaction step
+
+// Additional cache I/O thread, see LLTextureCache::getShardIndex()
+class LLTextureCacheShard : public LLWorkerThread
+{
+public:
+	LLTextureCacheShard(const std::string& name, bool threaded)
+		: LLWorkerThread(name, threaded)
+	{
+	}
+	~LLTextureCacheShard()
+	{
+		clearDeleteList() ;
+	}
+};
 
 class LLTextureCacheWorker : public LLWorkerClass
 {
@@ -92,8 +108,11 @@ public:
 						 U8* data, S32 datasize, S32 offset,
 						 S32 imagesize, // for writes
 						 LLTextureCache::Responder* responder)
-		: LLWorkerClass(cache, "LLTextureCacheWorker"),
+		: LLWorkerClass(cache->mShards[cache->getShardIndex(id)], "LLTextureCacheWorker"),
 		  mID(id),
+		  mShard(cache->getShardIndex(id)),
+		  mCacheHandle(LLWorkerThread::nullHandle()),
+		  mStartTime(0),
 		  mCache(cache),
 		  mPriority(priority),
 		  mReadData(NULL),
@@ -122,9 +141,10 @@ public:
 
 	virtual bool doWork(S32 param); // Called from LLWorkerThread::processRequest()
 
-	handle_t read() { addWork(0, LLWorkerThread::PRIORITY_HIGH | mPriority); return mRequestHandle; }
-	handle_t write() { addWork(1, LLWorkerThread::PRIORITY_HIGH | mPriority); return mRequestHandle; }
+	void read() { mStartTime = totalTime(); addWork(0, LLWorkerThread::PRIORITY_HIGH | mPriority); }
+	void write() { mStartTime = totalTime(); addWork(1, LLWorkerThread::PRIORITY_HIGH | mPriority); }
 	bool complete() { return checkWork(); }
+	void abort() { mWorkerThread->abortRequest(mRequestHandle, true); }
 	void ioComplete(S32 bytes)
 	{
 		mBytesRead = bytes;
@@ -140,6 +160,9 @@ protected:
 	LLTextureCache* mCache;
 	U32 mPriority;
 	LLUUID	mID;
+	S32 mShard;
+	handle_t mCacheHandle; // handle returned by LLTextureCache, see addWorker()
+	U64 mStartTime; // when the request was queued, in microseconds
 	
 	U8* mReadData;
 	U8* mWriteData;
@@ -176,7 +199,7 @@ private:
 
 bool LLTextureCacheLocalFileWorker::doRead()
 {
-	S32 local_size = LLAPRFile::size(mFileName, mCache->getLocalAPRFilePool());
+	S32 local_size = LLAPRFile::size(mFileName, mWorkerThread->getLocalAPRFilePool());
 
 	if (local_size > 0 && mFileName.size() > 4)
 	{
@@ -220,7 +243,7 @@ bool LLTextureCacheLocalFileWorker::doRead()
 		mBytesToRead = mDataSize;
 		setPriority(LLWorkerThread::PRIORITY_LOW | mPriority);
 		mFileHandle = LLLFSThread::sLocal->read(local_filename, mReadData, mOffset, mDataSize,
-												new ReadResponder(mCache, mRequestHandle));
+												new ReadResponder(mCache, mCacheHandle));
 		return false;
 	}
 	else
@@ -250,7 +273,7 @@ bool LLTextureCacheLocalFileWorker::doRead()
 	}
 	mReadData = new U8[mDataSize];
 	
-	S32 bytes_read = LLAPRFile::readEx(mFileName, mReadData, mOffset, mDataSize, mCache->getLocalAPRFilePool());	
+	S32 bytes_read = LLAPRFile::readEx(mFileName, mReadData, mOffset, mDataSize, mWorkerThread->getLocalAPRFilePool());	
 
 	if (bytes_read != mDataSize)
 	{
@@ -331,7 +354,7 @@ bool LLTextureCacheRemoteWorker::doRead()
 		// Is it a JPEG2000 file? 
 		{
 			local_filename = filename + ".j2c";
-			local_size = LLAPRFile::size(local_filename, mCache->getLocalAPRFilePool());
+			local_size = LLAPRFile::size(local_filename, mWorkerThread->getLocalAPRFilePool());
 			if (local_size > 0)
 			{
 				mImageFormat = IMG_CODEC_J2C;
@@ -341,7 +364,7 @@ bool LLTextureCacheRemoteWorker::doRead()
 		if (local_size == 0)
 		{
 			local_filename = filename + ".jpg";
-			local_size = LLAPRFile::size(local_filename, mCache->getLocalAPRFilePool());
+			local_size = LLAPRFile::size(local_filename, mWorkerThread->getLocalAPRFilePool());
 			if (local_size > 0)
 			{
 				mImageFormat = IMG_CODEC_JPEG;
@@ -352,7 +375,7 @@ bool LLTextureCacheRemoteWorker::doRead()
 		if (local_size == 0)
 		{
 			local_filename = filename + ".tga";
-			local_size = LLAPRFile::size(local_filename, mCache->getLocalAPRFilePool());
+			local_size = LLAPRFile::size(local_filename, mWorkerThread->getLocalAPRFilePool());
 			if (local_size > 0)
 			{
 				mImageFormat = IMG_CODEC_TGA;
@@ -379,7 +402,7 @@ bool LLTextureCacheRemoteWorker::doRead()
 		// Allocate read buffer
 		mReadData = new U8[mDataSize];
 		S32 bytes_read = LLAPRFile::readEx(local_filename, 
-											 mReadData, mOffset, mDataSize, mCache->getLocalAPRFilePool());
+											 mReadData, mOffset, mDataSize, mWorkerThread->getLocalAPRFilePool());
 		if (bytes_read != mDataSize)
 		{
  			llwarns << "Error reading file from local cache: " << local_filename
@@ -431,7 +454,7 @@ bool LLTextureCacheRemoteWorker::doRead()
 		// Allocate the read buffer
 		mReadData = new U8[size];
 		S32 bytes_read = LLAPRFile::readEx(mCache->mHeaderDataFileName, 
-											 mReadData, offset, size, mCache->getLocalAPRFilePool());
+											 mReadData, offset, size, mWorkerThread->getLocalAPRFilePool());
 		if (bytes_read != size)
 		{
 			llwarns << "LLTextureCacheWorker: "  << mID
@@ -456,8 +479,7 @@ bool LLTextureCacheRemoteWorker::doRead()
 	// Fourth state / stage : read the rest of the data from the UUID based cached file
 	if (!done && (mState == BODY))
 	{
-		std::string filename = mCache->getTextureFileName(mID);
-		S32 filesize = LLAPRFile::size(filename, mCache->getLocalAPRFilePool());
+		S32 filesize = mCache->getBodySize(mID, mWorkerThread->getLocalAPRFilePool());
 
 		if (filesize && (filesize + TEXTURE_CACHE_ENTRY_SIZE) > mOffset)
 		{
@@ -497,10 +519,10 @@ bool LLTextureCacheRemoteWorker::doRead()
 			mReadData = data;
 
 			// Read the data at last
-			S32 bytes_read = LLAPRFile::readEx(filename, 
-											 mReadData + data_offset,
-											 file_offset, file_size,
-											 mCache->getLocalAPRFilePool());
+			S32 bytes_read = mCache->readBody(mID, 
+											  mReadData + data_offset,
+											  file_offset, file_size,
+											  mWorkerThread->getLocalAPRFilePool());
 			if (bytes_read != file_size)
 			{
 				llwarns << "LLTextureCacheWorker: "  << mID
@@ -516,7 +538,7 @@ bool LLTextureCacheRemoteWorker::doRead()
 		{
 			// No body, we're done.
 			mDataSize = llmax(TEXTURE_CACHE_ENTRY_SIZE - mOffset, 0);
-			lldebugs << "No body file for: " << filename << llendl;
+			lldebugs << "No body for: " << mID << llendl;
 		}	
 		// Nothing else to do at that point...
 		done = true;
@@ -601,13 +623,13 @@ bool LLTextureCacheRemoteWorker::doWrite()
 			U8* padBuffer = new U8[TEXTURE_CACHE_ENTRY_SIZE];
 			memset(padBuffer, 0, TEXTURE_CACHE_ENTRY_SIZE);		// Init with zeros
 			memcpy(padBuffer, mWriteData, mDataSize);			// Copy the write buffer
-			bytes_written = LLAPRFile::writeEx(mCache->mHeaderDataFileName, padBuffer, offset, size, mCache->getLocalAPRFilePool());
+			bytes_written = LLAPRFile::writeEx(mCache->mHeaderDataFileName, padBuffer, offset, size, mWorkerThread->getLocalAPRFilePool());
 			delete [] padBuffer;
 		}
 		else
 		{
 			// Write the header record (== first TEXTURE_CACHE_ENTRY_SIZE bytes of the raw file) in the header file
-			bytes_written = LLAPRFile::writeEx(mCache->mHeaderDataFileName, mWriteData, offset, size, mCache->getLocalAPRFilePool());
+			bytes_written = LLAPRFile::writeEx(mCache->mHeaderDataFileName, mWriteData, offset, size, mWorkerThread->getLocalAPRFilePool());
 		}
 
 		if (bytes_written <= 0)
@@ -637,13 +659,10 @@ bool LLTextureCacheRemoteWorker::doWrite()
 		S32 file_size = mDataSize - TEXTURE_CACHE_ENTRY_SIZE;
 		
 		{
-			// build the cache file name from the UUID
-			std::string filename = mCache->getTextureFileName(mID);			
-// 			llinfos << "Writing Body: " << filename << " Bytes: " << file_offset+file_size << llendl;
-			S32 bytes_written = LLAPRFile::writeEx(	filename, 
-													mWriteData + TEXTURE_CACHE_ENTRY_SIZE,
-													0, file_size,
-													mCache->getLocalAPRFilePool());
+			S32 bytes_written = mCache->writeBody(mID,
+												  mWriteData + TEXTURE_CACHE_ENTRY_SIZE,
+												  file_size,
+												  mWorkerThread->getLocalAPRFilePool());
 			if (bytes_written <= 0)
 			{
 				llwarns << "LLTextureCacheWorker: "  << mID
@@ -662,6 +681,52 @@ bool LLTextureCacheRemoteWorker::doWrite()
 	return done;
 }
 
+// Reads and writes LLTextureDecodedCache files on the cache thread of the texture
+class LLTextureCacheDecodedWorker : public LLTextureCacheWorker
+{
+public:
+	LLTextureCacheDecodedWorker(LLTextureCache* cache, U32 priority, const LLUUID& id, S32 discard,
+								U8* data, S32 datasize, // for writes, owned by the worker
+								LLTextureCache::Responder* responder)
+			: LLTextureCacheWorker(cache, priority, id, NULL, datasize, 0, 0, responder),
+			mDiscard(discard),
+			mPackedData(data)
+	{
+		mImageFormat = IMG_CODEC_INVALID; // not a formatted image
+	}
+	~LLTextureCacheDecodedWorker()
+	{
+		delete[] mPackedData;
+	}
+
+	virtual bool doRead();
+	virtual bool doWrite();
+
+private:
+	S32 mDiscard;
+	U8* mPackedData;
+};
+
+bool LLTextureCacheDecodedWorker::doRead()
+{
+	mReadData = mCache->mDecodedCache.read(mID, mDiscard, mDataSize);
+	if (!mReadData)
+	{
+		mDataSize = 0;
+	}
+	mImageSize = mDataSize;
+	return true;
+}
+
+bool LLTextureCacheDecodedWorker::doWrite()
+{
+	if (!mCache->mDecodedCache.write(mID, mDiscard, mPackedData, mDataSize))
+	{
+		mDataSize = 0;
+	}
+	return true;
+}
+
 //virtual
 bool LLTextureCacheWorker::doWork(S32 param)
 {
@@ -684,6 +749,7 @@ bool LLTextureCacheWorker::doWork(S32 param)
 //virtual (WORKER THREAD)
 void LLTextureCacheWorker::finishWork(S32 param, bool completed)
 {
+	mCache->addLatency(mShard, (F32)(totalTime() - mStartTime) * 0.000001f);
 	if (mResponder.notNull())
 	{
 		bool success = (completed && mDataSize > 0);
@@ -738,22 +804,290 @@ void LLTextureCacheWorker::endWork(S32 param, bool aborted)
 
 //////////////////////////////////////////////////////////////////////////////
 
-LLTextureCache::LLTextureCache(bool threaded)
+LLTextureCache::LLTextureCache(bool threaded, U32 num_threads)
 	: LLWorkerThread("TextureCache", threaded),
 	  mWorkersMutex(NULL),
 	  mHeaderMutex(NULL),
 	  mListMutex(NULL),
-	  mHeaderAPRFile(NULL),
+	  mNextCacheHandle(0),
 	  mReadOnly(TRUE), //do not allow to change the texture cache until setReadOnly() is called.
+	  mLRUTime(0),
+	  mUsePackFiles(false),
+	  mPackCompacting(0),
 	  mTexturesSizeTotal(0),
 	  mDoPurge(FALSE)
 {
+	// without threads everything runs from update() on the calling thread, one queue is enough.
+	num_threads = threaded ? llclamp(num_threads, 1U, TEXTURE_CACHE_MAX_THREADS) : 1;
+	mShards.push_back(this);
+	for (U32 i = 1; i < num_threads; i++)
+	{
+		mShards.push_back(new LLTextureCacheShard(llformat("TextureCache%d", i), threaded));
+	}
+	mShardStats.resize(num_threads);
 }
 
 LLTextureCache::~LLTextureCache()
 {
+	for (U32 i = 1; i < mShards.size(); i++)
+	{
+		delete mShards[i];
+	}
+	mShards.clear();
 	clearDeleteList() ;
 	writeUpdatedEntries() ;
+	unmapHeaderEntriesFile() ;
+}
+
+//virtual
+void LLTextureCache::shutdown()
+{
+	for (U32 i = 1; i < mShards.size(); i++)
+	{
+		mShards[i]->shutdown();
+	}
+	LLWorkerThread::shutdown();
+}
+
+void LLTextureCache::pause()
+{
+	for (U32 i = 0; i < mShards.size(); i++)
+	{
+		mShards[i]->LLThread::pause();
+	}
+}
+
+//virtual
+bool LLTextureCache::runCondition()
+{
+	// mRunCondition must be locked here
+	// Same as LLQueuedThread::runCondition() but also stays up while the packs need compacting
+	if (mRequestQueue.empty() && mIdleThread && !mPackCompacting)
+		return false;
+	else
+		return true;
+}
+
+//virtual
+// Called on the (first) cache thread, or from update() when not threaded.
+void LLTextureCache::threadedUpdate()
+{
+	// Compact the packs a step at a time between requests
+	if (mPackCompacting && !mReadOnly && getPending() == 0)
+	{
+		if (!mPackStore.compact(TEXTURE_PACK_COMPACT_STEP))
+		{
+			mPackCompacting = 0;
+		}
+	}
+}
+
+// Called from any thread
+S32 LLTextureCache::getShardIndex(const LLUUID& id)
+{
+	return (S32)(id.getCRC32() % (U32)mShards.size());
+}
+
+S32 LLTextureCache::getTotalPending()
+{
+	S32 pending = 0;
+	for (U32 i = 0; i < mShards.size(); i++)
+	{
+		pending += mShards[i]->getPending();
+	}
+	return pending;
+}
+
+void LLTextureCache::getShardStats(S32 shard, S32& pending, F32& avg_latency_ms, F32& max_latency_ms)
+{
+	pending = mShards[shard]->getPending();
+	LLMutexLock lock(&mListMutex);
+	const ShardStats& stats = mShardStats[shard];
+	avg_latency_ms = stats.mRequests ? (F32)(stats.mTotalLatency * 1000.0 / stats.mRequests) : 0.f;
+	max_latency_ms = stats.mMaxLatency * 1000.f;
+}
+
+// Called from the shard threads
+void LLTextureCache::addLatency(S32 shard, F32 latency)
+{
+	LLMutexLock lock(&mListMutex);
+	ShardStats& stats = mShardStats[shard];
+	stats.mRequests++;
+	stats.mTotalLatency += latency;
+	stats.mMaxLatency = llmax(stats.mMaxLatency, latency);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+LLTextureCache::EntryIndex::EntryIndex()
+	: mTable(NULL),
+	  mReaders(0)
+{
+}
+
+LLTextureCache::EntryIndex::~EntryIndex()
+{
+	delete mTable;
+	for_each(mRetired.begin(), mRetired.end(), DeletePointer());
+	mRetired.clear();
+}
+
+LLTextureCache::EntryIndex::Table::Table(U32 max_entries)
+	: mCount(0)
+{
+	// keep the load factor under 1/2 so misses stop early.
+	U32 num_slots = 1024;
+	while (num_slots < max_entries * 2)
+	{
+		num_slots <<= 1;
+	}
+	mSlots = new Slot[num_slots];
+	mMask = num_slots - 1;
+	for (U32 i = 0; i <= mMask; i++)
+	{
+		mSlots[i].mIndex = -1;
+	}
+}
+
+LLTextureCache::EntryIndex::Table::~Table()
+{
+	delete[] mSlots;
+}
+
+void LLTextureCache::EntryIndex::Table::insert(const LLUUID& id, S32 idx)
+{
+	llassert_always(idx >= 0 && mCount < mMask);
+	U32 key = id.getCRC32();
+	U32 i = key & mMask;
+	while (mSlots[i].mIndex >= 0)
+	{
+		i = (i + 1) & mMask;
+	}
+	// publish the index last, readers stop at the first empty slot.
+	mSlots[i].mKey = key;
+	mSlots[i].mIndex = idx;
+	mCount++;
+}
+
+//mHeaderMutex is locked before calling this.
+void LLTextureCache::EntryIndex::rebuild(const Entry* entries, U32 num_entries, U32 max_entries)
+{
+	// readers keep using the old table until the new one is complete.
+	Table* table = new Table(llmax(num_entries, max_entries));
+	for (U32 idx = 0; idx < num_entries; idx++)
+	{
+		if (entries[idx].mImageSize > entries[idx].mBodySize)
+		{
+			table->insert(entries[idx].mID, idx);
+		}
+	}
+
+	Table* old = (Table*)apr_atomic_xchgptr((volatile void**)&mTable, table);
+	if (old)
+	{
+		mRetired.push_back(old);
+	}
+	reclaim();
+}
+
+//mHeaderMutex is locked before calling this.
+void LLTextureCache::EntryIndex::reclaim()
+{
+	// find() counts itself in before it loads mTable, so once the count drops
+	// to zero nobody can hold a table that was swapped out before.
+	if (!mRetired.empty() && mReaders == 0)
+	{
+		for_each(mRetired.begin(), mRetired.end(), DeletePointer());
+		mRetired.clear();
+	}
+}
+
+//no lock
+S32 LLTextureCache::EntryIndex::find(const LLUUID& id, const Entry* entries, U32 num_entries)
+{
+	S32 res = -1;
+	mReaders++;
+	const Table* table = mTable;
+	if (table && entries)
+	{
+		U32 key = id.getCRC32();
+		U32 mask = table->mMask;
+		for (U32 i = key & mask, n = 0; n <= mask; i = (i + 1) & mask, n++)
+		{
+			S32 idx = table->mSlots[i].mIndex;
+			if (idx < 0)
+			{
+				break; // reached an empty slot: not in the index
+			}
+			if (table->mSlots[i].mKey == key && (U32)idx < num_entries && entries[idx].mID == id)
+			{
+				res = idx;
+				break;
+			}
+		}
+	}
+	mReaders--;
+	return res;
+}
+
+//mHeaderMutex is locked before calling this.
+void LLTextureCache::EntryIndex::insert(const LLUUID& id, S32 idx)
+{
+	llassert_always(mTable);
+	mTable->insert(id, idx);
+	reclaim();
+}
+
+//mHeaderMutex is locked before calling this.
+void LLTextureCache::EntryIndex::erase(const LLUUID& id, S32 idx)
+{
+	Table* table = mTable;
+	if (!table || idx < 0)
+	{
+		return;
+	}
+	Slot* slots = table->mSlots;
+	U32 mask = table->mMask;
+	U32 key = id.getCRC32();
+	U32 i = key & mask;
+	while (true)
+	{
+		S32 cur = slots[i].mIndex;
+		if (cur < 0)
+		{
+			return; // not found
+		}
+		if (cur == idx && slots[i].mKey == key)
+		{
+			break;
+		}
+		i = (i + 1) & mask;
+	}
+
+	// backward shift deletion: pull later members of the probe chain into the hole
+	// so that no tombstones are needed. A reader racing with this can miss the
+	// moved entry, it retries the miss under the lock.
+	U32 j = i;
+	while (true)
+	{
+		j = (j + 1) & mask;
+		S32 cur = slots[j].mIndex;
+		if (cur < 0)
+		{
+			break;
+		}
+		U32 home = slots[j].mKey & mask;
+		bool stays = (i <= j) ? (i < home && home <= j) : (i < home || home <= j);
+		if (!stays)
+		{
+			slots[i].mKey = slots[j].mKey;
+			slots[i].mIndex = cur;
+			i = j;
+		}
+	}
+	slots[i].mIndex = -1;
+	table->mCount--;
+	reclaim();
 }
 
 //////////////////////////////////////////////////////////////////////////////
@@ -766,13 +1100,40 @@ S32 LLTextureCache::update(U32 max_time_ms)
 
 	S32 res;
 	res = LLWorkerThread::update(max_time_ms);
+	if (!mThreaded)
+	{
+		threadedUpdate();
+	}
+	for (U32 i = 1; i < mShards.size(); i++)
+	{
+		res += mShards[i]->update(max_time_ms);
+	}
 
 	mListMutex.lock();
 	handle_list_t priorty_list = mPrioritizeWriteList; // copy list
 	mPrioritizeWriteList.clear();
 	responder_list_t completed_list = mCompletedList; // copy list
 	mCompletedList.clear();
+	handle_list_t decoded_write_list;
+	decoded_write_list.swap(mDecodedWriteList);
 	mListMutex.unlock();
+
+	for (handle_list_t::iterator iter = decoded_write_list.begin(); iter != decoded_write_list.end(); )
+	{
+		if (writeComplete(*iter))
+		{
+			iter = decoded_write_list.erase(iter);
+		}
+		else
+		{
+			++iter;
+		}
+	}
+	if (!decoded_write_list.empty())
+	{
+		LLMutexLock lock(&mListMutex);
+		mDecodedWriteList.insert(mDecodedWriteList.end(), decoded_write_list.begin(), decoded_write_list.end());
+	}
 	
 	lockWorkers();
 	
@@ -799,10 +1160,23 @@ S32 LLTextureCache::update(U32 max_time_ms)
 		responder->completed(success);
 	}
 	
-	if(!res && timer.getElapsedTimeF32() > MAX_TIME_INTERVAL)
+	if(!res && timer.getElapsedTimeF32() > MAX_TIME_INTERVAL) //batch the write-back of the mapped entries.
 	{
 		timer.reset() ;
 		writeUpdatedEntries() ;
+
+		LLMutexLock lock(&mListMutex);
+		for (U32 i = 0; i < mShardStats.size(); i++)
+		{
+			ShardStats& stats = mShardStats[i];
+			if (stats.mRequests)
+			{
+				LL_DEBUGS("TextureCache") << "Thread " << i << " requests: " << stats.mRequests
+					<< " avg latency: " << stats.mTotalLatency * 1000.0 / stats.mRequests << " ms"
+					<< " max latency: " << stats.mMaxLatency * 1000.f << " ms" << LL_ENDL;
+			}
+			stats = ShardStats(); // stats cover the last interval only
+		}
 	}
 
 	return res;
@@ -827,13 +1201,39 @@ std::string LLTextureCache::getTextureFileName(const LLUUID& id)
 	return filename;
 }
 
+S32 LLTextureCache::getBodySize(const LLUUID& id, LLVolatileAPRPool* pool)
+{
+	if (mUsePackFiles)
+	{
+		return mPackStore.getSize(id);
+	}
+	return LLAPRFile::size(getTextureFileName(id), pool);
+}
+
+S32 LLTextureCache::readBody(const LLUUID& id, U8* data, S32 offset, S32 size, LLVolatileAPRPool* pool)
+{
+	if (mUsePackFiles)
+	{
+		return mPackStore.read(id, data, offset, size);
+	}
+	return LLAPRFile::readEx(getTextureFileName(id), data, offset, size, pool);
+}
+
+S32 LLTextureCache::writeBody(const LLUUID& id, U8* data, S32 size, LLVolatileAPRPool* pool)
+{
+	if (mUsePackFiles)
+	{
+		S32 bytes_written = mPackStore.write(id, data, size);
+		mPackCompacting = 1; // the write may have replaced a record
+		return bytes_written;
+	}
+	return LLAPRFile::writeEx(getTextureFileName(id), data, 0, size, pool);
+}
+
 //debug
 BOOL LLTextureCache::isInCache(const LLUUID& id) 
 {
-	LLMutexLock lock(&mHeaderMutex);
-	id_map_t::const_iterator iter = mHeaderIDMap.find(id);
-	
-	return (iter != mHeaderIDMap.end()) ;
+	return mHeaderIDMap.find(id, getMappedEntries(), getNumMappedEntries()) >= 0 ;
 }
 
 //debug
@@ -895,6 +1295,8 @@ void LLTextureCache::setDirNames(ELLPath location)
 	mHeaderEntriesFileName = gDirUtilp->getExpandedFilename(location, textures_dirname, entries_filename);
 	mHeaderDataFileName = gDirUtilp->getExpandedFilename(location, textures_dirname, cache_filename);
 	mTexturesDirName = gDirUtilp->getExpandedFilename(location, textures_dirname);
+	mPacksDirName = mTexturesDirName + gDirUtilp->getDirDelimiter() + "packs";
+	mDecodedDirName = mTexturesDirName + gDirUtilp->getDirDelimiter() + "decoded";
 }
 
 void LLTextureCache::purgeCache(ELLPath location)
@@ -904,7 +1306,6 @@ void LLTextureCache::purgeCache(ELLPath location)
 	if (!mReadOnly)
 	{
 		setDirNames(location);
-		llassert_always(mHeaderAPRFile == NULL);
 
 		//remove the legacy cache if exists
 		std::string texture_dir = mTexturesDirName ;
@@ -935,7 +1336,7 @@ void LLTextureCache::setReadOnly(BOOL read_only)
 //called in the main thread.
 S64 LLTextureCache::initCache(ELLPath location, S64 max_size, BOOL texture_cache_mismatch)
 {
-	llassert_always(getPending() == 0) ; //should not start accessing the texture cache before initialized.
+	llassert_always(getTotalPending() == 0) ; //should not start accessing the texture cache before initialized.
 
 	S64 header_size = (max_size * 2) / 10;
 	S64 max_entries = header_size / TEXTURE_CACHE_ENTRY_SIZE;
@@ -952,6 +1353,15 @@ S64 LLTextureCache::initCache(ELLPath location, S64 max_size, BOOL texture_cache
 			<< " Textures size: " << sCacheMaxTexturesSize / (1024 * 1024) << " MB" << LL_ENDL;
 
 	setDirNames(location);
+
+	// Bodies stored by the other backend would never be found, start over when switching.
+	mUsePackFiles = gSavedSettings.getBOOL("TextureCachePackFiles");
+	if (!texture_cache_mismatch && LLFile::isfile(mHeaderEntriesFileName)
+		&& mUsePackFiles != LLFile::isdir(mPacksDirName))
+	{
+		llinfos << "Texture cache body storage changed, clearing the cache." << llendl;
+		texture_cache_mismatch = TRUE;
+	}
 	
 	if(texture_cache_mismatch) 
 	{
@@ -976,10 +1386,22 @@ S64 LLTextureCache::initCache(ELLPath location, S64 max_size, BOOL texture_cache
 			LLFile::mkdir(dirname);
 		}
 	}
+	if (mUsePackFiles)
+	{
+		mPackStore.init(mPacksDirName, mReadOnly);
+	}
+	// Decoded images have their own budget on top of max_size.
+	mDecodedCache.init(mDecodedDirName, (S64)gSavedSettings.getU32("TextureDecodedCacheSize") * 1024 * 1024, mReadOnly);
 	readHeaderCache();
+	if (mUsePackFiles)
+	{
+		// Drop the records of bodies the entries do not know about (or with another size).
+		mPackStore.validate(mTexturesSizeMap);
+		mPackCompacting = 1;
+	}
 	purgeTextures(true); // calc mTexturesSize and make some room in the texture cache if we need it
 
-	llassert_always(getPending() == 0) ; //should not start accessing the texture cache before initialized.
+	llassert_always(getTotalPending() == 0) ; //should not start accessing the texture cache before initialized.
 
 	return max_size; // unused cache space
 }
@@ -987,39 +1409,55 @@ S64 LLTextureCache::initCache(ELLPath location, S64 max_size, BOOL texture_cache
 //----------------------------------------------------------------------------
 // mHeaderMutex must be locked for the following functions!
 
-LLAPRFile* LLTextureCache::openHeaderEntriesFile(bool readonly, S32 offset)
+bool LLTextureCache::mapHeaderEntriesFile()
 {
-	llassert_always(mHeaderAPRFile == NULL);
-	apr_int32_t flags = readonly ? APR_READ|APR_BINARY : APR_READ|APR_WRITE|APR_BINARY;
-	mHeaderAPRFile = new LLAPRFile(mHeaderEntriesFileName, flags, getLocalAPRFilePool());
-	if(offset > 0)
+	if (!mHeaderEntriesMap.isOpen())
 	{
-		mHeaderAPRFile->seek(APR_SET, offset);
+		size_t size = sizeof(EntriesInfo) + (size_t)sCacheMaxEntries * sizeof(Entry);
+		if (!mHeaderEntriesMap.open(mHeaderEntriesFileName, size, mReadOnly))
+		{
+			llwarns << "Unable to map texture cache entries file: " << mHeaderEntriesFileName << llendl;
+			return false;
+		}
+		mHeaderIDMap.rebuild(NULL, 0, sCacheMaxEntries);
 	}
-	return mHeaderAPRFile;
+	return true;
 }
 
-void LLTextureCache::closeHeaderEntriesFile()
+void LLTextureCache::unmapHeaderEntriesFile()
 {
-	if(!mHeaderAPRFile)
+	mHeaderEntriesMap.close();
+}
+
+//no lock
+LLTextureCache::Entry* LLTextureCache::getMappedEntries()
+{
+	if (!mHeaderEntriesMap.isOpen())
 	{
-		return ;
+		return NULL;
 	}
+	return (Entry*)(mHeaderEntriesMap.getData() + sizeof(EntriesInfo));
+}
 
-	delete mHeaderAPRFile;
-	mHeaderAPRFile = NULL;
+//no lock
+U32 LLTextureCache::getNumMappedEntries() const
+{
+	if (mHeaderEntriesMap.getSize() < sizeof(EntriesInfo))
+	{
+		return 0;
+	}
+	return (U32)((mHeaderEntriesMap.getSize() - sizeof(EntriesInfo)) / sizeof(Entry));
 }
 
 void LLTextureCache::readEntriesHeader()
 {
 	// mHeaderEntriesInfo initializes to default values so safe not to read it
-	llassert_always(mHeaderAPRFile == NULL);
-	if (LLAPRFile::isExist(mHeaderEntriesFileName, getLocalAPRFilePool()))
+	bool exists = LLAPRFile::isExist(mHeaderEntriesFileName, getLocalAPRFilePool());
+	if (mapHeaderEntriesFile() && exists)
 	{
-		LLAPRFile::readEx(mHeaderEntriesFileName, (U8*)&mHeaderEntriesInfo, 0, sizeof(EntriesInfo),
-						  getLocalAPRFilePool());
+		memcpy(&mHeaderEntriesInfo, mHeaderEntriesMap.getData(), sizeof(EntriesInfo));
 	}
-	else //create an empty entries header.
+	else if (!exists) //create an empty entries header.
 	{
 		mHeaderEntriesInfo.mVersion = sHeaderCacheVersion ;
 		mHeaderEntriesInfo.mEntries = 0 ;
@@ -1029,30 +1467,22 @@ void LLTextureCache::readEntriesHeader()
 
 void LLTextureCache::writeEntriesHeader()
 {
-	llassert_always(mHeaderAPRFile == NULL);
-	if (!mReadOnly)
+	if (!mReadOnly && mHeaderEntriesMap.isOpen())
 	{
-		LLAPRFile::writeEx(mHeaderEntriesFileName, (U8*)&mHeaderEntriesInfo, 0, sizeof(EntriesInfo),
-						   getLocalAPRFilePool());
+		memcpy(mHeaderEntriesMap.getData(), &mHeaderEntriesInfo, sizeof(EntriesInfo));
 	}
 }
 
 //mHeaderMutex is locked before calling this.
 S32 LLTextureCache::openAndReadEntry(const LLUUID& id, Entry& entry, bool create)
 {
-	S32 idx = -1;
-	
-	id_map_t::iterator iter1 = mHeaderIDMap.find(id);
-	if (iter1 != mHeaderIDMap.end())
-	{
-		idx = iter1->second;
-	}
+	S32 idx = mHeaderIDMap.find(id, getMappedEntries(), getNumMappedEntries());
 
 	if (idx < 0)
 	{
 		if (create && !mReadOnly)
 		{
-			if (mHeaderEntriesInfo.mEntries < sCacheMaxEntries)
+			if (mHeaderEntriesInfo.mEntries < llmin(sCacheMaxEntries, getNumMappedEntries()))
 			{
 				// Add an entry to the end of the list
 				idx = mHeaderEntriesInfo.mEntries++;
@@ -1066,18 +1496,19 @@ S32 LLTextureCache::openAndReadEntry(const LLUUID& id, Entry& entry, bool create
 			else
 			{
 				// Look for a still valid entry in the LRU
+				Entry* entries = getMappedEntries();
 				for (std::set<LLUUID>::iterator iter2 = mLRU.begin(); iter2 != mLRU.end();)
 				{
 					std::set<LLUUID>::iterator curiter2 = iter2++;
 					LLUUID oldid = *curiter2;
 					// Erase entry from LRU regardless
 					mLRU.erase(curiter2);
-					// Look up entry and use it if it is valid
-					id_map_t::iterator iter3 = mHeaderIDMap.find(oldid);
-					if (iter3 != mHeaderIDMap.end() && iter3->second >= 0)
+					// Look up entry and use it if it is valid and was not used since the LRU was built
+					S32 oldidx = mHeaderIDMap.find(oldid, entries, getNumMappedEntries());
+					if (oldidx >= 0 && entries[oldidx].mTime <= mLRUTime)
 					{
-						idx = iter3->second;
-						removeCachedTexture(oldid) ;//remove the existing cached texture to release the entry index.
+						idx = oldidx;
+						removeCachedTexture(oldid, idx) ;//remove the existing cached texture to release the entry index.
 						break;
 					}
 				}
@@ -1098,23 +1529,19 @@ S32 LLTextureCache::openAndReadEntry(const LLUUID& id, Entry& entry, bool create
 		// Remove this entry from the LRU if it exists
 		mLRU.erase(id);
 		// Read the entry
-		idx_entry_map_t::iterator iter = mUpdatedEntryMap.find(idx) ;
-		if(iter != mUpdatedEntryMap.end())
-		{
-			entry = iter->second ;
-		}
-		else
+		if (!readEntryFromHeaderImmediately(idx, entry))
 		{
-			readEntryFromHeaderImmediately(idx, entry) ;
+			clearCorruptedCache() ; //clear the cache.
+			idx = -1 ;
 		}
-		if(entry.mImageSize <= entry.mBodySize)//it happens on 64-bit systems, do not know why
+		else if(entry.mImageSize <= entry.mBodySize)//it happens on 64-bit systems, do not know why
 		{
 			llwarns << "corrupted entry: " << id << " entry image size: " << entry.mImageSize << " entry body size: " << entry.mBodySize << llendl ;
 
 			//erase this entry and the cached texture from the cache.
 			std::string tex_filename = getTextureFileName(id);
 			removeEntry(idx, entry, tex_filename) ;
-			mUpdatedEntryMap.erase(idx) ;
+			writeEntryToHeaderImmediately(idx, entry) ;
 			idx = -1 ;
 		}
 	}
@@ -1124,72 +1551,43 @@ S32 LLTextureCache::openAndReadEntry(const LLUUID& id, Entry& entry, bool create
 //mHeaderMutex is locked before calling this.
 void LLTextureCache::writeEntryToHeaderImmediately(S32& idx, Entry& entry, bool write_header)
 {	
-	LLAPRFile* aprfile ;
-	S32 bytes_written ;
-	S32 offset = sizeof(EntriesInfo) + idx * sizeof(Entry);
-	if(write_header)
-	{
-		aprfile = openHeaderEntriesFile(false, 0);		
-		bytes_written = aprfile->write((U8*)&mHeaderEntriesInfo, sizeof(EntriesInfo)) ;
-		if(bytes_written != sizeof(EntriesInfo))
-		{
-			clearCorruptedCache() ; //clear the cache.
-			idx = -1 ;//mark the idx invalid.
-			return ;
-		}
-
-		mHeaderAPRFile->seek(APR_SET, offset);
-	}
-	else
+	if (mReadOnly)
 	{
-		aprfile = openHeaderEntriesFile(false, offset);
+		return;
 	}
-	bytes_written = aprfile->write((void*)&entry, (S32)sizeof(Entry));
-	if(bytes_written != sizeof(Entry))
+	if (idx < 0 || (U32)idx >= getNumMappedEntries())
 	{
 		clearCorruptedCache() ; //clear the cache.
 		idx = -1 ;//mark the idx invalid.
-
 		return ;
 	}
 
-	closeHeaderEntriesFile();
-	mUpdatedEntryMap.erase(idx) ;
+	memcpy(getMappedEntries() + idx, &entry, sizeof(Entry));
+	if(write_header)
+	{
+		writeEntriesHeader();
+	}
 }
 
-//mHeaderMutex is locked before calling this.
-void LLTextureCache::readEntryFromHeaderImmediately(S32& idx, Entry& entry)
+//no lock: a concurrent writer can tear the copy, callers validate it.
+bool LLTextureCache::readEntryFromHeaderImmediately(S32 idx, Entry& entry)
 {
-	S32 offset = sizeof(EntriesInfo) + idx * sizeof(Entry);
-	LLAPRFile* aprfile = openHeaderEntriesFile(true, offset);
-	S32 bytes_read = aprfile->read((void*)&entry, (S32)sizeof(Entry));
-	closeHeaderEntriesFile();
-
-	if(bytes_read != sizeof(Entry))
+	if (idx < 0 || (U32)idx >= getNumMappedEntries())
 	{
-		clearCorruptedCache() ; //clear the cache.
-		idx = -1 ;//mark the idx invalid.
+		return false;
 	}
+	memcpy(&entry, getMappedEntries() + idx, sizeof(Entry));
+	return true;
 }
 
-//mHeaderMutex is locked before calling this.
-//update an existing entry time stamp, delay writing.
+//no lock
+//update an existing entry time stamp in place, the page is written back with the next flush.
 void LLTextureCache::updateEntryTimeStamp(S32 idx, Entry& entry)
 {
-	static const U32 MAX_ENTRIES_WITHOUT_TIME_STAMP = (U32)(LLTextureCache::sCacheMaxEntries * 0.75f) ;
-
-	if(mHeaderEntriesInfo.mEntries < MAX_ENTRIES_WITHOUT_TIME_STAMP)
+	if (idx >= 0 && !mReadOnly && (U32)idx < getNumMappedEntries())
 	{
-		return ; //there are enough empty entry index space, no need to stamp time.
-	}
-
-	if (idx >= 0)
-	{
-		if (!mReadOnly)
-		{
-			entry.mTime = time(NULL);			
-			mUpdatedEntryMap[idx] = entry ;
-		}
+		entry.mTime = time(NULL);
+		apr_atomic_set32((volatile apr_uint32_t*)&getMappedEntries()[idx].mTime, entry.mTime);
 	}
 }
 
@@ -1211,7 +1609,6 @@ bool LLTextureCache::updateEntry(S32& idx, Entry& entry, S32 new_image_size, S32
 		bool update_header = false ;
 		if(entry.mImageSize < 0) //is a brand-new entry
 		{
-			mHeaderIDMap[entry.mID] = idx;
 			mTexturesSizeMap[entry.mID] = new_body_size ;
 			mTexturesSizeTotal += new_body_size ;
 			
@@ -1230,6 +1627,11 @@ bool LLTextureCache::updateEntry(S32& idx, Entry& entry, S32 new_image_size, S32
 		entry.mBodySize = new_body_size ;
 		
 		writeEntryToHeaderImmediately(idx, entry, update_header) ;
+		if (update_header && idx >= 0)
+		{
+			// publish the entry to lock-free readers once it is in the mapping.
+			mHeaderIDMap.insert(entry.mID, idx);
+		}
 	
 		if (mTexturesSizeTotal > sCacheMaxTexturesSize)
 		{
@@ -1251,42 +1653,27 @@ U32 LLTextureCache::openAndReadEntries(std::vector<Entry>& entries)
 {
 	U32 num_entries = mHeaderEntriesInfo.mEntries;
 
-	mHeaderIDMap.clear();
 	mTexturesSizeMap.clear();
 	mFreeList.clear();
 	mTexturesSizeTotal = 0;
 
-	LLAPRFile* aprfile = NULL; 
-	if(mUpdatedEntryMap.empty())
+	Entry* mapped_entries = getMappedEntries();
+	if (num_entries > getNumMappedEntries())
 	{
-		aprfile = openHeaderEntriesFile(true, (S32)sizeof(EntriesInfo));
-	}
-	else //update the header file first.
-	{
-		aprfile = openHeaderEntriesFile(false, 0);
-		updatedHeaderEntriesFile() ;
-		if(!aprfile)
-		{
-			return 0;
-		}
-		aprfile->seek(APR_SET, (S32)sizeof(EntriesInfo));
+		llwarns << "Corrupted header entries, " << num_entries << " entries in a file holding " << getNumMappedEntries() << llendl;
+		purgeAllTextures(false);
+		return 0;
 	}
+	// readers keep finding entries in the old index until the new one is swapped in
+	mHeaderIDMap.rebuild(mapped_entries, num_entries, sCacheMaxEntries);
+
+	entries.assign(mapped_entries, mapped_entries + num_entries);
 	for (U32 idx=0; idx<num_entries; idx++)
 	{
-		Entry entry;
-		S32 bytes_read = aprfile->read((void*)(&entry), (S32)sizeof(Entry));
-		if (bytes_read < sizeof(Entry))
-		{
-			llwarns << "Corrupted header entries, failed at " << idx << " / " << num_entries << llendl;
-			closeHeaderEntriesFile();
-			purgeAllTextures(false);
-			return 0;
-		}
-		entries.push_back(entry);
+		const Entry& entry = entries[idx];
 // 		llinfos << "ENTRY: " << entry.mTime << " TEX: " << entry.mID << " IDX: " << idx << " Size: " << entry.mImageSize << llendl;
 		if(entry.mImageSize > entry.mBodySize)
 		{
-			mHeaderIDMap[entry.mID] = idx;
 			mTexturesSizeMap[entry.mID] = entry.mBodySize;
 			mTexturesSizeTotal += entry.mBodySize;
 		}
@@ -1295,78 +1682,31 @@ U32 LLTextureCache::openAndReadEntries(std::vector<Entry>& entries)
 			mFreeList.insert(idx);
 		}
 	}
-	closeHeaderEntriesFile();
 	return num_entries;
 }
 
-void LLTextureCache::writeEntriesAndClose(const std::vector<Entry>& entries)
+void LLTextureCache::writeEntries(const std::vector<Entry>& entries)
 {
 	S32 num_entries = entries.size();
 	llassert_always(num_entries == mHeaderEntriesInfo.mEntries);
 	
-	if (!mReadOnly)
+	if (!mReadOnly && num_entries)
 	{
-		LLAPRFile* aprfile = openHeaderEntriesFile(false, (S32)sizeof(EntriesInfo));
-		for (S32 idx=0; idx<num_entries; idx++)
+		if ((U32)num_entries > getNumMappedEntries())
 		{
-			S32 bytes_written = aprfile->write((void*)(&entries[idx]), (S32)sizeof(Entry));
-			if(bytes_written != sizeof(Entry))
-			{
-				clearCorruptedCache() ; //clear the cache.
-				return ;
-			}
+			clearCorruptedCache() ; //clear the cache.
+			return ;
 		}
-		closeHeaderEntriesFile();
+		memcpy(getMappedEntries(), &entries[0], num_entries * sizeof(Entry));
 	}
 }
 
+//schedules the write-back of the entries changed in the mapping since the last call.
 void LLTextureCache::writeUpdatedEntries()
 {
-	lockHeaders() ;
-	if (!mReadOnly && !mUpdatedEntryMap.empty())
-	{
-		openHeaderEntriesFile(false, 0);
-		updatedHeaderEntriesFile() ;
-		closeHeaderEntriesFile();
-	}
-	unlockHeaders() ;
-}
-
-//mHeaderMutex is locked and mHeaderAPRFile is created before calling this.
-void LLTextureCache::updatedHeaderEntriesFile()
-{
-	if (!mReadOnly && !mUpdatedEntryMap.empty() && mHeaderAPRFile)
+	if (!mReadOnly)
 	{
-		//entriesInfo
-		mHeaderAPRFile->seek(APR_SET, 0);
-		S32 bytes_written = mHeaderAPRFile->write((U8*)&mHeaderEntriesInfo, sizeof(EntriesInfo)) ;
-		if(bytes_written != sizeof(EntriesInfo))
-		{
-			clearCorruptedCache() ; //clear the cache.
-			return ;
-		}
-		
-		//write each updated entry
-		S32 entry_size = (S32)sizeof(Entry) ;
-		S32 prev_idx = -1 ;
-		S32 delta_idx ;
-		for (idx_entry_map_t::iterator iter = mUpdatedEntryMap.begin(); iter != mUpdatedEntryMap.end(); ++iter)
-		{
-			delta_idx = iter->first - prev_idx - 1;
-			prev_idx = iter->first ;
-			if(delta_idx)
-			{
-				mHeaderAPRFile->seek(APR_CUR, delta_idx * entry_size);
-			}
-			
-			bytes_written = mHeaderAPRFile->write((void*)(&iter->second), entry_size);
-			if(bytes_written != entry_size)
-			{
-				clearCorruptedCache() ; //clear the cache.
-				return ;
-			}
-		}
-		mUpdatedEntryMap.clear() ;
+		mHeaderEntriesMap.flush();
 	}
 }
 //----------------------------------------------------------------------------
@@ -1377,6 +1717,7 @@ void LLTextureCache::readHeaderCache()
 	mHeaderMutex.lock();
 
 	mLRU.clear(); // always clear the LRU
+	mLRUTime = time(NULL);
 
 	readEntriesHeader();
 	
@@ -1468,7 +1809,7 @@ void LLTextureCache::readHeaderCache()
 				llassert_always(new_entries.size() <= sCacheMaxEntries);
 				mHeaderEntriesInfo.mEntries = new_entries.size();
 				writeEntriesHeader();
-				writeEntriesAndClose(new_entries);
+				writeEntries(new_entries);
 				mHeaderMutex.unlock(); // unlock the mutex before calling again
 				readHeaderCache(); // repeat with new entries file
 				mHeaderMutex.lock();
@@ -1489,7 +1830,6 @@ void LLTextureCache::clearCorruptedCache()
 {
 	llwarns << "the texture cache is corrupted, need to be cleared." << llendl ;
 
-	closeHeaderEntriesFile();//close possible file handler
 	purgeAllTextures(false) ; //clear the cache.
 	
 	if (!mReadOnly) //regenerate the directory tree if not exists.
@@ -1524,18 +1864,24 @@ void LLTextureCache::purgeAllTextures(bool purge_directories)
 				LLFile::rmdir(dirname);
 			}
 		}
+		mPackStore.purge();
+		mDecodedCache.purge();
 		if (purge_directories)
 		{
+			gDirUtilp->deleteFilesInDir(mPacksDirName, mask);
+			LLFile::rmdir(mPacksDirName);
+			gDirUtilp->deleteFilesInDir(mDecodedDirName, mask);
+			LLFile::rmdir(mDecodedDirName);
+			unmapHeaderEntriesFile(); //texture.entries is deleted below.
 			gDirUtilp->deleteFilesInDir(mTexturesDirName, mask);
 			LLFile::rmdir(mTexturesDirName);
 		}		
 	}
-	mHeaderIDMap.clear();
+	mHeaderIDMap.rebuild(NULL, 0, sCacheMaxEntries);
 	mTexturesSizeMap.clear();
 	mTexturesSizeTotal = 0;
 	mFreeList.clear();
 	mTexturesSizeTotal = 0;
-	mUpdatedEntryMap.clear();
 
 	// Info with 0 entries
 	mHeaderEntriesInfo.mVersion = sHeaderCacheVersion;
@@ -1578,10 +1924,9 @@ void LLTextureCache::purgeTextures(bool validate)
 	{
 		if (iter1->second > 0)
 		{
-			id_map_t::iterator iter2 = mHeaderIDMap.find(iter1->first);
-			if (iter2 != mHeaderIDMap.end())
+			S32 idx = mHeaderIDMap.find(iter1->first, &entries[0], num_entries);
+			if (idx >= 0)
 			{
-				S32 idx = iter2->second;
 				time_idx_set.insert(std::make_pair(entries[idx].mTime, idx));
 // 				llinfos << "TIME: " << entries[idx].mTime << " TEX: " << entries[idx].mID << " IDX: " << idx << " Size: " << entries[idx].mImageSize << llendl;
 			}
@@ -1622,7 +1967,7 @@ void LLTextureCache::purgeTextures(bool validate)
 			if (uuididx == validate_idx)
 			{
  				LL_DEBUGS("TextureCache") << "Validating: " << filename << "Size: " << entries[idx].mBodySize << LL_ENDL;
-				S32 bodysize = LLAPRFile::size(filename, getLocalAPRFilePool());
+				S32 bodysize = getBodySize(entries[idx].mID, getLocalAPRFilePool());
 				if (bodysize != entries[idx].mBodySize)
 				{
 					LL_WARNS("TextureCache") << "TEXTURE CACHE BODY HAS BAD SIZE: " << bodysize << " != " << entries[idx].mBodySize
@@ -1647,7 +1992,7 @@ void LLTextureCache::purgeTextures(bool validate)
 
 	LL_DEBUGS("TextureCache") << "TEXTURE CACHE: Writing Entries: " << num_entries << LL_ENDL;
 
-	writeEntriesAndClose(entries);
+	writeEntries(entries);
 	
 	// *FIX:Mani - watchdog back on.
 	LLAppViewer::instance()->resumeMainloopTimeout();
@@ -1684,14 +2029,38 @@ LLTextureCacheWorker* LLTextureCache::getWriter(handle_t handle)
 	return res;
 }
 
+// mWorkersMutex must be locked
+LLTextureCache::handle_t LLTextureCache::addWorker(handle_map_t& workers, LLTextureCacheWorker* worker)
+{
+	while (mNextCacheHandle == nullHandle() ||
+		   mReaders.find(mNextCacheHandle) != mReaders.end() ||
+		   mWriters.find(mNextCacheHandle) != mWriters.end())
+	{
+		mNextCacheHandle++;
+	}
+	handle_t handle = mNextCacheHandle++;
+	worker->mCacheHandle = handle;
+	workers[handle] = worker;
+	return handle;
+}
+
 //////////////////////////////////////////////////////////////////////////////
 // Called from work thread
 
 // Reads imagesize from the header, updates timestamp
 S32 LLTextureCache::getHeaderCacheEntry(const LLUUID& id, Entry& entry)
 {
+	// Look the entry up in the mapped header without locking
+	S32 idx = mHeaderIDMap.find(id, getMappedEntries(), getNumMappedEntries());
+	if (idx >= 0 && readEntryFromHeaderImmediately(idx, entry) && entry.mID == id && entry.mImageSize > entry.mBodySize)
+	{
+		updateEntryTimeStamp(idx, entry); // updates time
+		return idx;
+	}
+
+	// Missed, raced with a writer or a purge, or hit a corrupted entry: sort it out under the lock
 	LLMutexLock lock(&mHeaderMutex);	
-	S32 idx = openAndReadEntry(id, entry, false);
+	idx = openAndReadEntry(id, entry, false);
 	if (idx >= 0)
 	{		
 		updateEntryTimeStamp(idx, entry); // updates time
@@ -1737,8 +2106,8 @@ LLTextureCache::handle_t LLTextureCache::readFromCache(const std::string& filena
 	LLTextureCacheWorker* worker = new LLTextureCacheLocalFileWorker(this, priority, filename, id,
 																	 NULL, size, offset, 0,
 																	 responder);
-	handle_t handle = worker->read();
-	mReaders[handle] = worker;
+	handle_t handle = addWorker(mReaders, worker);
+	worker->read();
 	return handle;
 }
 
@@ -1751,8 +2120,8 @@ LLTextureCache::handle_t LLTextureCache::readFromCache(const LLUUID& id, U32 pri
 	LLTextureCacheWorker* worker = new LLTextureCacheRemoteWorker(this, priority, id,
 																  NULL, size, offset,
 																  0, responder);
-	handle_t handle = worker->read();
-	mReaders[handle] = worker;
+	handle_t handle = addWorker(mReaders, worker);
+	worker->read();
 	return handle;
 }
 
@@ -1770,7 +2139,7 @@ bool LLTextureCache::readComplete(handle_t handle, bool abort)
 
 		if(!complete && abort)
 		{
-			abortRequest(handle, true) ;
+			worker->abort() ;
 		}
 	}
 	if (worker && (complete || abort))
@@ -1807,8 +2176,8 @@ LLTextureCache::handle_t LLTextureCache::writeToCache(const LLUUID& id, U32 prio
 	LLTextureCacheWorker* worker = new LLTextureCacheRemoteWorker(this, priority, id,
 																  data, datasize, 0,
 																  imagesize, responder);
-	handle_t handle = worker->write();
-	mWriters[handle] = worker;
+	handle_t handle = addWorker(mWriters, worker);
+	worker->write();
 	return handle;
 }
 
@@ -1849,25 +2218,38 @@ void LLTextureCache::addCompleted(Responder* responder, bool success)
 //////////////////////////////////////////////////////////////////////////////
 
 //called after mHeaderMutex is locked.
-void LLTextureCache::removeCachedTexture(const LLUUID& id)
+void LLTextureCache::removeCachedTexture(const LLUUID& id, S32 idx)
 {
 	if(mTexturesSizeMap.find(id) != mTexturesSizeMap.end())
 	{
 		mTexturesSizeTotal -= mTexturesSizeMap[id] ;
 		mTexturesSizeMap.erase(id);
 	}
-	mHeaderIDMap.erase(id);
-	LLAPRFile::remove(getTextureFileName(id), getLocalAPRFilePool());		
+	mHeaderIDMap.erase(id, idx);
+	if (mUsePackFiles)
+	{
+		mPackStore.remove(id);
+		mPackCompacting = 1;
+	}
+	else
+	{
+		LLAPRFile::remove(getTextureFileName(id), getLocalAPRFilePool());
+	}
 }
 
 //called after mHeaderMutex is locked.
 void LLTextureCache::removeEntry(S32 idx, Entry& entry, std::string& filename)
 {
- 	bool file_maybe_exists = true;	// Always attempt to remove when idx is invalid.
+ 	bool file_maybe_exists = !mUsePackFiles;	// Always attempt to remove a body file when idx is invalid.
 
 	if(idx >= 0) //valid entry
 	{
-		if (entry.mBodySize == 0)	// Always attempt to remove when mBodySize > 0.
+		if (mUsePackFiles)
+		{
+			mPackStore.remove(entry.mID);
+			mPackCompacting = 1;
+		}
+		else if (entry.mBodySize == 0)	// Always attempt to remove when mBodySize > 0.
 		{
 		  if (LLAPRFile::isExist(filename, getLocalAPRFilePool()))		// Sanity check. Shouldn't exist when body size is 0.
 		  {
@@ -1881,7 +2263,7 @@ void LLTextureCache::removeEntry(S32 idx, Entry& entry, std::string& filename)
 
 		entry.mImageSize = -1;
 		entry.mBodySize = 0;
-		mHeaderIDMap.erase(entry.mID);
+		mHeaderIDMap.erase(entry.mID, idx);
 		mTexturesSizeMap.erase(entry.mID);
 
 		mTexturesSizeTotal -= entry.mBodySize;
@@ -1913,10 +2295,49 @@ bool LLTextureCache::removeFromCache(const LLUUID& id)
 		}
 
 		unlockHeaders() ;
+
+		// A bad J2C may have been decoded into bad images
+		mDecodedCache.remove(id);
 	}
 	return ret ;
 }
 
+LLTextureCache::handle_t LLTextureCache::readDecodedFromCache(const LLUUID& id, U32 priority, S32 discard,
+															  DecodedReadResponder* responder)
+{
+	LLMutexLock lock(&mWorkersMutex);
+	LLTextureCacheWorker* worker = new LLTextureCacheDecodedWorker(this, priority, id, discard,
+																   NULL, 0, responder);
+	handle_t handle = addWorker(mReaders, worker);
+	worker->read();
+	return handle;
+}
+
+void LLTextureCache::writeDecodedToCache(const LLUUID& id, U32 priority, S32 discard,
+										 LLImageRaw* raw, LLImageRaw* aux)
+{
+	if (mReadOnly || !mDecodedCache.isEnabled())
+	{
+		return;
+	}
+	S32 datasize = 0;
+	U8* data = LLTextureDecodedCache::pack(raw, aux, datasize);
+	if (!data)
+	{
+		return;
+	}
+	handle_t handle;
+	{
+		LLMutexLock lock(&mWorkersMutex);
+		LLTextureCacheWorker* worker = new LLTextureCacheDecodedWorker(this, priority, id, discard,
+																	   data, datasize, NULL);
+		handle = addWorker(mWriters, worker);
+		worker->write();
+	}
+	LLMutexLock lock(&mListMutex);
+	mDecodedWriteList.push_back(handle);
+}
+
 //////////////////////////////////////////////////////////////////////////////
 
 LLTextureCache::ReadResponder::ReadResponder()
@@ -1942,3 +2363,11 @@ void LLTextureCache::ReadResponder::setData(U8* data, S32 datasize, S32 imagesiz
 }
 
 //////////////////////////////////////////////////////////////////////////////
+
+void LLTextureCache::DecodedReadResponder::setData(U8* data, S32 datasize, S32 imagesize, S32 imageformat, BOOL imagelocal)
+{
+	LLTextureDecodedCache::unpack(data, datasize, mRawImage, mAuxImage);
+	delete[] data;
+}
+
+//////////////////////////////////////////////////////////////////////////////
@@ -31,17 +31,22 @@
 #include "llstl.h"
 #include "llstring.h"
 #include "lluuid.h"
+#include "lltexturepackstore.h"
+#include "lltexturedecodedcache.h"
 
 #include "llworkerthread.h"
 
 class LLImageFormatted;
+class LLImageRaw;
 class LLTextureCacheWorker;
+class LLTextureCacheShard;
 
 class LLTextureCache : public LLWorkerThread
 {
 	friend class LLTextureCacheWorker;
 	friend class LLTextureCacheRemoteWorker;
 	friend class LLTextureCacheLocalFileWorker;
+	friend class LLTextureCacheDecodedWorker;
 
 private:
 	// Entries
@@ -69,9 +74,53 @@ private:
 		U32 mTime; // seconds since 1/1/1970
 	};
 
+	// Open-addressed (linear probing) hash of header entry indices keyed by UUID.
+	// find() takes no lock and may run while insert()/erase()/rebuild() are
+	// called with mHeaderMutex held. A racing find() can miss an entry or return
+	// a stale index, so it checks the UUID of the candidate entry and callers
+	// re-check the entry they read and retry misses under the lock.
+	// rebuild() fills a new table off to the side and swaps it in, the old
+	// table is deleted once no find() can still be reading it.
+	class EntryIndex
+	{
+	public:
+		EntryIndex();
+		~EntryIndex();
+
+		// Index the live entries (image larger than body) of a fresh entries list.
+		void rebuild(const Entry* entries, U32 num_entries, U32 max_entries);
+		S32 find(const LLUUID& id, const Entry* entries, U32 num_entries);
+		void insert(const LLUUID& id, S32 idx);
+		void erase(const LLUUID& id, S32 idx);
+
+	private:
+		struct Slot
+		{
+			U32 mKey; // CRC32 of the UUID
+			LLAtomicS32 mIndex; // -1 if empty
+		};
+		struct Table
+		{
+			Table(U32 max_entries);
+			~Table();
+			void insert(const LLUUID& id, S32 idx);
+
+			Slot* mSlots;
+			U32 mMask;
+			U32 mCount;
+		};
+		void reclaim();
+
+		Table* volatile mTable; // swapped with apr_atomic_xchgptr
+		LLAtomicS32 mReaders; // find() calls in progress
+		std::vector<Table*> mRetired; // swapped out, deleted when there are no readers
+	};
+
 	
 public:
 
+	typedef std::map<handle_t, LLTextureCacheWorker*> handle_map_t;
+
 	class Responder : public LLResponder
 	{
 	public:
@@ -97,11 +146,26 @@ public:
 			// not used
 		}
 	};
+
+	// Receives the images read from the decoded cache
+	class DecodedReadResponder : public Responder
+	{
+	public:
+		void setData(U8* data, S32 datasize, S32 imagesize, S32 imageformat, BOOL imagelocal);
+	protected:
+		LLPointer<LLImageRaw> mRawImage;
+		LLPointer<LLImageRaw> mAuxImage;
+	};
 	
-	LLTextureCache(bool threaded);
+	// Requests are spread over num_threads cache threads by UUID so that
+	// all requests for one texture are processed in order by one thread.
+	// This object is the first of those threads.
+	LLTextureCache(bool threaded, U32 num_threads = 1);
 	~LLTextureCache();
 
 	/*virtual*/ S32 update(U32 max_time_ms);	
+	/*virtual*/ void shutdown();
+	void pause(); // pauses all the cache threads, update() unpauses them
 	
 	void purgeCache(ELLPath location);
 	void setReadOnly(BOOL read_only) ;
@@ -120,6 +184,14 @@ public:
 
 	bool removeFromCache(const LLUUID& id);
 
+	// Decoded images, see LLTextureDecodedCache. Reads complete with readComplete().
+	bool isDecodedCacheEnabled() const { return mDecodedCache.isEnabled(); }
+	handle_t readDecodedFromCache(const LLUUID& id, U32 priority, S32 discard,
+								  DecodedReadResponder* responder);
+	// Copies the images, the write completes on its own.
+	void writeDecodedToCache(const LLUUID& id, U32 priority, S32 discard,
+							 LLImageRaw* raw, LLImageRaw* aux);
+
 	// For LLTextureCacheWorker::Responder
 	LLTextureCacheWorker* getReader(handle_t handle);
 	LLTextureCacheWorker* getWriter(handle_t handle);
@@ -131,16 +203,26 @@ public:
 	S32 getNumWrites() { return mWriters.size(); }
 	S64 getUsage() { return mTexturesSizeTotal; }
 	S64 getMaxUsage() { return sCacheMaxTexturesSize; }
+	S64 getDecodedUsage() { return mDecodedCache.getUsage(); }
+	S64 getMaxDecodedUsage() { return mDecodedCache.getMaxUsage(); }
 	U32 getEntries() { return mHeaderEntriesInfo.mEntries; }
 	U32 getMaxEntries() { return sCacheMaxEntries; };
 	BOOL isInCache(const LLUUID& id) ;
 	BOOL isInLocal(const LLUUID& id) ;
+	S32 getNumShards() { return (S32)mShards.size(); }
+	void getShardStats(S32 shard, S32& pending, F32& avg_latency_ms, F32& max_latency_ms);
+	S32 getTotalPending();
 
 protected:
 	// Accessed by LLTextureCacheWorker
 	std::string getLocalFileName(const LLUUID& id);
 	std::string getTextureFileName(const LLUUID& id);
+	// Texture bodies, stored either in the pack files or as one file per texture
+	S32 getBodySize(const LLUUID& id, LLVolatileAPRPool* pool);
+	S32 readBody(const LLUUID& id, U8* data, S32 offset, S32 size, LLVolatileAPRPool* pool);
+	S32 writeBody(const LLUUID& id, U8* data, S32 size, LLVolatileAPRPool* pool);
 	void addCompleted(Responder* responder, bool success);
+	void addLatency(S32 shard, F32 latency);
 	
 protected:
 	//void setFileAPRPool(apr_pool_t* pool) { mFileAPRPool = pool ; }
@@ -151,39 +233,57 @@ private:
 	void clearCorruptedCache();
 	void purgeAllTextures(bool purge_directories);
 	void purgeTextures(bool validate);
-	LLAPRFile* openHeaderEntriesFile(bool readonly, S32 offset);
-	void closeHeaderEntriesFile();
+	bool mapHeaderEntriesFile();
+	void unmapHeaderEntriesFile();
+	Entry* getMappedEntries();
+	U32 getNumMappedEntries() const;
 	void readEntriesHeader();
 	void writeEntriesHeader();
 	S32 openAndReadEntry(const LLUUID& id, Entry& entry, bool create);
 	bool updateEntry(S32& idx, Entry& entry, S32 new_image_size, S32 new_body_size);
 	void updateEntryTimeStamp(S32 idx, Entry& entry) ;
 	U32 openAndReadEntries(std::vector<Entry>& entries);
-	void writeEntriesAndClose(const std::vector<Entry>& entries);
-	void readEntryFromHeaderImmediately(S32& idx, Entry& entry) ;
+	void writeEntries(const std::vector<Entry>& entries);
+	bool readEntryFromHeaderImmediately(S32 idx, Entry& entry) ;
 	void writeEntryToHeaderImmediately(S32& idx, Entry& entry, bool write_header = false) ;
 	void removeEntry(S32 idx, Entry& entry, std::string& filename);
-	void removeCachedTexture(const LLUUID& id) ;
+	void removeCachedTexture(const LLUUID& id, S32 idx) ;
 	S32 getHeaderCacheEntry(const LLUUID& id, Entry& entry);
 	S32 setHeaderCacheEntry(const LLUUID& id, Entry& entry, S32 imagesize, S32 datasize);
 	void writeUpdatedEntries() ;
-	void updatedHeaderEntriesFile() ;
 	void lockHeaders() { mHeaderMutex.lock(); }
 	void unlockHeaders() { mHeaderMutex.unlock(); }
+	S32 getShardIndex(const LLUUID& id);
+	handle_t addWorker(handle_map_t& workers, LLTextureCacheWorker* worker);
+	/*virtual*/ bool runCondition();
+	/*virtual*/ void threadedUpdate();
 	
 private:
 	// Internal
 	LLMutex mWorkersMutex;
 	LLMutex mHeaderMutex;
 	LLMutex mListMutex;
-	LLAPRFile* mHeaderAPRFile;
+	LLMappedFile mHeaderEntriesMap; // texture.entries
 	
-	typedef std::map<handle_t, LLTextureCacheWorker*> handle_map_t;
 	handle_map_t mReaders;
 	handle_map_t mWriters;
+	handle_t mNextCacheHandle; // handles of the shard threads overlap, hand out our own
+
+	typedef std::vector<LLWorkerThread*> shard_list_t;
+	shard_list_t mShards; // mShards[0] is this
+
+	struct ShardStats
+	{
+		ShardStats() : mRequests(0), mTotalLatency(0.0), mMaxLatency(0.f) {}
+		U32 mRequests;
+		F64 mTotalLatency; // seconds from queuing to completion
+		F32 mMaxLatency;
+	};
+	std::vector<ShardStats> mShardStats; // protected by mListMutex
 
 	typedef std::vector<handle_t> handle_list_t;
 	handle_list_t mPrioritizeWriteList;
+	handle_list_t mDecodedWriteList; // writes nobody waits for, see update()
 
 	typedef std::vector<std::pair<LLPointer<Responder>, bool> > responder_list_t;
 	responder_list_t mCompletedList;
@@ -196,19 +296,22 @@ private:
 	EntriesInfo mHeaderEntriesInfo;
 	std::set<S32> mFreeList; // deleted entries
 	std::set<LLUUID> mLRU;
-	typedef std::map<LLUUID,S32> id_map_t;
-	id_map_t mHeaderIDMap;
+	U32 mLRUTime; // when mLRU was built, entries used since then are skipped
+	EntryIndex mHeaderIDMap;
 
 	// BODIES (TEXTURES minus headers)
 	std::string mTexturesDirName;
+	std::string mPacksDirName;
+	bool mUsePackFiles;
+	LLTexturePackStore mPackStore;
+	LLAtomicS32 mPackCompacting; // compaction work left, keeps the thread running
+	std::string mDecodedDirName;
+	LLTextureDecodedCache mDecodedCache;
 	typedef std::map<LLUUID,S32> size_map_t;
 	size_map_t mTexturesSizeMap;
 	S64 mTexturesSizeTotal;
 	LLAtomic32<BOOL> mDoPurge;
 
-	typedef std::map<S32, Entry> idx_entry_map_t;
-	idx_entry_map_t mUpdatedEntryMap;
-
 	// Statics
 	static F32 sHeaderCacheVersion;
 	static U32 sCacheMaxEntries;
@@ -0,0 +1,381 @@
+/**
+ * @file lltexturedecodedcache.cpp
+ * @brief Disk cache of decoded texture images.
+ *
+ * $LicenseInfo:firstyear=2012&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2012, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "llviewerprecompiledheaders.h"
+
+#include "lltexturedecodedcache.h"
+
+#include "lldir.h"
+#include "lldiriterator.h"
+#include "llimage.h"
+
+// Packed layout: DecodedHeader, then width * height * components bytes of
+// raw pixels, then aux_width * aux_height * aux_components bytes of aux pixels.
+struct DecodedHeader
+{
+	U32 mMagic;
+	S32 mWidth;
+	S32 mHeight;
+	S32 mComponents;
+	S32 mAuxWidth; // 0 if there is no aux image
+	S32 mAuxHeight;
+	S32 mAuxComponents;
+};
+
+const U32 TEXTURE_DECODED_MAGIC = 0x31434454; // "TDC1", change with the layout
+const S32 TEXTURE_DECODED_MAX_SIZE = 2048;
+const F32 TEXTURE_DECODED_PURGE_AMOUNT = .10f; // % of the budget freed when it is exceeded
+
+static S32 image_bytes(S32 width, S32 height, S32 components)
+{
+	return width * height * components;
+}
+
+static bool valid_image(S32 width, S32 height, S32 components)
+{
+	return width > 0 && width <= TEXTURE_DECODED_MAX_SIZE
+		&& height > 0 && height <= TEXTURE_DECODED_MAX_SIZE
+		&& components > 0 && components <= 4;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+LLTextureDecodedCache::LLTextureDecodedCache()
+	: mMutex(NULL),
+	  mReadOnly(false),
+	  mMaxBytes(0),
+	  mUsedBytes(0)
+{
+}
+
+LLTextureDecodedCache::~LLTextureDecodedCache()
+{
+}
+
+std::string LLTextureDecodedCache::getFileName(const key_t& key) const
+{
+	return mDirName + gDirUtilp->getDirDelimiter() + key.first.asString() + llformat("_%d.raw", key.second);
+}
+
+bool LLTextureDecodedCache::init(const std::string& dirname, S64 max_bytes, bool read_only)
+{
+	LLMutexLock lock(&mMutex);
+	mDirName = dirname;
+	mReadOnly = read_only;
+	mMaxBytes = max_bytes;
+	mLRU.clear();
+	mEntries.clear();
+	mUsedBytes = 0;
+	if (!isEnabled())
+	{
+		if (!mReadOnly && LLFile::isdir(mDirName))
+		{
+			// The tier was turned off, give the space back.
+			gDirUtilp->deleteFilesInDir(mDirName, "*");
+			LLFile::rmdir(mDirName);
+		}
+		return false;
+	}
+	if (!mReadOnly)
+	{
+		LLFile::mkdir(mDirName);
+	}
+
+	// UUID_D.raw, ordered by modification time
+	std::multimap<time_t, std::pair<key_t, S32> > files;
+	std::string filename;
+	LLDirIterator iter(mDirName, "*.raw");
+	while (iter.next(filename))
+	{
+		size_t sep = filename.find('_');
+		std::string id_str = filename.substr(0, sep);
+		llstat stat_data;
+		if (sep == std::string::npos || !LLUUID::validate(id_str)
+			|| LLFile::stat(mDirName + gDirUtilp->getDirDelimiter() + filename, &stat_data) != 0)
+		{
+			continue;
+		}
+		key_t key(LLUUID(id_str), atoi(filename.c_str() + sep + 1));
+		files.insert(std::make_pair(stat_data.st_mtime, std::make_pair(key, (S32)stat_data.st_size)));
+	}
+	// Oldest first, addEntry() puts each one in front of the previous ones.
+	for (std::multimap<time_t, std::pair<key_t, S32> >::iterator it = files.begin(); it != files.end(); ++it)
+	{
+		addEntry(it->second.first, it->second.second);
+	}
+
+	std::vector<std::string> evicted;
+	if (mUsedBytes > mMaxBytes)
+	{
+		evict(mMaxBytes, evicted);
+	}
+	llinfos << "Decoded texture cache: " << mEntries.size() << " images, "
+			<< mUsedBytes / (1024 * 1024) << " of " << mMaxBytes / (1024 * 1024) << " MB" << llendl;
+	removeFiles(evicted); // nothing else can use the cache yet
+	return true;
+}
+
+void LLTextureDecodedCache::purge()
+{
+	LLMutexLock lock(&mMutex);
+	mLRU.clear();
+	mEntries.clear();
+	mUsedBytes = 0;
+	if (!mReadOnly && !mDirName.empty())
+	{
+		gDirUtilp->deleteFilesInDir(mDirName, "*");
+	}
+}
+
+// Called with mMutex locked
+void LLTextureDecodedCache::addEntry(const key_t& key, S32 size)
+{
+	entry_map_t::iterator iter = mEntries.find(key);
+	if (iter != mEntries.end())
+	{
+		eraseEntry(iter);
+	}
+	mLRU.push_front(Entry(key, size));
+	mEntries[key] = mLRU.begin();
+	mUsedBytes += size;
+}
+
+// Called with mMutex locked
+void LLTextureDecodedCache::eraseEntry(entry_map_t::iterator iter)
+{
+	mUsedBytes -= iter->second->mSize;
+	mLRU.erase(iter->second);
+	mEntries.erase(iter);
+}
+
+// Called with mMutex locked, the files are removed by the caller once it is released.
+void LLTextureDecodedCache::evict(S64 max_bytes, std::vector<std::string>& files)
+{
+	while (mUsedBytes > max_bytes && !mLRU.empty())
+	{
+		key_t key = mLRU.back().mKey;
+		files.push_back(getFileName(key));
+		eraseEntry(mEntries.find(key));
+	}
+}
+
+void LLTextureDecodedCache::removeFiles(const std::vector<std::string>& files)
+{
+	if (mReadOnly)
+	{
+		return;
+	}
+	for (std::vector<std::string>::const_iterator iter = files.begin(); iter != files.end(); ++iter)
+	{
+		LLFile::remove(*iter);
+	}
+}
+
+U8* LLTextureDecodedCache::read(const LLUUID& id, S32 discard, S32& size)
+{
+	key_t key(id, discard);
+	std::string filename;
+	{
+		LLMutexLock lock(&mMutex);
+		entry_map_t::iterator iter = mEntries.find(key);
+		if (iter == mEntries.end())
+		{
+			return NULL;
+		}
+		// Most recently used
+		mLRU.splice(mLRU.begin(), mLRU, iter->second);
+		size = iter->second->mSize;
+		filename = getFileName(key);
+	}
+
+	U8* data = NULL;
+	LLFILE* file = LLFile::fopen(filename, "rb");
+	if (file && size > (S32)sizeof(DecodedHeader))
+	{
+		data = new U8[size];
+		if (fread(data, 1, size, file) != (size_t)size
+			|| ((DecodedHeader*)data)->mMagic != TEXTURE_DECODED_MAGIC)
+		{
+			delete[] data;
+			data = NULL;
+		}
+	}
+	if (file)
+	{
+		LLFile::close(file);
+	}
+	if (!data)
+	{
+		LL_DEBUGS("TextureCache") << "Unable to read decoded image " << filename << LL_ENDL;
+		LLMutexLock lock(&mMutex);
+		entry_map_t::iterator iter = mEntries.find(key);
+		if (iter != mEntries.end())
+		{
+			eraseEntry(iter);
+		}
+		size = 0;
+	}
+	return data;
+}
+
+bool LLTextureDecodedCache::write(const LLUUID& id, S32 discard, const U8* data, S32 size)
+{
+	if (mReadOnly || !isEnabled() || size > mMaxBytes * TEXTURE_DECODED_PURGE_AMOUNT)
+	{
+		return false;
+	}
+	key_t key(id, discard);
+	std::string filename = getFileName(key);
+	LLFILE* file = LLFile::fopen(filename, "wb");
+	if (!file)
+	{
+		return false;
+	}
+	bool success = fwrite(data, 1, size, file) == (size_t)size;
+	LLFile::close(file);
+	if (!success)
+	{
+		LLFile::remove(filename);
+		return false;
+	}
+
+	std::vector<std::string> evicted;
+	{
+		LLMutexLock lock(&mMutex);
+		addEntry(key, size);
+		if (mUsedBytes > mMaxBytes)
+		{
+			evict((S64)(mMaxBytes * (1.f - TEXTURE_DECODED_PURGE_AMOUNT)), evicted);
+		}
+	}
+	removeFiles(evicted);
+	return true;
+}
+
+void LLTextureDecodedCache::remove(const LLUUID& id)
+{
+	std::vector<std::string> files;
+	{
+		LLMutexLock lock(&mMutex);
+		entry_map_t::iterator iter = mEntries.lower_bound(key_t(id, S32_MIN));
+		while (iter != mEntries.end() && iter->first.first == id)
+		{
+			files.push_back(getFileName(iter->first));
+			eraseEntry(iter++);
+		}
+	}
+	removeFiles(files);
+}
+
+S64 LLTextureDecodedCache::getUsage()
+{
+	LLMutexLock lock(&mMutex);
+	return mUsedBytes;
+}
+
+//static
+U8* LLTextureDecodedCache::pack(LLImageRaw* raw, LLImageRaw* aux, S32& size)
+{
+	size = 0;
+	if (!raw || !raw->getData()
+		|| !valid_image(raw->getWidth(), raw->getHeight(), raw->getComponents()))
+	{
+		return NULL;
+	}
+	DecodedHeader header;
+	header.mMagic = TEXTURE_DECODED_MAGIC;
+	header.mWidth = raw->getWidth();
+	header.mHeight = raw->getHeight();
+	header.mComponents = raw->getComponents();
+	header.mAuxWidth = 0;
+	header.mAuxHeight = 0;
+	header.mAuxComponents = 0;
+	if (aux && aux->getData()
+		&& valid_image(aux->getWidth(), aux->getHeight(), aux->getComponents()))
+	{
+		header.mAuxWidth = aux->getWidth();
+		header.mAuxHeight = aux->getHeight();
+		header.mAuxComponents = aux->getComponents();
+	}
+	S32 raw_bytes = image_bytes(header.mWidth, header.mHeight, header.mComponents);
+	S32 aux_bytes = image_bytes(header.mAuxWidth, header.mAuxHeight, header.mAuxComponents);
+
+	size = (S32)sizeof(DecodedHeader) + raw_bytes + aux_bytes;
+	U8* data = new U8[size];
+	memcpy(data, &header, sizeof(DecodedHeader));
+	memcpy(data + sizeof(DecodedHeader), raw->getData(), raw_bytes);
+	if (aux_bytes)
+	{
+		memcpy(data + sizeof(DecodedHeader) + raw_bytes, aux->getData(), aux_bytes);
+	}
+	return data;
+}
+
+//static
+bool LLTextureDecodedCache::unpack(const U8* data, S32 size, LLPointer<LLImageRaw>& raw, LLPointer<LLImageRaw>& aux)
+{
+	raw = NULL;
+	aux = NULL;
+	if (!data || size < (S32)sizeof(DecodedHeader))
+	{
+		return false;
+	}
+	DecodedHeader header;
+	memcpy(&header, data, sizeof(DecodedHeader));
+	bool has_aux = header.mAuxWidth > 0;
+	if (header.mMagic != TEXTURE_DECODED_MAGIC
+		|| !valid_image(header.mWidth, header.mHeight, header.mComponents)
+		|| (has_aux && !valid_image(header.mAuxWidth, header.mAuxHeight, header.mAuxComponents)))
+	{
+		return false;
+	}
+	S32 raw_bytes = image_bytes(header.mWidth, header.mHeight, header.mComponents);
+	S32 aux_bytes = has_aux ? image_bytes(header.mAuxWidth, header.mAuxHeight, header.mAuxComponents) : 0;
+	if (size != (S32)sizeof(DecodedHeader) + raw_bytes + aux_bytes)
+	{
+		return false;
+	}
+
+	raw = new LLImageRaw((U16)header.mWidth, (U16)header.mHeight, (S8)header.mComponents);
+	if (!raw->getData())
+	{
+		raw = NULL;
+		return false;
+	}
+	memcpy(raw->getData(), data + sizeof(DecodedHeader), raw_bytes);
+	if (has_aux)
+	{
+		aux = new LLImageRaw((U16)header.mAuxWidth, (U16)header.mAuxHeight, (S8)header.mAuxComponents);
+		if (!aux->getData())
+		{
+			raw = NULL;
+			aux = NULL;
+			return false;
+		}
+		memcpy(aux->getData(), data + sizeof(DecodedHeader) + raw_bytes, aux_bytes);
+	}
+	return true;
+}
@@ -0,0 +1,101 @@
+/**
+ * @file lltexturedecodedcache.h
+ * @brief Disk cache of decoded texture images.
+ *
+ * $LicenseInfo:firstyear=2012&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2012, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLTEXTUREDECODEDCACHE_H
+#define LL_LLTEXTUREDECODEDCACHE_H
+
+#include "lluuid.h"
+#include "llthread.h"
+#include "llpointer.h"
+
+class LLImageRaw;
+
+// Second tier of the texture cache holding the output of the image decoder,
+// so that a texture decoded in an earlier session loads with a file read and
+// a copy instead of a J2C decode.
+// Each decode is stored in its own file (texturecache/decoded/UUID_D.raw,
+// D being the discard level) as a small header followed by the pixels of the
+// raw image and of the aux (alpha) image if there is one.
+// The tier has its own size budget and least recently used list, independent
+// of the J2C entries. The list is rebuilt from the file times at startup.
+//
+// All methods are thread safe. File I/O is done without holding the lock.
+class LLTextureDecodedCache
+{
+public:
+	LLTextureDecodedCache();
+	~LLTextureDecodedCache();
+
+	// Indexes the files in dirname. max_bytes <= 0 disables the tier.
+	bool init(const std::string& dirname, S64 max_bytes, bool read_only);
+	// Drops all the entries and deletes their files.
+	void purge();
+	bool isEnabled() const { return mMaxBytes > 0; }
+
+	// Returns a new[] buffer holding the packed images of id at discard level
+	// (owned by the caller), NULL if there is none.
+	U8* read(const LLUUID& id, S32 discard, S32& size);
+	// Stores packed images, evicting the least recently used entries to fit.
+	bool write(const LLUUID& id, S32 discard, const U8* data, S32 size);
+	// Removes the entries of id at all discard levels.
+	void remove(const LLUUID& id);
+
+	S64 getUsage();
+	S64 getMaxUsage() const { return mMaxBytes; }
+
+	// Packed format: header, raw pixels, aux pixels.
+	// Returns a new[] buffer owned by the caller.
+	static U8* pack(LLImageRaw* raw, LLImageRaw* aux, S32& size);
+	static bool unpack(const U8* data, S32 size, LLPointer<LLImageRaw>& raw, LLPointer<LLImageRaw>& aux);
+
+private:
+	typedef std::pair<LLUUID, S32> key_t;
+	struct Entry
+	{
+		Entry(const key_t& key, S32 size) : mKey(key), mSize(size) {}
+		key_t mKey;
+		S32 mSize;
+	};
+	typedef std::list<Entry> lru_list_t; // most recently used first
+	typedef std::map<key_t, lru_list_t::iterator> entry_map_t;
+
+	std::string getFileName(const key_t& key) const;
+	void addEntry(const key_t& key, S32 size);
+	void eraseEntry(entry_map_t::iterator iter);
+	void evict(S64 max_bytes, std::vector<std::string>& files);
+	void removeFiles(const std::vector<std::string>& files);
+
+private:
+	LLMutex mMutex; // protects everything below, never held during file I/O
+	std::string mDirName;
+	bool mReadOnly;
+	S64 mMaxBytes;
+	S64 mUsedBytes;
+	lru_list_t mLRU;
+	entry_map_t mEntries;
+};
+
+#endif // LL_LLTEXTUREDECODEDCACHE_H
@@ -53,6 +53,14 @@
 #include "llviewerassetstats.h"
 #include "llworld.h"
 
+// HTTP concurrency, see LLTextureFetch::updateHTTPConcurrency()
+const S32 HTTP_MIN_CONCURRENCY = 2;
+const S32 HTTP_START_CONCURRENCY = 8;
+const F32 HTTP_QUEUED_LOW = 1.f; // requests waiting, grow below
+const F32 HTTP_QUEUED_HIGH = 3.f; // requests waiting, shrink above
+const F32 HTTP_BACKOFF_TIME = 2.f; // seconds without growing after a 503
+const F32 HTTP_MIN_LATENCY_TIME = 30.f; // seconds a minimum latency is trusted
+
 //////////////////////////////////////////////////////////////////////////////
 class LLTextureFetchWorker : public LLWorkerClass
 {
@@ -81,6 +89,26 @@ private:
 		LLUUID mID;
 	};
 
+	class DecodedCacheReadResponder : public LLTextureCache::DecodedReadResponder
+	{
+	public:
+		DecodedCacheReadResponder(LLTextureFetch* fetcher, const LLUUID& id)
+			: mFetcher(fetcher), mID(id)
+		{
+		}
+		virtual void completed(bool success)
+		{
+			LLTextureFetchWorker* worker = mFetcher->getWorker(mID);
+			if (worker)
+			{
+				worker->callbackDecodedCacheRead(success && mRawImage.notNull(), mRawImage, mAuxImage);
+			}
+		}
+	private:
+		LLTextureFetch* mFetcher;
+		LLUUID mID;
+	};
+
 	class CacheWriteResponder : public LLTextureCache::WriteResponder
 	{
 	public:
@@ -153,6 +181,7 @@ public:
 	void callbackCacheRead(bool success, LLImageFormatted* image,
 						   S32 imagesize, BOOL islocal);
 	void callbackCacheWrite(bool success);
+	void callbackDecodedCacheRead(bool success, LLImageRaw* raw, LLImageRaw* aux);
 	void callbackDecoded(bool success, LLImageRaw* raw, LLImageRaw* aux);
 	
 	void setGetStatus(U32 status, const std::string& reason)
@@ -185,6 +214,7 @@ private:
 	void setupPacketData();
 	U32 calcWorkPriority();
 	void removeFromCache();
+	bool canUseDecodedCache(S32 discard);
 	bool processSimulatorPackets();
 	bool writeToCacheComplete();
 	
@@ -204,6 +234,7 @@ private:
 		SEND_HTTP_REQ,
 		WAIT_HTTP_REQ,
 		DECODE_IMAGE,
+		LOAD_FROM_DECODED_CACHE,
 		DECODE_IMAGE_UPDATE,
 		WRITE_TO_CACHE,
 		WAIT_ON_WRITE,
@@ -240,6 +271,7 @@ private:
 	S32 mRequestedDiscard;
 	S32 mLoadedDiscard;
 	S32 mDecodedDiscard;
+	S32 mDecodedCacheDiscard; // discard level looked up in the decoded cache, -1 if none
 	LLFrameTimer mRequestedTimer;
 	LLFrameTimer mFetchTimer;
 	LLTextureCache::handle_t mCacheReadHandle;
@@ -254,6 +286,7 @@ private:
 	handle_t mDecodeHandle;
 	BOOL mLoaded;
 	BOOL mDecoded;
+	BOOL mDecodedFromCache;
 	BOOL mWritten;
 	BOOL mNeedsAux;
 	BOOL mHaveAllData;
@@ -318,6 +351,7 @@ public:
 		}
 
 		lldebugs << "HTTP COMPLETE: " << mID << llendl;
+		mFetcher->updateHTTPConcurrency(status, (F32)(LLTimer::getTotalTime() - mStartTime) * 0.000001f);
 		LLTextureFetchWorker* worker = mFetcher->getWorker(mID);
 		if (worker)
 		{
@@ -620,6 +654,7 @@ const char* LLTextureFetchWorker::sStateDescs[] = {
 	"SEND_HTTP_REQ",
 	"WAIT_HTTP_REQ",
 	"DECODE_IMAGE",
+	"LOAD_FROM_DECODED_CACHE",
 	"DECODE_IMAGE_UPDATE",
 	"WRITE_TO_CACHE",
 	"WAIT_ON_WRITE",
@@ -653,6 +688,7 @@ LLTextureFetchWorker::LLTextureFetchWorker(LLTextureFetch* fetcher,
 	  mRequestedDiscard(-1),
 	  mLoadedDiscard(-1),
 	  mDecodedDiscard(-1),
+	  mDecodedCacheDiscard(-1),
 	  mCacheReadHandle(LLTextureCache::nullHandle()),
 	  mCacheWriteHandle(LLTextureCache::nullHandle()),
 	  mBuffer(NULL),
@@ -665,6 +701,7 @@ LLTextureFetchWorker::LLTextureFetchWorker(LLTextureFetch* fetcher,
 	  mSentRequest(UNSENT),
 	  mDecodeHandle(0),
 	  mDecoded(FALSE),
+	  mDecodedFromCache(FALSE),
 	  mWritten(FALSE),
 	  mNeedsAux(FALSE),
 	  mHaveAllData(FALSE),
@@ -881,6 +918,7 @@ bool LLTextureFetchWorker::doWork(S32 param)
 		mRequestedDiscard = -1;
 		mLoadedDiscard = -1;
 		mDecodedDiscard = -1;
+		mDecodedCacheDiscard = -1;
 		mRequestedSize = 0;
 		mFileSize = 0;
 		mCachedSize = 0;
@@ -1141,8 +1179,8 @@ bool LLTextureFetchWorker::doWork(S32 param)
 			//1, not openning too many file descriptors at the same time;
 			//2, control the traffic of http so udp gets bandwidth.
 			//
-			static const S32 MAX_NUM_OF_HTTP_REQUESTS_IN_QUEUE = 8 ;
-			if(mFetcher->getNumHTTPRequests() > MAX_NUM_OF_HTTP_REQUESTS_IN_QUEUE)
+			//the limit follows the measured latency, see LLTextureFetch::updateHTTPConcurrency().
+			if(mFetcher->getNumHTTPRequests() >= mFetcher->getMaxHTTPRequests())
 			{
 				return false ; //wait.
 			}
@@ -1199,7 +1237,7 @@ bool LLTextureFetchWorker::doWork(S32 param)
 				// Will call callbackHttpGet when curl request completes
 				std::vector<std::string> headers;
 				headers.push_back("Accept: image/x-j2c");
-				res = mFetcher->mCurlGetRequest->getByteRange(mUrl, headers, offset, mRequestedSize,
+				res = mFetcher->mCurlTextureRequest->getByteRange(mUrl, headers, offset, mRequestedSize,
 															  new HTTPGetResponder(mFetcher, mID, LLTimer::getTotalTime(), mRequestedSize, offset, true));
 			}
 			if (!res)
@@ -1380,9 +1418,26 @@ bool LLTextureFetchWorker::doWork(S32 param)
 		setPriority(LLWorkerThread::PRIORITY_LOW | mWorkPriority); // Set priority first since Responder may change it
 		mRawImage = NULL;
 		mAuxImage = NULL;
+		mDecodedFromCache = FALSE;
 		llassert_always(mFormattedImage.notNull());
 		S32 discard = mHaveAllData ? 0 : mLoadedDiscard;
 		U32 image_priority = LLWorkerThread::PRIORITY_NORMAL | mWorkPriority;
+		if (mDecodedCacheDiscard != discard && canUseDecodedCache(discard))
+		{
+			// Look for an earlier decode of this discard level first, once
+			mDecodedCacheDiscard = discard;
+			mDecoded = FALSE;
+			mState = LOAD_FROM_DECODED_CACHE;
+			DecodedCacheReadResponder* responder = new DecodedCacheReadResponder(mFetcher, mID);
+			mCacheReadHandle = mFetcher->mTextureCache->readDecodedFromCache(mID, mWorkPriority, discard, responder);
+			return false;
+		}
+		if (mFormattedImage->getCodec() == IMG_CODEC_J2C)
+		{
+			// Let the decoder keep its state while this texture is still being refined
+			static LLCachedControl<bool> progressive_decode(gSavedSettings,"TextureDecodeProgressive");
+			((LLImageJ2C*)mFormattedImage.get())->setIncrementalDecode(progressive_decode);
+		}
 		mDecoded  = FALSE;
 		mState = DECODE_IMAGE_UPDATE;
 		LL_DEBUGS("Texture") << mID << ": Decoding. Bytes: " << mFormattedImage->getDataSize() << " Discard: " << discard
@@ -1391,6 +1446,34 @@ bool LLTextureFetchWorker::doWork(S32 param)
 																  new DecodeResponder(mFetcher, mID, this));
 		// fall though
 	}
+
+	if (mState == LOAD_FROM_DECODED_CACHE)
+	{
+		if (!mDecoded)
+		{
+			return false;
+		}
+		// Make sure request is complete. *TODO: make this auto-complete
+		if (!mFetcher->mTextureCache->readComplete(mCacheReadHandle, false))
+		{
+			return false;
+		}
+		mCacheReadHandle = LLTextureCache::nullHandle();
+		if (!mDecodedFromCache || (mNeedsAux && mAuxImage.isNull()))
+		{
+			// Not there, decode it
+			mRawImage = NULL;
+			mAuxImage = NULL;
+			mDecodedFromCache = FALSE;
+			mDecoded = FALSE;
+			mState = DECODE_IMAGE;
+			setPriority(LLWorkerThread::PRIORITY_HIGH | mWorkPriority);
+			return false;
+		}
+		LL_DEBUGS("Texture") << mID << ": Loaded decoded image. Discard: " << mDecodedDiscard << LL_ENDL;
+		mState = DECODE_IMAGE_UPDATE;
+		// fall through
+	}
 	
 	if (mState == DECODE_IMAGE_UPDATE)
 	{
@@ -1421,6 +1504,10 @@ bool LLTextureFetchWorker::doWork(S32 param)
 				llassert_always(mRawImage.notNull());
 				LL_DEBUGS("Texture") << mID << ": Decoded. Discard: " << mDecodedDiscard
 						<< " Raw Image: " << llformat("%dx%d",mRawImage->getWidth(),mRawImage->getHeight()) << LL_ENDL;
+				if (!mDecodedFromCache && mDecodedDiscard == mDecodedCacheDiscard)
+				{
+					mFetcher->mTextureCache->writeDecodedToCache(mID, mWorkPriority, mDecodedDiscard, mRawImage, mAuxImage);
+				}
 				setPriority(LLWorkerThread::PRIORITY_HIGH | mWorkPriority);
 				mState = WRITE_TO_CACHE;
 			}
@@ -1496,6 +1583,11 @@ bool LLTextureFetchWorker::doWork(S32 param)
 		}
 		else
 		{
+			if (mFormattedImage.notNull() && mFormattedImage->getCodec() == IMG_CODEC_J2C)
+			{
+				// No more data is coming for now, release the kept decoder state
+				((LLImageJ2C*)mFormattedImage.get())->resetDecodeState();
+			}
 			setPriority(LLWorkerThread::PRIORITY_LOW | mWorkPriority);
 			return true;
 		}
@@ -1746,6 +1838,41 @@ void LLTextureFetchWorker::callbackCacheWrite(bool success)
 
 //////////////////////////////////////////////////////////////////////////////
 
+void LLTextureFetchWorker::callbackDecodedCacheRead(bool success, LLImageRaw* raw, LLImageRaw* aux)
+{
+	LLMutexLock lock(&mWorkMutex);
+	if (mState != LOAD_FROM_DECODED_CACHE)
+	{
+		return;
+	}
+	if (success)
+	{
+		mRawImage = raw;
+		mAuxImage = aux;
+		mDecodedDiscard = mDecodedCacheDiscard;
+		mDecodedFromCache = TRUE;
+	}
+	mDecoded = TRUE;
+	setPriority(LLWorkerThread::PRIORITY_HIGH | mWorkPriority);
+}
+
+// Decodes are only worth keeping when they will not change: complete J2C
+// data for the discard level, and not a local file that may be edited.
+bool LLTextureFetchWorker::canUseDecodedCache(S32 discard)
+{
+	if (!mFetcher->mTextureCache->isDecodedCacheEnabled()
+		|| mInLocalCache || mUrl.compare(0, 7, "file://") == 0
+		|| mFormattedImage->getCodec() != IMG_CODEC_J2C
+		|| mFormattedImage->getWidth() <= 0) // the data size of a level needs the header
+	{
+		return false;
+	}
+	return mHaveAllData
+		|| mFormattedImage->getDataSize() >= ((LLImageJ2C*)mFormattedImage.get())->calcDataSize(discard);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
 void LLTextureFetchWorker::callbackDecoded(bool success, LLImageRaw* raw, LLImageRaw* aux)
 {
 	LLMutexLock lock(&mWorkMutex);
@@ -1824,10 +1951,16 @@ LLTextureFetch::LLTextureFetch(LLTextureCache* cache, LLImageDecodeThread* image
 	  mHTTPTextureBits(0),
 	  mTotalHTTPRequests(0),
 	  mCurlGetRequest(NULL),
+	  mCurlTextureRequest(NULL),
+	  mHTTPMinLatency(0.f),
+	  mHTTPLatency(0.f),
 	  mQAMode(qa_mode)
 {
 	mCurlPOSTRequestCount = 0;
 	mMaxBandwidth = gSavedSettings.getF32("ThrottleBandwidthKBPS");
+	mHTTPMaxConcurrency = llmax((S32)gSavedSettings.getU32("TextureFetchMaxHTTPRequests"), HTTP_MIN_CONCURRENCY);
+	mHTTPConcurrency = (F32)llmin(HTTP_START_CONCURRENCY, mHTTPMaxConcurrency);
+	mHTTPPipelining = gSavedSettings.getBOOL("TextureFetchHTTPPipelining");
 	mTextureInfo.setUpLogging(gSavedSettings.getBOOL("LogTextureDownloadsToViewerLog"), gSavedSettings.getBOOL("LogTextureDownloadsToSimulator"), gSavedSettings.getU32("TextureLoggingThreshold"));
 }
 
@@ -2028,6 +2161,62 @@ S32 LLTextureFetch::getNumRequests()
 	return size ;
 }
 
+S32 LLTextureFetch::getMaxHTTPRequests()
+{
+	LLMutexLock lock(&mNetworkQueueMutex);
+	return llfloor(mHTTPConcurrency);
+}
+
+// Adjusts the number of HTTP requests kept in flight, like TCP Vegas does
+// with its window. With C requests in flight taking L seconds each while
+// the least loaded requests take Lmin, about C * (1 - Lmin / L) of them are
+// waiting in a queue on the server or the link instead of moving data.
+// Keeping one to three queued keeps the link busy without piling up
+// requests. A 503 or a connection failure halves the count.
+void LLTextureFetch::updateHTTPConcurrency(U32 status, F32 latency)
+{
+	LLMutexLock lock(&mNetworkQueueMutex);
+	if (status == HTTP_SERVICE_UNAVAILABLE || status == HTTP_INTERNAL_ERROR)
+	{
+		// Once per backoff period, the other requests in flight saw the same overload
+		if (mHTTPBackoffTimer.getElapsedTimeF32() > HTTP_BACKOFF_TIME)
+		{
+			mHTTPConcurrency = llmax(mHTTPConcurrency * 0.5f, (F32)HTTP_MIN_CONCURRENCY);
+			mHTTPBackoffTimer.reset();
+			LL_DEBUGS("Texture") << "HTTP status " << status << ", requests: " << mHTTPConcurrency << LL_ENDL;
+		}
+		return;
+	}
+	if (status >= HTTP_BAD_REQUEST || latency <= 0.f)
+	{
+		return; // says nothing about the load
+	}
+
+	// Forget the minimum from time to time in case the route changed
+	if (mHTTPMinLatency <= 0.f || latency < mHTTPMinLatency
+		|| mHTTPMinLatencyTimer.getElapsedTimeF32() > HTTP_MIN_LATENCY_TIME)
+	{
+		mHTTPMinLatency = latency;
+		mHTTPMinLatencyTimer.reset();
+	}
+	mHTTPLatency = mHTTPLatency > 0.f ? lerp(mHTTPLatency, latency, 0.125f) : latency;
+
+	F32 queued = mHTTPConcurrency * (1.f - mHTTPMinLatency / llmax(mHTTPLatency, mHTTPMinLatency));
+	if (queued < HTTP_QUEUED_LOW)
+	{
+		// Grows by one request per round of responses, not while throttled
+		if (mTextureBandwidth < mMaxBandwidth && mHTTPBackoffTimer.getElapsedTimeF32() > HTTP_BACKOFF_TIME)
+		{
+			mHTTPConcurrency += 1.f / mHTTPConcurrency;
+		}
+	}
+	else if (queued > HTTP_QUEUED_HIGH)
+	{
+		mHTTPConcurrency -= 1.f / mHTTPConcurrency;
+	}
+	mHTTPConcurrency = llclamp(mHTTPConcurrency, (F32)HTTP_MIN_CONCURRENCY, (F32)mHTTPMaxConcurrency);
+}
+
 S32 LLTextureFetch::getNumHTTPRequests() 
 { 
 	mNetworkQueueMutex.lock() ;
@@ -2193,8 +2382,15 @@ void LLTextureFetch::commonUpdate()
 	// Run a cross-thread command, if any.
 	cmdDoWork();
 	
+	{
+		LLMutexLock lock(&mNetworkQueueMutex);
+		mCurlTextureRequest->setPipelining(mHTTPPipelining);
+		mCurlTextureRequest->setMaxConnections(mHTTPMaxConcurrency);
+	}
+
 	// Update Curl on same thread as mCurlGetRequest was constructed
 	S32 processed = mCurlGetRequest->process();
+	processed += mCurlTextureRequest->process();
 	if (processed > 0)
 	{
 		lldebugs << "processed: " << processed << " messages." << llendl;
@@ -2207,10 +2403,15 @@ void LLTextureFetch::commonUpdate()
 S32 LLTextureFetch::update(U32 max_time_ms)
 {
 	static LLCachedControl<F32> band_width(gSavedSettings,"ThrottleBandwidthKBPS");
+	static LLCachedControl<U32> max_http_requests(gSavedSettings,"TextureFetchMaxHTTPRequests");
+	static LLCachedControl<bool> http_pipelining(gSavedSettings,"TextureFetchHTTPPipelining");
 
 	{
 		mNetworkQueueMutex.lock() ;
 		mMaxBandwidth = band_width ;
+		mHTTPMaxConcurrency = llmax((S32)max_http_requests, HTTP_MIN_CONCURRENCY);
+		mHTTPConcurrency = llmin(mHTTPConcurrency, (F32)mHTTPMaxConcurrency);
+		mHTTPPipelining = http_pipelining;
 
 		gTextureList.sTextureBits += mHTTPTextureBits ;
 		mHTTPTextureBits = 0 ;
@@ -2258,6 +2459,7 @@ void LLTextureFetch::startThread()
 {
 	// Construct mCurlGetRequest from Worker Thread
 	mCurlGetRequest = new LLCurlRequest();
+	mCurlTextureRequest = new LLCurlPooledRequest(mHTTPPipelining, mHTTPMaxConcurrency);
 }
 
 // WORKER THREAD
@@ -2266,6 +2468,8 @@ void LLTextureFetch::endThread()
 	// Destroy mCurlGetRequest from Worker Thread
 	delete mCurlGetRequest;
 	mCurlGetRequest = NULL;
+	delete mCurlTextureRequest;
+	mCurlTextureRequest = NULL;
 }
 
 // WORKER THREAD
@@ -79,6 +79,7 @@ public:
 	void dump();
 	S32 getNumRequests() ;
 	S32 getNumHTTPRequests() ;
+	S32 getMaxHTTPRequests() ;
 	U32 getTotalNumHTTPRequests() ;
 	
 	// Public for access by callbacks
@@ -111,6 +112,7 @@ protected:
 	void removeFromNetworkQueue(LLTextureFetchWorker* worker, bool cancel);
 	void addToHTTPQueue(const LLUUID& id);
 	void removeFromHTTPQueue(const LLUUID& id, S32 received_size = 0);
+	void updateHTTPConcurrency(U32 status, F32 latency);
 	void removeRequest(LLTextureFetchWorker* worker, bool cancel);
 
 	// Overrides from the LLThread tree
@@ -167,6 +169,7 @@ private:
 	LLTextureCache* mTextureCache;
 	LLImageDecodeThread* mImageDecodeThread;
 	LLCurlRequest* mCurlGetRequest;
+	LLCurlPooledRequest* mCurlTextureRequest; // texture GETs, keeps the connections to the texture hosts
 	
 	// Map of all requests by UUID
 	typedef std::map<LLUUID,LLTextureFetchWorker*> map_t;
@@ -180,6 +183,15 @@ private:
 	cancel_queue_t mCancelQueue;
 	F32 mTextureBandwidth;
 	F32 mMaxBandwidth;
+
+	// HTTP requests in flight, adjusted by updateHTTPConcurrency()
+	F32 mHTTPConcurrency;
+	S32 mHTTPMaxConcurrency;
+	bool mHTTPPipelining;
+	F32 mHTTPMinLatency; // seconds, lowest request latency seen lately
+	F32 mHTTPLatency; // seconds, smoothed request latency
+	LLFrameTimer mHTTPMinLatencyTimer;
+	LLFrameTimer mHTTPBackoffTimer;
 	LLTextureInfo mTextureInfo;
 
 	U32 mHTTPTextureBits;
@@ -0,0 +1,612 @@
+/** 
+ * @file lltexturepackstore.cpp
+ * @brief Packs texture cache bodies into large segment files.
+ *
+ * $LicenseInfo:firstyear=2012&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2012, Linden Research, Inc.
+ * 
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ * 
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ * 
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "llviewerprecompiledheaders.h"
+
+#include "lltexturepackstore.h"
+
+#include "lldir.h"
+#include "lldiriterator.h"
+
+// Segment layout: SegmentHeader followed by the records.
+struct SegmentHeader
+{
+	U32 mMagic;
+	U32 mGeneration;
+};
+
+// Record layout: RecordHeader followed by mSize bytes of body.
+struct RecordHeader
+{
+	U32 mMagic;
+	LLUUID mID;
+	S32 mSize;
+};
+
+const U32 TEXTURE_PACK_SEGMENT_MAGIC = 0x47455354; // "TSEG"
+const U32 TEXTURE_PACK_RECORD_MAGIC = 0x4b415054; // "TPAK"
+const S32 TEXTURE_PACK_SEGMENT_SIZE = 64 * 1024 * 1024;
+const S32 TEXTURE_PACK_MAX_SEGMENTS = 10000;
+const F32 TEXTURE_PACK_COMPACT_RATIO = 0.5f; // compact segments with less live data than this
+
+static S32 record_size(S32 body_size)
+{
+	return (S32)sizeof(RecordHeader) + body_size;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+LLTexturePackStore::LLTexturePackStore()
+	: mMutex(NULL),
+	  mReadOnly(false),
+	  mActiveSegment(-1),
+	  mNextGeneration(0),
+	  mCompactSegment(-1)
+{
+}
+
+LLTexturePackStore::~LLTexturePackStore()
+{
+	for (segment_map_t::iterator iter = mSegments.begin(); iter != mSegments.end(); ++iter)
+	{
+		Segment* seg = iter->second;
+		if (seg->mFile)
+		{
+			LLFile::close(seg->mFile);
+		}
+		delete seg;
+	}
+	mSegments.clear();
+}
+
+std::string LLTexturePackStore::getSegmentFileName(S32 segment) const
+{
+	return mDirName + gDirUtilp->getDirDelimiter() + llformat("%04d.pack", segment);
+}
+
+// Called with mMutex locked
+LLTexturePackStore::Segment* LLTexturePackStore::openSegment(S32 segment, bool create)
+{
+	segment_map_t::iterator iter = mSegments.find(segment);
+	if (iter != mSegments.end())
+	{
+		return iter->second;
+	}
+	std::string filename = getSegmentFileName(segment);
+	LLFILE* file = LLFile::fopen(filename, mReadOnly ? "rb" : "r+b");
+	if (!file && create && !mReadOnly)
+	{
+		file = LLFile::fopen(filename, "w+b");
+	}
+	if (!file)
+	{
+		return NULL;
+	}
+	Segment* seg = new Segment;
+	seg->mFile = file;
+	mSegments[segment] = seg;
+	return seg;
+}
+
+// Called with mMutex locked
+void LLTexturePackStore::closeSegment(S32 segment)
+{
+	segment_map_t::iterator iter = mSegments.find(segment);
+	if (iter == mSegments.end())
+	{
+		return;
+	}
+	Segment* seg = iter->second;
+	llassert_always(seg->mUsers == 0);
+	LLFile::close(seg->mFile);
+	delete seg;
+	mSegments.erase(iter);
+	if (!mReadOnly)
+	{
+		LLFile::remove(getSegmentFileName(segment));
+	}
+	if (segment == mActiveSegment)
+	{
+		mActiveSegment = -1;
+	}
+}
+
+bool LLTexturePackStore::init(const std::string& dirname, bool read_only)
+{
+	LLMutexLock lock(&mMutex);
+	mDirName = dirname;
+	mReadOnly = read_only;
+	if (!mReadOnly)
+	{
+		LLFile::mkdir(mDirName);
+	}
+
+	std::vector<S32> segment_files;
+	std::string filename;
+	LLDirIterator iter(mDirName, "*.pack");
+	while (iter.next(filename))
+	{
+		S32 segment = atoi(filename.c_str());
+		if (segment >= 0 && segment < TEXTURE_PACK_MAX_SEGMENTS)
+		{
+			segment_files.push_back(segment);
+		}
+	}
+
+	// Later generations hold the newer records
+	std::vector<std::pair<U32, S32> > segments;
+	for (std::vector<S32>::iterator it = segment_files.begin(); it != segment_files.end(); ++it)
+	{
+		Segment* seg = openSegment(*it, false);
+		if (!seg || !readSegmentHeader(seg))
+		{
+			llwarns << "Unable to read texture pack " << getSegmentFileName(*it) << llendl;
+			if (seg)
+			{
+				closeSegment(*it); // can't tell how old its records are, drop them
+			}
+			continue;
+		}
+		segments.push_back(std::make_pair(seg->mGeneration, *it));
+		mNextGeneration = llmax(mNextGeneration, seg->mGeneration + 1);
+	}
+	std::sort(segments.begin(), segments.end());
+
+	for (std::vector<std::pair<U32, S32> >::iterator it = segments.begin(); it != segments.end(); ++it)
+	{
+		S32 segment = it->second;
+		Segment* seg = mSegments[segment];
+		if (!scanSegment(segment, seg))
+		{
+			llwarns << "Unable to read texture pack " << getSegmentFileName(segment) << llendl;
+			continue;
+		}
+		if (seg->mSize < TEXTURE_PACK_SEGMENT_SIZE)
+		{
+			mActiveSegment = segment;
+		}
+	}
+
+	llinfos << "Texture packs: " << mSegments.size() << " segments, " << mExtents.size()
+			<< " bodies, " << getLiveBytes() << " of " << getTotalBytes() << " bytes live" << llendl;
+	return true;
+}
+
+// Called with mMutex locked during init(), no other access is possible yet.
+bool LLTexturePackStore::readSegmentHeader(Segment* seg)
+{
+	SegmentHeader header;
+	if (fseek(seg->mFile, 0, SEEK_SET) != 0
+		|| fread(&header, sizeof(SegmentHeader), 1, seg->mFile) != 1
+		|| header.mMagic != TEXTURE_PACK_SEGMENT_MAGIC)
+	{
+		return false;
+	}
+	seg->mGeneration = header.mGeneration;
+	seg->mSize = (S32)sizeof(SegmentHeader);
+	return true;
+}
+
+// Called with mMutex locked on a segment just created, no other access is possible yet.
+bool LLTexturePackStore::writeSegmentHeader(Segment* seg)
+{
+	SegmentHeader header;
+	header.mMagic = TEXTURE_PACK_SEGMENT_MAGIC;
+	header.mGeneration = seg->mGeneration;
+	if (fseek(seg->mFile, 0, SEEK_SET) != 0
+		|| fwrite(&header, sizeof(SegmentHeader), 1, seg->mFile) != 1
+		|| fflush(seg->mFile) != 0)
+	{
+		return false;
+	}
+	seg->mSize = (S32)sizeof(SegmentHeader);
+	return true;
+}
+
+// Called with mMutex locked during init(), no other access is possible yet.
+bool LLTexturePackStore::scanSegment(S32 segment, Segment* seg)
+{
+	if (fseek(seg->mFile, 0, SEEK_END) != 0)
+	{
+		return false;
+	}
+	S32 file_size = (S32)ftell(seg->mFile);
+	S32 offset = (S32)sizeof(SegmentHeader);
+	RecordHeader header;
+	while (offset + (S32)sizeof(RecordHeader) <= file_size)
+	{
+		if (fseek(seg->mFile, offset, SEEK_SET) != 0
+			|| fread(&header, sizeof(RecordHeader), 1, seg->mFile) != 1
+			|| header.mMagic != TEXTURE_PACK_RECORD_MAGIC
+			|| header.mSize <= 0
+			|| offset + record_size(header.mSize) > file_size)
+		{
+			break; // torn tail from a crash, it gets overwritten by the next append
+		}
+		setExtent(header.mID, Extent(segment, offset, header.mSize));
+		offset += record_size(header.mSize);
+	}
+	if (offset < file_size)
+	{
+		llwarns << "Ignoring " << (file_size - offset) << " trailing bytes in texture pack "
+				<< getSegmentFileName(segment) << llendl;
+	}
+	seg->mSize = offset;
+	return true;
+}
+
+void LLTexturePackStore::purge()
+{
+	LLMutexLock lock(&mMutex);
+	mExtents.clear();
+	mActiveSegment = -1;
+	mCompactSegment = -1;
+	mCompactList.clear();
+	segment_map_t::iterator iter = mSegments.begin();
+	while (iter != mSegments.end())
+	{
+		segment_map_t::iterator cur = iter++;
+		cur->second->mLiveBytes = 0;
+		if (cur->second->mUsers == 0)
+		{
+			closeSegment(cur->first);
+		}
+		// else compact() deletes it once the reads in progress are done
+	}
+}
+
+// Called with mMutex locked
+void LLTexturePackStore::setExtent(const LLUUID& id, const Extent& extent)
+{
+	eraseExtent(id);
+	mExtents[id] = extent;
+	segment_map_t::iterator iter = mSegments.find(extent.mSegment);
+	if (iter != mSegments.end())
+	{
+		iter->second->mLiveBytes += record_size(extent.mSize);
+	}
+}
+
+// Called with mMutex locked
+void LLTexturePackStore::eraseExtent(const LLUUID& id)
+{
+	extent_map_t::iterator iter = mExtents.find(id);
+	if (iter == mExtents.end())
+	{
+		return;
+	}
+	segment_map_t::iterator seg_iter = mSegments.find(iter->second.mSegment);
+	if (seg_iter != mSegments.end())
+	{
+		seg_iter->second->mLiveBytes -= record_size(iter->second.mSize);
+	}
+	mExtents.erase(iter);
+}
+
+void LLTexturePackStore::validate(const std::map<LLUUID, S32>& body_sizes)
+{
+	LLMutexLock lock(&mMutex);
+	S32 dropped = 0;
+	extent_map_t::iterator iter = mExtents.begin();
+	while (iter != mExtents.end())
+	{
+		extent_map_t::iterator cur = iter++;
+		std::map<LLUUID, S32>::const_iterator size_iter = body_sizes.find(cur->first);
+		if (size_iter == body_sizes.end() || size_iter->second != cur->second.mSize)
+		{
+			eraseExtent(cur->first);
+			++dropped;
+		}
+	}
+	if (dropped)
+	{
+		llinfos << "Dropped " << dropped << " stale texture pack records" << llendl;
+	}
+}
+
+S32 LLTexturePackStore::getSize(const LLUUID& id)
+{
+	LLMutexLock lock(&mMutex);
+	extent_map_t::iterator iter = mExtents.find(id);
+	return iter != mExtents.end() ? iter->second.mSize : 0;
+}
+
+S32 LLTexturePackStore::read(const LLUUID& id, U8* data, S32 offset, S32 size)
+{
+	Extent extent;
+	Segment* seg = NULL;
+	{
+		LLMutexLock lock(&mMutex);
+		extent_map_t::iterator iter = mExtents.find(id);
+		if (iter == mExtents.end())
+		{
+			return 0;
+		}
+		extent = iter->second;
+		segment_map_t::iterator seg_iter = mSegments.find(extent.mSegment);
+		if (seg_iter == mSegments.end())
+		{
+			return 0;
+		}
+		seg = seg_iter->second;
+		seg->mUsers++; // keeps compact() from deleting the file under us
+	}
+	
+	S32 bytes_read = 0;
+	if (offset >= 0 && offset < extent.mSize)
+	{
+		size = llmin(size, extent.mSize - offset);
+		LLMutexLock lock(&seg->mFileMutex);
+		if (fseek(seg->mFile, extent.mOffset + (S32)sizeof(RecordHeader) + offset, SEEK_SET) == 0)
+		{
+			bytes_read = (S32)fread(data, 1, size, seg->mFile);
+		}
+	}
+
+	release(seg);
+	return bytes_read;
+}
+
+// Called with mMutex unlocked
+void LLTexturePackStore::release(Segment* seg)
+{
+	LLMutexLock lock(&mMutex);
+	seg->mUsers--;
+}
+
+// Called with mMutex locked. Returns the segment with mUsers incremented.
+LLTexturePackStore::Segment* LLTexturePackStore::reserve(S32 rec_size, S32& segment, S32& offset)
+{
+	Segment* seg = NULL;
+	if (mActiveSegment >= 0)
+	{
+		seg = mSegments[mActiveSegment];
+		if (seg->mSize > (S32)sizeof(SegmentHeader) && seg->mSize + rec_size > TEXTURE_PACK_SEGMENT_SIZE)
+		{
+			seg = NULL;
+		}
+	}
+	if (!seg)
+	{
+		S32 next = mSegments.empty() ? 0 : mSegments.rbegin()->first + 1;
+		if (next >= TEXTURE_PACK_MAX_SEGMENTS)
+		{
+			// Reuse the lowest free number, the generation keeps the order
+			for (next = 0; mSegments.find(next) != mSegments.end(); ++next)
+			{
+			}
+		}
+		LLFile::remove(getSegmentFileName(next)); // leftover from a purge that failed
+		seg = openSegment(next, true);
+		if (!seg)
+		{
+			llwarns << "Unable to create texture pack " << getSegmentFileName(next) << llendl;
+			return NULL;
+		}
+		seg->mGeneration = mNextGeneration++;
+		if (!writeSegmentHeader(seg))
+		{
+			llwarns << "Unable to create texture pack " << getSegmentFileName(next) << llendl;
+			closeSegment(next);
+			return NULL;
+		}
+		mActiveSegment = next;
+	}
+	segment = mActiveSegment;
+	offset = seg->mSize;
+	seg->mSize += rec_size;
+	seg->mUsers++;
+	return seg;
+}
+
+S32 LLTexturePackStore::write(const LLUUID& id, const U8* data, S32 size)
+{
+	return writeRecord(id, data, size, NULL);
+}
+
+// If replaces is set the new record is only published if id still maps to that
+// extent (compaction must not override a newer write).
+S32 LLTexturePackStore::writeRecord(const LLUUID& id, const U8* data, S32 size, const Extent* replaces)
+{
+	if (mReadOnly || size <= 0)
+	{
+		return 0;
+	}
+
+	S32 segment;
+	S32 offset;
+	Segment* seg;
+	{
+		LLMutexLock lock(&mMutex);
+		seg = reserve(record_size(size), segment, offset);
+		if (!seg)
+		{
+			return 0;
+		}
+	}
+
+	RecordHeader header;
+	header.mMagic = TEXTURE_PACK_RECORD_MAGIC;
+	header.mID = id;
+	header.mSize = size;
+	bool success = false;
+	{
+		LLMutexLock lock(&seg->mFileMutex);
+		success = fseek(seg->mFile, offset, SEEK_SET) == 0
+			&& fwrite(&header, sizeof(RecordHeader), 1, seg->mFile) == 1
+			&& fwrite(data, 1, size, seg->mFile) == (size_t)size
+			&& fflush(seg->mFile) == 0;
+	}
+
+	LLMutexLock lock(&mMutex);
+	seg->mUsers--;
+	if (!success)
+	{
+		llwarns << "Failed to write texture pack " << getSegmentFileName(segment) << llendl;
+		// Leave the hole, the following records stay readable
+		return 0;
+	}
+	if (replaces)
+	{
+		extent_map_t::iterator iter = mExtents.find(id);
+		if (iter == mExtents.end() || !(iter->second == *replaces))
+		{
+			return 0; // rewritten or removed meanwhile, the copy is dead space
+		}
+	}
+	setExtent(id, Extent(segment, offset, size));
+	return size;
+}
+
+void LLTexturePackStore::remove(const LLUUID& id)
+{
+	LLMutexLock lock(&mMutex);
+	eraseExtent(id);
+}
+
+bool LLTexturePackStore::compact(S32 max_bytes)
+{
+	if (mReadOnly)
+	{
+		return false;
+	}
+	
+	Extent extent;
+	LLUUID id;
+	std::vector<U8> buffer;
+	S32 moved = 0;
+	while (moved < max_bytes)
+	{
+		Segment* seg = NULL;
+		{
+			LLMutexLock lock(&mMutex);
+			if (mCompactSegment < 0)
+			{
+				// Pick the segment with the least live data
+				F32 best_ratio = TEXTURE_PACK_COMPACT_RATIO;
+				for (segment_map_t::iterator iter = mSegments.begin(); iter != mSegments.end(); ++iter)
+				{
+					if (iter->first == mActiveSegment || iter->second->mSize <= (S32)sizeof(SegmentHeader))
+					{
+						continue;
+					}
+					F32 ratio = (F32)iter->second->mLiveBytes / (F32)iter->second->mSize;
+					if (ratio < best_ratio)
+					{
+						best_ratio = ratio;
+						mCompactSegment = iter->first;
+					}
+				}
+				if (mCompactSegment < 0)
+				{
+					return false;
+				}
+				mCompactList.clear();
+				for (extent_map_t::iterator iter = mExtents.begin(); iter != mExtents.end(); ++iter)
+				{
+					if (iter->second.mSegment == mCompactSegment)
+					{
+						mCompactList.push_back(iter->first);
+					}
+				}
+				LL_DEBUGS("TextureCache") << "Compacting texture pack " << mCompactSegment << ": "
+										  << mCompactList.size() << " live records" << LL_ENDL;
+			}
+
+			// Find the next record still living in the segment
+			extent = Extent();
+			while (!mCompactList.empty())
+			{
+				id = mCompactList.back();
+				mCompactList.pop_back();
+				extent_map_t::iterator iter = mExtents.find(id);
+				if (iter != mExtents.end() && iter->second.mSegment == mCompactSegment)
+				{
+					extent = iter->second;
+					break;
+				}
+			}
+			if (extent.mSegment < 0)
+			{
+				// Everything moved out
+				segment_map_t::iterator seg_iter = mSegments.find(mCompactSegment);
+				if (seg_iter != mSegments.end())
+				{
+					if (seg_iter->second->mUsers > 0)
+					{
+						return true; // a read is still using it, try again later
+					}
+					closeSegment(mCompactSegment);
+				}
+				mCompactSegment = -1;
+				continue;
+			}
+			seg = mSegments[extent.mSegment];
+			seg->mUsers++;
+		}
+
+		buffer.resize(extent.mSize);
+		bool success;
+		{
+			LLMutexLock lock(&seg->mFileMutex);
+			success = fseek(seg->mFile, extent.mOffset + (S32)sizeof(RecordHeader), SEEK_SET) == 0
+				&& fread(&buffer[0], 1, extent.mSize, seg->mFile) == (size_t)extent.mSize;
+		}
+		release(seg);
+		if (success)
+		{
+			writeRecord(id, &buffer[0], extent.mSize, &extent);
+		}
+		else
+		{
+			remove(id); // unreadable, the cache fetches it again
+		}
+		moved += record_size(extent.mSize);
+	}
+	return true;
+}
+
+S64 LLTexturePackStore::getLiveBytes()
+{
+	LLMutexLock lock(&mMutex);
+	S64 res = 0;
+	for (segment_map_t::iterator iter = mSegments.begin(); iter != mSegments.end(); ++iter)
+	{
+		res += iter->second->mLiveBytes;
+	}
+	return res;
+}
+
+S64 LLTexturePackStore::getTotalBytes()
+{
+	LLMutexLock lock(&mMutex);
+	S64 res = 0;
+	for (segment_map_t::iterator iter = mSegments.begin(); iter != mSegments.end(); ++iter)
+	{
+		res += iter->second->mSize;
+	}
+	return res;
+}
@@ -0,0 +1,128 @@
+/** 
+ * @file lltexturepackstore.h
+ * @brief Packs texture cache bodies into large segment files.
+ *
+ * $LicenseInfo:firstyear=2012&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2012, Linden Research, Inc.
+ * 
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ * 
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ * 
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLTEXTUREPACKSTORE_H
+#define LL_LLTEXTUREPACKSTORE_H
+
+#include "lluuid.h"
+#include "llthread.h"
+
+// Stores texture bodies as records appended to a few large segment files
+// (texturecache/packs/NNNN.pack) instead of one file per texture.
+// The extent of the current record of each texture is kept in memory and
+// rebuilt by scanning the record headers at startup, in the order the
+// segments were created (segment numbers are reused once they run out). Replaced and removed
+// records are left in place as dead space until compact() copies the live
+// records out of a mostly dead segment and deletes it.
+//
+// All methods are thread safe. Records of different textures can be read
+// and written concurrently; reads and writes of one texture must not race
+// (LLTextureCache sends all requests for a texture to the same thread).
+class LLTexturePackStore
+{
+public:
+	LLTexturePackStore();
+	~LLTexturePackStore();
+
+	// Opens or creates the segments in dirname and rebuilds the index.
+	bool init(const std::string& dirname, bool read_only);
+	// Drops all the records and deletes the segment files not in use.
+	void purge();
+
+	// Drops the records that do not match the body sizes known to the cache
+	// (stale copies, bodies of removed entries).
+	void validate(const std::map<LLUUID, S32>& body_sizes);
+
+	// Returns the body size, 0 if there is no record for id.
+	S32 getSize(const LLUUID& id);
+	// Returns the number of bytes read, 0 on failure.
+	S32 read(const LLUUID& id, U8* data, S32 offset, S32 size);
+	// Replaces the record of id. Returns the number of bytes written, 0 on failure.
+	S32 write(const LLUUID& id, const U8* data, S32 size);
+	void remove(const LLUUID& id);
+
+	// Moves up to max_bytes of live records out of the segment being compacted.
+	// Returns true while there is compaction work left.
+	bool compact(S32 max_bytes);
+
+	S64 getLiveBytes();
+	S64 getTotalBytes();
+
+private:
+	struct Extent
+	{
+		Extent() : mSegment(-1), mOffset(0), mSize(0) {}
+		Extent(S32 segment, S32 offset, S32 size) : mSegment(segment), mOffset(offset), mSize(size) {}
+		bool operator==(const Extent& rhs) const
+		{
+			return mSegment == rhs.mSegment && mOffset == rhs.mOffset && mSize == rhs.mSize;
+		}
+		S32 mSegment;
+		S32 mOffset; // of the record header
+		S32 mSize; // of the body
+	};
+
+	struct Segment
+	{
+		Segment() : mFile(NULL), mFileMutex(NULL), mGeneration(0), mSize(0), mLiveBytes(0), mUsers(0) {}
+		LLFILE* mFile;
+		LLMutex mFileMutex; // serializes seek + read/write on mFile
+		U32 mGeneration; // creation order, later segments hold the newer records
+		S32 mSize; // bytes appended or reserved, including the segment header
+		S32 mLiveBytes; // bytes of the records in the index
+		S32 mUsers; // reads and writes in progress, the file is kept until 0
+	};
+
+	std::string getSegmentFileName(S32 segment) const;
+	Segment* openSegment(S32 segment, bool create);
+	void closeSegment(S32 segment);
+	bool readSegmentHeader(Segment* seg);
+	bool writeSegmentHeader(Segment* seg);
+	bool scanSegment(S32 segment, Segment* seg);
+	Segment* reserve(S32 record_size, S32& segment, S32& offset);
+	void release(Segment* seg);
+	S32 writeRecord(const LLUUID& id, const U8* data, S32 size, const Extent* replaces);
+	void setExtent(const LLUUID& id, const Extent& extent);
+	void eraseExtent(const LLUUID& id);
+
+private:
+	LLMutex mMutex; // protects everything below, never held during file I/O
+	std::string mDirName;
+	bool mReadOnly;
+
+	typedef std::map<LLUUID, Extent> extent_map_t;
+	extent_map_t mExtents;
+
+	typedef std::map<S32, Segment*> segment_map_t;
+	segment_map_t mSegments;
+	S32 mActiveSegment; // segment being appended to
+	U32 mNextGeneration; // of the next segment created
+
+	S32 mCompactSegment; // segment being emptied, -1 if none
+	std::vector<LLUUID> mCompactList; // records left to move out of mCompactSegment
+};
+
+#endif // LL_LLTEXTUREPACKSTORE_H
@@ -275,6 +275,7 @@ LLViewerRegion::LLViewerRegion(const U64 &handle,
 	mProductName("unknown"),
 	mHttpUrl(""),
 	mCacheLoaded(FALSE),
+	mCacheLoading(FALSE),
 	mCacheDirty(FALSE),
 	mReleaseNotesRequested(FALSE),
 	mCapabilitiesReceived(false)
@@ -321,6 +322,13 @@ LLViewerRegion::LLViewerRegion(const U64 &handle,
 	mImpl->mObjectPartition.push_back(new LLBridgePartition());	//PARTITION_BRIDGE
 	mImpl->mObjectPartition.push_back(new LLHUDParticlePartition());//PARTITION_HUD_PARTICLE
 	mImpl->mObjectPartition.push_back(NULL);						//PARTITION_NONE
+
+	// Start reading the object cache off disk now, it is needed as soon as
+	// the region handshake arrives
+	if(LLVOCache::hasInstance())
+	{
+		LLVOCache::getInstance()->preloadRegion(mHandle);
+	}
 }
 
 
@@ -407,7 +415,23 @@ void LLViewerRegion::loadObjectCache()
 
 	if(LLVOCache::hasInstance())
 	{
-		LLVOCache::getInstance()->readFromCache(mHandle, mImpl->mCacheID, mImpl->mCacheMap) ;
+		// Read by the object cache thread, see updateObjectCacheLoad()
+		LLVOCache::getInstance()->preloadRegion(mHandle);
+		mCacheLoading = TRUE;
+		updateObjectCacheLoad();
+	}
+}
+
+void LLViewerRegion::updateObjectCacheLoad()
+{
+	if (mCacheLoading && 
+		LLVOCache::getInstance()->getPreloadedRegion(mHandle, mImpl->mCacheID, mImpl->mCacheMap))
+	{
+		mCacheLoading = FALSE;
+
+		// After loading cache, signal that simulator can start
+		// sending data.
+		sendRegionHandshakeReply();
 	}
 }
 
@@ -416,9 +440,19 @@ void LLViewerRegion::saveObjectCache()
 {
 	if (!mCacheLoaded)
 	{
+		if(LLVOCache::hasInstance())
+		{ //never handshaked, drop the preloaded cache
+			LLVOCache::getInstance()->discardPreloadedRegion(mHandle);
+		}
 		return;
 	}
 
+	if (mCacheLoading)
+	{
+		LLVOCache::getInstance()->discardPreloadedRegion(mHandle);
+		mCacheLoading = FALSE;
+	}
+
 	if (mImpl->mCacheMap.empty())
 	{
 		return;
@@ -426,7 +460,8 @@ void LLViewerRegion::saveObjectCache()
 
 	if(LLVOCache::hasInstance())
 	{
-		LLVOCache::getInstance()->writeToCache(mHandle, mImpl->mCacheID, mImpl->mCacheMap, mCacheDirty) ;
+		// Written and deleted by the object cache thread
+		LLVOCache::getInstance()->saveRegion(mHandle, mImpl->mCacheID, mImpl->mCacheMap, mCacheDirty) ;
 		mCacheDirty = FALSE;
 	}
 
@@ -1207,15 +1242,21 @@ LLDataPacker *LLViewerRegion::getDP(U32 local_id, U32 crc, U8 &cache_miss_type)
 	if (entry)
 	{
 		// we've seen this object before
+		LLDataPackerBinaryBuffer* dp = NULL;
 		if (entry->getCRC() == crc)
 		{
 			// Record a hit
 			entry->recordHit();
+			dp = entry->getDP(crc);
+		}
+
+		if (dp)
+		{
 		cache_miss_type = CACHE_MISS_TYPE_NONE;
-			return entry->getDP(crc);
+			return dp;
 		}
 		else
-		{
+		{ // CRC changed, or the cached data failed validation
 			// llinfos << "CRC miss for " << local_id << llendl;
 		cache_miss_type = CACHE_MISS_TYPE_CRC;
 			mCacheMissCRC.put(local_id);
@@ -1466,10 +1507,19 @@ void LLViewerRegion::unpackRegionHandshake()
 	// off disk.
 	loadObjectCache();
 
-	// After loading cache, signal that simulator can start
-	// sending data.
+	// The reply waits for the cache to be read, since the simulator
+	// starts sending objects as soon as it gets it.
+	if (!mCacheLoading)
+	{
+		sendRegionHandshakeReply();
+	}
+}
+
+void LLViewerRegion::sendRegionHandshakeReply()
+{
 	// TODO: Send all upstream viewer->sim handshake info here.
-	LLHost host = msg->getSender();
+	LLMessageSystem* msg = gMessageSystem;
+	const LLHost& host = getHost();
 	msg->newMessage("RegionHandshakeReply");
 	msg->nextBlock("AgentData");
 	msg->addUUID("AgentID", gAgent.getID());
@@ -100,6 +100,8 @@ public:
 	// Call this after you have the region name and handle.
 	void loadObjectCache();
 	void saveObjectCache();
+	// Polls the object cache read started by loadObjectCache()
+	void updateObjectCacheLoad();
 
 	void sendMessage(); // Send the current message to this region's simulator
 	void sendReliableMessage(); // Send the current message to this region's simulator
@@ -333,6 +335,7 @@ protected:
 	void disconnectAllNeighbors();
 	void initStats();
 	void setFlags(BOOL b, U32 flags);
+	void sendRegionHandshakeReply();
 
 public:
 	LLWind  mWind;
@@ -397,6 +400,7 @@ private:
 	// Regions can have order 10,000 objects, so assume
 	// a structure of size 2^14 = 16,000
 	BOOL									mCacheLoaded;
+	BOOL									mCacheLoading; // handshake reply waits for the read
 	BOOL                                    mCacheDirty;
 
 	LLDynamicArray<U32>						mCacheMissFull;
@@ -26,6 +26,7 @@
 
 #include "llviewerprecompiledheaders.h"
 #include "llvocache.h"
+#include "llcrc.h"
 #include "llerror.h"
 #include "llregionhandle.h"
 #include "llviewercontrol.h"
@@ -40,6 +41,22 @@ BOOL check_write(LLAPRFile* apr_file, void* src, S32 n_bytes)
 	return apr_file->write(src, n_bytes) == n_bytes ;
 }
 
+static U32 get_data_crc(const U8* data, S32 size)
+{
+	LLCRC crc;
+	crc.update(data, size);
+	return crc.getCRC();
+}
+
+static void delete_entries(LLVOCacheEntry::vocache_entry_map_t& cache_entry_map)
+{
+	for(LLVOCacheEntry::vocache_entry_map_t::iterator iter = cache_entry_map.begin(); iter != cache_entry_map.end(); ++iter)
+	{
+		delete iter->second;
+	}
+	cache_entry_map.clear();
+}
+
 
 //---------------------------------------------------------------------------
 // LLVOCacheEntry
@@ -51,7 +68,10 @@ LLVOCacheEntry::LLVOCacheEntry(U32 local_id, U32 crc, LLDataPackerBinaryBuffer &
 	mCRC(crc),
 	mHitCount(0),
 	mDupeCount(0),
-	mCRCChangeCount(0)
+	mCRCChangeCount(0),
+	mFileOffset(0),
+	mDataCRC(0),
+	mDataValidated(TRUE)
 {
 	mBuffer = new U8[dp.getBufferSize()];
 	mDP.assignBuffer(mBuffer, dp.getBufferSize());
@@ -65,82 +85,64 @@ LLVOCacheEntry::LLVOCacheEntry()
 	mHitCount(0),
 	mDupeCount(0),
 	mCRCChangeCount(0),
-	mBuffer(NULL)
+	mBuffer(NULL),
+	mFileOffset(0),
+	mDataCRC(0),
+	mDataValidated(TRUE)
 {
 	mDP.assignBuffer(mBuffer, 0);
 }
 
-LLVOCacheEntry::LLVOCacheEntry(LLAPRFile* apr_file)
-	: mBuffer(NULL)
+LLVOCacheEntry::LLVOCacheEntry(const FileRecord& record, LLVOCacheFile* file)
+	:
+	mLocalID(record.mLocalID),
+	mCRC(record.mCRC),
+	mHitCount(record.mHitCount),
+	mDupeCount(record.mDupeCount),
+	mCRCChangeCount(record.mCRCChangeCount),
+	mBuffer(NULL),
+	mFile(file),
+	mFileOffset(record.mOffset),
+	mDataCRC(record.mDataCRC),
+	mDataValidated(FALSE)
 {
-	S32 size = -1;
-	BOOL success;
+	//the mapping is read-only, the data is only ever unpacked
+	mDP.assignBuffer(const_cast<U8*>(file->getData()) + record.mOffset, record.mSize);
+}
 
-	mDP.assignBuffer(mBuffer, 0);
-	success = check_read(apr_file, &mLocalID, sizeof(U32));
-	if(success)
-	{
-		success = check_read(apr_file, &mCRC, sizeof(U32));
-	}
-	if(success)
-	{
-		success = check_read(apr_file, &mHitCount, sizeof(S32));
-	}
-	if(success)
+LLVOCacheEntry::~LLVOCacheEntry()
+{
+	if (mFile.notNull())
 	{
-		success = check_read(apr_file, &mDupeCount, sizeof(S32));
+		mDP.releaseBuffer();
 	}
-	if(success)
+	else
 	{
-		success = check_read(apr_file, &mCRCChangeCount, sizeof(S32));
+		mDP.freeBuffer();
 	}
-	if(success)
-	{
-		success = check_read(apr_file, &size, sizeof(S32));
+}
 
-		// Corruption in the cache entries
-		if ((size > 10000) || (size < 1))
-		{
-			// We've got a bogus size, skip reading it.
-			// We won't bother seeking, because the rest of this file
-			// is likely bogus, and will be tossed anyway.
-			llwarns << "Bogus cache entry, size " << size << ", aborting!" << llendl;
-			success = FALSE;
-		}
-	}
-	if(success && size > 0)
+void LLVOCacheEntry::detachFile()
+{
+	if (mFile.isNull())
 	{
-		mBuffer = new U8[size];
-		success = check_read(apr_file, mBuffer, size);
-
-		if(success)
-		{
-			mDP.assignBuffer(mBuffer, size);
-		}
-		else
-		{
-			delete[] mBuffer ;
-			mBuffer = NULL ;
-		}
+		return;
 	}
 
-	if(!success)
-	{
-		mLocalID = 0;
-		mCRC = 0;
-		mHitCount = 0;
-		mDupeCount = 0;
-		mCRCChangeCount = 0;
-		mBuffer = NULL;
-	}
+	S32 size = mDP.getBufferSize();
+	mBuffer = new U8[size];
+	memcpy(mBuffer, mDP.getBuffer(), size);
+	mDP.releaseBuffer();
+	mDP.assignBuffer(mBuffer, size);
+	mFile = NULL;
 }
 
-LLVOCacheEntry::~LLVOCacheEntry()
+void LLVOCacheEntry::setFileOffset(U32 offset, U32 data_crc)
 {
-	mDP.freeBuffer();
+	mFileOffset = offset;
+	mDataCRC = data_crc;
 }
 
-
 // New CRC means the object has changed.
 void LLVOCacheEntry::assignCRC(U32 crc, LLDataPackerBinaryBuffer &dp)
 {
@@ -151,10 +153,20 @@ void LLVOCacheEntry::assignCRC(U32 crc, LLDataPackerBinaryBuffer &dp)
 		mHitCount = 0;
 		mCRCChangeCount++;
 
-		mDP.freeBuffer();
+		if (mFile.notNull())
+		{
+			mDP.releaseBuffer();
+			mFile = NULL;
+		}
+		else
+		{
+			mDP.freeBuffer();
+		}
 		mBuffer = new U8[dp.getBufferSize()];
 		mDP.assignBuffer(mBuffer, dp.getBufferSize());
 		mDP = dp;
+		mFileOffset = 0;
+		mDataValidated = TRUE;
 	}
 }
 
@@ -166,6 +178,22 @@ LLDataPackerBinaryBuffer *LLVOCacheEntry::getDP(U32 crc)
 		//llinfos << "Not getting cache entry, invalid!" << llendl;
 		return NULL;
 	}
+
+	if (!mDataValidated)
+	{ //first hit on data read from the cache file, check it against the CRC table
+		if (get_data_crc(mDP.getBuffer(), mDP.getBufferSize()) != mDataCRC)
+		{
+			llwarns << "Corrupt cache entry for local id " << mLocalID << ", discarding" << llendl;
+			//forget the object, so that its next full update replaces the entry
+			mCRC = 0;
+			mDP.releaseBuffer();
+			mFile = NULL;
+			mFileOffset = 0;
+			mDataValidated = TRUE;
+			return NULL;
+		}
+		mDataValidated = TRUE;
+	}
 	mHitCount++;
 	return &mDP;
 }
@@ -187,38 +215,16 @@ void LLVOCacheEntry::dump() const
 		<< llendl;
 }
 
-BOOL LLVOCacheEntry::writeToFile(LLAPRFile* apr_file) const
+void LLVOCacheEntry::getFileRecord(FileRecord& record) const
 {
-	BOOL success;
-	success = check_write(apr_file, (void*)&mLocalID, sizeof(U32));
-	if(success)
-	{
-		success = check_write(apr_file, (void*)&mCRC, sizeof(U32));
-	}
-	if(success)
-	{
-		success = check_write(apr_file, (void*)&mHitCount, sizeof(S32));
-	}
-	if(success)
-	{
-		success = check_write(apr_file, (void*)&mDupeCount, sizeof(S32));
-	}
-	if(success)
-	{
-		success = check_write(apr_file, (void*)&mCRCChangeCount, sizeof(S32));
-	}
-	if(success)
-	{
-		S32 size = mDP.getBufferSize();
-		success = check_write(apr_file, (void*)&size, sizeof(S32));
-	
-		if(success)
-		{
-			success = check_write(apr_file, (void*)mBuffer, size);
-		}
-	}
-
-	return success ;
+	record.mLocalID = mLocalID;
+	record.mCRC = mCRC;
+	record.mHitCount = mHitCount;
+	record.mDupeCount = mDupeCount;
+	record.mCRCChangeCount = mCRCChangeCount;
+	record.mOffset = mFileOffset;
+	record.mSize = mDP.getBufferSize();
+	record.mDataCRC = mDataCRC;
 }
 
 //-------------------------------------------------------------------
@@ -233,6 +239,38 @@ const U32 INVALID_TIME = 0 ;
 const char* object_cache_dirname = "objectcache";
 const char* header_filename = "object.cache";
 
+// Region cache file layout, in host byte order:
+//   RegionFileHeader
+//   packed object data, appended as the region is written
+//   FileRecord index sorted by local ID, at mIndexOffset
+// A write appends the data of the new and changed objects after the current
+// index and a new index after them, then commits both by rewriting the
+// header, so that an interrupted write leaves the previous state readable.
+// Data and indices left unused by appends are reclaimed by a full rewrite.
+static const char REGION_FILE_MAGIC[4] = { 'S', 'L', 'V', 'C' };
+static const U32 REGION_FILE_VERSION = 2;
+const S32 MAX_OBJECT_DATA_SIZE = 10000;
+
+struct RegionFileHeader
+{
+	char mMagic[4];
+	U32 mVersion;
+	U8 mCacheID[UUID_BYTES];
+	U32 mNumEntries;
+	U32 mIndexOffset;
+	U32 mIndexCRC;
+};
+
+// Runs the requests of the asynchronous interface, see the end of this file
+class LLVOCache::IOThread : public LLQueuedThread
+{
+public:
+	IOThread() : LLQueuedThread("Object Cache") {}
+
+	handle_t getNewHandle() { return generateHandle(); }
+	void queueRequest(QueuedRequest* req) { addRequest(req); }
+};
+
 LLVOCache* LLVOCache::sInstance = NULL;
 
 //static 
@@ -265,7 +303,9 @@ LLVOCache::LLVOCache():
 	mInitialized(FALSE),
 	mReadOnly(TRUE),
 	mNumEntries(0),
-	mCacheSize(1)
+	mCacheSize(1),
+	mThread(NULL),
+	mPreloadMutex(NULL)
 {
 	mEnabled = gSavedSettings.getBOOL("ObjectCacheEnabled");
 	mLocalAPRFilePoolp = new LLVolatileAPRPool() ;
@@ -273,6 +313,24 @@ LLVOCache::LLVOCache():
 
 LLVOCache::~LLVOCache()
 {
+	if(mThread)
+	{
+		//let the regions saved last reach the disk
+		while(mPendingRequests > 0)
+		{
+			ms_sleep(1);
+		}
+		mThread->shutdown();
+		delete mThread;
+		mThread = NULL;
+	}
+
+	for(preload_map_t::iterator iter = mPreloads.begin(); iter != mPreloads.end(); ++iter)
+	{
+		delete_entries(iter->second.mEntries);
+	}
+	mPreloads.clear();
+
 	if(mEnabled)
 	{
 		writeCacheHeader();
@@ -323,6 +381,11 @@ void LLVOCache::initCache(ELLPath location, U32 size, U32 cache_version)
 			removeCache();
 		}
 	}	
+
+	if(!mThread)
+	{
+		mThread = new IOThread();
+	}
 }
 	
 void LLVOCache::removeCache(ELLPath location) 
@@ -583,7 +646,7 @@ BOOL LLVOCache::updateEntry(const HeaderEntryInfo* entry)
 	return check_write(&apr_file, (void*)entry, sizeof(HeaderEntryInfo)) ;
 }
 
-void LLVOCache::readFromCache(U64 handle, const LLUUID& id, LLVOCacheEntry::vocache_entry_map_t& cache_entry_map) 
+void LLVOCache::readFromCache(U64 handle, LLUUID& id, LLVOCacheEntry::vocache_entry_map_t& cache_entry_map) 
 {
 	if(!mEnabled)
 	{
@@ -599,47 +662,64 @@ void LLVOCache::readFromCache(U64 handle, const LLUUID& id, LLVOCacheEntry::voca
 		return ;
 	}
 
-	bool success = true ;
+	std::string filename;
+	getObjectCacheFilename(handle, filename);
+
+	//entries view their data in the mapping, which lives as long as they do
+	LLPointer<LLVOCacheFile> file = new LLVOCacheFile();
+	bool success = file->open(filename) && file->getSize() >= sizeof(RegionFileHeader);
+
+	RegionFileHeader header;
+	if(success)
 	{
-		std::string filename;
-		getObjectCacheFilename(handle, filename);
-		LLAPRFile apr_file(filename, APR_READ|APR_BINARY, mLocalAPRFilePoolp);
-	
-		LLUUID cache_id ;
-		success = check_read(&apr_file, cache_id.mData, UUID_BYTES) ;
-	
-		if(success)
-		{		
-			if(cache_id != id)
+		memcpy(&header, file->getData(), sizeof(RegionFileHeader));
+		if(memcmp(header.mMagic, REGION_FILE_MAGIC, sizeof(REGION_FILE_MAGIC)) || header.mVersion != REGION_FILE_VERSION)
+		{
+			llinfos << "Unknown cache file format for this region, discarding" << llendl;
+			success = false ;
+		}
+		else
+		{ //checked against the region by getPreloadedRegion()
+			memcpy(id.mData, header.mCacheID, UUID_BYTES);
+		}
+	}
+
+	if(success)
+	{
+		const size_t index_size = (size_t)header.mNumEntries * sizeof(LLVOCacheEntry::FileRecord);
+		if(header.mIndexOffset < sizeof(RegionFileHeader) || header.mIndexOffset + index_size > file->getSize() 
+			|| get_data_crc(file->getData() + header.mIndexOffset, index_size) != header.mIndexCRC)
+		{
+			llwarns << "Aborting cache file load for " << filename << ", corrupt index!" << llendl;
+			success = false ;
+		}
+	}
+
+	if(success)
+	{
+		const U8* index = file->getData() + header.mIndexOffset;
+		for (U32 i = 0; success && i < header.mNumEntries; i++)
+		{
+			LLVOCacheEntry::FileRecord record;
+			memcpy(&record, index + i * sizeof(record), sizeof(record));
+			if (!record.mLocalID || record.mSize < 1 || record.mSize > MAX_OBJECT_DATA_SIZE
+				|| record.mOffset < sizeof(RegionFileHeader) || record.mOffset + record.mSize > header.mIndexOffset)
 			{
-				llinfos << "Cache ID doesn't match for this region, discarding"<< llendl;
+				llwarns << "Aborting cache file load for " << filename << ", cache file corruption!" << llendl;
 				success = false ;
 			}
-
-			if(success)
+			else
 			{
-				S32 num_entries;
-				success = check_read(&apr_file, &num_entries, sizeof(S32)) ;
-	
-				for (S32 i = 0; success && i < num_entries; i++)
-				{
-					LLVOCacheEntry* entry = new LLVOCacheEntry(&apr_file);
-					if (!entry->getLocalID())
-					{
-						llwarns << "Aborting cache file load for " << filename << ", cache file corruption!" << llendl;
-						delete entry ;
-						success = false ;
-					}
-					cache_entry_map[entry->getLocalID()] = entry;
-				}
+				cache_entry_map[record.mLocalID] = new LLVOCacheEntry(record, file);
 			}
-		}		
+		}
 	}
 	
 	if(!success)
 	{
 		if(cache_entry_map.empty())
 		{
+			file = NULL ; //unmap it first, a mapped file can't be deleted on Windows
 			removeEntry(iter->second) ;
 		}
 	}
@@ -718,33 +798,340 @@ void LLVOCache::writeToCache(U64 handle, const LLUUID& id, const LLVOCacheEntry:
 	}
 
 	//write to cache file
-	bool success = true ;
+	std::string filename;
+	getObjectCacheFilename(handle, filename);
+	bool success = writeRegionFile(filename, id, cache_entry_map) ;
+
+	if(!success)
 	{
-		std::string filename;
-		getObjectCacheFilename(handle, filename);
-		LLAPRFile apr_file(filename, APR_CREATE|APR_WRITE|APR_BINARY, mLocalAPRFilePoolp);
-	
-		success = check_write(&apr_file, (void*)id.mData, UUID_BYTES) ;
+		removeEntry(entry) ;
 
-	
-		if(success)
+	}
+
+	return ;
+}
+
+BOOL LLVOCache::writeRegionFile(const std::string& filename, const LLUUID& id, const LLVOCacheEntry::vocache_entry_map_t& cache_entry_map)
+{
+	RegionFileHeader header;
+	S32 file_size = LLAPRFile::size(filename, mLocalAPRFilePoolp);
+	if(file_size < (S32)sizeof(RegionFileHeader)
+		|| LLAPRFile::readEx(filename, &header, 0, sizeof(RegionFileHeader), mLocalAPRFilePoolp) != (S32)sizeof(RegionFileHeader)
+		|| memcmp(header.mMagic, REGION_FILE_MAGIC, sizeof(REGION_FILE_MAGIC)) || header.mVersion != REGION_FILE_VERSION
+		|| memcmp(header.mCacheID, id.mData, UUID_BYTES)
+		|| header.mIndexOffset < sizeof(RegionFileHeader)
+		|| header.mIndexOffset + header.mNumEntries * sizeof(LLVOCacheEntry::FileRecord) > (U32)file_size)
+	{ //nothing to append to
+		return rewriteRegionFile(filename, id, cache_entry_map);
+	}
+
+	//data of the unchanged entries stays where it is, the rest goes after the current index
+	U32 data_end = header.mIndexOffset + header.mNumEntries * sizeof(LLVOCacheEntry::FileRecord);
+	U32 live_bytes = 0;
+	U32 new_bytes = 0;
+	U32 num_entries = 0;
+	for(LLVOCacheEntry::vocache_entry_map_t::const_iterator iter = cache_entry_map.begin(); iter != cache_entry_map.end(); ++iter)
+	{
+		LLVOCacheEntry* entry = iter->second;
+		S32 size = entry->getDataSize();
+		if(size <= 0)
 		{
-			S32 num_entries = cache_entry_map.size() ;
-			success = check_write(&apr_file, &num_entries, sizeof(S32));
-	
-			for (LLVOCacheEntry::vocache_entry_map_t::const_iterator iter = cache_entry_map.begin(); success && iter != cache_entry_map.end(); ++iter)
-			{
-				success = iter->second->writeToFile(&apr_file) ;
-			}
+			continue;
+		}
+		++num_entries;
+		live_bytes += size;
+		if(!entry->getFileOffset() || entry->getFileOffset() + size > header.mIndexOffset)
+		{
+			new_bytes += size;
 		}
 	}
 
-	if(!success)
+	U32 index_size = num_entries * sizeof(LLVOCacheEntry::FileRecord);
+	if(data_end + new_bytes - sizeof(RegionFileHeader) > 2 * live_bytes)
+	{ //more dead data than live data, compact
+		return rewriteRegionFile(filename, id, cache_entry_map);
+	}
+
+	std::vector<U8> buffer(new_bytes + index_size);
+	U32 offset = data_end;
+	U8* data = buffer.empty() ? NULL : &buffer[0];
+	U8* index = data + new_bytes;
+	for(LLVOCacheEntry::vocache_entry_map_t::const_iterator iter = cache_entry_map.begin(); iter != cache_entry_map.end(); ++iter)
 	{
-		removeEntry(entry) ;
+		LLVOCacheEntry* entry = iter->second;
+		S32 size = entry->getDataSize();
+		if(size <= 0)
+		{
+			continue;
+		}
+		if(!entry->getFileOffset() || entry->getFileOffset() + size > header.mIndexOffset)
+		{
+			memcpy(data, entry->getData(), size);
+			entry->setFileOffset(offset, get_data_crc(data, size));
+			data += size;
+			offset += size;
+		}
 
+		LLVOCacheEntry::FileRecord record;
+		entry->getFileRecord(record);
+		memcpy(index, &record, sizeof(record));
+		index += sizeof(record);
 	}
 
-	return ;
+	if(!buffer.empty() && 
+		LLAPRFile::writeEx(filename, &buffer[0], data_end, buffer.size(), mLocalAPRFilePoolp) != (S32)buffer.size())
+	{
+		return FALSE;
+	}
+
+	//commit
+	header.mNumEntries = num_entries;
+	header.mIndexOffset = data_end + new_bytes;
+	header.mIndexCRC = get_data_crc(buffer.empty() ? NULL : &buffer[0] + new_bytes, index_size);
+	return LLAPRFile::writeEx(filename, &header, 0, sizeof(RegionFileHeader), mLocalAPRFilePoolp) == (S32)sizeof(RegionFileHeader);
+}
+
+BOOL LLVOCache::rewriteRegionFile(const std::string& filename, const LLUUID& id, const LLVOCacheEntry::vocache_entry_map_t& cache_entry_map)
+{
+	U32 data_size = 0;
+	U32 num_entries = 0;
+	for(LLVOCacheEntry::vocache_entry_map_t::const_iterator iter = cache_entry_map.begin(); iter != cache_entry_map.end(); ++iter)
+	{
+		S32 size = iter->second->getDataSize();
+		if(size > 0)
+		{
+			data_size += size;
+			++num_entries;
+		}
+	}
+
+	U32 index_size = num_entries * sizeof(LLVOCacheEntry::FileRecord);
+	std::vector<U8> buffer(sizeof(RegionFileHeader) + data_size + index_size);
+	U32 offset = sizeof(RegionFileHeader);
+	U8* index = &buffer[0] + offset + data_size;
+	for(LLVOCacheEntry::vocache_entry_map_t::const_iterator iter = cache_entry_map.begin(); iter != cache_entry_map.end(); ++iter)
+	{
+		LLVOCacheEntry* entry = iter->second;
+		S32 size = entry->getDataSize();
+		if(size <= 0)
+		{
+			continue;
+		}
+		memcpy(&buffer[offset], entry->getData(), size);
+		//the file is about to be replaced, it can not be viewed anymore
+		entry->detachFile();
+		entry->setFileOffset(offset, get_data_crc(&buffer[offset], size));
+		offset += size;
+
+		LLVOCacheEntry::FileRecord record;
+		entry->getFileRecord(record);
+		memcpy(index, &record, sizeof(record));
+		index += sizeof(record);
+	}
+
+	RegionFileHeader header;
+	memcpy(header.mMagic, REGION_FILE_MAGIC, sizeof(REGION_FILE_MAGIC));
+	header.mVersion = REGION_FILE_VERSION;
+	memcpy(header.mCacheID, id.mData, UUID_BYTES);
+	header.mNumEntries = num_entries;
+	header.mIndexOffset = sizeof(RegionFileHeader) + data_size;
+	header.mIndexCRC = get_data_crc(&buffer[0] + header.mIndexOffset, index_size);
+	memcpy(&buffer[0], &header, sizeof(RegionFileHeader));
+
+	//write a temporary file and swap it in, so that a crash leaves a readable file
+	std::string tmp_filename = filename + ".tmp";
+	LLAPRFile::remove(tmp_filename, mLocalAPRFilePoolp);
+	if(LLAPRFile::writeEx(tmp_filename, &buffer[0], 0, buffer.size(), mLocalAPRFilePoolp) != (S32)buffer.size())
+	{
+		LLAPRFile::remove(tmp_filename, mLocalAPRFilePoolp);
+		return FALSE;
+	}
+	LLAPRFile::remove(filename, mLocalAPRFilePoolp);
+	return LLAPRFile::rename(tmp_filename, filename, mLocalAPRFilePoolp);
+}
+
+//-------------------------------------------------------------------
+// Object cache thread requests
+//-------------------------------------------------------------------
+// All requests have the same priority, so that the thread runs them in
+// the order they were made.
+
+class LLVOCache::ReadRequest : public LLQueuedThread::QueuedRequest
+{
+public:
+	ReadRequest(handle_t handle, U64 region_handle)
+		: LLQueuedThread::QueuedRequest(handle, LLQueuedThread::PRIORITY_NORMAL, LLQueuedThread::FLAG_AUTO_COMPLETE),
+		  mRegionHandle(region_handle)
+	{
+	}
+
+	/*virtual*/ bool processRequest()
+	{
+		LLUUID id;
+		LLVOCacheEntry::vocache_entry_map_t cache_entry_map;
+		LLVOCache* cache = LLVOCache::getInstance();
+		cache->readFromCache(mRegionHandle, id, cache_entry_map);
+		cache->readCompleted(mRegionHandle, id, cache_entry_map);
+		cache->mPendingRequests--;
+		return true;
+	}
+
+private:
+	U64 mRegionHandle;
+};
+
+class LLVOCache::WriteRequest : public LLQueuedThread::QueuedRequest
+{
+public:
+	WriteRequest(handle_t handle, U64 region_handle, const LLUUID& id, LLVOCacheEntry::vocache_entry_map_t& cache_entry_map, BOOL dirty_cache)
+		: LLQueuedThread::QueuedRequest(handle, LLQueuedThread::PRIORITY_NORMAL, LLQueuedThread::FLAG_AUTO_COMPLETE),
+		  mRegionHandle(region_handle),
+		  mCacheID(id),
+		  mDirtyCache(dirty_cache)
+	{
+		mEntries.swap(cache_entry_map);
+	}
+
+	/*virtual*/ bool processRequest()
+	{
+		LLVOCache* cache = LLVOCache::getInstance();
+		cache->writeToCache(mRegionHandle, mCacheID, mEntries, mDirtyCache);
+		delete_entries(mEntries);
+		cache->mPendingRequests--;
+		return true;
+	}
+
+private:
+	U64 mRegionHandle;
+	LLUUID mCacheID;
+	LLVOCacheEntry::vocache_entry_map_t mEntries;
+	BOOL mDirtyCache;
+};
+
+class LLVOCache::RemoveRequest : public LLQueuedThread::QueuedRequest
+{
+public:
+	RemoveRequest(handle_t handle, U64 region_handle)
+		: LLQueuedThread::QueuedRequest(handle, LLQueuedThread::PRIORITY_NORMAL, LLQueuedThread::FLAG_AUTO_COMPLETE),
+		  mRegionHandle(region_handle)
+	{
+	}
+
+	/*virtual*/ bool processRequest()
+	{
+		LLVOCache* cache = LLVOCache::getInstance();
+		cache->removeEntry(mRegionHandle);
+		cache->mPendingRequests--;
+		return true;
+	}
+
+private:
+	U64 mRegionHandle;
+};
+
+void LLVOCache::addRequest(LLQueuedThread::QueuedRequest* req)
+{
+	mPendingRequests++;
+	mThread->queueRequest(req);
+}
+
+void LLVOCache::readCompleted(U64 handle, const LLUUID& id, LLVOCacheEntry::vocache_entry_map_t& cache_entry_map)
+{
+	LLMutexLock lock(&mPreloadMutex);
+	preload_map_t::iterator iter = mPreloads.find(handle);
+	if(iter == mPreloads.end() || iter->second.mDone)
+	{ //discarded while it was read
+		delete_entries(cache_entry_map);
+		return;
+	}
+
+	iter->second.mDone = TRUE;
+	iter->second.mCacheID = id;
+	iter->second.mEntries.swap(cache_entry_map);
+}
+
+void LLVOCache::preloadRegion(U64 handle)
+{
+	if(!mThread)
+	{
+		return;
+	}
+
+	{
+		LLMutexLock lock(&mPreloadMutex);
+		if(mPreloads.find(handle) != mPreloads.end())
+		{
+			return;
+		}
+		mPreloads[handle] = PreloadInfo();
+	}
+	addRequest(new ReadRequest(mThread->getNewHandle(), handle));
+}
+
+BOOL LLVOCache::getPreloadedRegion(U64 handle, const LLUUID& id, LLVOCacheEntry::vocache_entry_map_t& cache_entry_map)
+{
+	LLVOCacheEntry::vocache_entry_map_t discarded;
+	{
+		LLMutexLock lock(&mPreloadMutex);
+		preload_map_t::iterator iter = mPreloads.find(handle);
+		if(iter == mPreloads.end())
+		{ //nothing to wait for
+			return TRUE;
+		}
+		if(!iter->second.mDone)
+		{
+			return FALSE;
+		}
+
+		if(iter->second.mCacheID == id)
+		{
+			cache_entry_map.swap(iter->second.mEntries);
+		}
+		else
+		{
+			discarded.swap(iter->second.mEntries);
+		}
+		mPreloads.erase(iter);
+	}
+
+	if(!discarded.empty())
+	{ //the next save of the region replaces the file
+		llinfos << "Cache ID doesn't match for this region, discarding"<< llendl;
+		delete_entries(discarded);
+	}
+	return TRUE;
 }
 
+void LLVOCache::discardPreloadedRegion(U64 handle)
+{
+	LLVOCacheEntry::vocache_entry_map_t discarded;
+	{
+		LLMutexLock lock(&mPreloadMutex);
+		preload_map_t::iterator iter = mPreloads.find(handle);
+		if(iter == mPreloads.end())
+		{
+			return;
+		}
+		discarded.swap(iter->second.mEntries);
+		mPreloads.erase(iter);
+	}
+	delete_entries(discarded);
+}
+
+void LLVOCache::saveRegion(U64 handle, const LLUUID& id, LLVOCacheEntry::vocache_entry_map_t& cache_entry_map, BOOL dirty_cache)
+{
+	if(!mThread)
+	{
+		delete_entries(cache_entry_map);
+		return;
+	}
+	addRequest(new WriteRequest(mThread->getNewHandle(), handle, id, cache_entry_map, dirty_cache));
+}
+
+void LLVOCache::removeRegion(U64 handle)
+{
+	if(mThread)
+	{
+		addRequest(new RemoveRequest(mThread->getNewHandle(), handle));
+	}
+}
@@ -31,6 +31,24 @@
 #include "lldatapacker.h"
 #include "lldlinked.h"
 #include "lldir.h"
+#include "llfile.h"
+#include "llpointer.h"
+#include "llqueuedthread.h"
+#include "llrefcount.h"
+
+//---------------------------------------------------------------------------
+// Read-only mapping of a region cache file, shared by the cache entries
+// viewing their data in it.
+class LLVOCacheFile : public LLRefCount
+{
+public:
+	bool open(const std::string& filename)	{ return mFile.open(filename, 0, true); }
+	const U8* getData() const				{ return mFile.getData(); }
+	size_t getSize() const					{ return mFile.getSize(); }
+
+private:
+	LLMappedFile mFile;
+};
 
 
 //---------------------------------------------------------------------------
@@ -40,8 +58,22 @@ class LLVOCacheEntry;
 class LLVOCacheEntry
 {
 public:
+	// Index record of an entry in a region cache file
+	struct FileRecord
+	{
+		U32 mLocalID;
+		U32 mCRC;
+		S32 mHitCount;
+		S32 mDupeCount;
+		S32 mCRCChangeCount;
+		U32 mOffset;	// of the packed object data in the file
+		S32 mSize;
+		U32 mDataCRC;	// of the packed object data, checked on the first hit
+	};
+
 	LLVOCacheEntry(U32 local_id, U32 crc, LLDataPackerBinaryBuffer &dp);
-	LLVOCacheEntry(LLAPRFile* apr_file);
+	// Views the data of record in file without copying it
+	LLVOCacheEntry(const FileRecord& record, LLVOCacheFile* file);
 	LLVOCacheEntry();
 	~LLVOCacheEntry();
 
@@ -51,7 +83,14 @@ public:
 	S32 getCRCChangeCount() const	{ return mCRCChangeCount; }
 
 	void dump() const;
-	BOOL writeToFile(LLAPRFile* apr_file) const;
+	void getFileRecord(FileRecord& record) const;
+	const U8* getData() const		{ return mDP.getBuffer(); }
+	S32 getDataSize() const			{ return mDP.getBufferSize(); }
+	// Offset of the data in the region cache file, 0 if it is not in the file
+	U32 getFileOffset() const		{ return mFileOffset; }
+	void setFileOffset(U32 offset, U32 data_crc);
+	// Copies data viewed in a cache file, so that the file can be replaced
+	void detachFile();
 	void assignCRC(U32 crc, LLDataPackerBinaryBuffer &dp);
 	LLDataPackerBinaryBuffer *getDP(U32 crc);
 	void recordHit();
@@ -67,15 +106,35 @@ protected:
 	S32							mDupeCount;
 	S32							mCRCChangeCount;
 	LLDataPackerBinaryBuffer	mDP;
-	U8							*mBuffer;
+	U8							*mBuffer;		// NULL when viewing mFile
+	LLPointer<LLVOCacheFile>	mFile;
+	U32							mFileOffset;
+	U32							mDataCRC;
+	BOOL						mDataValidated;
 };
 
 //
-//Note: LLVOCache is not thread-safe
+//Note: LLVOCache is not thread-safe. Once initCache() has run, the cache
+//files are only read and written by the object cache thread, and the main
+//thread goes through the asynchronous interface below.
 //
 class LLVOCache
 {
 private:
+	class IOThread;
+	class ReadRequest;
+	class WriteRequest;
+	class RemoveRequest;
+
+	struct PreloadInfo
+	{
+		PreloadInfo() : mDone(FALSE) {}
+		BOOL mDone;
+		LLUUID mCacheID;
+		LLVOCacheEntry::vocache_entry_map_t mEntries;
+	};
+	typedef std::map<U64, PreloadInfo> preload_map_t;
+
 	struct HeaderEntryInfo
 	{
 		HeaderEntryInfo() : mIndex(0), mHandle(0), mTime(0) {}
@@ -114,13 +173,30 @@ public:
 	void initCache(ELLPath location, U32 size, U32 cache_version) ;
 	void removeCache(ELLPath location) ;
 
-	void readFromCache(U64 handle, const LLUUID& id, LLVOCacheEntry::vocache_entry_map_t& cache_entry_map) ;
-	void writeToCache(U64 handle, const LLUUID& id, const LLVOCacheEntry::vocache_entry_map_t& cache_entry_map, BOOL dirty_cache) ;
-	void removeEntry(U64 handle) ;
+	// Asynchronous interface, main thread only. Requests are run in order.
+	// Starts reading the cache file of the region, unless it is already read.
+	void preloadRegion(U64 handle) ;
+	// FALSE while the cache file of the region is being read. Then moves the
+	// entries read to cache_entry_map if they belong to region cache id.
+	BOOL getPreloadedRegion(U64 handle, const LLUUID& id, LLVOCacheEntry::vocache_entry_map_t& cache_entry_map) ;
+	void discardPreloadedRegion(U64 handle) ;
+	// Hands the entries over to be written (if dirty_cache) and deleted,
+	// cache_entry_map is left empty.
+	void saveRegion(U64 handle, const LLUUID& id, LLVOCacheEntry::vocache_entry_map_t& cache_entry_map, BOOL dirty_cache) ;
+	void removeRegion(U64 handle) ;
 
 	void setReadOnly(BOOL read_only) {mReadOnly = read_only;} 
 
 private:
+	// Object cache thread
+	// id is set to the cache ID of the region the entries belong to
+	void readFromCache(U64 handle, LLUUID& id, LLVOCacheEntry::vocache_entry_map_t& cache_entry_map) ;
+	void writeToCache(U64 handle, const LLUUID& id, const LLVOCacheEntry::vocache_entry_map_t& cache_entry_map, BOOL dirty_cache) ;
+	void removeEntry(U64 handle) ;
+	void readCompleted(U64 handle, const LLUUID& id, LLVOCacheEntry::vocache_entry_map_t& cache_entry_map) ;
+	void addRequest(LLQueuedThread::QueuedRequest* req) ;
+
+
 	void setDirNames(ELLPath location);	
 	// determine the cache filename for the region from the region handle	
 	void getObjectCacheFilename(U64 handle, std::string& filename);
@@ -132,6 +208,10 @@ private:
 	void removeEntry(HeaderEntryInfo* entry) ;
 	void purgeEntries(U32 size);
 	BOOL updateEntry(const HeaderEntryInfo* entry);
+	// Appends the entries not in the region file yet along with a new index,
+	// or rewrites the whole file when it is missing or mostly dead data
+	BOOL writeRegionFile(const std::string& filename, const LLUUID& id, const LLVOCacheEntry::vocache_entry_map_t& cache_entry_map);
+	BOOL rewriteRegionFile(const std::string& filename, const LLUUID& id, const LLVOCacheEntry::vocache_entry_map_t& cache_entry_map);
 	
 private:
 	BOOL                 mEnabled;
@@ -146,6 +226,11 @@ private:
 	header_entry_queue_t mHeaderEntryQueue;
 	handle_entry_map_t   mHandleEntryMap;	
 
+	IOThread*            mThread;
+	LLAtomic32<S32>      mPendingRequests;
+	LLMutex              mPreloadMutex;
+	preload_map_t        mPreloads; // protected by mPreloadMutex
+
 	static LLVOCache* sInstance ;
 public:
 	static LLVOCache* getInstance() ;
@@ -405,7 +405,7 @@ U32 LLVOVolume::processUpdateMessage(LLMessageSystem *mesgsys,
 
 				if(LLVOCache::hasInstance() && getRegion())
 				{
-					LLVOCache::getInstance()->removeEntry(getRegion()->getHandle()) ;
+					LLVOCache::getInstance()->removeRegion(getRegion()->getHandle()) ;
 				}
 				
 				llwarns << "Bogus TE data in " << getID() << llendl;
@@ -3942,6 +3942,10 @@ void LLVolumeGeometryManager::rebuildGeom(LLSpatialGroup* group)
 		
 			rebuildMesh(group);
 		}
+		else if (group->isState(LLSpatialGroup::MESH_DIRTY) && gPipeline.getGeometryPool())
+		{ //generate the mesh ahead of the draw pools calling rebuildMesh
+			gPipeline.getGeometryPool()->queueGroup(group);
+		}
 		return;
 	}
 
@@ -3950,6 +3954,11 @@ void LLVolumeGeometryManager::rebuildGeom(LLSpatialGroup* group)
 
 	LLFastTimer ftm2(FTM_REBUILD_VOLUME_VB);
 
+	if (group->isState(LLSpatialGroup::GEOM_QUEUED))
+	{ //faces are about to move, land the queued mesh first
+		gPipeline.getGeometryPool()->finishGroup(group);
+	}
+
 	group->clearDrawMap();
 
 	mFaceList.clear();
@@ -4343,6 +4352,10 @@ void LLVolumeGeometryManager::rebuildGeom(LLSpatialGroup* group)
 	if (LLPipeline::sDelayVBUpdate)
 	{
 		group->setState(LLSpatialGroup::MESH_DIRTY | LLSpatialGroup::NEW_DRAWINFO);
+		if (gPipeline.getGeometryPool())
+		{
+			gPipeline.getGeometryPool()->queueGroup(group);
+		}
 	}
 
 	mFaceList.clear();
@@ -4357,6 +4370,12 @@ void LLVolumeGeometryManager::rebuildMesh(LLSpatialGroup* group)
 	if (group && group->isState(LLSpatialGroup::MESH_DIRTY) && !group->isState(LLSpatialGroup::GEOM_DIRTY))
 	{
 		LLFastTimer tm(FTM_VOLUME_GEOM);
+
+		if (group->isState(LLSpatialGroup::GEOM_QUEUED))
+		{ //upload what the workers generated, anything left is rebuilt below
+			gPipeline.getGeometryPool()->finishGroup(group);
+		}
+
 		S32 num_mapped_veretx_buffer = LLVertexBuffer::sMappedCount ;
 
 		group->mBuilt = 1.f;
@@ -4437,6 +4456,472 @@ void LLVolumeGeometryManager::rebuildMesh(LLSpatialGroup* group)
 	llassert(!group || !group->isState(LLSpatialGroup::NEW_DRAWINFO));
 }
 
+static LLFastTimer::DeclareTimer FTM_VOLUME_GEOM_QUEUE("Queue Volume Geometry");
+static LLFastTimer::DeclareTimer FTM_VOLUME_GEOM_UPLOAD("Upload Volume Geometry");
+
+LLVolumeGeometryPool::LLVolumeGeometryPool(U32 num_threads)
+: mCondition(NULL),
+  mQueued(0),
+  mNumThreads(num_threads)
+{
+}
+
+LLVolumeGeometryPool::~LLVolumeGeometryPool()
+{
+	shutdown();
+	for_each(mWorkers.begin(), mWorkers.end(), DeletePointer());
+	mWorkers.clear();
+
+	for (std::list<Job*>::iterator iter = mJobs.begin(); iter != mJobs.end(); ++iter)
+	{
+		Job* job = *iter;
+		job->mGroup->clearState(LLSpatialGroup::GEOM_QUEUED);
+		ll_aligned_free_16(job->mData);
+		delete job;
+	}
+	mJobs.clear();
+	mQueue.clear();
+}
+
+void LLVolumeGeometryPool::shutdown()
+{
+	for (U32 i = 0; i < mWorkers.size(); ++i)
+	{
+		mWorkers[i]->shutdown();
+	}
+}
+
+static S32 staging_size(S32 count, S32 element_size)
+{
+	return (count*element_size + 0xF) & ~0xF;
+}
+
+BOOL LLVolumeGeometryPool::queueGroup(LLSpatialGroup* group)
+{
+	if (!mNumThreads || group->isDead())
+	{
+		return FALSE;
+	}
+
+	LLFastTimer t(FTM_VOLUME_GEOM_QUEUE);
+
+	if (mWorkers.empty())
+	{ //groups are only queued with delayed VB updates, start the workers with the first one
+		for (U32 i = 0; i < mNumThreads; ++i)
+		{
+			mWorkers.push_back(new Worker(this, i));
+		}
+		for (U32 i = 0; i < mWorkers.size(); ++i)
+		{
+			mWorkers[i]->start();
+		}
+	}
+
+	if (group->isState(LLSpatialGroup::GEOM_QUEUED))
+	{ //one job per group, land the queued one if there is more to generate
+		BOOL rebuild = FALSE;
+		for (LLSpatialGroup::element_iter drawable_iter = group->getData().begin(); drawable_iter != group->getData().end(); ++drawable_iter)
+		{
+			LLDrawable* drawablep = *drawable_iter;
+			LLVOVolume* vobj = drawablep->getVOVolume();
+			if (!drawablep->isDead() && drawablep->isState(LLDrawable::REBUILD_ALL) &&
+				vobj && !vobj->isFlexible())
+			{
+				rebuild = TRUE;
+				break;
+			}
+		}
+
+		if (!rebuild)
+		{
+			return TRUE;
+		}
+
+		finishGroup(group);
+	}
+
+	Job* job = new Job;
+	job->mGroup = group;
+	job->mData = NULL;
+	job->mState = Job::QUEUED;
+	S32 size = 0;
+
+	for (LLSpatialGroup::element_iter drawable_iter = group->getData().begin(); drawable_iter != group->getData().end(); ++drawable_iter)
+	{
+		LLDrawable* drawablep = *drawable_iter;
+		if (drawablep->isDead() || !drawablep->isState(LLDrawable::REBUILD_ALL))
+		{
+			continue;
+		}
+
+		LLVOVolume* vobj = drawablep->getVOVolume();
+		if (!vobj || vobj->isFlexible())
+		{ //flexible volumes change every frame, leave them to rebuildMesh()
+			continue;
+		}
+
+		vobj->preRebuild();
+
+		LLVolume* volume = vobj->getVolume();
+		for (S32 i = 0; i < drawablep->getNumFaces(); ++i)
+		{
+			LLFace* face = drawablep->getFace(i);
+			if (!face || !face->getVertexBuffer())
+			{
+				continue;
+			}
+
+			job->mFaces.push_back(FaceJob());
+			FaceJob& face_job = job->mFaces.back();
+			LLFace::GeometryParams& params = face_job.mParams;
+			if (!face->getGeometryParams(*volume, face->getTEOffset(),
+					vobj->getRelativeXform(), vobj->getRelativeXformInvTrans(), face->getGeomIndex(), params))
+			{
+				job->mFaces.pop_back();
+				continue;
+			}
+
+			face_job.mDrawable = drawablep;
+			face_job.mFaceIndex = i;
+			face_job.mBuffer = face->getVertexBuffer();
+			face_job.mGeomIndex = face->getGeomIndex();
+			face_job.mGeomCount = face->getGeomCount();
+			face_job.mIndicesIndex = face->getIndicesStart();
+			face_job.mIndicesCount = face->getIndicesCount();
+
+			//colors are written 4 at a time
+			S32 num_vertices = (params.mNumVertices + 3) & ~3;
+			for (S32 type = 0; type < LLVertexBuffer::TYPE_MAX; ++type)
+			{
+				face_job.mOffset[type] = -1;
+			}
+			face_job.mIndexOffset = -1;
+
+			if (params.mRebuildIndices)
+			{
+				face_job.mIndexOffset = size;
+				size += staging_size(params.mNumIndices, sizeof(U16));
+			}
+			if (params.mRebuildTCoord)
+			{
+				face_job.mOffset[LLVertexBuffer::TYPE_TEXCOORD0] = size;
+				size += staging_size(num_vertices, LLVertexBuffer::sTypeSize[LLVertexBuffer::TYPE_TEXCOORD0]);
+				if (params.mRebuildBump)
+				{
+					face_job.mOffset[LLVertexBuffer::TYPE_TEXCOORD1] = size;
+					size += staging_size(num_vertices, LLVertexBuffer::sTypeSize[LLVertexBuffer::TYPE_TEXCOORD1]);
+				}
+			}
+			if (params.mRebuildPos)
+			{
+				face_job.mOffset[LLVertexBuffer::TYPE_VERTEX] = size;
+				size += staging_size(num_vertices, LLVertexBuffer::sTypeSize[LLVertexBuffer::TYPE_VERTEX]);
+			}
+			if (params.mRebuildNormal)
+			{
+				face_job.mOffset[LLVertexBuffer::TYPE_NORMAL] = size;
+				size += staging_size(num_vertices, LLVertexBuffer::sTypeSize[LLVertexBuffer::TYPE_NORMAL]);
+			}
+			if (params.mRebuildBinormal)
+			{
+				face_job.mOffset[LLVertexBuffer::TYPE_BINORMAL] = size;
+				size += staging_size(num_vertices, LLVertexBuffer::sTypeSize[LLVertexBuffer::TYPE_BINORMAL]);
+			}
+			if (params.mRebuildWeights)
+			{
+				face_job.mOffset[LLVertexBuffer::TYPE_WEIGHT4] = size;
+				size += staging_size(num_vertices, LLVertexBuffer::sTypeSize[LLVertexBuffer::TYPE_WEIGHT4]);
+			}
+			if (params.mRebuildColor)
+			{
+				face_job.mOffset[LLVertexBuffer::TYPE_COLOR] = size;
+				size += staging_size(num_vertices, LLVertexBuffer::sTypeSize[LLVertexBuffer::TYPE_COLOR]);
+			}
+		}
+
+		job->mVolumes.push_back(volume);
+		drawablep->clearState(LLDrawable::REBUILD_ALL);
+	}
+
+	if (job->mFaces.empty())
+	{
+		delete job;
+		return FALSE;
+	}
+
+	job->mData = (U8*) ll_aligned_malloc_16(size);
+	group->setState(LLSpatialGroup::GEOM_QUEUED);
+	mJobs.push_back(job);
+
+	{
+		LLMutexLock lock(&mCondition);
+		mQueue.push_back(job);
+		mQueued++;
+	}
+
+	for (U32 i = 0; i < mWorkers.size(); ++i)
+	{
+		mWorkers[i]->wake();
+	}
+
+	return TRUE;
+}
+
+void LLVolumeGeometryPool::finishGroup(LLSpatialGroup* group)
+{
+	for (std::list<Job*>::iterator iter = mJobs.begin(); iter != mJobs.end(); ++iter)
+	{
+		Job* job = *iter;
+		if (job->mGroup == group)
+		{
+			mJobs.erase(iter);
+			waitForJob(job);
+			uploadJob(job);
+			return;
+		}
+	}
+
+	group->clearState(LLSpatialGroup::GEOM_QUEUED);
+}
+
+void LLVolumeGeometryPool::drain(F32 max_dtime)
+{
+	LLTimer update_timer;
+
+	std::list<Job*>::iterator iter = mJobs.begin();
+	while (iter != mJobs.end() && update_timer.getElapsedTimeF32() < max_dtime)
+	{
+		Job* job = *iter;
+		bool done;
+		{
+			LLMutexLock lock(&mCondition);
+			done = job->mState == Job::DONE;
+		}
+
+		if (done)
+		{
+			iter = mJobs.erase(iter);
+			uploadJob(job);
+		}
+		else
+		{
+			++iter;
+		}
+	}
+}
+
+void LLVolumeGeometryPool::sync()
+{
+	LLMutexLock lock(&mCondition);
+
+	//help with the queued jobs rather than wait for them
+	Job* job;
+	while ((job = popJob()) != NULL)
+	{
+		mCondition.unlock();
+		runJob(job);
+		mCondition.lock();
+		job->mState = Job::DONE;
+	}
+
+	for (std::list<Job*>::iterator iter = mJobs.begin(); iter != mJobs.end(); ++iter)
+	{
+		while ((*iter)->mState != Job::DONE)
+		{
+			mCondition.wait();
+		}
+	}
+}
+
+void LLVolumeGeometryPool::finish()
+{
+	sync();
+
+	while (!mJobs.empty())
+	{
+		Job* job = mJobs.front();
+		mJobs.pop_front();
+		uploadJob(job);
+	}
+}
+
+LLVolumeGeometryPool::Job* LLVolumeGeometryPool::popJob()
+{
+	// mCondition must be locked here
+	if (mQueue.empty())
+	{
+		return NULL;
+	}
+
+	Job* job = mQueue.front();
+	mQueue.pop_front();
+	mQueued--;
+	job->mState = Job::RUNNING;
+	return job;
+}
+
+void LLVolumeGeometryPool::runJob(Job* job)
+{
+	// no LLFastTimer here, this may run on a worker
+	for (U32 i = 0; i < job->mFaces.size(); ++i)
+	{
+		const FaceJob& face_job = job->mFaces[i];
+		const LLFace::GeometryParams& params = face_job.mParams;
+		U8* data = job->mData;
+
+		if (params.mRebuildIndices)
+		{
+			params.genIndices((U16*) (data + face_job.mIndexOffset));
+		}
+		if (params.mRebuildTCoord)
+		{
+			LLVector2* tex_coords = (LLVector2*) (data + face_job.mOffset[LLVertexBuffer::TYPE_TEXCOORD0]);
+			params.genTexCoords(tex_coords);
+			if (params.mRebuildBump)
+			{
+				params.genBumpTexCoords(tex_coords, (LLVector2*) (data + face_job.mOffset[LLVertexBuffer::TYPE_TEXCOORD1]));
+			}
+		}
+		if (params.mRebuildPos)
+		{
+			params.genPositions((LLVector4a*) (data + face_job.mOffset[LLVertexBuffer::TYPE_VERTEX]));
+		}
+		if (params.mRebuildNormal)
+		{
+			params.genNormals((LLVector4a*) (data + face_job.mOffset[LLVertexBuffer::TYPE_NORMAL]));
+		}
+		if (params.mRebuildBinormal)
+		{
+			params.genBinormals((LLVector4a*) (data + face_job.mOffset[LLVertexBuffer::TYPE_BINORMAL]));
+		}
+		if (params.mRebuildWeights)
+		{
+			params.genWeights((LLVector4a*) (data + face_job.mOffset[LLVertexBuffer::TYPE_WEIGHT4]));
+		}
+		if (params.mRebuildColor)
+		{
+			params.genColors((LLColor4U*) (data + face_job.mOffset[LLVertexBuffer::TYPE_COLOR]));
+		}
+	}
+}
+
+void LLVolumeGeometryPool::jobDone(Job* job)
+{
+	LLMutexLock lock(&mCondition);
+	job->mState = Job::DONE;
+	mCondition.signal();
+}
+
+void LLVolumeGeometryPool::waitForJob(Job* job)
+{
+	LLMutexLock lock(&mCondition);
+	if (job->mState == Job::QUEUED)
+	{ //no worker has started it, faster to run it here
+		mQueue.erase(std::find(mQueue.begin(), mQueue.end(), job));
+		mQueued--;
+		job->mState = Job::RUNNING;
+
+		mCondition.unlock();
+		runJob(job);
+		mCondition.lock();
+		job->mState = Job::DONE;
+	}
+
+	while (job->mState != Job::DONE)
+	{
+		mCondition.wait();
+	}
+}
+
+void LLVolumeGeometryPool::uploadJob(Job* job)
+{
+	LLFastTimer t(FTM_VOLUME_GEOM_UPLOAD);
+
+	LLSpatialGroup* group = job->mGroup;
+	group->clearState(LLSpatialGroup::GEOM_QUEUED);
+
+	for (U32 i = 0; i < job->mFaces.size() && !group->isDead(); ++i)
+	{
+		const FaceJob& face_job = job->mFaces[i];
+		const LLFace::GeometryParams& params = face_job.mParams;
+		LLDrawable* drawablep = face_job.mDrawable;
+		if (drawablep->isDead())
+		{
+			continue;
+		}
+
+		LLFace* face = face_job.mFaceIndex < drawablep->getNumFaces() ? drawablep->getFace(face_job.mFaceIndex) : NULL;
+		if (!face ||
+			face->getVertexBuffer() != face_job.mBuffer ||
+			face->getGeomIndex() != face_job.mGeomIndex ||
+			face->getIndicesStart() != face_job.mIndicesIndex)
+		{ //face moved since it was queued, regenerate it
+			drawablep->setState(LLDrawable::REBUILD_ALL);
+			group->dirtyMesh();
+			continue;
+		}
+
+		LLVertexBuffer* buffer = face_job.mBuffer;
+		if (params.mRebuildIndices)
+		{
+			U8* dst = buffer->mapIndexBuffer(face_job.mIndicesIndex, face_job.mIndicesCount, true);
+			memcpy(dst, job->mData + face_job.mIndexOffset, params.mNumIndices*sizeof(U16));
+			buffer->setBuffer(0);
+		}
+
+		for (S32 type = 0; type < LLVertexBuffer::TYPE_MAX; ++type)
+		{
+			if (face_job.mOffset[type] >= 0)
+			{
+				U8* dst = buffer->mapVertexBuffer(type, face_job.mGeomIndex, face_job.mGeomCount, true);
+				memcpy(dst, job->mData + face_job.mOffset[type], params.mNumVertices*LLVertexBuffer::sTypeSize[type]);
+				buffer->setBuffer(0);
+			}
+		}
+	}
+
+	ll_aligned_free_16(job->mData);
+	delete job;
+}
+
+LLVolumeGeometryPool::Worker::Worker(LLVolumeGeometryPool* owner, S32 index)
+: LLThread(llformat("volume geometry %d", index)),
+  mOwner(owner)
+{
+}
+
+//virtual
+bool LLVolumeGeometryPool::Worker::runCondition()
+{
+	// mRunCondition must be locked here
+	return mOwner->mQueued > 0;
+}
+
+//virtual
+void LLVolumeGeometryPool::Worker::run()
+{
+	while (1)
+	{
+		// blocks until there is a job to start, or we are quitting
+		checkPause();
+		if (isQuitting())
+		{
+			break;
+		}
+
+		Job* job;
+		{
+			LLMutexLock lock(&mOwner->mCondition);
+			job = mOwner->popJob();
+		}
+		if (job)
+		{
+			mOwner->runJob(job);
+			mOwner->jobDone(job);
+		}
+	}
+}
+
 struct CompareBatchBreakerModified
 {
 	bool operator()(const LLFace* const& lhs, const LLFace* const& rhs)
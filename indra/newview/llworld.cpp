@@ -648,6 +648,9 @@ void LLWorld::updateRegions(F32 max_update_time)
 		 iter != mRegionList.end(); ++iter)
 	{
 		LLViewerRegion* regionp = *iter;
+		// Not subject to the time limit, the simulator waits on it
+		regionp->updateObjectCacheLoad();
+
 		F32 max_time = max_update_time - update_timer.getElapsedTimeF32();
 		if (did_one && max_time <= 0.f)
 			break;
@@ -363,6 +363,8 @@ LLPipeline::LLPipeline() :
 	mRenderDebugFeatureMask(0),
 	mRenderDebugMask(0),
 	mOldRenderDebugMask(0),
+	mCullPool(NULL),
+	mGeometryPool(NULL),
 	mGroupQ1Locked(false),
 	mGroupQ2Locked(false),
 	mLastRebuildPool(NULL),
@@ -398,9 +400,15 @@ void LLPipeline::init()
 	sUseTriStrips = gSavedSettings.getBOOL("RenderUseTriStrips");
 	LLVertexBuffer::sUseStreamDraw = gSavedSettings.getBOOL("RenderUseStreamVBO");
 	LLVertexBuffer::sPreferStreamDraw = gSavedSettings.getBOOL("RenderPreferStreamDraw");
+	LLVertexBuffer::sUseStreamRing = gSavedSettings.getBOOL("RenderStreamRingBuffer");
+	LLVertexBuffer::sUseDynamicRing = gSavedSettings.getBOOL("RenderDynamicRingBuffer");
+	LLVertexBuffer::sUseStaticPool = gSavedSettings.getBOOL("RenderStaticBufferPool");
 	sRenderAttachedLights = gSavedSettings.getBOOL("RenderAttachedLights");
 	sRenderAttachedParticles = gSavedSettings.getBOOL("RenderAttachedParticles");
 
+	mCullPool = new LLSpatialCullPool(llmin(gSavedSettings.getU32("RenderCullThreadCount"), (U32) 8));
+	mGeometryPool = new LLVolumeGeometryPool(llmin(gSavedSettings.getU32("RenderGeometryThreadCount"), (U32) 8));
+
 	mInitialized = TRUE;
 	
 	stop_glerror();
@@ -534,6 +542,12 @@ void LLPipeline::cleanup()
 
 	mMovedBridge.clear();
 
+	delete mCullPool;
+	mCullPool = NULL;
+
+	delete mGeometryPool;
+	mGeometryPool = NULL;
+
 	mInitialized = FALSE;
 }
 
@@ -1983,19 +1997,14 @@ void LLPipeline::updateCull(LLCamera& camera, LLCullResult& result, S32 water_cl
 
 	LLGLDepthTest depth(GL_TRUE, GL_FALSE);
 
+	//the cull pool sets up the water clip plane of each region for the
+	//frustum and occlusion passes of its partitions
+	camera.disableUserClipPlane();
+
 	for (LLWorld::region_list_t::const_iterator iter = LLWorld::getInstance()->getRegionList().begin(); 
 			iter != LLWorld::getInstance()->getRegionList().end(); ++iter)
 	{
 		LLViewerRegion* region = *iter;
-		if (water_clip != 0)
-		{
-			LLPlane plane(LLVector3(0,0, (F32) -water_clip), (F32) water_clip*region->getWaterHeight());
-			camera.setUserClipPlane(plane);
-		}
-		else
-		{
-			camera.disableUserClipPlane();
-		}
 
 		for (U32 i = 0; i < LLViewerRegion::NUM_PARTITIONS; i++)
 		{
@@ -2004,13 +2013,14 @@ void LLPipeline::updateCull(LLCamera& camera, LLCullResult& result, S32 water_cl
 			{
 				if (hasRenderType(part->mDrawableType))
 				{
-					part->cull(camera);
+					part->reboundOctree();
+					mCullPool->addPartition(part, water_clip, region->getWaterHeight());
 				}
 			}
 		}
 	}
 
-	camera.disableUserClipPlane();
+	mCullPool->cull(camera);
 
 	if (hasRenderType(LLPipeline::RENDER_TYPE_SKY) && 
 		gSky.mVOSkyp.notNull() && 
@@ -2189,6 +2199,8 @@ void LLPipeline::rebuildPriorityGroups()
 	mGroupQ1.clear();
 	mGroupQ1Locked = false;
 
+	//upload finished meshes, about 20ms per second
+	mGeometryPool->drain(0.02f*gFrameIntervalSeconds);
 }
 		
 void LLPipeline::rebuildGroups()
@@ -2246,6 +2258,9 @@ void LLPipeline::updateGeom(F32 max_dtime)
 
 	assertInitialized();
 
+	//volumes are updated below
+	mGeometryPool->sync();
+
 	if (sDelayedVBOEnable > 0)
 	{
 		if (--sDelayedVBOEnable <= 0)
@@ -5953,6 +5968,11 @@ void LLPipeline::resetVertexBuffers(LLDrawable* drawable)
 
 void LLPipeline::resetVertexBuffers()
 {	
+	if (mGeometryPool)
+	{
+		mGeometryPool->finish();
+	}
+
 	for (LLWorld::region_list_t::const_iterator iter = LLWorld::getInstance()->getRegionList().begin(); 
 			iter != LLWorld::getInstance()->getRegionList().end(); ++iter)
 	{
@@ -5998,6 +6018,9 @@ void LLPipeline::resetVertexBuffers()
 	sUseTriStrips = gSavedSettings.getBOOL("RenderUseTriStrips");
 	LLVertexBuffer::sUseStreamDraw = gSavedSettings.getBOOL("RenderUseStreamVBO");
 	LLVertexBuffer::sPreferStreamDraw = gSavedSettings.getBOOL("RenderPreferStreamDraw");
+	LLVertexBuffer::sUseStreamRing = gSavedSettings.getBOOL("RenderStreamRingBuffer");
+	LLVertexBuffer::sUseDynamicRing = gSavedSettings.getBOOL("RenderDynamicRingBuffer");
+	LLVertexBuffer::sUseStaticPool = gSavedSettings.getBOOL("RenderStaticBufferPool");
 	LLVertexBuffer::sEnableVBOs = gSavedSettings.getBOOL("RenderVBOEnable");
 	LLVertexBuffer::sDisableVBOMapping = LLVertexBuffer::sEnableVBOs && gSavedSettings.getBOOL("RenderVBOMappingDisable") ;
 	sBakeSunlight = gSavedSettings.getBOOL("RenderBakeSunlight");
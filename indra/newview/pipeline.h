@@ -56,6 +56,8 @@ class LLTextureEntry;
 class LLRenderFunc;
 class LLCubeMap;
 class LLCullResult;
+class LLSpatialCullPool;
+class LLVolumeGeometryPool;
 class LLVOAvatar;
 class LLGLSLShader;
 class LLCurlRequest;
@@ -217,6 +219,7 @@ public:
 	void updateGL();
 	void rebuildPriorityGroups();
 	void rebuildGroups();
+	LLVolumeGeometryPool* getGeometryPool() const { return mGeometryPool; }
 
 	//calculate pixel area of given box from vantage point of given camera
 	static F32 calcPixelArea(LLVector3 center, LLVector3 size, LLCamera& camera);
@@ -592,6 +595,9 @@ protected:
 	U32						mRenderDebugMask;
 
 	U32						mOldRenderDebugMask;
+
+	LLSpatialCullPool*		mCullPool; // runs the frustum checks of updateCull()
+	LLVolumeGeometryPool*	mGeometryPool; // generates volume meshes ahead of rebuildMesh()
 	
 	/////////////////////////////////////////////
 	//
@@ -31,6 +31,7 @@
 
 #include "llsdtraits.h"
 #include "llstring.h"
+#include "llformat.h"
 
 namespace tut
 {
@@ -753,6 +754,81 @@ namespace tut
 		ensure("type is a string", v.isString());
 	}
 
+	template<> template<>
+	void SDTestObject::test<15>()
+		// lookups by C string, on small maps (scanned) and large ones
+	{
+		for (int size = 1; size <= 20; size += 19)
+		{
+			LLSD v;
+			for (int i = 0; i < size; ++i)
+			{
+				v[llformat("key%02d", i * 2)] = i;
+			}
+			const LLSD& c = v;
+			ensure_equals("first key", c["key00"].asInteger(), 0);
+			ensure_equals("last key", c[llformat("key%02d", (size - 1) * 2).c_str()].asInteger(), size - 1);
+			ensure("missing key between", !c.has("key01") && c["key01"].isUndefined());
+			ensure("missing key before", !c.has("a") && c["a"].isUndefined());
+			ensure("missing key after", !c.has("z") && c["z"].isUndefined());
+			ensure("prefix of a key", !c.has("key") && c["key"].isUndefined());
+
+			v["key00"] = "changed";
+			ensure_equals("updated in place", v.size(), size);
+			ensure_equals("updated value", c["key00"].asString(), std::string("changed"));
+			v["key01"] = true;
+			ensure_equals("inserted", v.size(), size + 1);
+			ensure("inserted value", c.has("key01") && c["key01"].asBoolean());
+		}
+
+		LLSD scalar = 5;
+		const LLSD& c = scalar;
+		ensure("scalar has no keys", !c.has("key") && c["key"].isUndefined());
+	}
+
+	template<> template<>
+	void SDTestObject::test<16>()
+		// copies share nested containers, writes copy only what they touch
+	{
+		SDCleanupCheck check;
+
+		LLSD event;
+		event["body"]["agents"][0]["name"] = "first";
+		event["body"]["agents"][1]["name"] = "second";
+		event["pump"] = "test";
+
+		std::vector<LLSD> listeners;
+		{
+			SDAllocationCheck check("copies to listeners", 0);
+			listeners.resize(10, event);
+			for (int i = 0; i < 10; ++i)
+			{
+				listeners.push_back(event);
+			}
+		}
+
+		{
+			// top level map and the new value
+			SDAllocationCheck check("adding a key to a copy", 2);
+			listeners[0]["reqid"] = 1;
+		}
+		const LLSD& original = event;
+		const std::vector<LLSD>& copies = listeners;
+		ensure("original unaltered", !original.has("reqid"));
+
+		{
+			// top map, body map, agents array, agent map and the new value
+			SDAllocationCheck check("writing deep into a copy", 5);
+			listeners[1]["body"]["agents"][0]["name"] = "changed";
+		}
+		ensureTypeAndValue("original deep value unaltered",
+			original["body"]["agents"][0]["name"], "first");
+		ensureTypeAndValue("other copy deep value unaltered",
+			copies[2]["body"]["agents"][0]["name"], "first");
+		ensureTypeAndValue("copy deep value changed",
+			copies[1]["body"]["agents"][0]["name"], "changed");
+	}
+
 	/* TO DO:
 		conversion of undefined to UUID, Date, URI and Binary
 		conversion of undefined to map and array